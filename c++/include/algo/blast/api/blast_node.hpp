@@ -36,6 +36,7 @@
 
 #include <algo/blast/core/blast_export.h>
 #include <algo/blast/api/blast_aux.hpp>
+#include <util/line_reader.hpp>
 
 BEGIN_NCBI_SCOPE
 BEGIN_SCOPE(blast)
@@ -106,12 +107,15 @@ public :
 	 string & GetNodeIdStr() { return m_NodeIdStr;}
 	 int GetNumOfQueries() {return m_NumOfQueries;}
 	 int GetQueriesLength() {return m_QueriesLength;}
+	 /// Number of hits (gapped extensions) of the searches of the node
+	 Int8 GetNumHits() {return m_NumHits;}
 protected:
    	virtual ~CBlastNode(void);
    	virtual void* Main(void) = 0;
 	void SetState(EState state) { m_State = state; }
 	void SetStatus(int status) { m_Status = status; }
 	void SetQueriesLength(int l) { m_QueriesLength = l;}
+	void AddNumHits(Int8 n) { m_NumHits += n;}
 	void SetDataLoaderPrefix();
 	int m_NodeNum;
 private:
@@ -125,6 +129,7 @@ private:
 	EState m_State;
 	int m_Status;
 	int m_QueriesLength;
+	Int8 m_NumHits;
 	string m_DataLoaderPrefix;
 };
 
@@ -136,6 +141,7 @@ public:
 	typedef map<int, CRef<CBlastNodeMailbox> > TPostOffice;
 	typedef map<int, CRef<CBlastNode> > TRegisteredNodes;
 	typedef map<int, double> TActiveNodes;
+	typedef map<int, int> TNodeThreads;
 	typedef map<int, CRef<CBlastNodeMsg> > TFormatQueue;
 	void RegisterNode(CBlastNode * node, CBlastNodeMailbox * mailbox);
 	int GetNumNodes() { return m_RegisteredNodes.size();}
@@ -154,9 +160,14 @@ public:
 	~CBlastMasterNode() {}
 	int GetNumOfQueries() { return m_NumQueries; }
 	Int8 GetQueriesLength() { return m_QueriesLength; }
+	Int8 GetNumHits() { return m_NumHits; }
 	int GetNumErrStatus() { return m_NumErrStatus; }
+	/// Time (in seconds) each of the threads spent running nodes
+	const vector<double> & GetThreadBusyTimes() { return m_ThreadBusyTimes; }
 private:
 	void x_WaitForNewEvent();
+	/// Returns the index of a thread not running any node
+	int x_GetIdleThread();
 
 	CNcbiOstream & m_OutputStream;
 	int m_MaxNumThreads;
@@ -171,6 +182,10 @@ private:
 	int m_NumErrStatus;
 	int m_NumQueries;
 	Int8 m_QueriesLength;
+	Int8 m_NumHits;
+	/// Thread running each active node
+	TNodeThreads m_NodeThreads;
+	vector<double> m_ThreadBusyTimes;
 };
 
 
@@ -178,15 +193,60 @@ class NCBI_XBLAST_EXPORT CBlastNodeInputReader : public CStreamLineReader
 {
 public:
 
-	CBlastNodeInputReader(CNcbiIstream& is, int batch_size, int est_avg_len) :
-		CStreamLineReader(is), m_QueryBatchSize(batch_size), m_EstAvgQueryLength(est_avg_len), m_QueryCount(0) {}
+	CBlastNodeInputReader(CNcbiIstream& is, int batch_size, int est_avg_len);
 
 	int GetQueryBatch(string & queries, int & query_no);
 
+	/// Set the size (in residues) of the next batches
+	void SetQueryBatchSize(int batch_size) { m_QueryBatchSize = batch_size; }
+	int GetQueryBatchSize() const { return m_QueryBatchSize; }
+
+	/// Size (in bytes) of the input not read yet
+	/// @return -1 if the input is not seekable
+	Int8 GetRemainingInputSize() const;
+
 private:
-	const int m_QueryBatchSize;
+	int m_QueryBatchSize;
 	const int m_EstAvgQueryLength;
 	int m_QueryCount;
+	/// Size of the input, -1 if unknown
+	Int8 m_InputSize;
+};
+
+/// Sizes the query batches of the nodes (-mt_mode 1).  Batch sizes are in
+/// residues.  Once batches complete, the next ones target as many hits as the
+/// first one had at the default size, with the hits to residues ratio mixed
+/// over the completed batches as CBatchSizeMixer does within a thread; hit
+/// rich queries are thus spread over smaller batches.  Near the end of the
+/// input the batches shrink so that the threads finish at about the same
+/// time.
+class NCBI_XBLAST_EXPORT CBlastNodeBatchScheduler
+{
+public:
+	/// @param batch_size Default batch size [in]
+	/// @param num_threads Number of threads running the nodes [in]
+	CBlastNodeBatchScheduler(int batch_size, int num_threads);
+
+	/// Account for the batches completed so far
+	/// @param queries_length Total length of the queries searched [in]
+	/// @param num_hits Total number of hits found [in]
+	void Update(Int8 queries_length, Int8 num_hits);
+
+	/// Size of the next batch
+	/// @param remaining_input Size of the input not read yet, -1 if
+	/// unknown [in]
+	int GetBatchSize(Int8 remaining_input) const;
+
+private:
+	const int m_BatchSize;
+	const int m_NumThreads;
+	/// Mixed hits to residues ratio, negative until a batch had hits
+	double m_Ratio;
+	/// Hits targeted per batch
+	double m_TargetHits;
+	/// Totals already accounted for
+	Int8 m_QueriesLength;
+	Int8 m_NumHits;
 };
 
 END_SCOPE(blast)
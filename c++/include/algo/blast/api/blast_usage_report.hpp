@@ -98,7 +98,8 @@ public:
 		eELBJobId,
 		eELBBatchNum,
         eSRA,
-        eELBVersion
+        eELBVersion,
+        eMTThreadTimes
 	};
 
 	CBlastUsageReport();
@@ -56,6 +56,11 @@ class IQueryFactory;
 
 /// A simple realization of the DELTA-BLAST algorithm: seacrch domain database,
 /// compute PSSM, search sequence database
+///
+/// If the environment variable DELTABLAST_CDD_CACHE names a directory, the
+/// conserved domain hits and the PSSM computed for each query are stored
+/// there, keyed by the query residues, the domain database version and the
+/// search options, and reused instead of searching the domain database again.
 class NCBI_XBLAST_EXPORT CDeltaBlast : public CObject, public CThreadable
 {
 public:
@@ -124,6 +129,21 @@ protected:
     /// @return Domain database search results
     CRef<CSearchResultSet> x_FindDomainHits(void);
 
+    /// Find the domain cache file names for all queries and read the
+    /// entries that are present
+    /// @param opts Options for the domain database search [in]
+    /// @param query_data Queries to search [in]
+    /// @param cached Cached domain search results, an empty reference for
+    /// each query that is not in the cache [out]
+    void x_LoadDomainCache(const CBlastOptionsHandle& opts,
+                           ILocalQueryData& query_data,
+                           vector< CRef<CSearchResults> >& cached);
+
+    /// Save domain search results and PSSM for a single query in the
+    /// domain cache
+    /// @param index Query index [in]
+    void x_SaveDomainCache(size_t index);
+
     /// Perform sanity checks on input parameters
     void x_Validate(void);
 
@@ -149,6 +169,12 @@ private:
     /// Conseved domain search (intermediate) results
     CRef<CSearchResultSet> m_DomainResults;
 
+    /// Domain cache file for each query, empty if the query is not cached
+    vector<string> m_DomainCacheFiles;
+
+    /// PSSMs read from the domain cache, empty for queries not found there
+    vector< CRef<CPssmWithParameters> > m_CachedPssm;
+
     /// Pssm-protein search results
     CRef<CSearchResultSet> m_Results;
 };
@@ -117,6 +117,14 @@ public:
 	m_batch_num_str = string("B") + NStr::NumericToString( batch_num );
     }
 
+    /// Render the results of a database search with the given writer
+    /// instead of converting them to Seq-aligns
+    /// (@sa CBlastTracebackSearch::SetHSPResultsWriter)
+    /// @param writer Writer to use [in]
+    void SetHSPResultsWriter(CRef<IBlastHSPResultsWriter> writer) {
+        m_HSPResultsWriter = writer;
+    }
+
 private:
     /// Query factory from which to obtain the query sequence data
     CRef<IQueryFactory> m_QueryFactory;
@@ -147,6 +155,9 @@ private:
     // current batch number
     std::string m_batch_num_str;
 
+    /// Writer handed to the traceback stage, if any
+    CRef<IBlastHSPResultsWriter> m_HSPResultsWriter;
+
     friend class ::CBlastFilterTest;
     friend class CBl2Seq;
 };
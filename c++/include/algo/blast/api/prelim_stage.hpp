@@ -50,6 +50,9 @@
 BEGIN_NCBI_SCOPE
 BEGIN_SCOPE(blast)
 
+class CQuerySplitter;
+class CSplitQueryBlk;
+
 /// Search class to perform the preliminary stage of the BLAST search
 class NCBI_XBLAST_EXPORT CBlastPrelimSearch : public CObject, public CThreadable
 {
@@ -77,6 +80,16 @@ public:
                        BlastSeqSrc* seqsrc,
                        CConstRef<objects::CPssmWithParameters> pssm = null);
 
+    /// Constructor which takes a PSSM and an already initialized BlastSeqSrc
+    /// object, and only seeds alignments with words that lie within the
+    /// given query ranges (used by incremental PSI-BLAST iterations)
+    /// @note we don't own the BlastSeqSrc
+    CBlastPrelimSearch(CRef<IQueryFactory> query_factory,
+                       CRef<CBlastOptions> options,
+                       BlastSeqSrc* seqsrc,
+                       CConstRef<objects::CPssmWithParameters> pssm,
+                       const vector<TSeqRange>& seed_ranges);
+
     /// Borrow the internal data and results results. 
     CRef<SInternalData> Run();
 
@@ -146,16 +159,38 @@ private:
     /// @param pssm PSSM to initialize PSI-BLAST
     /// @param seqsrc Wrapper for source of database sequences [in]
     /// @param num_threads Number of threads to use [in]
+    /// @param seed_ranges Query ranges to which the lookup table is
+    /// restricted, or NULL to use the whole query [in]
     void x_Init(CRef<IQueryFactory> query_factory,
                 CRef<CBlastOptions> options,
                 CConstRef<objects::CPssmWithParameters> pssm,
                 BlastSeqSrc* seqsrc,
-                size_t num_threads = 1);
+                size_t num_threads = 1,
+                const vector<TSeqRange>* seed_ranges = NULL);
 
     /// Runs the preliminary search in multi-threaded mode
     /// @param internal_data internal preliminary data structures
     int x_LaunchMultiThreadedSearch(SInternalData& internal_data);
 
+    /// Cost model choosing how the threads are used when the query is split:
+    /// returns the number of threads searching the database with the same
+    /// query chunk.  GetNumberOfThreads() means the query chunks are searched
+    /// one after the other, each by all threads (database split only), 1
+    /// means each thread searches whole query chunks (query split only).
+    /// @param num_chunks Number of query chunks [in]
+    size_t x_GetNumThreadsPerQueryChunk(size_t num_chunks);
+
+    /// Runs the preliminary search of a split query with a single pool of
+    /// threads, the tiles of work being a query chunk searched against a
+    /// chunk of the database
+    /// @param query_splitter Splitter of the query [in]
+    /// @param split_query_blk Split query information [in]
+    /// @param threads_per_chunk Number of threads searching the database with
+    /// the same query chunk [in]
+    void x_RunQueryChunkTiles(CQuerySplitter& query_splitter,
+                              CSplitQueryBlk& split_query_blk,
+                              size_t threads_per_chunk);
+
     bool x_BuildStdSegList( vector<list<CRef<CStd_seg> > >  & list );
 
     /// Query factory is retained to ensure the lifetime of the data (queries)
@@ -118,6 +118,23 @@ public:
     /// Accessor for the most recently used PSSM
     CConstRef<objects::CPssmWithParameters> GetPssm() const;
 
+    /// Enables incremental iterations. Once a new PSSM is set with SetPssm,
+    /// only the words overlapping PSSM columns whose scores changed by more
+    /// than threshold since the previous call to Run seed new alignments.
+    /// The alignments of the previous iteration that avoid the changed
+    /// columns are kept, rescored with the new PSSM and its statistics, and
+    /// merged with the new alignments of their subjects.
+    /// If the PSSM scores did not change, the previous results are returned
+    /// as they are; if most columns changed, the whole database is searched
+    /// again. Incremental iterations only apply to database searches
+    /// without composition based statistics, as these adjust the scores of
+    /// every subject. They are faster but may not reproduce the results of
+    /// a full search exactly; they are disabled by default.
+    /// @param threshold largest change in a PSSM score that leaves its
+    /// column unchanged, or a negative value to always search the whole
+    /// database [in]
+    void SetIncrementalThreshold(int threshold);
+
     /// Run the PSI-BLAST engine for one iteration
     CRef<CSearchResultSet> Run();
 
@@ -149,6 +166,7 @@ private:
  * @param opts_handle PSI-BLAST options [in]
  * @param diagnostics_req Optional requests for diagnostics data from the PSSM
  * engine [in]
+ * @param num_threads Number of threads used by the PSSM engine [in]
  * @todo add overloaded function which takes a blast::SSeqLoc
  */
 NCBI_XBLAST_EXPORT
@@ -158,7 +176,8 @@ PsiBlastComputePssmFromAlignment(const objects::CBioseq& query,
                                  CRef<objects::CScope> database_scope,
                                  const CPSIBlastOptionsHandle& opts_handle,
                                  CConstRef<CBlastAncillaryData> ancillary_data,
-                                 PSIDiagnosticsRequest* diagnostics_req = 0);
+                                 PSIDiagnosticsRequest* diagnostics_req = 0,
+                                 size_t num_threads = 1);
 
 END_SCOPE(blast)
 END_NCBI_SCOPE
@@ -36,6 +36,7 @@
  
 #include <corelib/ncbiobj.hpp>
 #include <algo/blast/api/blast_aux.hpp>
+#include <algo/blast/api/setup_factory.hpp>     // for CThreadable
 #include <algo/blast/api/pssm_input.hpp>
 #include <algo/blast/api/blast_exception.hpp>
 #include <algo/blast/api/blast_results.hpp> // for CBlastAncillaryData
@@ -96,7 +97,7 @@ public:
 /// ...
 /// @endcode
 
-class NCBI_XBLAST_EXPORT CPssmEngine : public CObject
+class NCBI_XBLAST_EXPORT CPssmEngine : public CObject, public CThreadable
 {
 public:
     /// Constructor to configure the PSSM engine with a PSSM input data
@@ -72,11 +72,10 @@ public:
 	 * 									 threads if the input database support
 	 * 								     threadable search
 	 * 					1 = Force non-threaded search
-	 * 					Note: If the input num of threads > max number of threads
-	 * 					      supported by a particaular database, the num of threads
-	 * 						  is kept to the max num supported by the database.
-	 * 						  If the target database does not support threaded search,
-	 * 						  value of the num of threads is ignored.
+	 * 					Note: If the input num of threads > number of database
+	 * 					      volumes, the queries are split into groups and each
+	 * 						  volume is searched by several threads, one per
+	 * 						  group of queries (at most one per query).
 	 */
     CLocalRPSBlast(CRef<CBlastQueryVector> query_vector,
               	  	  const string & db,
@@ -75,6 +75,17 @@ SeqDbBlastSeqSrcInit(CSeqDB * seqdb,
                      Int4 mask_algo_id  = -1,
                      ESubjectMaskingType mask_type = eNoSubjMasking);
 
+/** Give a sequence source created by SeqDbBlastSeqSrcInit its own chunk
+ * bookmark, so that it iterates over the database independently of the other
+ * sequence sources sharing its CSeqDB object.  The bookmark is shared with the
+ * copies of the sequence source made afterwards (e.g.: one per search thread).
+ * @param seq_src Sequence source to modify [in|out]
+ * @return false if seq_src is not a BLAST database sequence source
+ */
+NCBI_XBLAST_EXPORT
+bool
+SeqDbBlastSeqSrcSetPrivateChunkBookmark(BlastSeqSrc* seq_src);
+
 END_SCOPE(blast)
 END_NCBI_SCOPE
 
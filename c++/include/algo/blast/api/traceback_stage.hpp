@@ -52,6 +52,45 @@ BEGIN_SCOPE(blast)
 // Forward declaration
 class IBlastSeqInfoSrc;
 
+/// Interface for consumers which render the results of the traceback stage
+/// directly from the HSPs, without creating Seq-aligns for them.
+class NCBI_XBLAST_EXPORT IBlastHSPResultsWriter : public CObject
+{
+public:
+    /// Destructor
+    virtual ~IBlastHSPResultsWriter() {}
+
+    /// Write the results of a database search
+    /// @param results HSPs found by the traceback, ordered by query [in]
+    /// @param query_data Query sequences and their Seq-locs [in]
+    /// @param queries Concatenated query sequence data [in]
+    /// @param query_info Offsets of the query contexts [in]
+    /// @param seqdb BLAST database which was searched [in]
+    /// @param program BLAST program type [in]
+    virtual void Write(BlastHSPResults* results,
+                       ILocalQueryData& query_data,
+                       const BLAST_SequenceBlk* queries,
+                       const BlastQueryInfo* query_info,
+                       CSeqDB& seqdb,
+                       EBlastProgramType program) = 0;
+};
+
+/// Convert the HSPs of a database search to Seq-aligns the same way as
+/// CBlastTracebackSearch::Run does, e.g. for HSPs which an
+/// IBlastHSPResultsWriter saved and which were read back later.
+/// @param results HSPs of the search, ordered by query [in]
+/// @param query_data Query sequences and their Seq-locs [in]
+/// @param seqinfo_src Source of the subject Seq-ids and lengths [in]
+/// @param options Options the search was run with [in]
+/// @param subj_masks Masks of the subjects, per query [out]
+/// @return One Seq-align-set per query
+NCBI_XBLAST_EXPORT TSeqAlignVector
+BlastHSPResultsToSeqAligns(BlastHSPResults* results,
+                           ILocalQueryData& query_data,
+                           const IBlastSeqInfoSrc& seqinfo_src,
+                           const CBlastOptions& options,
+                           vector<TSeqLocInfoVector>& subj_masks);
+
 class NCBI_XBLAST_EXPORT CBlastTracebackSearch : public CObject, public CThreadable
 {
 public:
@@ -88,6 +127,11 @@ public:
     /// Sets the m_DBscanInfo field.
     void SetDBScanInfo(CRef<SDatabaseScanData> dbscan_info);
 
+    /// Hand the HSPs of a database search to a writer instead of converting
+    /// them to Seq-aligns; the result set then holds empty alignments.
+    /// @param writer Writer to use, or null to create Seq-aligns [in]
+    void SetHSPResultsWriter(CRef<IBlastHSPResultsWriter> writer);
+
     /// Retrieve any error/warning messages that occurred during the search
     TSearchMessages GetSearchMessages() const;
 
@@ -132,6 +176,9 @@ private:
     /// Tracks information from database scanning phase.  Right now only used
     /// for the number of occurrences of a pattern in phiblast run.
     CRef<SDatabaseScanData> m_DBscanInfo;
+
+    /// Writer which consumes the HSPs directly, if any
+    CRef<IBlastHSPResultsWriter> m_HSPResultsWriter;
 };
 
 
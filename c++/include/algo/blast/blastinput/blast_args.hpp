@@ -1073,6 +1073,8 @@ public:
 
         /// unaligned reads in magicblast
         eFasta,
+        /// Binary columnar hit table, 21
+        eHitTable,
         /// Sentinel value for error checking
         eEndValue
         
@@ -1338,6 +1340,28 @@ private:
     bool m_IsRemote;
 };
 
+/// Argument class to request a search which does not use the object manager:
+/// the FASTA queries are searched as read and the tabular report is written
+/// straight from the HSPs and the BLAST database
+class NCBI_BLASTINPUT_EXPORT CLeanSearchArgs : public IBlastCmdLineArgs
+{
+public:
+    /// Default constructor
+    CLeanSearchArgs() : m_IsLean(false) {}
+    /** Interface method, \sa IBlastCmdLineArgs::SetArgumentDescriptions */
+    virtual void SetArgumentDescriptions(CArgDescriptions& arg_desc);
+    /** Interface method, \sa IBlastCmdLineArgs::SetArgumentDescriptions */
+    virtual void ExtractAlgorithmOptions(const CArgs& cmd_line_args,
+                                         CBlastOptions& options);
+
+    /// Return whether the search should be run without the object manager
+    bool UseLeanSearch() const { return m_IsLean; }
+
+private:
+    /// Should the search be run without the object manager?
+    bool m_IsLean;
+};
+
 /// Argument class to collect debugging options.
 /// Only show in command line if compiled with _BLAST_DEBUG
 class NCBI_BLASTINPUT_EXPORT CDebugArgs : public IBlastCmdLineArgs
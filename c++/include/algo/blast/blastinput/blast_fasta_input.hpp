@@ -138,12 +138,29 @@ public:
 
     void SetParseSeqIds(bool val) {m_ParseSeqIds = val;}
 
+    /// Store the sequences in ncbi4na rather than IUPACna, so that they are
+    /// encoded as they are read (possibly in a background thread, see
+    /// CBlastInputOMF::SetPrefetch) rather than during the query setup
+    void SetEncodeSequences(bool val) {m_EncodeSequences = val;}
+
+    /// Read protein sequences (stored in ncbieaa, or ncbistdaa if they are
+    /// encoded) rather than nucleotide ones
+    void SetProtein(bool val) {m_IsProtein = val;}
+
+    /// When the defline ids are not parsed, use the first word of the
+    /// defline as a local id rather than a generated number
+    void SetLocalIdsFromDeflines(bool val) {m_LocalIdsFromDeflines = val;}
+
 private:
     CShortReadFastaInputSource(const CShortReadFastaInputSource&);
     CShortReadFastaInputSource& operator=(const CShortReadFastaInputSource&);
 
     CTempString x_ParseDefline(CTempString& line);
 
+    /// Set the length and sequence data of a Bioseq
+    void x_SetSequenceData(CBioseq& bioseq, const char* sequence,
+                           TSeqPos length);
+
     /// Read sequences in FASTA or FASTQ format
     void x_ReadFastaOrFastq(CBioseq_set& bioseq_set);
 
@@ -160,7 +177,9 @@ private:
     /// on a single line separated by '><'
     void x_ReadFastc(CBioseq_set& bioseq_set);
 
-    CRef<CSeq_id> x_GetNextSeqId(void);
+    /// Local id for a sequence whose defline id is not parsed
+    /// @param defline_id First word of the defline [in]
+    CRef<CSeq_id> x_GetNextSeqId(const CTempString& defline_id);
 
     /// Number of bases added so far
     TSeqPos m_BasesAdded;
@@ -178,6 +197,12 @@ private:
     unsigned int m_Id;
     /// Should defline ids be used Bioseq objects
     bool m_ParseSeqIds;
+    /// Should sequences be stored in ncbi4na
+    bool m_EncodeSequences;
+    /// Are the sequences proteins
+    bool m_IsProtein;
+    /// Should unparsed defline ids be used as local ids
+    bool m_LocalIdsFromDeflines;
 };
 
 
@@ -444,16 +444,24 @@ public:
     CBlastInputOMF(CBlastInputSourceOMF* source,
                    TSeqPos batch_size);
 
+    ~CBlastInputOMF();
+
     void GetNextSeqBatch(CBioseq_set& bioseq_set);
     CRef<CBioseq_set> GetNextSeqBatch(void);
 
+    /// Read the next batch of sequences in a background thread while the
+    /// current one is being searched.  The source must not be used directly
+    /// while this object reads from it.
+    void SetPrefetch(bool val) {m_Prefetch = val;}
+    bool GetPrefetch(void) const {return m_Prefetch;}
+
     void SetBatchSize(TSeqPos num) {m_BatchSize = num;}
     TSeqPos GetBatchSize(void) const {return m_BatchSize;}
 
     void SetMaxBatchNumSeqs(TSeqPos num) {m_MaxNumSequences = num;}
     TSeqPos GetMaxBatchNumSeqs(void) const {return m_MaxNumSequences;}
 
-    bool End(void) {return m_Source->End();}
+    bool End(void);
 
     Int8 GetNumSeqsProcessed() const { return m_NumSeqs; }
     Int8 GetTotalLengthProcessed() const { return m_TotalLength; }
@@ -462,11 +470,32 @@ private:
     CBlastInputOMF(const CBlastInputOMF& rhs);
     CBlastInputOMF& operator=(const CBlastInputOMF& rhs);
 
+    /// Thread reading the next batch of sequences
+    class CPrefetchThread;
+
+    /// Read a batch of sequences from the source
+    /// @param batch_size Minimum number of bases in the batch [in]
+    /// @param max_num_seqs Maximum number of sequences in the batch [in]
+    /// @param bioseq_set Read sequences are appended there [in|out]
+    /// @param num_seqs Number of sequences read [out]
+    /// @param num_bases Number of bases read [out]
+    void x_ReadSeqBatch(TSeqPos batch_size, TSeqPos max_num_seqs,
+                        CBioseq_set& bioseq_set, TSeqPos& num_seqs,
+                        TSeqPos& num_bases);
+
+    /// Start reading the next batch in the background
+    void x_StartPrefetch(void);
+
     CBlastInputSourceOMF* m_Source;
     TSeqPos m_BatchSize;
     TSeqPos m_MaxNumSequences;
     CRef<CBioseq_set> m_BioseqSet;
 
+    /// Read the next batch in the background?
+    bool m_Prefetch;
+    /// Thread reading the next batch, if any
+    CRef<CPrefetchThread> m_PrefetchThread;
+
     // # of seqs processed
     Int8 m_NumSeqs;
 
@@ -479,6 +479,8 @@ NCBI_BLASTINPUT_EXPORT extern const string kArgUnalignedOutput;
 NCBI_BLASTINPUT_EXPORT extern const string kArgUnalignedFormat;
 /// Argument to specify mt mode (split by db or split by queries)
 NCBI_BLASTINPUT_EXPORT extern const string kArgMTMode;
+/// Argument to run the search without the object manager
+NCBI_BLASTINPUT_EXPORT extern const string kArgLean;
 /// Argument to specify user tag for alignments (magicblast)
 NCBI_BLASTINPUT_EXPORT extern const string kArgUserTag;
 
@@ -349,6 +349,10 @@ typedef struct RPSBackboneCell {
 /** The number of regions into which the concatenated RPS blast
     database is split via bucket sorting */
 #define RPS_BUCKET_SIZE 2048
+
+/** The number of PSSM rows in each of the blocks into which the hits
+    of one bucket are grouped before they are extended */
+#define RPS_BLOCK_SIZE 64
                            
 
 /** structure used for bucket sorting offsets retrieved
@@ -384,6 +388,13 @@ typedef struct BlastRPSLookupTable {
     Int4 num_buckets;        /**< number of buckets used to sort offsets
                                   retrieved from the lookup table */
     RPSBucket *bucket_array; /**< list of buckets */
+    Boolean sort_by_block;   /**< if TRUE, the hits in each bucket are
+                                  grouped by blocks of RPS_BLOCK_SIZE PSSM
+                                  rows before they are extended */
+    BlastOffsetPair *block_buffer; /**< scratch space used for grouping
+                                        the hits of one bucket */
+    Int4 block_buffer_alloc; /**< max number of offset pairs block_buffer
+                                  can hold */
 } BlastRPSLookupTable;
   
 /** Create a new RPS blast lookup table.
@@ -318,6 +318,31 @@ PSICreatePssmWithDiagnostics(const PSIMsa* msap,
                              PSIMatrix** pssm,
                              PSIDiagnosticsResponse** diagnostics);
 
+/** Same as PSICreatePssmWithDiagnostics, but the purging of biased segments,
+ * the sequence weights and the frequency ratios are computed using multiple
+ * OpenMP threads. The PSSM does not depend on the number of threads.
+ * @param msap multiple sequence alignment data structure [in]
+ * @param options options to the PSSM engine [in]
+ * @param sbp BLAST score block structure [in|out]
+ * @param request diagnostics information request [in]
+ * @param pssm PSSM and statistical information (the latter is also returned 
+ * in the sbp->kbp_gap_psi[0]) [out]
+ * @param diagnostics diagnostics information response, expects a pointer to an
+ * uninitialized structure which will be populated with data requested in
+ * requests [in|out]
+ * @param num_threads number of OpenMP threads to be used [in]
+ * @return PSI_SUCCESS on success, otherwise one of the PSIERR_* constants
+ */
+NCBI_XBLAST_EXPORT
+int
+PSICreatePssmWithDiagnostics_MT(const PSIMsa* msap,
+                                const PSIBlastOptions* options,
+                                BlastScoreBlk* sbp,
+                                const PSIDiagnosticsRequest* request,
+                                PSIMatrix** pssm,
+                                PSIDiagnosticsResponse** diagnostics,
+                                size_t num_threads);
+
 /** Main entry point to core PSSM engine for computing CDD-based PSSMs
  * @param cd_msa information about CDs that match to query sequence [in]
  * @param options options to PSSM engine [in]
@@ -128,6 +128,9 @@ public:
     /** Old style index with superheader. */
     static const Uint4 INDEX_FORMAT_VERSION_1 = 1;
 
+    /** Index with superheader and compressed offset lists. */
+    static const Uint4 INDEX_FORMAT_VERSION_2 = 2;
+
     /** Symbolic values for endianess. */
     enum EEndianness { eLittleEndian = 0, eBigEndian };
 
@@ -265,6 +268,20 @@ public:
     */
     virtual void Save( const std::string & fname );
 
+protected:
+
+    /** Object constructor.
+
+        Used by superheaders of later index format versions that
+        share this layout.
+
+        @param n_seq number of sequences in the database volume
+        @param n_vol number of index volumes in the index for a given
+                     database volume.
+        @param version index format version
+    */
+    CIndexSuperHeader( Uint4 n_seq, Uint4 n_vol, Uint4 version );
+
 private:
 
     /// Expected size of the superheader file.
@@ -274,6 +291,52 @@ private:
     Uint4 num_vol_; //< total number of volumes in the index
 };
 
+/** Superheader for indices with compressed offset lists. 
+
+    The superheader layout is the same as for version 1; the version
+    tells that the index volumes store their offset lists compressed.
+*/
+template<> class NCBI_XBLAST_EXPORT 
+CIndexSuperHeader< CIndexSuperHeader_Base::INDEX_FORMAT_VERSION_2 >
+    : public CIndexSuperHeader< CIndexSuperHeader_Base::INDEX_FORMAT_VERSION_1 >
+{
+    /** Base class alias. */
+    typedef CIndexSuperHeader< 
+        CIndexSuperHeader_Base::INDEX_FORMAT_VERSION_1 > TBase;
+
+public:
+
+    /** Object constructor.
+
+        Reads the superheader structure from the file.
+
+        @param size actual size of the superheader file
+        @param endianness superheader file endianness
+        @param version index format version
+        @param fname index superheader file name
+        @param is input stream corresponding to superheader file
+
+        @throw CIndexSuperHeader_Exception
+    */
+    CIndexSuperHeader( 
+            size_t size, Uint4 endianness, Uint4 version, 
+            const std::string & fname, std::istream & is )
+        : TBase( size, endianness, version, fname, is )
+    {}
+
+    /** Object constructor.
+
+        Used to create a superheader object for saving.
+
+        @param n_seq number of sequences in the database volume
+        @param n_vol number of index volumes in the index for a given
+                     database volume.
+    */
+    CIndexSuperHeader( Uint4 n_seq, Uint4 n_vol )
+        : TBase( n_seq, n_vol, INDEX_FORMAT_VERSION_2 )
+    {}
+};
+
 /** Read superheader structure from the file.
 
     @param fname superheader file name
@@ -289,6 +352,7 @@ GetIndexSuperHeader( const std::string & fname );
 struct SIndexHeader
 {
     bool legacy_;               /**< This is a legacy index format. */
+    bool compressed_;           /**< Offset lists are compressed. */
 
     unsigned long hkey_width_;  /**< Size in bp of the Nmer used as a hash key. */
     unsigned long stride_;      /**< Stride used to index database locations. */
@@ -459,7 +523,11 @@ class NCBI_XBLAST_EXPORT CDbIndex : public CObject
         */
         static const unsigned long CODE_BITS = 3;       
 
-        /** Index version that this library handles. */
+        /** Index version that this library handles. 
+            VERSION is the legacy format, VERSION + 1 the format with
+            configurable stride and word size hint, and VERSION + 2 the
+            latter with compressed offset lists.
+        */
         static const unsigned char VERSION = (unsigned char)5;
 
         /** Simple record type used to specify index creation parameters.
@@ -468,6 +536,7 @@ class NCBI_XBLAST_EXPORT CDbIndex : public CObject
         {
             bool idmap;                         /**< Indicator of the index map creation. */
             bool legacy;                        /**< Indicator of the legacy index format. */
+            bool compressed;                    /**< Indicator of compressed offset lists. */
             unsigned long stride;               /**< Stride to use for stored database locations. */
             unsigned long ws_hint;              /**< Most likely word size to use for searches. */
             unsigned long hkey_width;           /**< Width of the hash key in bits. */
@@ -476,6 +545,7 @@ class NCBI_XBLAST_EXPORT CDbIndex : public CObject
             unsigned long chunk_overlap;        /**< Amount by which individual chunks overlap. */
             unsigned long report_level;         /**< Verbose index creation. */
             unsigned long max_index_size;       /**< Maximum index size in megabytes. */
+            unsigned long num_threads;          /**< Number of threads used to build the offset lists. */
 
             std::string stat_file_name;         /**< File to write index statistics into. */
         };
@@ -639,6 +709,7 @@ class NCBI_XBLAST_EXPORT CDbIndex : public CObject
         {
             unsigned long word_size;            /**< Target seed length. */
             unsigned long two_hits;             /**< Window for two-hit method (see megablast docs). */
+            unsigned long num_threads;          /**< Number of threads computing the seeds. */
         };
 
         /** Create an index object.
@@ -840,7 +911,7 @@ class NCBI_XBLAST_EXPORT CDbIndex : public CObject
                                         instead of mmap()'ing it
             @return object containing loaded index data
         */
-        template< bool LEGACY >
+        template< bool LEGACY, bool COMPRESSED >
         static CRef< CDbIndex > LoadIndex( 
                 const std::string & fname, bool nomap = false );
 
@@ -957,6 +1028,7 @@ class NCBI_XBLAST_EXPORT CDbIndex : public CObject
 class COffsetData_Base
 {
     friend class CPreOrderedOffsetIterator;
+    friend class CCompressedOffsetIterator;
 
     public:
 
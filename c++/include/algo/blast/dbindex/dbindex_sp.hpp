@@ -36,6 +36,10 @@
 #include <corelib/ncbifile.hpp>
 #include <algo/blast/dbindex/dbindex.hpp>
 
+#if NCBI_SSE >= 40
+#include <tmmintrin.h>
+#endif
+
 BEGIN_NCBI_SCOPE
 BEGIN_SCOPE( blastdbindex )
 
@@ -316,23 +320,274 @@ COffsetData< iterator_t >::COffsetData(
     }
 }
 
+//-------------------------------------------------------------------------
+/** Tables used to decode the compressed offset lists.
+    The lists are stored with group varint encoding: a group of four
+    values is stored as a control byte followed by the little endian 
+    bytes of the values. Bits 2i and 2i+1 of the control byte hold the 
+    number of bytes of the i-th value of the group minus one.
+*/
+struct SGroupVarintTables
+{
+    /** Fill in the tables. */
+    SGroupVarintTables();
+
+    Uint1 length[256];          /**< Number of bytes of the values of a group. */
+    Uint1 shuffle[256][16];     /**< Byte shuffle masks decoding a group. */
+};
+
+/** Get the tables used to decode the compressed offset lists.
+    @return the decoding tables
+*/
+const SGroupVarintTables & GetGroupVarintTables();
+
+/** Encode a sequence of values with group varint encoding.
+    The sequence is padded with 0 values to a multiple of 4.
+    @param values   [I]     the values to encode
+    @param out      [O]     the encoded data
+*/
+void EncodeGroupVarint( 
+        const std::vector< TWord > & values, std::vector< Uint1 > & out );
+
+/** Decode a group of four values one byte at a time.
+    @param ctrl     [I]     control byte of the group
+    @param data     [I]     value bytes of the group
+    @param values   [O]     the decoded values
+*/
+INLINE
+void DecodeGroupVarintScalar( Uint1 ctrl, const Uint1 * data, TWord * values )
+{
+    for( unsigned long i = 0; i < 4; ++i ) {
+        unsigned long len = ((ctrl>>(2*i))&0x3) + 1;
+        TWord value = 0;
+
+        for( unsigned long j = 0; j < len; ++j ) {
+            value += ((TWord)(*data++))<<(8*j);
+        }
+
+        values[i] = value;
+    }
+}
+
+#if NCBI_SSE >= 40
+/** Decode a group of four values with a single byte shuffle.
+    16 bytes starting at data must be readable.
+    @param tables   [I]     decoding tables
+    @param ctrl     [I]     control byte of the group
+    @param data     [I]     value bytes of the group
+    @param values   [O]     the decoded values
+*/
+INLINE
+void DecodeGroupVarintSSE( 
+        const SGroupVarintTables & tables, 
+        Uint1 ctrl, const Uint1 * data, TWord * values )
+{
+    __m128i d = _mm_loadu_si128( (const __m128i *)data );
+    __m128i mask = _mm_loadu_si128( (const __m128i *)tables.shuffle[ctrl] );
+    _mm_storeu_si128( (__m128i *)values, _mm_shuffle_epi8( d, mask ) );
+}
+#endif
+
+class CCompressedOffsetData;
+
+/** Iterator for compressed pre-ordered offset lists.
+
+    A compressed list holds the same words as the corresponding 
+    0-terminated list, in the same order, as a sequence of group varint
+    encoded values. Each pass over the list (see 
+    CPreOrderedOffsetIterator) starts with the number of words in the
+    pass. Offsets are stored as the minimum offset plus the difference 
+    from the previous offset of the pass, so the values stay small for 
+    long lists. Special offsets are stored as is.
+  */
+class CCompressedOffsetIterator
+{
+    /** Type of offset data class supported by this iterator. */
+    typedef CCompressedOffsetData TOffsetData;
+
+    public:
+
+        /** Object constructor.
+            @param offset_data  [I] offset data connected to the this object
+            @param key          [I] nmer value identifying the offset list
+            @param ws           [I] target word size
+        */
+        CCompressedOffsetIterator( 
+                const TOffsetData & offset_data, TWord key, unsigned long ws );
+
+        /** Advance the iterator.
+            @return false if the end of the current pass is reached; 
+                    true otherwise
+        */
+        bool Next();
+
+        /** Check if more data is available in the iterator.
+            @return true if more data is available; false otherwise
+        */
+        bool More() const { return more_ != 0; }
+
+        /** Iterator dereference.
+            @return the value pointed to by the interator
+        */
+        TWord Offset() const { return offset_; }
+
+    private:
+
+        /** Decode the next value of the list.
+            @return the next value
+        */
+        TWord NextValue();
+
+        const SGroupVarintTables * tables_; /**< Decoding tables. */
+        const Uint1 * curr_;    /**< Next group of values in the list. */
+        TWord values_[4];       /**< Values of the last decoded group. */
+        unsigned long value_;   /**< Index of the next value in values_. */
+        TWord left_;            /**< Number of words left in the current pass. */
+        TWord prev_;            /**< Previous offset of the current pass. */
+        TWord offset_;          /**< Current offset value. */
+        unsigned long more_;    /**< Flag indicating that more values are available. */
+        unsigned long mod_;     /**< Determines which passes to skip. */
+        unsigned long min_offset_; /**< Minimum offset used by the index. */
+};
+
+//-------------------------------------------------------------------------
+/** Offset list data for all Nmers and the corresponding hash table,
+    with compressed offset lists.
+
+    The hash table holds the byte offset of each list from the start of
+    the list data, or 0 for empty lists. The list data is padded, so 
+    that a group of values can be decoded with a single 16 byte load.
+*/
+class CCompressedOffsetData : public COffsetData_Base
+{
+    friend class CCompressedOffsetIterator;
+
+    typedef COffsetData_Base TBase;             /**< Base class alias. */
+
+    public:
+
+        /** Type used to iterate over an offset list. */
+        typedef CCompressedOffsetIterator TIterator;
+
+        /** Constructs the object by mapping to the memory segment.
+            @param map          [I/O]   points to the memory segment
+            @param hkey_width   [I]     hash key width
+            @param stride       [I]     stride of the index
+            @param ws_hint      [I]     ws_hint value of the index
+        */
+        CCompressedOffsetData( 
+                TWord ** map, unsigned long hkey_width, 
+                unsigned long stride, unsigned long ws_hint )
+            : TBase( map, hkey_width, stride, ws_hint ),
+              data_start_( 0 ), tables_( &GetGroupVarintTables() )
+        {
+            if( *map ) {
+                data_start_ = (const Uint1 *)*map;
+                *map += this->total_;
+            }
+        }
+
+    private:
+
+        const Uint1 * data_start_;          /**< Start of the list data. */
+        const SGroupVarintTables * tables_; /**< Decoding tables. */
+};
+
+//-------------------------------------------------------------------------
+INLINE
+CCompressedOffsetIterator::CCompressedOffsetIterator(
+        const TOffsetData & offset_data, TWord key, unsigned long ws )
+    : tables_( offset_data.tables_ ), curr_( 0 ), value_( 4 ), left_( 0 ),
+      min_offset_( offset_data.getMinOffset() )
+{
+    prev_ = min_offset_;
+
+    {
+        unsigned long h = offset_data.hkey_width() - 1;
+        unsigned long s = offset_data.getStride();
+        unsigned long w = offset_data.getWSHint();
+
+        more_ = (w - h)/s;
+        mod_  = (ws - h)/s;
+    }
+
+    TWord start = offset_data.hash_table_[key];
+
+    if( start != 0 ) {
+        curr_ = offset_data.data_start_ + start;
+        left_ = NextValue();
+    }
+    else more_ = 0;
+}
+
+//-------------------------------------------------------------------------
+INLINE
+TWord CCompressedOffsetIterator::NextValue()
+{
+    if( value_ == 4 ) {
+        Uint1 ctrl = *curr_++;
+#if NCBI_SSE >= 40
+        DecodeGroupVarintSSE( *tables_, ctrl, curr_, values_ );
+#else
+        DecodeGroupVarintScalar( ctrl, curr_, values_ );
+#endif
+        curr_ += tables_->length[ctrl];
+        value_ = 0;
+    }
+
+    return values_[value_++];
+}
+
+//-------------------------------------------------------------------------
+INLINE
+bool CCompressedOffsetIterator::Next()
+{
+    if( left_ == 0 ) {
+        if( more_ != 0 ) {
+            more_ = (more_ <= mod_) ? 0 : more_ - 1;
+
+            if( more_ != 0 ) {
+                left_ = NextValue();
+                prev_ = min_offset_;
+            }
+        }
+
+        return false;
+    }
+
+    --left_;
+    TWord value = NextValue();
+
+    if( value < min_offset_ ) offset_ = value;
+    else offset_ = prev_ = prev_ + (value - min_offset_);
+    return true;
+}
+
 //-------------------------------------------------------------------------
 /** Some computed type definitions.
   */
-template< bool LEGACY >
+template< bool LEGACY, bool COMPRESSED >
 struct CDbIndex_Traits
 {
     typedef COffsetData< CPreOrderedOffsetIterator > TOffsetData;
     typedef CSubjectMap TSubjectMap;
 };
 
+/** Type definitions for indices with compressed offset lists. */
+template< bool LEGACY >
+struct CDbIndex_Traits< LEGACY, true >
+{
+    typedef CCompressedOffsetData TOffsetData;
+    typedef CSubjectMap TSubjectMap;
+};
+
 /** Implementation of the BLAST database index
 */
-template< bool LEGACY >
+template< bool LEGACY, bool COMPRESSED = false >
 class CDbIndex_Impl : public CDbIndex
 {
     /** Offset data and subject map types computer. */
-    typedef CDbIndex_Traits< LEGACY > TTraits;
+    typedef CDbIndex_Traits< LEGACY, COMPRESSED > TTraits;
 
     public:
 
@@ -463,8 +718,8 @@ class CDbIndex_Impl : public CDbIndex
 };
 
 //-------------------------------------------------------------------------
-template< bool LEGACY >
-CDbIndex_Impl< LEGACY >::CDbIndex_Impl(
+template< bool LEGACY, bool COMPRESSED >
+CDbIndex_Impl< LEGACY, COMPRESSED >::CDbIndex_Impl(
         CMemoryFile * map, const SIndexHeader & header, 
         const vector< string > & idmap, TWord * data )
     : mapfile_( map ), map_start_( 0 ), version_( VERSION ),
@@ -501,8 +756,8 @@ CDbIndex_Impl< LEGACY >::CDbIndex_Impl(
 }
 
 //-------------------------------------------------------------------------
-template< bool LEGACY >
-void CDbIndex_Impl< LEGACY >::Remap()
+template< bool LEGACY, bool COMPRESSED >
+void CDbIndex_Impl< LEGACY, COMPRESSED >::Remap()
 {
     if( mapfile_ != 0 ) {
         delete subject_map_; subject_map_ = 0;
@@ -514,9 +769,9 @@ void CDbIndex_Impl< LEGACY >::Remap()
 }
 
 //-------------------------------------------------------------------------
-template< bool LEGACY >
+template< bool LEGACY, bool COMPRESSED >
 CConstRef< CDbIndex::CSearchResults > 
-CDbIndex_Impl< LEGACY >::DoSearch( 
+CDbIndex_Impl< LEGACY, COMPRESSED >::DoSearch( 
         const BLAST_SequenceBlk * query, 
         const BlastSeqLoc * locs,
         const SSearchOptions & search_options )
@@ -527,7 +782,7 @@ CDbIndex_Impl< LEGACY >::DoSearch(
 //-------------------------------------------------------------------------
 CMemoryFile * MapFile( const std::string & fname );
 
-template< bool LEGACY >
+template< bool LEGACY, bool COMPRESSED >
 CRef< CDbIndex > CDbIndex::LoadIndex( 
         const std::string & fname, bool nomap )
 {
@@ -570,7 +825,10 @@ CRef< CDbIndex > CDbIndex::LoadIndex(
         }
     }
 
-    result.Reset( new CDbIndex_Impl< LEGACY >( map, header, idmap, data ) );
+    header.compressed_ = COMPRESSED;
+    result.Reset( 
+            new CDbIndex_Impl< LEGACY, COMPRESSED >( 
+                map, header, idmap, data ) );
     return result;
 }
 
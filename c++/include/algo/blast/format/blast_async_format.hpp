@@ -51,22 +51,38 @@ USING_SCOPE(blast);
 /// Contains query, results and CBlastFormat for one batch
 struct SFormatResultValues {
 
+	/// Buffer the formatter writes to.  If set for all values of a batch,
+	/// the batch can be formatted by any thread of CBlastAsyncFormatThread,
+	/// which then copies the buffer to its output stream in batch order;
+	/// such batches must not share formatters.  Declared first, as the
+	/// formatter uses it until it is destroyed.
+	shared_ptr<CNcbiOstrstream> buffer;
 	CRef<CBlastQueryVector> qVec; ///< Queries
 	CRef<CSearchResultSet> blastResults; ///< Results
 	CRef<CBlastFormat> formatter; ///< Information for formatting
-	SFormatResultValues(CRef<CBlastQueryVector> qv, CRef<CSearchResultSet> br, CRef<CBlastFormat> fmt)
-		: qVec(qv), blastResults(br), formatter(fmt) {}
+	SFormatResultValues(CRef<CBlastQueryVector> qv, CRef<CSearchResultSet> br, CRef<CBlastFormat> fmt,
+	                    shared_ptr<CNcbiOstrstream> buf = shared_ptr<CNcbiOstrstream>())
+		: buffer(buf), qVec(qv), blastResults(br), formatter(fmt) {}
 };
 
 /////////////////////////////////////////////////////////////////////////////
 /// Run as separate thread and format results.
+///
+/// Batches whose values all carry a buffer are formatted concurrently by
+/// num_threads threads and written to the output stream in batch order.
+/// Other batches are formatted in batch order, straight to the streams of
+/// their formatters.
 class NCBI_XBLASTFORMAT_EXPORT CBlastAsyncFormatThread : public CThread
 {
 public:
-    CBlastAsyncFormatThread() 
-    : m_ResultsMap(), m_Done(false), m_Semaphore(0, kMax_Int)
-   {
-   }
+   /// Constructor
+   /// @param num_threads Number of threads formatting buffered batches [in]
+   /// @param out Stream the buffered batches are written to [in]
+   /// @param max_pending Maximum number of batches queued ahead of the
+   ///  next batch to print; QueueResults blocks until the output catches
+   ///  up.  Zero means no limit [in]
+   CBlastAsyncFormatThread(int num_threads = 1, CNcbiOstream* out = NULL,
+                           int max_pending = 0);
 
    /// Queue results for printing.
    /// Will throw if called after call to Finalize or if a duplicate
@@ -82,6 +98,7 @@ public:
 
    /// Calls Finalize (if not already called) then CThread::Join();
    /// Should only be called if QueueResults will no longer be called.
+   /// Throws if a batch could not be formatted.
    void Join();
 
 protected:
@@ -89,16 +106,51 @@ protected:
 
     virtual void* Main(void);
 private:
+    friend class CBlastFormatWorkerThread;
+
+    /// Formatting state of a queued batch
+    enum EBatchState {
+        eQueued,        ///< Not picked up yet
+        eFormatting,    ///< Being formatted
+        eFormatted      ///< Formatted into its buffers
+    };
+
+    /// A queued batch
+    struct SBatch {
+        vector<SFormatResultValues> values;
+        bool buffered;
+        EBatchState state;
+    };
+
+    /// Format buffered batches until the queue is closed and drained
+    void x_FormatBufferedBatches();
+
+    /// Format a batch, recording the first failure
+    void x_FormatBatch(int batch_number, vector<SFormatResultValues>& values);
 
     // Prohibit copy constructor and assignment operator
     CBlastAsyncFormatThread(const CBlastAsyncFormatThread&);
     CBlastAsyncFormatThread& operator= (const CBlastAsyncFormatThread&);
 
-    std::map<int, vector<SFormatResultValues>> m_ResultsMap;
+    std::map<int, SBatch> m_ResultsMap;
 
     bool m_Done;
 
-    CSemaphore m_Semaphore;
+    /// Number of threads formatting buffered batches
+    int m_NumThreads;
+    /// Stream the buffered batches are written to
+    CNcbiOstream* m_Out;
+    /// Maximum number of batches queued ahead of m_NextBatch
+    int m_MaxPending;
+    /// Number of the next batch to print
+    int m_NextBatch;
+    /// Error of the first batch which could not be formatted
+    string m_Error;
+
+    /// Guards the members above
+    CFastMutex m_Mutex;
+    /// Signalled whenever a batch is queued, formatted or printed
+    CConditionVariable m_Event;
 };
 
 #endif /* ALGO_BLAST_FORMAT___BLAST__ASYNC_FORMAT__HPP */
@@ -54,8 +54,11 @@ Author: Jason Papadopoulos
 #include <algo/blast/api/local_db_adapter.hpp>
 #include <algo/blast/api/blast_seqinfosrc.hpp>
 #include <algo/blast/format/sam.hpp>
+#include <algo/blast/format/blast_hsp_sam.hpp>
+#include <algo/blast/format/blast_hit_table.hpp>
 #include <objects/blast/blast__.hpp>
 #include <algo/blast/api/blast_usage_report.hpp>
+#include <algo/blast/api/traceback_stage.hpp>
 
 
 BEGIN_NCBI_SCOPE
@@ -320,6 +323,13 @@ public:
     void SetHitsSortOption(int hitsSortOption) {m_HitsSortOption = hitsSortOption;}
     void SetHspsSortOption(int hspsSortOption) {m_HspsSortOption = hspsSortOption;}
     void SetCustomDelimiter(string customDelim) {m_CustomDelim = customDelim;}
+
+    /// Returns a writer which renders the tabular or SAM report, or the
+    /// binary hit table, directly from the HSPs of a database search (@sa
+    /// CLocalBlast::SetHSPResultsWriter), or null if the requested report
+    /// needs the Seq-aligns
+    /// @param num_threads Number of threads rendering the rows [in]
+    CRef<blast::IBlastHSPResultsWriter> GetHSPResultsWriter(int num_threads = 1);
     
     
 
@@ -413,6 +423,11 @@ private:
 
     /// Pointer to the SAM formatting object
     unique_ptr<CBlast_SAM_Formatter> m_SamFormatter;
+    /// SAM writer handed out by GetHSPResultsWriter, flushed by PrintEpilog
+    CRef<CBlastHSPSAMWriter> m_HSPSAMWriter;
+    /// Hit table writer handed out by GetHSPResultsWriter; WriteArchive
+    /// completes its chunks and PrintEpilog closes it
+    CRef<CBlastHitTableWriter> m_HitTableWriter;
 
     string m_Cmdline;
 
@@ -529,6 +544,8 @@ private:
    void x_WriteXML2(CCmdLineBlastXML2ReportData & report_data);
 
    void x_InitSAMFormatter();
+   /// Program information for the PG header line of the SAM report
+   objects::CSAM_Formatter::SProgramInfo x_GetSAMProgramInfo() const;
    void x_PrintTaxReport(const blast::CSearchResults& results);
    void x_InitDeflineTemplates(void);
    void x_InitAlignTemplates(void);
@@ -0,0 +1,253 @@
+/* $Id$
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's offical duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*/
+
+/** @file blast_hit_table.hpp
+ * Binary, column-oriented hit table (-outfmt 21) written directly from the
+ * HSPs of a BLAST database search.
+ *
+ * The file starts with a SHitTableFileHeader and holds one chunk per query
+ * batch, followed by a zero chunk size.  A chunk is a SHitTableChunkHeader
+ * followed by its columns, each aligned on 8 bytes, in this order:
+ *
+ *   - query columns: first HSP (num_queries + 1 entries), length, Seq-id
+ *   - subject columns: ordinal id, length, Seq-id
+ *   - HSP columns: query, subject, context, score, number of identities,
+ *     number of positives, number of HSPs for sum statistics, composition
+ *     adjustment method, e-value, bit score, query offset, end and frame,
+ *     subject offset, end and frame, first edit script operation
+ *     (num_hsps + 1 entries)
+ *   - edit script operations (length << 4 | EGapAlignOpType)
+ *   - Seq-id strings, NUL terminated
+ *   - the BLAST archive (binary ASN.1) of the batch without its alignments,
+ *     which holds the queries, the search options, the masks and the
+ *     statistics needed to format the report
+ *
+ * Numbers are stored in the byte order of the writing host, so the columns
+ * can be used in place after memory mapping the file.
+*/
+
+#ifndef ALGO_BLAST_FORMAT___BLAST_HIT_TABLE__HPP
+#define ALGO_BLAST_FORMAT___BLAST_HIT_TABLE__HPP
+
+#include <algo/blast/api/traceback_stage.hpp>
+#include <algo/blast/api/blast_seqinfosrc.hpp>
+#include <objects/blast/Blast4_archive.hpp>
+#include <corelib/ncbifile.hpp>
+
+BEGIN_NCBI_SCOPE
+
+/// Header of a hit table file
+struct SHitTableFileHeader {
+    char  magic[8];         ///< "BLASTHT" followed by a NUL
+    Uint4 byte_order;       ///< 0x01020304 in the byte order of the writer
+    Uint4 version;          ///< Format version
+};
+
+/// Header of a chunk of a hit table file
+struct SHitTableChunkHeader {
+    Uint8 size;             ///< Size of the chunk, including this header
+    Uint4 num_queries;      ///< Number of queries
+    Uint4 num_subjects;     ///< Number of distinct subjects
+    Uint4 num_hsps;         ///< Number of HSPs
+    Uint4 program;          ///< EBlastProgramType of the search
+    Uint8 num_ops;          ///< Number of edit script operations
+    Uint8 strings_size;     ///< Size of the Seq-id strings
+    Uint8 archive_size;     ///< Size of the BLAST archive
+};
+
+/// Columns of one chunk of a hit table; the pointers refer to the memory
+/// mapped file
+struct SHitTableChunk {
+    /// Header of the chunk
+    const SHitTableChunkHeader* header;
+
+    const Uint4* query_first_hsp;   ///< Index of the first HSP of a query
+    const Uint4* query_length;      ///< Query length
+    const Uint4* query_id;          ///< Offset of the query Seq-id string
+
+    const Int4*  subject_oid;       ///< Subject ordinal id in the database
+    const Uint4* subject_length;    ///< Subject length
+    const Uint4* subject_id;        ///< Offset of the subject Seq-id string
+
+    const Uint4*  hsp_query;        ///< Query index
+    const Uint4*  hsp_subject;      ///< Subject index
+    const Int4*   hsp_context;      ///< Context within the query
+    const Int4*   hsp_score;        ///< Raw score
+    const Int4*   hsp_num_ident;    ///< Number of identities
+    const Int4*   hsp_num_positives;///< Number of positives
+    const Int4*   hsp_num;          ///< Number of HSPs for sum statistics
+    const Int4*   hsp_comp_adjustment_method; ///< Composition adjustment
+    const double* hsp_evalue;       ///< Expect value
+    const double* hsp_bit_score;    ///< Bit score
+    const Int4*   hsp_query_offset; ///< Query start, on the query frame
+    const Int4*   hsp_query_end;    ///< Query end, on the query frame
+    const Int4*   hsp_query_frame;  ///< Query frame
+    const Int4*   hsp_subject_offset; ///< Subject start, on its frame
+    const Int4*   hsp_subject_end;  ///< Subject end, on its frame
+    const Int4*   hsp_subject_frame;///< Subject frame
+    /// Index of the first edit script operation of an HSP; an HSP without
+    /// an edit script has none
+    const Uint8*  hsp_first_op;
+
+    const Uint4*  ops;              ///< Edit script operations
+    const char*   strings;          ///< Seq-id strings
+    const char*   archive;          ///< BLAST archive without alignments
+
+    /// Seq-id string of a query
+    const char* GetQueryId(Uint4 index) const {
+        return strings + query_id[index];
+    }
+    /// Seq-id string of a subject
+    const char* GetSubjectId(Uint4 index) const {
+        return strings + subject_id[index];
+    }
+};
+
+/// Writes the hit table.  The HSPs of a query batch are buffered by Write()
+/// and written out together with the BLAST archive of the batch by
+/// WriteChunk(); Close() terminates the file.
+class NCBI_XBLASTFORMAT_EXPORT CBlastHitTableWriter
+    : public blast::IBlastHSPResultsWriter
+{
+public:
+    /// Constructor
+    /// @param out Stream to write the table to [in]
+    CBlastHitTableWriter(CNcbiOstream& out);
+
+    /// @inheritDoc
+    virtual void Write(BlastHSPResults* results,
+                       blast::ILocalQueryData& query_data,
+                       const BLAST_SequenceBlk* queries,
+                       const BlastQueryInfo* query_info,
+                       CSeqDB& seqdb,
+                       EBlastProgramType program);
+
+    /// Write the buffered HSPs as one chunk
+    /// @param archive BLAST archive of the batch, its alignments are not
+    /// saved [in]
+    void WriteChunk(const objects::CBlast4_archive& archive);
+
+    /// Terminate the file
+    void Close(void);
+
+private:
+    /// Seq-id string of a sequence
+    /// @param ids Seq-ids of the sequence [in]
+    static string x_GetIdString(const list< CRef<objects::CSeq_id> >& ids);
+
+    /// Add a string to the chunk
+    /// @return Offset of the string
+    Uint4 x_AddString(const string& str);
+
+    /// Write the file header, if not done yet
+    void x_WriteFileHeader(void);
+
+    /// Stream the table is written to
+    CNcbiOstream& m_Out;
+    /// The file header was written
+    bool m_HeaderWritten;
+    /// Program type of the buffered HSPs
+    EBlastProgramType m_Program;
+
+    /// @name Buffered columns
+    /// @{
+    vector<Uint4> m_QueryFirstHSP;
+    vector<Uint4> m_QueryLength;
+    vector<Uint4> m_QueryId;
+    vector<Int4>  m_SubjectOid;
+    vector<Uint4> m_SubjectLength;
+    vector<Uint4> m_SubjectId;
+    vector<Uint4> m_HSPQuery;
+    vector<Uint4> m_HSPSubject;
+    vector<Int4>  m_HSPContext;
+    vector<Int4>  m_HSPScore;
+    vector<Int4>  m_HSPNumIdent;
+    vector<Int4>  m_HSPNumPositives;
+    vector<Int4>  m_HSPNum;
+    vector<Int4>  m_HSPCompAdjustment;
+    vector<double> m_HSPEvalue;
+    vector<double> m_HSPBitScore;
+    vector<Int4>  m_HSPQueryOffset;
+    vector<Int4>  m_HSPQueryEnd;
+    vector<Int4>  m_HSPQueryFrame;
+    vector<Int4>  m_HSPSubjectOffset;
+    vector<Int4>  m_HSPSubjectEnd;
+    vector<Int4>  m_HSPSubjectFrame;
+    vector<Uint8> m_HSPFirstOp;
+    vector<Uint4> m_Ops;
+    string        m_Strings;
+    /// @}
+
+    /// Indices of the subjects of the chunk, by ordinal id
+    map<int, Uint4> m_SubjectIndex;
+};
+
+/// Reads a memory mapped hit table
+class NCBI_XBLASTFORMAT_EXPORT CBlastHitTableReader : public CObject
+{
+public:
+    /// Constructor; throws if the file is not a valid hit table
+    /// @param path Path of the hit table file [in]
+    CBlastHitTableReader(const string& path);
+
+    /// Returns true if the file is a hit table
+    /// @param path Path of the file [in]
+    static bool IsHitTable(const string& path);
+
+    /// Number of chunks in the file
+    size_t GetNumChunks(void) const { return m_Chunks.size(); }
+
+    /// Columns of a chunk
+    /// @param index Index of the chunk [in]
+    const SHitTableChunk& GetChunk(size_t index) const {
+        return m_Chunks[index];
+    }
+
+    /// Convert the HSPs of a chunk to Seq-aligns, the same way as the search
+    /// which wrote them would have
+    /// @param index Index of the chunk [in]
+    /// @param query_data Queries of the chunk, from its BLAST archive [in]
+    /// @param seqinfo_src Source of the subject Seq-ids and lengths [in]
+    /// @param options Options of the search, from the BLAST archive [in]
+    /// @param subj_masks Masks of the subjects, per query [out]
+    /// @return One Seq-align-set per query
+    blast::TSeqAlignVector
+    GetSeqAligns(size_t index,
+                 blast::ILocalQueryData& query_data,
+                 const blast::IBlastSeqInfoSrc& seqinfo_src,
+                 const blast::CBlastOptions& options,
+                 vector<TSeqLocInfoVector>& subj_masks) const;
+
+private:
+    /// The memory mapped file
+    unique_ptr<CMemoryFile> m_File;
+    /// Chunks of the file
+    vector<SHitTableChunk> m_Chunks;
+};
+
+END_NCBI_SCOPE
+
+#endif /* ALGO_BLAST_FORMAT___BLAST_HIT_TABLE__HPP */
@@ -0,0 +1,162 @@
+/* $Id$
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's offical duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*/
+
+/** @file blast_hsp_sam.hpp
+ * SAM (-outfmt 17) output rendered directly from the HSPs of a blastn
+ * database search, optionally written as BGZF-compressed BAM.
+*/
+
+#ifndef ALGO_BLAST_FORMAT___BLAST_HSP_SAM__HPP
+#define ALGO_BLAST_FORMAT___BLAST_HSP_SAM__HPP
+
+#include <algo/blast/api/traceback_stage.hpp>
+#include <objtools/format/sam_formatter.hpp>
+#include <objmgr/scope.hpp>
+
+BEGIN_NCBI_SCOPE
+
+/// Writes the SAM report straight from BlastHSPResults.  The records are
+/// identical to the ones printed by CBlast_SAM_Formatter for the Seq-aligns
+/// of the same search; the CIGAR strings are built from the HSP edit
+/// scripts.  As with CSAM_Formatter, the header lists every reference
+/// sequence, so the records are buffered until Flush() is called at the end
+/// of the report.
+class NCBI_XBLASTFORMAT_EXPORT CBlastHSPSAMWriter
+    : public blast::IBlastHSPResultsWriter
+{
+public:
+    /// Constructor
+    /// @param out Stream to write the report to [in]
+    /// @param custom_spec SAM output format specification [in]
+    /// @param info Program information for the PG header line [in]
+    /// @param scope Scope holding the query sequences [in]
+    /// @param hitlist_size Maximum number of subjects per query [in]
+    /// @param num_threads Number of threads rendering the records [in]
+    CBlastHSPSAMWriter(CNcbiOstream& out,
+                       const string& custom_spec,
+                       const objects::CSAM_Formatter::SProgramInfo& info,
+                       objects::CScope& scope,
+                       int hitlist_size,
+                       int num_threads = 1);
+
+    /// Returns true if the format specification requests BAM output
+    /// @param custom_spec SAM output format specification [in]
+    static bool IsBAM(const string& custom_spec);
+
+    /// @inheritDoc
+    virtual void Write(BlastHSPResults* results,
+                       blast::ILocalQueryData& query_data,
+                       const BLAST_SequenceBlk* queries,
+                       const BlastQueryInfo* query_info,
+                       CSeqDB& seqdb,
+                       EBlastProgramType program);
+
+    /// Write the header and the buffered records
+    void Flush(void);
+
+private:
+    /// CIGAR operations and their lengths
+    typedef vector< pair<char, TSeqPos> > TCigar;
+    /// Reference sequence labels and lengths
+    typedef vector< pair<string, TSeqPos> > TRefs;
+
+    /// One alignment record
+    struct SRecord {
+        string read;            ///< Read (QNAME) label
+        string ref;             ///< Reference (RNAME) label
+        TSeqPos ref_length;     ///< Reference sequence length
+        TSeqPos pos;            ///< Zero-based reference position
+        bool reverse;           ///< Read is on the minus strand
+        /// CIGAR operations, including hard clips
+        TCigar cigar;
+        string seq;             ///< Read sequence data, empty if not printed
+        int score;              ///< Raw score, 0 if not set
+        double evalue;          ///< Expect value
+        bool has_evalue;        ///< Expect value is not a sum statistic
+        double bit_score;       ///< Bit score, negative if not set
+        double pct_identity;    ///< Percent identity
+        int num_dif;            ///< Number of inserted and deleted bases
+    };
+
+    /// Render the records for the HSPs of one subject
+    /// @param hsp_list HSPs of the subject, sorted by e-value [in]
+    /// @param query_label Label of the query [in]
+    /// @param query_length Length of the query [in]
+    /// @param q_shift Offset of the query location on its sequence [in]
+    /// @param queries Concatenated query sequence data [in]
+    /// @param query_info Offsets of the query contexts [in]
+    /// @param seqdb BLAST database [in]
+    /// @param records The rendered records [out]
+    /// @return false if the subject has no (unfiltered) Seq-ids
+    bool x_FormatHSPList(const BlastHSPList* hsp_list,
+                         const string& query_label,
+                         TSeqPos query_length,
+                         TSeqPos q_shift,
+                         const BLAST_SequenceBlk* queries,
+                         const BlastQueryInfo* query_info,
+                         CSeqDB& seqdb,
+                         vector<SRecord>& records);
+
+    /// Order the records of a query by their position on the query, then by
+    /// e-value (@sa CAlignFormatUtil::SortHspByMasterStartAscending)
+    static bool x_ComparePosition(const SRecord& a, const SRecord& b);
+
+    /// Append a record to the buffered report
+    /// @param record The record [in]
+    void x_AddRecord(const SRecord& record);
+
+    /// Compose the text header
+    string x_GetHeader(void) const;
+
+    /// Stream the report is written to
+    CNcbiOstream& m_Out;
+    /// Program information for the PG header line
+    objects::CSAM_Formatter::SProgramInfo m_ProgramInfo;
+    /// Scope holding the query sequences
+    CRef<objects::CScope> m_Scope;
+    /// The query is the reference sequence, otherwise the subject is
+    bool m_QueryIsRef;
+    /// Print the read sequence data
+    bool m_SeqData;
+    /// Write BGZF-compressed BAM rather than SAM
+    bool m_BAM;
+    /// Maximum number of subjects per query
+    int m_HitlistSize;
+    /// Number of threads rendering the records
+    int m_NumThreads;
+    /// Reference sequences in the order of their first record
+    TRefs m_Refs;
+    /// Indices of the reference sequences in m_Refs
+    map<string, int> m_RefIndex;
+    /// SAM records, or BGZF blocks of BAM records
+    string m_Body;
+    /// BAM records not yet compressed
+    string m_BAMBuffer;
+};
+
+END_NCBI_SCOPE
+
+#endif /* ALGO_BLAST_FORMAT___BLAST_HSP_SAM__HPP */
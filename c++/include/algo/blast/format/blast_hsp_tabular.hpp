@@ -0,0 +1,141 @@
+/* $Id$
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's offical duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*/
+
+/** @file blast_hsp_tabular.hpp
+ * Tabular (-outfmt 6 and 10) output rendered directly from the HSPs of a
+ * BLAST database search, without creating Seq-aligns or fetching the
+ * subject sequences through the object manager.
+*/
+
+#ifndef ALGO_BLAST_FORMAT___BLAST_HSP_TABULAR__HPP
+#define ALGO_BLAST_FORMAT___BLAST_HSP_TABULAR__HPP
+
+#include <algo/blast/api/traceback_stage.hpp>
+#include <objtools/align_format/format_flags.hpp>
+#include <objmgr/scope.hpp>
+
+BEGIN_NCBI_SCOPE
+
+/// Writes the rows of the tabular report straight from BlastHSPResults.
+/// Only the columns which can be computed from the HSPs, the query and the
+/// BLAST database headers are supported (@sa CanFormat); the rows are
+/// identical to the ones printed by CBlastTabularInfo for those columns.
+class NCBI_XBLASTFORMAT_EXPORT CBlastHSPTabularWriter
+    : public blast::IBlastHSPResultsWriter
+{
+public:
+    /// Constructor
+    /// @param out Stream to write the report to [in]
+    /// @param format_spec Tabular output format specification [in]
+    /// @param delim Field delimiter [in]
+    /// @param scope Scope holding the query sequences, NULL if the queries
+    /// are not in a scope: the query labels are then computed from the
+    /// query Seq-ids only [in]
+    /// @param believe_query Use the local query ids as they are [in]
+    /// @param hitlist_size Maximum number of subjects per query [in]
+    /// @param num_threads Number of threads rendering the rows [in]
+    CBlastHSPTabularWriter(CNcbiOstream& out,
+                           const string& format_spec,
+                           const string& delim,
+                           objects::CScope* scope,
+                           bool believe_query,
+                           int hitlist_size,
+                           int num_threads = 1);
+
+    /// Returns true if all the fields of the format specification can be
+    /// rendered by this class
+    /// @param format_spec Tabular output format specification [in]
+    static bool CanFormat(const string& format_spec);
+
+    /// @inheritDoc
+    virtual void Write(BlastHSPResults* results,
+                       blast::ILocalQueryData& query_data,
+                       const BLAST_SequenceBlk* queries,
+                       const BlastQueryInfo* query_info,
+                       CSeqDB& seqdb,
+                       EBlastProgramType program);
+
+private:
+    /// Labels of one sequence, for the supported id columns
+    struct SSeqLabels {
+        string seqid;       ///< Full Seq-id(s)
+        string acc;         ///< Accession
+        string accver;      ///< Accession.version
+        TSeqPos length;     ///< Sequence length
+    };
+
+    /// Compute the labels of a query sequence
+    /// @param query_data Query sequences [in]
+    /// @param index Index of the query [in]
+    /// @param labels The labels [out]
+    void x_GetQueryLabels(blast::ILocalQueryData& query_data, size_t index,
+                          SSeqLabels& labels);
+
+    /// Compute the labels of a subject sequence
+    /// @param seqdb BLAST database [in]
+    /// @param oid Ordinal id of the subject [in]
+    /// @param labels The labels [out]
+    /// @return false if the subject has no (unfiltered) Seq-ids
+    bool x_GetSubjectLabels(CSeqDB& seqdb, int oid, SSeqLabels& labels);
+
+    /// Render the rows for the HSPs of one subject
+    /// @param hsp_list HSPs of the subject, sorted by e-value [in]
+    /// @param query Labels of the query [in]
+    /// @param q_shift Offset of the query location on its sequence [in]
+    /// @param queries Concatenated query sequence data [in]
+    /// @param query_info Offsets of the query contexts [in]
+    /// @param seqdb BLAST database [in]
+    /// @param program BLAST program type [in]
+    /// @param rows The rendered rows [out]
+    /// @return false if the subject has no (unfiltered) Seq-ids
+    bool x_FormatHSPList(const BlastHSPList* hsp_list,
+                         const SSeqLabels& query,
+                         TSeqPos q_shift,
+                         const BLAST_SequenceBlk* queries,
+                         const BlastQueryInfo* query_info,
+                         CSeqDB& seqdb,
+                         EBlastProgramType program,
+                         string& rows);
+
+    /// Stream the report is written to
+    CNcbiOstream& m_Out;
+    /// Fields to print, in order
+    vector<align_format::ETabularField> m_Fields;
+    /// Field delimiter
+    string m_Delim;
+    /// Scope holding the query sequences, if any
+    CRef<objects::CScope> m_Scope;
+    /// Use the local query ids as they are
+    bool m_BelieveQuery;
+    /// Maximum number of subjects per query
+    int m_HitlistSize;
+    /// Number of threads rendering the rows
+    int m_NumThreads;
+};
+
+END_NCBI_SCOPE
+
+#endif /* ALGO_BLAST_FORMAT___BLAST_HSP_TABULAR__HPP */
@@ -45,6 +45,12 @@
 
 BEGIN_NCBI_SCOPE
 
+BEGIN_SCOPE(objects)
+BEGIN_SCOPE(blastxml2)
+class CBlastOutput2;
+END_SCOPE(blastxml2)
+END_SCOPE(objects)
+
 /** @addtogroup BlastFormatting
  *
  * @{
@@ -122,8 +128,8 @@ public:
 };
 
 
-/// Fills all fields in the XML BLAST v2 output object.
-/// @param bxmlout XML BLAST v2 output object [in] [out]
+/// Writes the XML BLAST v2 report. The hits are serialized one at a time
+/// as they are created, so the report is never held in memory in full.
 /// @param data Data structure containing all information necessary to
 ///             produce a BLAST XML report.[in]
 /// @param out_stream  output stream [out]
@@ -134,6 +140,15 @@ void BlastXML2_FormatReport(const IBlastXML2ReportData* data,
 NCBI_XBLASTFORMAT_EXPORT
 void BlastXML2_FormatReport(const IBlastXML2ReportData* data, string file_name);
 
+/// Fills all fields, including all the hits, in the XML BLAST v2 output
+/// object.
+/// @param bxmlout XML BLAST v2 output object [in] [out]
+/// @param data Data structure containing all information necessary to
+///             produce a BLAST XML report.[in]
+NCBI_XBLASTFORMAT_EXPORT
+void BlastXML2_FillReport(objects::blastxml2::CBlastOutput2& bxmlout,
+                          const IBlastXML2ReportData* data);
+
 NCBI_XBLASTFORMAT_EXPORT
 void BlastXML2_PrintHeader(CNcbiOstream *out_stream);
 
@@ -166,6 +166,9 @@ private:
 	/// Name of the kmer files.
 	vector<string> m_KmerFiles;
 
+	/// Memory mapped kmer files, shared read-only by the search threads.
+	vector< CRef<CMinHashFile> > m_MinHashFiles;
+
 	/// GIList to limit search by.
 	CRef<CSeqDBGiList> m_GIList;
 
@@ -217,6 +217,28 @@ void BlastKmerGetCompressedTranslationTable(vector<Uint1>& trans_table, int alph
 NCBI_XBLAST_EXPORT
 int BlastKmerGetDistance(const vector<uint32_t>& minhash1, const vector<uint32_t>& minhash2);
 
+/// Calculates the minhash signature of a kmer set with num_hashes hash
+/// functions: for each function the kmer with the smallest hash value.
+/// Several hash functions are evaluated at once in SIMD lanes if available.
+///
+/// @param kmers kmers of one sequence chunk, must not be empty [in]
+/// @param num_hashes number of hash functions [in]
+/// @param a first random numbers of the hash functions [in]
+/// @param b second random numbers of the hash functions [in]
+/// @param signature kmers with the minimum hash values [out]
+NCBI_XBLAST_EXPORT
+void BlastKmerGetMinHashSignature(const set<uint32_t>& kmers, int num_hashes, const uint32_t* a, const uint32_t* b, vector<uint32_t>& signature);
+
+/// Calculates the minhash signature of a kmer set with one hash function:
+/// the num_hashes smallest hash values in ascending order, padded with
+/// 0xffffffff if there are fewer kmers.
+///
+/// @param kmers kmers of one sequence chunk [in]
+/// @param num_hashes number of values in the signature [in]
+/// @param signature smallest hash values [out]
+NCBI_XBLAST_EXPORT
+void BlastKmerGetMinHashSignature2(const set<uint32_t>& kmers, int num_hashes, vector<uint32_t>& signature);
+
 NCBI_XBLAST_EXPORT
 bool minhash_query(const string& query,
                      vector < vector <uint32_t> >& seq_hash,
@@ -52,8 +52,10 @@ USING_SCOPE(blast);
 /// Threading class for BlastKmer searches.
 /// Each thread runs a batch of input sequences
 /// through KMER lookup and then through BLAST.
+/// The KMER lookup of a batch can itself use several threads,
+/// see SetNumberOfThreads.
 ////////////
-class NCBI_XBLAST_EXPORT CBlastKmerSearch : public CObject
+class NCBI_XBLAST_EXPORT CBlastKmerSearch : public CObject, public CThreadable
 {
 public:
     CBlastKmerSearch(CRef<IQueryFactory> queryFactory,
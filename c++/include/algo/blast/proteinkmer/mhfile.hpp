@@ -160,6 +160,13 @@ public:
     /// @param hits Vector of the hash values read from disk.
     void GetMinHits(int oid, int& subjectOid, vector<uint32_t>& hits) const;
 
+    /// Gets the database OID and the hash values for entry given by oid
+    /// in place, without copying them out of the memory mapped file.
+    /// @param oid Entry to fetch.
+    /// @param subjectOid OID of the BLAST database (for current volume)
+    /// @return GetNumHashes() values, each GetDataWidth() bytes wide.
+    const unsigned char* GetSignature(int oid, int& subjectOid) const;
+
     /// Returns the number of hash arrays.
     int GetNumSignatures() const {return (m_DataFileSize/(GetDataWidth()*GetNumHashes()+4));}
 
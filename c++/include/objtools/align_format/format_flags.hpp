@@ -169,7 +169,8 @@ NCBI_ALIGN_FORMAT_EXPORT string DescribeTabularOutputFormatSpecifiers(bool is_ig
 
 enum ESAMField {
     eSAM_SeqData = 0,			///< Include seq data
-    eSAM_SubjAsRefSeq           ///< Subject as reference seqs
+    eSAM_SubjAsRefSeq,          ///< Subject as reference seqs
+    eSAM_BAM                    ///< BGZF-compressed BAM output
 };
 
 struct SSAMFormatSpec {
@@ -54,10 +54,16 @@ public:
     /// of accessions in one-to-one correspondence.
     /// Any accessions which are not found will be assigned OIDs
     /// of kSeqDBEntryNotFound (-1).
+    /// Large batches are split across the number of threads set with
+    /// SetNumberOfThreads().
     /// @param accessions Vector of string accessions [in]
     /// @param oids Reference to vector of TOid to receive found OIDs [out]
     void GetOids(const vector<string>& accessions, vector<blastdb::TOid>& oids) const;
 
+    /// Set the number of threads used for batched accession lookups
+    /// @param num_threads Number of threads, 1 by default [in]
+    void SetNumberOfThreads(int num_threads) { m_NumThreads = max(num_threads, 1); }
+
     /// Get OIDs for single string accession.
     /// String accession may have ".version" appended.
     /// If there are no matches, oids will be returned empty.
@@ -107,6 +113,7 @@ private:
     string  m_TaxId2OffsetsFile;
     mutable bool m_LMDBFileOpened;
     blastdb::TOid m_NumOids;
+    int m_NumThreads;
 };
 
 /// Build the canonical LMDB file name for BLAST databases
@@ -744,12 +744,20 @@ CSeqDBIdxFile::GetSeqStart(int oid, TIndx & start) const
 /// this file, to reduce the number of accidental false positives
 /// during the search.  The ambiguity data encodes the location of,
 /// and actual data for, those regions.
+///
+/// A volume may instead store this data in a block compressed file
+/// (.psz or .nsz).  In that case the offsets used here still refer to
+/// the uncompressed data; the blocks covering a requested range are
+/// decompressed on demand into a cache owned by the calling thread.
 
 class CSeqDBSeqFile : public CSeqDBExtFile {
 public:
     /// Type which spans possible file offsets.
     typedef CSeqDBAtlas::TIndx TIndx;
     
+    /// Uncompressed data of a block, or of a range spanning blocks.
+    typedef CObjectFor< vector<char> > TBlock;
+    
     /// Constructor
     ///
     /// This builds an object which provides access to the sequence
@@ -758,7 +766,8 @@ public:
     /// protein file, these are just the database sequences seperated
     /// by NUL bytes.  In a nucleotide volume, the packed data for
     /// each sequence is followed by ambiguity data for that sequence
-    /// (if any such data exists).
+    /// (if any such data exists).  If the volume has no .psq or .nsq
+    /// file but a block compressed .psz or .nsz file, that is used.
     ///
     /// @param atlas
     ///   The memory management layer object.
@@ -766,14 +775,9 @@ public:
     ///   The name of the database volume.
     /// @param prot_nucl
     ///   The sequence data type.
-    /// @param locked
-    ///   The lock holder object for this thread.
     CSeqDBSeqFile(CSeqDBAtlas    & atlas,
                   const string   & dbname,
-                  char             prot_nucl)                  
-        : CSeqDBExtFile(atlas, dbname + ".-sq", prot_nucl)
-    {
-    }
+                  char             prot_nucl);
     
     /// Destructor
     virtual ~CSeqDBSeqFile()
@@ -796,35 +800,195 @@ public:
                    TIndx   start,
                    TIndx   end) const
     {
-        x_ReadBytes(buf, start, end);
+        if (m_Compressed) {
+            CRef<TBlock> block;
+            memcpy(buf, x_GetUncompressed(start, end, block),
+                   (size_t)(end - start));
+        } else {
+            x_ReadBytes(buf, start, end);
+        }
     }
     
     /// Get a pointer into the file contents.
     ///
-    /// Copy the sequence data from offsets start to end into the
-    /// array at buf, which is assumed to already have been allocated.
-    /// This method assumes the atlas lock is held.  If the user will
-    /// take ownership of the memory region hold, the keep argument
-    /// should be specified as true.
+    /// Returns a pointer to the sequence data from offsets start to
+    /// end.  For a block compressed file the pointer refers to a block
+    /// of uncompressed data, which is pinned until the pointer (or any
+    /// pointer into the same range) is passed to RetData(); eviction
+    /// from the calling thread's cache does not free a pinned block.
     ///
     /// @param start
     ///     The starting offset for the first byte to read.
     /// @param end
     ///     The offset for the first byte after the area to read.
-    /// @param keep
-    ///     True if an extra hold should be acquired on the data.
-    /// @param hold
-    ///     Specify true to get a request-duration hold.
-    /// @param locked
-    ///     The lock holder object for this thread.
     /// @return
     ///     A pointer into the file data.
-    const char * GetFileDataPtr(TIndx            start) const // commented                           
+    const char * GetFileDataPtr(TIndx start, TIndx end) const
     {
-        const char *p = (const char *)m_Lease.GetFileDataPtr(start);
-        
-        return p;        
+        if (m_Compressed) {
+            return x_GetPinned(start, end);
+        }
+        return (const char *)m_Lease.GetFileDataPtr(start);
+    }
+    
+    /// Add a pin to the block holding data.
+    ///
+    /// This allows a pointer returned by GetFileDataPtr() to be handed
+    /// out again; each pin needs its own call to RetData().  Pointers
+    /// that are not in a pinned block are ignored.
+    ///
+    /// @param datap
+    ///     A pointer into data returned by GetFileDataPtr().
+    static void RetainData(const char * datap);
+    
+    /// Release a pin on the block holding data.
+    ///
+    /// The block is freed with its last pin, unless it is still in a
+    /// thread's cache.  Pointers that are not in a pinned block (such
+    /// as those into memory mapped files) are ignored, so this may be
+    /// called with any sequence data pointer.
+    ///
+    /// @param datap
+    ///     A pointer into data returned by GetFileDataPtr().
+    static void RetData(const char * datap);
+    
+    /// Check whether the sequence data is block compressed.
+    bool IsCompressed() const
+    {
+        return m_Compressed;
+    }
+    
+    /// Get the size of the per-thread cache of uncompressed data.
+    ///
+    /// The size defaults to kSeqDBSeqCacheSize bytes and can be set
+    /// with the BLASTDB_SEQ_CACHE_SIZE environment variable (e.g.
+    /// "64MB"), which is read when a thread first uses the cache.  The
+    /// most recently used entry is kept even if it is larger.
+    ///
+    /// @return
+    ///     The cache size in bytes.
+    static size_t GetCacheSize();
+    
+private:
+    /// Choose between the raw and the block compressed sequence file.
+    ///
+    /// @param atlas
+    ///   The memory management layer object.
+    /// @param dbname
+    ///   The name of the database volume.
+    /// @param prot_nucl
+    ///   The sequence data type.
+    /// @return
+    ///   The file name template (with '-' for the sequence type).
+    static string x_GetFileName(CSeqDBAtlas  & atlas,
+                                const string & dbname,
+                                char           prot_nucl);
+    
+    /// Read and validate the header of a block compressed file.
+    void x_ReadCompressedHeader();
+    
+    /// Get the uncompressed data from offsets start to end.
+    ///
+    /// @param start
+    ///     The starting offset (in uncompressed data).
+    /// @param end
+    ///     The offset for the first byte after the area.
+    /// @param block
+    ///     Set to the cache entry holding the data.
+    /// @return
+    ///     A pointer to the data in block.
+    const char * x_GetUncompressed(TIndx          start,
+                                   TIndx          end,
+                                   CRef<TBlock> & block) const;
+    
+    /// Get the uncompressed data from offsets start to end, pinned.
+    ///
+    /// @param start
+    ///     The starting offset (in uncompressed data).
+    /// @param end
+    ///     The offset for the first byte after the area.
+    /// @return
+    ///     A pointer to the data, to be released with RetData().
+    const char * x_GetPinned(TIndx start, TIndx end) const;
+    
+    /// Decompress one block.
+    ///
+    /// @param block
+    ///     The index of the block.
+    /// @param dst
+    ///     The destination, with room for the whole block.
+    void x_DecompressBlock(Uint4 block, char * dst) const;
+    
+    /// Get the uncompressed length of a block.
+    size_t x_GetBlockLength(Uint4 block) const
+    {
+        TIndx begin = (TIndx) block * m_BlockSize;
+        return (size_t) min((TIndx) m_BlockSize, m_RawLength - begin);
+    }
+    
+    /// True if the file is block compressed.
+    bool m_Compressed;
+    
+    /// Compression method (one of ESeqDBSeqCompression).
+    Uint4 m_Method;
+    
+    /// Uncompressed size of each block (except the last).
+    Uint4 m_BlockSize;
+    
+    /// Number of compressed blocks.
+    Uint4 m_NumBlocks;
+    
+    /// Length of the uncompressed sequence data.
+    TIndx m_RawLength;
+    
+    /// Offset of the block offset table in the file.
+    TIndx m_BlockTable;
+    
+    /// Identifies this file's blocks in the per-thread caches.
+    Uint8 m_CacheId;
+};
+
+
+/// Guard for sequence data pinned by CSeqDBSeqFile::GetFileDataPtr()
+///
+/// Code that only needs the data for the duration of a scope holds it
+/// with this object, which returns it with CSeqDBSeqFile::RetData().
+
+class CSeqDBSeqDataHold {
+public:
+    /// Constructor
+    ///
+    /// @param datap
+    ///     The data to return on destruction (or NULL).
+    explicit CSeqDBSeqDataHold(const char * datap = 0)
+        : m_Data(datap)
+    {
+    }
+    
+    /// Destructor
+    ~CSeqDBSeqDataHold()
+    {
+        if (m_Data) {
+            CSeqDBSeqFile::RetData(m_Data);
+        }
     }
+    
+    /// Set the data to return on destruction.
+    void Set(const char * datap)
+    {
+        _ASSERT(m_Data == 0);
+        m_Data = datap;
+    }
+    
+private:
+    /// Prevent copy construction.
+    CSeqDBSeqDataHold(const CSeqDBSeqDataHold &);
+    
+    /// Prevent copy assignment.
+    CSeqDBSeqDataHold & operator=(const CSeqDBSeqDataHold &);
+    
+    /// The data to return.
+    const char * m_Data;
 };
 
 
@@ -338,7 +338,9 @@ public:
     /// release the lock because the sequence data is pinned down by
     /// the reference count we have acquired to return to the user.
     /// The returned sequence data is intended for blast searches, and
-    /// will contain random values in any ambiguous regions.
+    /// will contain random values in any ambiguous regions.  Data from
+    /// a block compressed volume is pinned until it is returned with
+    /// CSeqDBSeqFile::RetData().
     ///
     /// @param oid
     ///   The OID of the sequence. [in]
@@ -1024,6 +1024,14 @@ public:
     /// @return A pointer to the attached GI list, or NULL.
     const CSeqDBGiList * GetGiList() const;
 
+    /// Get negative list attached to this database.
+    ///
+    /// This returns the negative ID list passed to the top level
+    /// CSeqDB constructor, or NULL if no negative list was used.
+    ///
+    /// @return A pointer to the attached negative list, or NULL.
+    const CSeqDBNegativeList * GetNegativeList() const;
+
     /// Get IdSet list attached to this database.
     ///
     /// This returns the ID set used to filter this database. If a
@@ -1064,8 +1072,29 @@ public:
     /// Translate an Accession to a list of OIDs.
     void AccessionToOids(const string & acc, vector<int> & oids) const;
 
+    /// Translate Accessions to OIDs.
+    ///
+    /// Large lists are resolved in LMDB key order, and split across
+    /// the threads set with SetNumberOfThreads() when OpenMP is
+    /// available.  The returned vector has one
+    /// entry per input accession; accessions which are not found are
+    /// assigned kSeqDBEntryNotFound.
+    /// @param accs Accessions to translate [in]
+    /// @param oids OIDs found for each accession [out]
     void AccessionsToOids(const vector<string>& accs, vector<blastdb::TOid>& oids) const;
 
+    /// Translate Accessions to an OID mask file.
+    ///
+    /// The accessions are resolved as in AccessionsToOids(), and the
+    /// OIDs found (and not excluded by this database's filtering) are
+    /// written as an OID mask file.  The file can be kept and reused
+    /// to restrict later runs to the same set of OIDs without
+    /// repeating the lookups.
+    /// @param accs Accessions to translate [in]
+    /// @param mask_file Name of the OID mask file to create [in]
+    /// @return Number of OIDs included in the mask
+    int AccessionsToOidMaskFile(const vector<string>& accs, const string & mask_file) const;
+
     /// Translate a Seq-id to a list of OIDs.
     void SeqidToOids(const CSeq_id & seqid, vector<int> & oids) const;
 
@@ -1499,6 +1528,14 @@ public:
     /// Return blast db version
     EBlastDbVersion GetBlastDbVersion() const;
 
+    /// Get the names of the LMDB files used by this database
+    ///
+    /// This returns the names of the accession index files; the other
+    /// LMDB files share their base names.  The list is empty for
+    /// databases older than version 5.
+    /// @param lmdb_list File names [out]
+    void GetLMDBFileNames(vector<string> & lmdb_list) const;
+
     /// Get Oid list for input tax ids
     /// @param tax_ids	taxonomy ids, return only tax ids found in db
     // @param rv		oids corrpond to tax ids
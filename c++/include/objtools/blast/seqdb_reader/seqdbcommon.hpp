@@ -130,6 +130,36 @@ enum ESeqDBAllocType {
     eNew
 };
 
+/// Compression methods for block compressed sequence files.
+///
+/// A volume may store its sequence data in a .psz or .nsz file
+/// instead of the .psq or .nsq file.  The sequence data is cut into
+/// fixed size blocks which are compressed independently, so that any
+/// range can be read by decompressing only the blocks covering it.
+/// The layout is described in sequence_files.txt.
+
+enum ESeqDBSeqCompression {
+    eSeqDBSeqCompress_None = 0,
+    eSeqDBSeqCompress_Zlib = 1,
+    eSeqDBSeqCompress_Zstd = 2
+};
+
+/// Parse the name of a sequence compression method.
+/// @param name One of "none", "zlib" or "zstd" [in]
+/// @return The compression method
+/// @throws CSeqDBException if the name is not recognized
+NCBI_XOBJREAD_EXPORT
+ESeqDBSeqCompression SeqDB_ParseSeqCompression(const string & name);
+
+/// Format version of block compressed sequence files.
+const Uint4 kSeqDBSeqCompressFormat = 1;
+
+/// Default uncompressed size of the blocks of a compressed sequence file.
+const Uint4 kSeqDBSeqCompressBlockSize = 128 * 1024;
+
+/// Default size of the per-thread cache of uncompressed sequence data.
+const size_t kSeqDBSeqCacheSize = 32 * 1024 * 1024;
+
 
 typedef Uint8 TTi;
 
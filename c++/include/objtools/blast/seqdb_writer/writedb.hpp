@@ -705,6 +705,28 @@ void CWriteDB_CreateOidMaskDB(const string& input_db,
                               int oid_mask_type,
                               const string & title = string());
 
+/** Compress the sequence files of a BLAST database.
+ *
+ * The .psq or .nsq file of each volume is replaced by a .psz or .nsz
+ * file which holds the same data in independently compressed blocks.
+ * SeqDB reads such volumes transparently, decompressing only the blocks
+ * covering the sequences that are accessed.  This reduces the amount of
+ * I/O needed to scan a database, at the cost of CPU time to decompress.
+ *
+ * @param db_name name of the database to compress [in]
+ * @param seq_type type of sequences stored in the database [in]
+ * @param method compression method to use [in]
+ * @param block_size uncompressed size of each block [in]
+ * @throws CWriteDBException if a sequence file cannot be compressed
+ */
+NCBI_XOBJWRITE_EXPORT
+void CWriteDB_CompressSequenceFiles(const string& db_name,
+                                    CWriteDB::ESeqType seq_type,
+                                    ESeqDBSeqCompression method =
+                                        eSeqDBSeqCompress_Zlib,
+                                    Uint4 block_size =
+                                        kSeqDBSeqCompressBlockSize);
+
 END_NCBI_SCOPE
 
 #endif // OBJTOOLS_BLAST_SEQDB_WRITER___WRITEDB__HPP
@@ -154,6 +154,27 @@ public:
     /// A mapping from sequence identifier to blob ids.
     typedef limited_size_map<CSeq_id_Handle, int> TIdMap;
 
+    /// Hit and miss counts of the caches of decoded sequence headers and
+    /// sequence data
+    struct NCBI_XLOADER_BLASTDB_EXPORT SCacheStatistics
+    {
+        SCacheStatistics();
+
+        Uint8           m_HeaderHits;       ///< Headers found in the cache
+        Uint8           m_HeaderMisses;     ///< Headers read from the BLAST DB
+        Uint8           m_SeqDataHits;      ///< Slices found in the cache
+        Uint8           m_SeqDataMisses;    ///< Slices read from the BLAST DB
+    };
+
+    /// Get the statistics of the caches of all local BLAST DB data loaders
+    /// of this process.  Each BLAST database has one cache of the most
+    /// recently used sequence headers and sequence data slices, so the
+    /// subjects of a report are decoded once even if the scopes that
+    /// retrieved them are reset or belong to other threads.  Databases
+    /// filtered by a user ID or negative list are not shared, and get a
+    /// cache of their own.
+    static SCacheStatistics GetCacheStatistics(void);
+
     /// @note this is added to temporarily comply with the toolkit's stable
     /// components rule of having backwards compatible APIs
     NCBI_DEPRECATED
@@ -128,12 +128,37 @@ BlastSetupPreliminarySearch(CRef<IQueryFactory> query_factory,
                                          NULL, num_threads);
 }
 
+/// Restrict the query segments used to build the lookup table to the
+/// given ranges
+/// @param lookup_segments query segments to restrict, freed by this
+/// function [in]
+/// @param seed_ranges query ranges to which the segments are restricted [in]
+/// @return the intersection of both sets of ranges
+static BlastSeqLoc*
+s_RestrictLookupSegments(BlastSeqLoc* lookup_segments,
+                         const vector<TSeqRange>& seed_ranges)
+{
+    BlastSeqLoc* retval = NULL;
+    for (BlastSeqLoc* itr = lookup_segments; itr; itr = itr->next) {
+        ITERATE(vector<TSeqRange>, range, seed_ranges) {
+            const Int4 from = max(itr->ssr->left, (Int4)range->GetFrom());
+            const Int4 to = min(itr->ssr->right, (Int4)range->GetTo());
+            if (from <= to) {
+                BlastSeqLocNew(&retval, from, to);
+            }
+        }
+    }
+    BlastSeqLocFree(lookup_segments);
+    return retval;
+}
+
 CRef<SBlastSetupData>
 BlastSetupPreliminarySearchEx(CRef<IQueryFactory> qf,
                               CRef<CBlastOptions> options,
                               CConstRef<CPssmWithParameters> pssm,
                               BlastSeqSrc* seqsrc,
-                              size_t num_threads)
+                              size_t num_threads,
+                              const vector<TSeqRange>* seed_ranges)
 {
     CRef<SBlastSetupData> retval(new SBlastSetupData(qf, options));
     TSearchMessages m;
@@ -185,6 +210,10 @@ BlastSetupPreliminarySearchEx(CRef<IQueryFactory> qf,
     		NCBI_RETHROW(e, CBlastException, eCoreBlastError, e.GetMsg());
     	}
     }
+    if (seed_ranges) {
+        lookup_segments = s_RestrictLookupSegments(lookup_segments,
+                                                   *seed_ranges);
+    }
     CRef< CBlastSeqLocWrap > lookup_segments_wrap( 
             new CBlastSeqLocWrap( lookup_segments ) );
     retval->m_InternalData->m_ScoreBlk.Reset
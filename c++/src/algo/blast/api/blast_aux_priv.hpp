@@ -130,12 +130,15 @@ BlastSetupPreliminarySearch(CRef<IQueryFactory> query_factory,
 /// @param pssm PSSM [in]
 /// @param seqsrc source of database/subject sequence data [in]
 /// @param num_threads number of threads to use [in]
+/// @param seed_ranges if not NULL, only words within these query ranges are
+/// added to the lookup table [in]
 CRef<SBlastSetupData>
 BlastSetupPreliminarySearchEx(CRef<IQueryFactory> qf,
                               CRef<CBlastOptions> options,
                               CConstRef<CPssmWithParameters> pssm,
                               BlastSeqSrc* seqsrc,
-                              size_t num_threads);
+                              size_t num_threads,
+                              const vector<TSeqRange>* seed_ranges = NULL);
 
 /// Builds an CSearchResultSet::TAncillaryVector
 /// @param program BLAST program [in]
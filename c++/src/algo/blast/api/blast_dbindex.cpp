@@ -373,12 +373,15 @@ private:
     /** Reference count for the volume results.
 
         Holds results for a given volume only while there is a search
-        thread potentially in need of those results.
+        thread potentially in need of those results. The index volume
+        itself stays mapped once loaded, so that it is not mapped again
+        for every query batch.
     */
     struct SVolResults
     {
         SVolResults() : ref_count( 0 ) {}
 
+        CRef< CDbIndex > index; ///< Index volume or null.
         TVolResults res; ///< Seed set or null.
         int ref_count;   ///< How many threads still need the result set.
     };
@@ -827,18 +830,25 @@ void CIndexedDb_New::UpdateIndex( Int4 oid, Int4 * vol_idx_p )
 
     if( res.ref_count <= 0 ) {
         res.ref_count += n_threads_;
-        IDX_TRACE( "loading volume "  << new_vol_idx << ": " << vi->name );
         ASSERT( vi->has_index );
-        CRef< CDbIndex > index( CDbIndex::Load( vi->name ) );
+
+        if( res.index == 0 ) {
+            IDX_TRACE( "loading volume "  << new_vol_idx << ": " << vi->name );
+            res.index = CDbIndex::Load( vi->name );
         
-        if( index == 0 ) {
-            std::ostringstream os;
-            os << "CIndexedDb: could not load index volume: " << vi->name;
-            NCBI_THROW( CIndexedDbException, eIndexInitError, os.str() );
+            if( res.index == 0 ) {
+                std::ostringstream os;
+                os << "CIndexedDb: could not load index volume: " << vi->name;
+                NCBI_THROW( CIndexedDbException, eIndexInitError, os.str() );
+            }
         }
 
+        // The other search threads wait for the seeds of this volume, so
+        // all of them are used to compute the seeds.
+        //
         IDX_TRACE( "searching volume " << vi->name );
-        res.res = index->Search( queries_, locs_wrap_->getLocs(), sopt_ );
+        sopt_.num_threads = n_threads_;
+        res.res = res.index->Search( queries_, locs_wrap_->getLocs(), sopt_ );
         IDX_TRACE( "results loaded for " << vi->name );
     }
 
@@ -1021,6 +1031,7 @@ void CIndexedDb_Old::PreSearch(
     CDbIndex::SSearchOptions sopt;
     sopt.word_size = lut_options->word_size;
     sopt.two_hits = word_options->window_size;
+    sopt.num_threads = 1;
 
     for( vector< string >::size_type v = 0; 
             v < index_names_.size(); v += 1 ) {
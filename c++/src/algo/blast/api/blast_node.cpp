@@ -80,7 +80,7 @@ CBlastNode::CBlastNode (int node_num, const CNcbiArguments & ncbi_args, const CA
 		                CBlastAppDiagHandler & bah, int query_index, int num_queries, CBlastNodeMailbox * mailbox):
                         m_NodeNum(node_num), m_NcbiArgs(ncbi_args), m_Args(args),
                         m_Bah(bah), m_QueryIndex(query_index), m_NumOfQueries(num_queries),
-                        m_QueriesLength(0), m_DataLoaderPrefix(kEmptyStr)
+                        m_QueriesLength(0), m_NumHits(0), m_DataLoaderPrefix(kEmptyStr)
 {
 	if(mailbox != NULL) {
 		m_Mailbox.Reset(mailbox);
@@ -120,11 +120,27 @@ CBlastNode::SetDataLoaderPrefix()
 
 CBlastMasterNode::CBlastMasterNode(CNcbiOstream & out_stream, int num_threads):
 		m_OutputStream(out_stream), m_MaxNumThreads(num_threads), m_MaxNumNodes(num_threads + 2),
-		m_NumErrStatus(0), m_NumQueries(0), m_QueriesLength(0)
+		m_NumErrStatus(0), m_NumQueries(0), m_QueriesLength(0), m_NumHits(0),
+		m_ThreadBusyTimes(num_threads, 0.0)
 {
 	m_StopWatch.Start();
 }
 
+int
+CBlastMasterNode::x_GetIdleThread()
+{
+	vector<bool> busy(m_ThreadBusyTimes.size(), false);
+	ITERATE(TNodeThreads, itr, m_NodeThreads) {
+		busy[itr->second] = true;
+	}
+	for (unsigned int i = 0; i < busy.size(); i++) {
+		if (!busy[i]) {
+			return i;
+		}
+	}
+	NCBI_THROW(CBlastException, eCoreBlastError, "No idle thread" );
+}
+
 void
 CBlastMasterNode::x_WaitForNewEvent()
 {
@@ -172,6 +188,7 @@ bool CBlastMasterNode::Processing()
 								double start_time = m_StopWatch.Elapsed();
 								n->Run();
 								pair< int, double > p(chunk_num, start_time);
+								m_NodeThreads[chunk_num] = x_GetIdleThread();
 								m_ActiveNodes.insert(p);
 								CRef<CBlastNodeMsg> empty_msg;
 								pair<int,CRef<CBlastNodeMsg> > m(chunk_num, empty_msg);
@@ -198,6 +215,8 @@ bool CBlastMasterNode::Processing()
 						m_FormatQueue[itr->first] = msg;
 						double diff = m_StopWatch.Elapsed() - m_ActiveNodes[itr->first];
 						m_ActiveNodes.erase(chunk_num);
+						m_ThreadBusyTimes[m_NodeThreads[chunk_num]] += diff;
+						m_NodeThreads.erase(chunk_num);
 						CTimeSpan s(diff);
 						INFO_POST("Chunk #" << chunk_num << " completed in " << s.AsSmartString());
 						break;
@@ -246,6 +265,7 @@ void CBlastMasterNode::FormatResults()
 		}
 		m_NumQueries += n->GetNumOfQueries();
 		m_QueriesLength += n->GetQueriesLength();
+		m_NumHits += n->GetNumHits();
 		n->Detach();
 		m_PostOffice.erase(node_num);
 		m_RegisteredNodes.erase(node_num);
@@ -281,6 +301,38 @@ bool s_IsSeqID(string & line)
     return false;
 }
 
+CBlastNodeInputReader::CBlastNodeInputReader(CNcbiIstream& is, int batch_size, int est_avg_len) :
+		CStreamLineReader(is), m_QueryBatchSize(batch_size), m_EstAvgQueryLength(est_avg_len),
+		m_QueryCount(0), m_InputSize(-1)
+{
+	CT_POS_TYPE pos = is.tellg();
+	if (pos != CT_POS_TYPE(-1)) {
+		is.seekg(0, IOS_BASE::end);
+		CT_POS_TYPE end = is.tellg();
+		is.seekg(pos);
+		if ((end != CT_POS_TYPE(-1)) && is.good()) {
+			m_InputSize = NcbiStreamposToInt8(end);
+		}
+	}
+	is.clear();
+}
+
+Int8
+CBlastNodeInputReader::GetRemainingInputSize() const
+{
+	if (m_InputSize < 0) {
+		return -1;
+	}
+	if (AtEOF()) {
+		return 0;
+	}
+	CT_POS_TYPE pos = GetPosition();
+	if (pos == CT_POS_TYPE(-1)) {
+		return -1;
+	}
+	return max(m_InputSize - NcbiStreamposToInt8(pos), (Int8) 0);
+}
+
 int
 CBlastNodeInputReader::GetQueryBatch(string & queries, int & query_no)
 {
@@ -320,3 +372,56 @@ CBlastNodeInputReader::GetQueryBatch(string & queries, int & query_no)
     }
     return q_count;
 }
+
+/// Factor mixing the hits to residues ratio of new batches in
+/// (@sa CBatchSizeMixer)
+static const double kBatchMixIn = 0.3;
+/// Batches are not made smaller than the default size divided by this
+static const int kMinBatchFraction = 8;
+/// Batches are not made larger than the default size times this
+static const int kMaxBatchFactor = 2;
+
+CBlastNodeBatchScheduler::CBlastNodeBatchScheduler(int batch_size, int num_threads) :
+		m_BatchSize(batch_size), m_NumThreads(max(num_threads, 1)), m_Ratio(-1.0),
+		m_TargetHits(0.0), m_QueriesLength(0), m_NumHits(0)
+{
+}
+
+void
+CBlastNodeBatchScheduler::Update(Int8 queries_length, Int8 num_hits)
+{
+	Int8 length = queries_length - m_QueriesLength;
+	Int8 hits = num_hits - m_NumHits;
+	m_QueriesLength = queries_length;
+	m_NumHits = num_hits;
+	// Batches without hits (or nodes not reporting them) tell nothing
+	// about the cost of the queries
+	if ((length <= 0) || (hits <= 0)) {
+		return;
+	}
+	double ratio = (double) hits / length;
+	if (m_Ratio < 0) {
+		m_Ratio = ratio;
+		m_TargetHits = ratio * m_BatchSize;
+	}
+	else {
+		m_Ratio = kBatchMixIn * ratio + (1.0 - kBatchMixIn) * m_Ratio;
+	}
+}
+
+int
+CBlastNodeBatchScheduler::GetBatchSize(Int8 remaining_input) const
+{
+	double batch_size = m_BatchSize;
+	if (m_Ratio > 0) {
+		batch_size = m_TargetHits / m_Ratio;
+	}
+	batch_size = min(batch_size, (double) m_BatchSize * kMaxBatchFactor);
+	if (remaining_input >= 0) {
+		// Leave about two batches per thread, so that the last ones to
+		// complete are small
+		batch_size = min(batch_size, (double) remaining_input / (2 * m_NumThreads));
+	}
+	batch_size = max(batch_size, (double) m_BatchSize / kMinBatchFraction);
+	return max((int) batch_size, 1);
+}
@@ -155,6 +155,7 @@ string CBlastUsageReport::x_EUsageParmsToString(EUsageParams p)
 		case eELBBatchNum:		retval.assign("elb_batch_num"); break;
         case eSRA:              retval.assign("sra"); break;
         case eELBVersion:       retval.assign("elb_version"); break;
+        case eMTThreadTimes:    retval.assign("mt_thread_times"); break;
     	default:
         	LOG_POST(Warning <<"Invalid usage params: " << (int)p);
         	abort();
@@ -40,8 +40,22 @@
 #include <objects/scoremat/Pssm.hpp>
 
 #include <algo/blast/api/local_blast.hpp>
+#include <algo/blast/api/objmgr_query_data.hpp>
 #include <algo/blast/api/deltablast.hpp>
 
+// Domain cache includes
+#include <corelib/ncbifile.hpp>
+#include <corelib/ncbi_process.hpp>
+#include <util/checksum.hpp>
+#include <serial/serial.hpp>
+#include <serial/objistr.hpp>
+#include <serial/objostr.hpp>
+#include <objects/seqalign/Seq_align_set.hpp>
+#include <objects/seqalign/Seq_align.hpp>
+#include <objects/seqalign/Dense_seg.hpp>
+#include <objects/seq/Bioseq.hpp>
+#include <objtools/blast/seqdb_reader/seqdb.hpp>
+
 
 /** @addtogroup AlgoBlast
  *
@@ -52,6 +66,252 @@ BEGIN_NCBI_SCOPE
 USING_SCOPE(objects);
 BEGIN_SCOPE(blast)
 
+/// Format tag of the domain cache files, changed whenever the file format or
+/// the contents of the cache key change
+static const char* kDomainCacheTag = "CDDCACHE-1";
+
+/// Contents of a domain cache file: conserved domain search results and
+/// PSSM for one query
+struct SDomainCacheEntry {
+    CRef<CSeq_align_set> aligns;
+    CRef<CBlastAncillaryData> ancillary_data;
+    /// Masked query regions with their frames
+    typedef vector< pair<TSeqRange, int> > TMasks;
+    TMasks masks;
+    CRef<CPssmWithParameters> pssm;
+};
+
+/// Add the version of the domain database to a cache key: its title, date,
+/// size and the sizes and modification times of the files that RPS-BLAST
+/// and the PSSM engine read
+static void s_AddDomainDbToCacheKey(CChecksum& key, const string& dbname)
+{
+    static const char* kExtensions[] = {
+        ".rps", ".loo", ".aux", ".freq", ".obsr", ".pin", ".psq"
+    };
+
+    CSeqDB seqdb(dbname, CSeqDB::eProtein);
+    key.AddLine(seqdb.GetTitle());
+    key.AddLine(seqdb.GetDate());
+    key.AddLine(NStr::NumericToString(seqdb.GetNumSeqs()) + " " +
+                NStr::NumericToString(seqdb.GetTotalLength()));
+
+    vector<string> paths;
+    seqdb.FindVolumePaths(paths);
+    ITERATE (vector<string>, path, paths) {
+        key.AddLine(*path);
+        for (size_t i = 0; i < ArraySize(kExtensions); i++) {
+            CFile f(*path + kExtensions[i]);
+            if (!f.Exists()) {
+                continue;
+            }
+            CTime mtime;
+            f.GetTime(&mtime);
+            key.AddLine(NStr::NumericToString(f.GetLength()) + " " +
+                        mtime.AsString());
+        }
+    }
+}
+
+/// Add the options that affect domain search results and the PSSM to a
+/// cache key
+static void s_AddOptionsToCacheKey(CChecksum& key,
+                                   const CBlastOptions& rps_opts,
+                                   const CDeltaBlastOptionsHandle& opts)
+{
+    CNcbiOstrstream os;
+    os.precision(17);
+    os << rps_opts.GetEvalueThreshold() << " "
+       << rps_opts.GetHitlistSize() << " "
+       << rps_opts.GetMaxNumHspPerSequence() << " "
+       << rps_opts.GetMaxHspsPerSubject() << " "
+       << rps_opts.GetCullingLimit() << " "
+       << rps_opts.GetPercentIdentity() << " "
+       << rps_opts.GetQueryCovHspPerc() << " "
+       << (int)rps_opts.GetCompositionBasedStats() << " "
+       << rps_opts.GetSegFiltering() << " "
+       << rps_opts.GetSegFilteringWindow() << " "
+       << rps_opts.GetSegFilteringLocut() << " "
+       << rps_opts.GetSegFilteringHicut() << " "
+       << rps_opts.GetMaskAtHash() << " "
+       << rps_opts.GetWordThreshold() << " "
+       << rps_opts.GetWindowSize() << " "
+       << rps_opts.GetXDropoff() << " "
+       << rps_opts.GetGapXDropoff() << " "
+       << rps_opts.GetGapXDropoffFinal() << " "
+       << rps_opts.GetGapTrigger() << " "
+       << rps_opts.GetDbLength() << " "
+       << rps_opts.GetDbSeqNum() << " "
+       << rps_opts.GetEffectiveSearchSpace() << " "
+       << rps_opts.GetSumStatisticsMode() << " "
+       << rps_opts.GetSmithWatermanMode();
+    key.AddLine(CNcbiOstrstreamToString(os));
+
+    CNcbiOstrstream pssm_os;
+    pssm_os.precision(17);
+    pssm_os << opts.GetMatrixName() << " "
+            << opts.GetGapOpeningCost() << " "
+            << opts.GetGapExtensionCost() << " "
+            << opts.GetDomainInclusionThreshold();
+    key.AddLine(CNcbiOstrstreamToString(pssm_os));
+}
+
+/// Check whether domain search alignments can be stored in the cache: the
+/// query id must be replaced when they are read back, which is only done
+/// for Dense-seg alignments
+static bool s_IsCacheableAlignSet(const CSeq_align_set& aligns)
+{
+    ITERATE (CSeq_align_set::Tdata, it, aligns.Get()) {
+        const CSeq_align::TSegs& segs = (*it)->GetSegs();
+        if (segs.IsDisc()) {
+            if (!s_IsCacheableAlignSet(segs.GetDisc())) {
+                return false;
+            }
+        }
+        else if (!segs.IsDenseg()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Set the query (first row) id in domain search alignments
+static void s_SetDomainQueryId(CSeq_align_set& aligns, const CSeq_id& query_id)
+{
+    NON_CONST_ITERATE (CSeq_align_set::Tdata, it, aligns.Set()) {
+        CSeq_align::TSegs& segs = (*it)->SetSegs();
+        if (segs.IsDisc()) {
+            s_SetDomainQueryId(segs.SetDisc(), query_id);
+        }
+        else if (segs.IsDenseg() && !segs.GetDenseg().GetIds().empty()) {
+            CRef<CSeq_id> id(new CSeq_id);
+            id->Assign(query_id);
+            segs.SetDenseg().SetIds().front() = id;
+        }
+    }
+}
+
+/// Read a domain cache file
+/// @return True if the file was found and read, false otherwise
+static bool s_ReadDomainCacheEntry(const string& fname,
+                                   SDomainCacheEntry& entry)
+{
+    if (!CFile(fname).Exists()) {
+        return false;
+    }
+
+    try {
+        CNcbiIfstream in(fname.c_str(), IOS_BASE::in | IOS_BASE::binary);
+        string tag, params;
+        if (!getline(in, tag) || tag != kDomainCacheTag ||
+            !getline(in, params)) {
+            ERR_POST(Warning << "Ignoring stale CDD cache file " << fname);
+            return false;
+        }
+
+        // Karlin-Altschul parameters, search space, length adjustment and
+        // masked query regions
+        CNcbiIstrstream is(params);
+        double lambda[2], k[2], h[2];
+        Int8 search_space = 0;
+        int length_adjustment = 0;
+        size_t num_masks = 0;
+        is >> lambda[0] >> k[0] >> h[0] >> lambda[1] >> k[1] >> h[1]
+           >> search_space >> length_adjustment >> num_masks;
+        for (size_t i = 0; is && i < num_masks; i++) {
+            TSeqPos from = 0, to = 0;
+            int frame = 0;
+            is >> from >> to >> frame;
+            entry.masks.push_back(make_pair(TSeqRange(from, to), frame));
+        }
+        if (!is) {
+            ERR_POST(Warning << "Ignoring corrupt CDD cache file " << fname);
+            return false;
+        }
+        entry.ancillary_data.Reset(new CBlastAncillaryData(
+                                           make_pair(lambda[0], lambda[1]),
+                                           make_pair(k[0], k[1]),
+                                           make_pair(h[0], h[1]),
+                                           search_space));
+        entry.ancillary_data->SetLengthAdjustment(length_adjustment);
+
+        entry.aligns.Reset(new CSeq_align_set);
+        entry.pssm.Reset(new CPssmWithParameters);
+        unique_ptr<CObjectIStream> asn_in(
+                                 CObjectIStream::Open(eSerial_AsnBinary, in));
+        *asn_in >> *entry.aligns >> *entry.pssm;
+    }
+    catch (CException& e) {
+        ERR_POST(Warning << "Cannot read CDD cache file " << fname << ": "
+                 << e.GetMsg());
+        return false;
+    }
+    return true;
+}
+
+/// Write a domain cache file; the entry is written to a temporary file
+/// first so that concurrent searches never see a partial file
+static void s_WriteDomainCacheEntry(const string& fname,
+                                    const SDomainCacheEntry& entry)
+{
+    string tmp_name = fname + "." +
+        NStr::NumericToString(CCurrentProcess::GetPid()) + ".tmp";
+    try {
+        {
+            CNcbiOfstream out(tmp_name.c_str(),
+                              IOS_BASE::out | IOS_BASE::binary);
+            if (!out) {
+                ERR_POST(Warning << "Cannot create CDD cache file "
+                         << tmp_name);
+                return;
+            }
+
+            const Blast_KarlinBlk* ungapped =
+                entry.ancillary_data->GetUngappedKarlinBlk();
+            const Blast_KarlinBlk* gapped =
+                entry.ancillary_data->GetGappedKarlinBlk();
+            out.precision(17);
+            out << kDomainCacheTag << "\n"
+                << ungapped->Lambda << " " << ungapped->K << " "
+                << ungapped->H << " "
+                << gapped->Lambda << " " << gapped->K << " "
+                << gapped->H << " "
+                << entry.ancillary_data->GetSearchSpace() << " "
+                << entry.ancillary_data->GetLengthAdjustment() << " "
+                << entry.masks.size();
+            ITERATE (SDomainCacheEntry::TMasks, it, entry.masks) {
+                out << " " << it->first.GetFrom() << " "
+                    << it->first.GetTo() << " " << it->second;
+            }
+            out << "\n";
+
+            {
+                unique_ptr<CObjectOStream> asn_out(
+                                CObjectOStream::Open(eSerial_AsnBinary, out));
+                *asn_out << *entry.aligns << *entry.pssm;
+                asn_out->Flush();
+            }
+            out.flush();
+            if (!out) {
+                out.close();
+                CFile(tmp_name).Remove();
+                ERR_POST(Warning << "Failed to write CDD cache file "
+                         << tmp_name);
+                return;
+            }
+        }
+        if (!CFile(tmp_name).Rename(fname, CDirEntry::fRF_Overwrite)) {
+            CFile(tmp_name).Remove();
+            ERR_POST(Warning << "Failed to install CDD cache file " << fname);
+        }
+    }
+    catch (CException& e) {
+        CFile(tmp_name).Remove();
+        ERR_POST(Warning << "Cannot save CDD cache file " << fname << ": "
+                 << e.GetMsg());
+    }
+}
+
 CDeltaBlast::CDeltaBlast(CRef<IQueryFactory> query_factory,
                          CRef<CLocalDbAdapter> blastdb,
                          CRef<CLocalDbAdapter> domain_db,
@@ -113,7 +373,13 @@ CRef<CSearchResultSet> CDeltaBlast::Run(void)
     // for each results from single query
     for (size_t i=0;i < m_DomainResults->size();i++) {
     
-        CRef<CCddInputData> pssm_input(
+        // use the PSSM from the domain cache, if there is one
+        if (m_CachedPssm[i].NotEmpty()) {
+            m_Pssm.push_back(m_CachedPssm[i]);
+            m_Pssm.back()->SetPssm().SetQuery().SetSeq().ResetId();
+        }
+        else {
+            CRef<CCddInputData> pssm_input(
                                new CCddInputData(query_seq[i],
                                           query_lens[i],
                                          (*m_DomainResults)[i].GetSeqAlign(),
@@ -125,11 +391,13 @@ CRef<CSearchResultSet> CDeltaBlast::Run(void)
                                          diags));
                                                      
     
-        CRef<CPssmEngine> pssm_engine;
-        pssm_engine.Reset(new CPssmEngine(pssm_input.GetNonNullPointer()));
+            CRef<CPssmEngine> pssm_engine;
+            pssm_engine.Reset(new CPssmEngine(pssm_input.GetNonNullPointer()));
 
-        // compute pssm
-        m_Pssm.push_back(pssm_engine->Run());
+            // compute pssm
+            m_Pssm.push_back(pssm_engine->Run());
+            x_SaveDomainCache(i);
+        }
 
         // pssm may not have query id set if there were no CDD hits
         // in such case set query id in the PSSM
@@ -208,8 +476,165 @@ CRef<CSearchResultSet> CDeltaBlast::x_FindDomainHits(void)
         opts->SetFilterString("F");
     }
 
-    CLocalBlast blaster(m_Queries, opts, m_DomainDb);
-    return blaster.Run();
+    CRef<ILocalQueryData> query_data =
+        m_Queries->MakeLocalQueryData(&m_Options->GetOptions());
+
+    vector< CRef<CSearchResults> > cached;
+    x_LoadDomainCache(*opts, *query_data, cached);
+
+    vector<size_t> missing;
+    for (size_t i = 0;i < cached.size();i++) {
+        if (cached[i].Empty()) {
+            missing.push_back(i);
+        }
+    }
+
+    // search all queries if none was found in the cache, or if the remaining
+    // ones cannot be separated from the rest
+    CObjMgr_QueryFactory* objmgr_queries =
+        dynamic_cast<CObjMgr_QueryFactory*>(m_Queries.GetPointer());
+    if (missing.size() == cached.size() ||
+        (!missing.empty() && !objmgr_queries)) {
+
+        CLocalBlast blaster(m_Queries, opts, m_DomainDb);
+        return blaster.Run();
+    }
+
+    // search only the queries that were not found in the cache
+    CRef<CSearchResultSet> found;
+    if (!missing.empty()) {
+        TSeqLocVector all_queries = objmgr_queries->GetTSeqLocVector();
+        TSeqLocVector missing_queries;
+        ITERATE (vector<size_t>, it, missing) {
+            missing_queries.push_back(all_queries[*it]);
+        }
+        CRef<IQueryFactory> missing_factory(
+                                new CObjMgr_QueryFactory(missing_queries));
+        CLocalBlast blaster(missing_factory, opts, m_DomainDb);
+        found = blaster.Run();
+        _ASSERT(found->size() == missing.size());
+    }
+
+    // merge cached and new results in the original query order
+    CRef<CSearchResultSet> retval(new CSearchResultSet());
+    size_t next = 0;
+    for (size_t i = 0;i < cached.size();i++) {
+        if (cached[i].Empty()) {
+            cached[i].Reset(&(*found)[next++]);
+        }
+        retval->push_back(cached[i]);
+    }
+    return retval;
+}
+
+void CDeltaBlast::x_LoadDomainCache(const CBlastOptionsHandle& opts,
+                                    ILocalQueryData& query_data,
+                                    vector< CRef<CSearchResults> >& cached)
+{
+    const size_t kNumQueries = query_data.GetNumQueries();
+    m_DomainCacheFiles.assign(kNumQueries, kEmptyStr);
+    m_CachedPssm.assign(kNumQueries, CRef<CPssmWithParameters>());
+    cached.assign(kNumQueries, CRef<CSearchResults>());
+
+    const char* cache_dir = getenv("DELTABLAST_CDD_CACHE");
+    if (cache_dir == NULL || *cache_dir == 0) {
+        return;
+    }
+
+    // the part of the cache key shared by all queries
+    CChecksum common_key(CChecksum::eMD5);
+    try {
+        s_AddDomainDbToCacheKey(common_key, m_DomainDb->GetDatabaseName());
+    }
+    catch (CException& e) {
+        ERR_POST(Warning << "Cannot use CDD cache: " << e.GetMsg());
+        return;
+    }
+    s_AddOptionsToCacheKey(common_key, opts.GetOptions(), *m_Options);
+
+    BLAST_SequenceBlk* seq_blk = query_data.GetSequenceBlk();
+    BlastQueryInfo* query_info = query_data.GetQueryInfo();
+    for (size_t i = 0;i < kNumQueries;i++) {
+        if (!query_data.IsValidQuery(i)) {
+            continue;
+        }
+
+        // the key is made of query residues and user-provided masks
+        const BlastContextInfo& context = query_info->contexts[i];
+        CChecksum key(CChecksum::eMD5);
+        key.AddLine(kDomainCacheTag);
+        key.AddLine(common_key.GetHexSum());
+        key.AddChars((const char*)seq_blk->sequence_start +
+                     context.query_offset + 1, context.query_length);
+        key.AddLine(kEmptyStr);
+        if (seq_blk->lcase_mask) {
+            for (BlastSeqLoc* loc = seq_blk->lcase_mask->seqloc_array[i];
+                 loc;loc = loc->next) {
+
+                key.AddLine(NStr::NumericToString(loc->ssr->left) + "-" +
+                            NStr::NumericToString(loc->ssr->right));
+            }
+        }
+        m_DomainCacheFiles[i] = CDirEntry::MakePath(cache_dir,
+                                                    key.GetHexSum(), "cdd");
+
+        SDomainCacheEntry entry;
+        if (!s_ReadDomainCacheEntry(m_DomainCacheFiles[i], entry)) {
+            continue;
+        }
+
+        // cached results may come from a query with a different id
+        CConstRef<CSeq_id> query_id(query_data.GetSeq_loc(i)->GetId());
+        s_SetDomainQueryId(*entry.aligns, *query_id);
+
+        TMaskedQueryRegions masks;
+        ITERATE (SDomainCacheEntry::TMasks, it, entry.masks) {
+            TSeqRange range(it->first);
+            CRef<CSeqLocInfo> mask(new CSeqLocInfo(
+                                            const_cast<CSeq_id&>(*query_id),
+                                            range, it->second));
+            masks.push_back(mask);
+        }
+
+        cached[i].Reset(new CSearchResults(query_id, entry.aligns,
+                                           TQueryMessages(),
+                                           entry.ancillary_data, &masks));
+        m_CachedPssm[i] = entry.pssm;
+    }
+}
+
+void CDeltaBlast::x_SaveDomainCache(size_t index)
+{
+    if (index >= m_DomainCacheFiles.size() ||
+        m_DomainCacheFiles[index].empty()) {
+        return;
+    }
+
+    const CSearchResults& results = (*m_DomainResults)[index];
+    CRef<CBlastAncillaryData> ancillary_data = results.GetAncillaryData();
+    if (results.HasErrors() || ancillary_data.Empty() ||
+        !ancillary_data->GetUngappedKarlinBlk() ||
+        !ancillary_data->GetGappedKarlinBlk() ||
+        !s_IsCacheableAlignSet(*results.GetSeqAlign())) {
+        return;
+    }
+
+    SDomainCacheEntry entry;
+    entry.aligns.Reset(const_cast<CSeq_align_set*>(
+                                   results.GetSeqAlign().GetPointer()));
+    entry.ancillary_data = ancillary_data;
+    entry.pssm = m_Pssm[index];
+
+    TMaskedQueryRegions masks;
+    results.GetMaskedQueryRegions(masks);
+    ITERATE (TMaskedQueryRegions, it, masks) {
+        const CSeq_interval& interval = (*it)->GetInterval();
+        entry.masks.push_back(make_pair(TSeqRange(interval.GetFrom(),
+                                                  interval.GetTo()),
+                                        (*it)->GetFrame()));
+    }
+
+    s_WriteDomainCacheEntry(m_DomainCacheFiles[index], entry);
 }
 
 void CDeltaBlast::x_Validate(void)
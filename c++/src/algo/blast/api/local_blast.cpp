@@ -273,6 +273,7 @@ CLocalBlast::Run()
         m_TbackSearch->SetResultType(eSequenceComparison);
     }
     m_TbackSearch->SetNumberOfThreads(GetNumberOfThreads());
+    m_TbackSearch->SetHSPResultsWriter(m_HSPResultsWriter);
     CRef<CSearchResultSet> retval = m_TbackSearch->Run();
     retval->SetFilteredQueryRegions(m_PrelimSearch->GetFilteredQueryRegions());
     m_Messages = m_TbackSearch->GetSearchMessages();
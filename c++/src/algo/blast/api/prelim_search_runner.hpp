@@ -112,22 +112,30 @@ public:
                         const CBlastOptionsMemento* opts_memento)
         : m_InternalData(internal_data), m_OptsMemento(opts_memento)
     {
+        CopyThreadLocalData(m_InternalData);
+    }
+
+    /// Replace the fields of a copy of the internal data which cannot be
+    /// shared between search threads by copies of their own
+    /// @note the BlastQueryInfo copy must be freed by the caller
+    /// @param internal_data Copy of the internal data to modify [in|out]
+    static void CopyThreadLocalData(SInternalData& internal_data) {
         // The following fields need to be copied to ensure MT-safety
         BlastSeqSrc* seqsrc =
-            BlastSeqSrcCopy(m_InternalData.m_SeqSrc->GetPointer());
-        m_InternalData.m_SeqSrc.Reset(new TBlastSeqSrc(seqsrc,
-                                                       BlastSeqSrcFree));
+            BlastSeqSrcCopy(internal_data.m_SeqSrc->GetPointer());
+        internal_data.m_SeqSrc.Reset(new TBlastSeqSrc(seqsrc,
+                                                      BlastSeqSrcFree));
         // The progress field must be copied to ensure MT-safety
-        if (m_InternalData.m_ProgressMonitor->Get()) {
+        if (internal_data.m_ProgressMonitor->Get()) {
             SBlastProgress* bp =
-                SBlastProgressNew(m_InternalData.m_ProgressMonitor->Get()->user_data);
-            m_InternalData.m_ProgressMonitor.Reset(new CSBlastProgress(bp));
+                SBlastProgressNew(internal_data.m_ProgressMonitor->Get()->user_data);
+            internal_data.m_ProgressMonitor.Reset(new CSBlastProgress(bp));
         }
         // The BlastQueryInfo field needs to be copied to silence Thread
         // Sanitizer warnings, and probably to ensure MT-safety too.
         BlastQueryInfo* queryInfo =
-                BlastQueryInfoDup(m_InternalData.m_QueryInfo);
-        m_InternalData.m_QueryInfo = queryInfo;
+                BlastQueryInfoDup(internal_data.m_QueryInfo);
+        internal_data.m_QueryInfo = queryInfo;
     }
 
 protected:
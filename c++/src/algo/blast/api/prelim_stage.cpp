@@ -36,6 +36,7 @@
 #include <algo/blast/api/prelim_stage.hpp>
 #include <algo/blast/api/uniform_search.hpp>    // for CSearchDatabase
 #include <algo/blast/api/blast_mtlock.hpp>
+#include <algo/blast/api/seqsrc_seqdb.hpp>
 #include <algo/blast/core/blast_hits.h>
 #include <algo/blast/core/blast_stat.h>
 
@@ -45,6 +46,7 @@
 #include "split_query_aux_priv.hpp"
 #include "blast_seqalign.hpp"
 #include <sstream>
+#include <cmath>
 
 #include <algo/blast/api/blast_dbindex.hpp>
 
@@ -99,6 +101,18 @@ CBlastPrelimSearch::CBlastPrelimSearch(CRef<IQueryFactory> query_factory,
     m_InternalData->m_SeqSrc.Reset(new TBlastSeqSrc(seqsrc, 0));
 }
 
+CBlastPrelimSearch::CBlastPrelimSearch(CRef<IQueryFactory> query_factory,
+                               CRef<CBlastOptions> options,
+                               BlastSeqSrc* seqsrc,
+                               CConstRef<objects::CPssmWithParameters> pssm,
+                               const vector<TSeqRange>& seed_ranges)
+    : m_QueryFactory(query_factory), m_InternalData(new SInternalData),
+    m_Options(options),  m_DbAdapter(NULL), m_DbInfo(NULL)
+{
+    x_Init(query_factory, options, pssm, seqsrc, 1, &seed_ranges);
+    m_InternalData->m_SeqSrc.Reset(new TBlastSeqSrc(seqsrc, 0));
+}
+
 void
 CBlastPrelimSearch::SetNumberOfThreads(size_t nthreads)
 {
@@ -127,11 +141,12 @@ CBlastPrelimSearch::x_Init(CRef<IQueryFactory> query_factory,
                            CRef<CBlastOptions> options,
                            CConstRef<objects::CPssmWithParameters> pssm,
                            BlastSeqSrc* seqsrc,
-                           size_t num_threads)
+                           size_t num_threads,
+                           const vector<TSeqRange>* seed_ranges)
 {
     CRef<SBlastSetupData> setup_data =
         BlastSetupPreliminarySearchEx(query_factory, options, pssm, seqsrc,
-                                      num_threads);
+                                      num_threads, seed_ranges);
     m_InternalData = setup_data->m_InternalData;
     copy(setup_data->m_Masks.begin(), setup_data->m_Masks.end(),
          back_inserter(m_MasksForAllQueries));
@@ -194,6 +209,374 @@ CBlastPrelimSearch::x_LaunchMultiThreadedSearch(SInternalData& internal_data)
     return 0;
 }
 
+/// Returns true if an error searching a query chunk can be ignored
+/// @param e Exception thrown by the search of the query chunk [in]
+static bool
+s_IsIgnorableQueryChunkError(const CBlastException& e)
+{
+    // This error message is safe to ignore for a given chunk,
+    // because the chunks might end up producing a region of
+    // the query for which ungapped Karlin-Altschul blocks
+    // cannot be calculated
+    const string err_msg1("search cannot proceed due to errors "
+                         "in all contexts/frames of query "
+                         "sequences");
+    const string err_msg2(kBlastErrMsg_CantCalculateUngappedKAParams);
+    return e.GetMsg().find(err_msg1) != NPOS ||
+           e.GetMsg().find(err_msg2) != NPOS;
+}
+
+/// Largest fraction of the search time of a query chunk its threads may
+/// spend waiting for each other to finish the last chunks of the database
+static const double kMaxQueryChunkTailFraction = 0.05;
+
+size_t
+CBlastPrelimSearch::x_GetNumThreadsPerQueryChunk(size_t num_chunks)
+{
+    const size_t kNumThreads = GetNumberOfThreads();
+    // The query chunks can only be searched concurrently if each can iterate
+    // over the database on its own, and the database index is set up for one
+    // query chunk at a time
+    const bool is_blastdb = m_DbAdapter.NotEmpty()
+        ? m_DbAdapter->IsBlastDb() : m_DbInfo != NULL;
+    if (kNumThreads <= 1 || num_chunks <= 1 || !is_blastdb ||
+        m_Options->GetUseIndex()) {
+        return kNumThreads;
+    }
+
+    // The engine hands out the database in chunks of 1% of its sequences
+    // (see Blast_RunPreliminarySearchWithInterrupt).  When t threads search
+    // the c chunks of the database with the same query chunk, each waits
+    // (t - 1) / 2 chunks on average for the others to finish, about t^2 / 2c
+    // of the search time.  Use as many threads per query chunk as keep this
+    // below kMaxQueryChunkTailFraction; the other threads search the next
+    // query chunks at the same time.
+    const double kNumDbChunks =
+        min(BlastSeqSrcGetNumSeqs(m_InternalData->m_SeqSrc->GetPointer()),
+            100);
+    size_t retval =
+        (size_t) sqrt(2.0 * kMaxQueryChunkTailFraction * kNumDbChunks);
+
+    // No point in more threads per query chunk than it takes to use all of
+    // them with all query chunks searched concurrently
+    retval = max(retval, (kNumThreads + num_chunks - 1) / num_chunks);
+    return max((size_t) 1, min(retval, kNumThreads));
+}
+
+/// Query chunks searched as tiles of work by a pool of threads: the threads
+/// claim a query chunk and search it against the chunks of the database until
+/// there are none left, then claim another one.  A query chunk is set up by
+/// the first thread claiming it and its setup is freed once its last thread
+/// is done with it; the HSPs of each query chunk are merged into the results
+/// of the full query, in the order of the query chunks, once all its threads
+/// are done.
+class CQueryChunkTiles : public CObject
+{
+public:
+    /// Constructor
+    /// @param query_splitter Splitter of the query [in]
+    /// @param split_query_blk Split query information [in]
+    /// @param full_data Data of the full query [in]
+    /// @param threads_per_chunk Maximum number of threads searching a query
+    /// chunk [in]
+    /// @param num_threads Number of threads of the search [in]
+    /// @param options BLAST options [in]
+    CQueryChunkTiles(CQuerySplitter& query_splitter,
+                     CSplitQueryBlk& split_query_blk,
+                     SInternalData& full_data,
+                     size_t threads_per_chunk,
+                     size_t num_threads,
+                     CRef<CBlastOptions> options)
+        : m_QuerySplitter(query_splitter),
+          m_SplitQueryBlk(split_query_blk),
+          m_FullData(full_data),
+          m_ThreadsPerChunk(threads_per_chunk),
+          m_NumSearchThreads(num_threads),
+          m_Options(options),
+          m_ChunkData(query_splitter.GetNumberOfChunks()),
+          m_NumThreads(query_splitter.GetNumberOfChunks(), 0),
+          m_State(query_splitter.GetNumberOfChunks(), eNotSetUp),
+          m_NextMerge(0),
+          m_Status(0)
+    {}
+
+    /// Claim a query chunk to search, setting it up if it is the first claim
+    /// @return index of the query chunk, -1 if there is none left
+    int Claim(void) {
+        CFastMutexGuard guard(m_Mutex);
+        for (size_t i = m_NextMerge; i < m_State.size(); i++) {
+            if (x_HasFailed()) {
+                return -1;
+            }
+            if (m_State[i] == eDone || m_NumThreads[i] >= m_ThreadsPerChunk) {
+                continue;
+            }
+            m_NumThreads[i]++;
+            if (m_State[i] == eNotSetUp) {
+                m_State[i] = eSettingUp;
+                guard.Release();
+                CRef<SInternalData> data;
+                exception_ptr error;
+                try {
+                    data = x_SetUpChunk((Uint4) i);
+                } catch (...) {
+                    error = current_exception();
+                }
+                guard.Guard(m_Mutex);
+                m_ChunkData[i] = data;
+                m_State[i] = data.NotEmpty() ? eSearching : eDone;
+                if (error && !m_Error) {
+                    m_Error = error;
+                }
+                m_SetUp.SignalAll();
+            }
+            while (m_State[i] == eSettingUp) {
+                m_SetUp.WaitForSignal(m_Mutex);
+            }
+            if (m_State[i] == eSearching && !x_HasFailed()) {
+                return (int) i;
+            }
+            // Nothing to search in this query chunk
+            m_NumThreads[i]--;
+            x_MergeDoneChunks();
+        }
+        return -1;
+    }
+
+    /// Data of a claimed query chunk
+    /// @param chunk Index of the query chunk [in]
+    const SInternalData& GetChunkData(int chunk) const {
+        return *m_ChunkData[chunk];
+    }
+
+    /// Release a claimed query chunk: its database chunks were all handed
+    /// out, so no thread claims it anymore
+    /// @param chunk Index of the query chunk [in]
+    /// @param status Status returned by the search of the query chunk [in]
+    void Release(int chunk, int status) {
+        // Freed once the mutex is released
+        CRef<SInternalData> setup_data;
+        CFastMutexGuard guard(m_Mutex);
+        if (status && !m_Status) {
+            m_Status = status;
+        }
+        // A thread gets past the last database chunk only when there are no
+        // more to hand out
+        m_State[chunk] = eDone;
+        m_NumThreads[chunk]--;
+        if (m_NumThreads[chunk] == 0) {
+            // Only the HSPs are needed until the query chunk is merged
+            setup_data = m_ChunkData[chunk];
+            m_ChunkData[chunk].Reset(new SInternalData);
+            m_ChunkData[chunk]->m_HspStream = setup_data->m_HspStream;
+            // free this as the query_splitter keeps a reference to the
+            // chunk factories, which in turn keep a reference to the
+            // local query data.
+            m_QuerySplitter.GetQueryFactoryForChunk((Uint4) chunk)
+                ->MakeLocalQueryData(&*m_Options)->FlushSequenceData();
+        }
+        x_MergeDoneChunks();
+    }
+
+    /// Record the exception thrown by the search of a tile, to be rethrown
+    /// by RethrowError
+    /// @param error The exception [in]
+    void SetError(exception_ptr error) {
+        CFastMutexGuard guard(m_Mutex);
+        if ( !m_Error ) {
+            m_Error = error;
+        }
+    }
+
+    /// Rethrow the first exception thrown by the setup or the search of a
+    /// tile, if any
+    void RethrowError(void) const {
+        if (m_Error) {
+            rethrow_exception(m_Error);
+        }
+    }
+
+    /// Status of the search, non-zero if any tile failed
+    int GetStatus(void) const {
+        return m_Status;
+    }
+
+private:
+    /// State of a query chunk
+    enum EChunkState {
+        eNotSetUp,      ///< Not claimed yet
+        eSettingUp,     ///< Set up by the thread which claimed it first
+        eSearching,     ///< Searched by the threads which claimed it
+        eDone           ///< No database chunks left to search
+    };
+
+    /// True if the setup or the search of a tile failed
+    bool x_HasFailed(void) const {
+        return m_Status != 0 || m_Error;
+    }
+
+    /// Set up a query chunk
+    /// @param chunk Index of the query chunk [in]
+    /// @return data of the query chunk, NULL if it has nothing to search
+    CRef<SInternalData> x_SetUpChunk(Uint4 chunk) {
+        // The query chunks are set up one at a time, as when they are
+        // searched one after the other
+        CFastMutexGuard guard(m_SetUpMutex);
+
+        // Each query chunk iterates over the whole database: the setup
+        // resets the iteration of a copy of the full query's sequence
+        // source, which the query chunk's copy shares
+        CRef<SInternalData> full_data(new SInternalData(m_FullData));
+        BlastSeqSrc* seqsrc =
+            BlastSeqSrcCopy(m_FullData.m_SeqSrc->GetPointer());
+        full_data->m_SeqSrc.Reset(new TBlastSeqSrc(seqsrc, BlastSeqSrcFree));
+        if ( !SeqDbBlastSeqSrcSetPrivateChunkBookmark(seqsrc) ) {
+            NCBI_THROW(CBlastException, eCoreBlastError,
+                       "Query chunks cannot be searched concurrently "
+                       "against this sequence source");
+        }
+
+        try {
+            CRef<IQueryFactory> chunk_qf =
+                m_QuerySplitter.GetQueryFactoryForChunk(chunk);
+            return SplitQuery_CreateChunkData(chunk_qf, m_Options, full_data,
+                                              m_NumSearchThreads);
+        } catch (const CBlastException& e) {
+            if ( !s_IsIgnorableQueryChunkError(e) ) {
+                throw;
+            }
+        }
+        return CRef<SInternalData>();
+    }
+
+    /// Merge the query chunks which are done, in order
+    void x_MergeDoneChunks(void) {
+        while (m_NextMerge < m_State.size() && !x_HasFailed() &&
+               m_State[m_NextMerge] == eDone &&
+               m_NumThreads[m_NextMerge] == 0) {
+            CRef<SInternalData>& data = m_ChunkData[m_NextMerge];
+            if (data.NotEmpty()) {
+                _ASSERT(data->m_HspStream->GetPointer());
+                m_Status = BlastHSPStreamMerge(m_SplitQueryBlk.GetCStruct(),
+                                   (Uint4) m_NextMerge,
+                                   data->m_HspStream->GetPointer(),
+                                   m_FullData.m_HspStream->GetPointer());
+                data.Reset();
+            }
+            m_NextMerge++;
+        }
+    }
+
+    CQuerySplitter& m_QuerySplitter;
+    CSplitQueryBlk& m_SplitQueryBlk;
+    SInternalData& m_FullData;
+    const size_t m_ThreadsPerChunk;
+    const size_t m_NumSearchThreads;
+    CRef<CBlastOptions> m_Options;
+
+    /// Data of the query chunks, set up when first claimed, only the HSPs
+    /// once released by all their threads
+    vector< CRef<SInternalData> > m_ChunkData;
+    /// Number of threads searching or setting up each query chunk
+    vector<size_t> m_NumThreads;
+    /// State of each query chunk
+    vector<EChunkState> m_State;
+    /// Next query chunk to merge
+    size_t m_NextMerge;
+    /// First non-zero status returned by a tile or merge
+    int m_Status;
+    /// First exception thrown by the setup or the search of a tile
+    exception_ptr m_Error;
+    /// Protects the above
+    CFastMutex m_Mutex;
+    /// Signalled when a query chunk is set up
+    CConditionVariable m_SetUp;
+    /// Serializes the setup of the query chunks
+    CFastMutex m_SetUpMutex;
+};
+
+/// Thread of the pool searching the tiles of the query chunks
+class CQueryChunkTilesThread : public CThread
+{
+public:
+    CQueryChunkTilesThread(CQueryChunkTiles& tiles,
+                           const CBlastOptionsMemento* opts_memento)
+        : m_Tiles(tiles), m_OptsMemento(opts_memento)
+    {}
+
+protected:
+    virtual void* Main(void) {
+        int chunk;
+        while ((chunk = m_Tiles.Claim()) >= 0) {
+            const SInternalData& chunk_data = m_Tiles.GetChunkData(chunk);
+            SInternalData internal_data(chunk_data);
+            int status = 0;
+            // The query chunk must be released whatever happens, or the
+            // query chunks after it are never merged
+            try {
+                CPrelimSearchThread::CopyThreadLocalData(internal_data);
+                status = CPrelimSearchRunner(internal_data, m_OptsMemento)();
+            } catch (...) {
+                m_Tiles.SetError(current_exception());
+            }
+            if (internal_data.m_QueryInfo != chunk_data.m_QueryInfo) {
+                BlastQueryInfoFree(internal_data.m_QueryInfo);
+            }
+            m_Tiles.Release(chunk, status);
+        }
+        return NULL;
+    }
+
+private:
+    CQueryChunkTiles& m_Tiles;
+    const CBlastOptionsMemento* m_OptsMemento;
+};
+
+void
+CBlastPrelimSearch::x_RunQueryChunkTiles(CQuerySplitter& query_splitter,
+                                         CSplitQueryBlk& split_query_blk,
+                                         size_t threads_per_chunk)
+{
+    unique_ptr<const CBlastOptionsMemento> opts_memento
+        (m_Options->CreateSnapshot());
+
+    _TRACE("Searching " << query_splitter.GetNumberOfChunks()
+           << " query chunks with " << GetNumberOfThreads() << " threads, "
+           << threads_per_chunk << " per query chunk");
+    CQueryChunkTiles tiles(query_splitter, split_query_blk, *m_InternalData,
+                           threads_per_chunk, GetNumberOfThreads(),
+                           m_Options);
+
+    // The threads live as long as the whole search: the database keeps its
+    // per-thread caches by thread
+    BlastSeqSrcSetNumberOfThreads(m_InternalData->m_SeqSrc->GetPointer(),
+                                  GetNumberOfThreads());
+
+    typedef vector< CRef<CQueryChunkTilesThread> > TTilesThreads;
+    TTilesThreads the_threads(GetNumberOfThreads());
+    NON_CONST_ITERATE(TTilesThreads, thread, the_threads) {
+        thread->Reset(new CQueryChunkTilesThread(tiles, opts_memento.get()));
+        if (thread->Empty()) {
+            NCBI_THROW(CBlastSystemException, eOutOfMemory,
+                       "Failed to create preliminary search thread");
+        }
+    }
+    NON_CONST_ITERATE(TTilesThreads, thread, the_threads) {
+        (*thread)->Run();
+    }
+    NON_CONST_ITERATE(TTilesThreads, thread, the_threads) {
+        (*thread)->Join();
+    }
+
+    BlastSeqSrcSetNumberOfThreads(m_InternalData->m_SeqSrc->GetPointer(), 0);
+
+    tiles.RethrowError();
+    if (tiles.GetStatus()) {
+        NCBI_THROW(CBlastException, eCoreBlastError,
+                   BlastErrorCode2String((Int2) tiles.GetStatus()));
+    }
+}
+
 CRef<SInternalData>
 CBlastPrelimSearch::Run()
 {
@@ -225,58 +608,57 @@ CBlastPrelimSearch::Run()
     if (query_splitter->IsQuerySplit()) {
 
         CRef<CSplitQueryBlk> split_query_blk = query_splitter->Split();
+        const size_t kThreadsPerChunk =
+            x_GetNumThreadsPerQueryChunk(query_splitter->GetNumberOfChunks());
 
-        for (Uint4 i = 0; i < query_splitter->GetNumberOfChunks(); i++) {
-            try {
-                CRef<IQueryFactory> chunk_qf =
-                    query_splitter->GetQueryFactoryForChunk(i);
-                _TRACE("Query chunk " << i << "/" <<
-                       query_splitter->GetNumberOfChunks());
-                CRef<SInternalData> chunk_data =
-                    SplitQuery_CreateChunkData(chunk_qf, m_Options,
-                                               m_InternalData,
-                                               GetNumberOfThreads());
-
-                CRef<ILocalQueryData> query_data(
-                        chunk_qf->MakeLocalQueryData( &*m_Options ) );
-                BLAST_SequenceBlk * chunk_queries =
-                    query_data->GetSequenceBlk();
-                GetDbIndexSetUsingThreadsFn()( IsMultiThreaded() );
-                GetDbIndexRunSearchFn()(
-                        chunk_queries, lut_options, word_options );
-
-                if (IsMultiThreaded()) {
-                     x_LaunchMultiThreadedSearch(*chunk_data);
-                } else {
-                    retval =
-                        CPrelimSearchRunner(*chunk_data, opts_memento.get())();
-                    if (retval) {
-                        NCBI_THROW(CBlastException, eCoreBlastError,
-                                   BlastErrorCode2String(retval));
+        if (kThreadsPerChunk < GetNumberOfThreads()) {
+            x_RunQueryChunkTiles(*query_splitter, *split_query_blk,
+                                 kThreadsPerChunk);
+        } else {
+            for (Uint4 i = 0; i < query_splitter->GetNumberOfChunks(); i++) {
+                try {
+                    CRef<IQueryFactory> chunk_qf =
+                        query_splitter->GetQueryFactoryForChunk(i);
+                    _TRACE("Query chunk " << i << "/" <<
+                           query_splitter->GetNumberOfChunks());
+                    CRef<SInternalData> chunk_data =
+                        SplitQuery_CreateChunkData(chunk_qf, m_Options,
+                                                   m_InternalData,
+                                                   GetNumberOfThreads());
+
+                    CRef<ILocalQueryData> query_data(
+                            chunk_qf->MakeLocalQueryData( &*m_Options ) );
+                    BLAST_SequenceBlk * chunk_queries =
+                        query_data->GetSequenceBlk();
+                    GetDbIndexSetUsingThreadsFn()( IsMultiThreaded() );
+                    GetDbIndexRunSearchFn()(
+                            chunk_queries, lut_options, word_options );
+
+                    if (IsMultiThreaded()) {
+                         x_LaunchMultiThreadedSearch(*chunk_data);
+                    } else {
+                        retval = CPrelimSearchRunner(*chunk_data,
+                                                     opts_memento.get())();
+                        if (retval) {
+                            NCBI_THROW(CBlastException, eCoreBlastError,
+                                       BlastErrorCode2String(retval));
+                        }
                     }
-                }
 
 
-                _ASSERT(chunk_data->m_HspStream->GetPointer());
-                BlastHSPStreamMerge(split_query_blk->GetCStruct(), i,
-                                chunk_data->m_HspStream->GetPointer(),
-                                m_InternalData->m_HspStream->GetPointer());
-                _ASSERT(m_InternalData->m_HspStream->GetPointer());
-                // free this as the query_splitter keeps a reference to the
-                // chunk factories, which in turn keep a reference to the local
-                // query data.
-                query_data->FlushSequenceData();
-            } catch (const CBlastException& e) {
-                // This error message is safe to ignore for a given chunk,
-                // because the chunks might end up producing a region of
-                // the query for which ungapped Karlin-Altschul blocks
-                // cannot be calculated
-                const string err_msg1("search cannot proceed due to errors "
-                                     "in all contexts/frames of query "
-                                     "sequences");
-                const string err_msg2(kBlastErrMsg_CantCalculateUngappedKAParams);
-                if (e.GetMsg().find(err_msg1) == NPOS && e.GetMsg().find(err_msg2) == NPOS) {
-                    throw;
+                    _ASSERT(chunk_data->m_HspStream->GetPointer());
+                    BlastHSPStreamMerge(split_query_blk->GetCStruct(), i,
+                                    chunk_data->m_HspStream->GetPointer(),
+                                    m_InternalData->m_HspStream->GetPointer());
+                    _ASSERT(m_InternalData->m_HspStream->GetPointer());
+                    // free this as the query_splitter keeps a reference to
+                    // the chunk factories, which in turn keep a reference to
+                    // the local query data.
+                    query_data->FlushSequenceData();
+                } catch (const CBlastException& e) {
+                    if ( !s_IsIgnorableQueryChunkError(e) ) {
+                        throw;
+                    }
                 }
             }
         }
@@ -91,6 +91,12 @@ CPsiBlast::GetPssm() const
     return m_Impl->GetPssm();
 }
 
+void
+CPsiBlast::SetIncrementalThreshold(int threshold)
+{
+    m_Impl->SetIncrementalThreshold(threshold);
+}
+
 CRef<CSearchResultSet>
 CPsiBlast::Run()
 {
@@ -104,7 +110,8 @@ PsiBlastComputePssmFromAlignment(const objects::CBioseq& query,
                                  CRef<objects::CScope> database_scope,
                                  const CPSIBlastOptionsHandle& opts_handle,
                                  CConstRef<CBlastAncillaryData> ancillary_data,
-                                 PSIDiagnosticsRequest* diagnostics_request)
+                                 PSIDiagnosticsRequest* diagnostics_request,
+                                 size_t num_threads)
 {
     // Extract PSSM engine options from options handle
     CPSIBlastOptions opts;
@@ -143,6 +150,7 @@ PsiBlastComputePssmFromAlignment(const objects::CBioseq& query,
 
     CPssmEngine engine(&input);
     engine.SetUngappedStatisticalParams(ancillary_data);
+    engine.SetNumberOfThreads(num_threads);
     CRef<CPssmWithParameters> retval(engine.Run());
 
     PsiBlastAddAncillaryPssmData(*retval,
@@ -40,12 +40,17 @@
 #include <algo/blast/api/blast_exception.hpp>
 #include <algo/blast/api/objmgrfree_query_data.hpp>
 #include <algo/blast/api/blast_seqinfosrc.hpp>
+#include <algo/blast/api/pssm_engine.hpp>
 
 // Object includes
 #include <objects/seqset/Seq_entry.hpp>
 #include <objects/scoremat/Pssm.hpp>
 #include <objects/scoremat/PssmFinalData.hpp>
 #include <objects/scoremat/PssmWithParameters.hpp>
+#include <objects/seqalign/Seq_align.hpp>
+#include <objects/seqalign/Seq_align_set.hpp>
+#include <objects/seqalign/Dense_seg.hpp>
+#include <objtools/blast/seqdb_reader/seqdb.hpp>
 
 /** @addtogroup AlgoBlast
  *
@@ -60,7 +65,7 @@ CPsiBlastImpl::CPsiBlastImpl(CRef<objects::CPssmWithParameters> pssm,
                              CRef<CLocalDbAdapter> subject,
                              CConstRef<CPSIBlastOptionsHandle> options)
 : m_Pssm(pssm), m_Query(0), m_Subject(subject), m_OptsHandle(options),
-    m_ResultType(eDatabaseSearch)
+    m_ResultType(eDatabaseSearch), m_IncrementalThreshold(-1)
 {
     x_Validate();
     x_ExtractQueryFromPssm();
@@ -71,7 +76,7 @@ CPsiBlastImpl::CPsiBlastImpl(CRef<IQueryFactory> query,
                              CRef<CLocalDbAdapter> subject,
                              CConstRef<CBlastProteinOptionsHandle> options)
 : m_Pssm(0), m_Query(query), m_Subject(subject), m_OptsHandle(options),
-    m_ResultType(eDatabaseSearch)
+    m_ResultType(eDatabaseSearch), m_IncrementalThreshold(-1)
 {
     x_Validate();
 }
@@ -118,8 +123,75 @@ CPsiBlastImpl::x_ExtractQueryFromPssm()
     m_Query.Reset(new CObjMgrFree_QueryFactory(query_bioseq)); /* NCBI_FAKE_WARNING */
 }
 
+/// Fraction of the query beyond which seeding only from the changed PSSM
+/// columns is not worth it, and the whole database is searched again
+static const double kMaxIncrementalSeedFraction = 0.5;
+
 CRef<CSearchResultSet>
 CPsiBlastImpl::Run()
+{
+    vector<bool> changed;
+    bool identical = false;
+    if (x_FindChangedColumns(changed, identical)) {
+        const size_t kQueryLength = changed.size();
+        const TSeqPos kWordSize = (TSeqPos)
+            m_OptsHandle->GetOptions().GetWordSize();
+
+        // Collect the query ranges containing words that overlap a changed
+        // column; the lookup table is built only from these
+        vector<TSeqRange> seed_ranges;
+        size_t seed_length = 0;
+        for (size_t i = 0; i < kQueryLength; i++) {
+            if ( !changed[i] ) {
+                continue;
+            }
+            TSeqPos from = i < kWordSize ? 0 : (TSeqPos)i - kWordSize + 1;
+            TSeqPos to = min((TSeqPos)(i + kWordSize - 1),
+                             (TSeqPos)kQueryLength - 1);
+            if ( !seed_ranges.empty() &&
+                 from <= seed_ranges.back().GetTo() + 1) {
+                seed_length -= seed_ranges.back().GetLength();
+                seed_ranges.back().SetTo(to);
+            } else {
+                seed_ranges.push_back(TSeqRange(from, to));
+            }
+            seed_length += seed_ranges.back().GetLength();
+        }
+
+        if (identical) {
+            // The scores did not change, so the previous results still
+            // hold, and so do the K&A values saved with the previous PSSM
+            CPssm& pssm = m_Pssm->SetPssm();
+            const CPssm& prev_pssm = m_PrevPssm->GetPssm();
+            pssm.SetLambda(prev_pssm.GetLambda());
+            pssm.SetKappa(prev_pssm.GetKappa());
+            pssm.SetH(prev_pssm.GetH());
+            pssm.SetLambdaUngapped(prev_pssm.GetLambdaUngapped());
+            pssm.SetKappaUngapped(prev_pssm.GetKappaUngapped());
+            pssm.SetHUngapped(prev_pssm.GetHUngapped());
+            x_SaveIterationState();
+            return m_Results;
+        }
+
+        // Without any seeds there would be no search statistics to rescore
+        // the previous alignments with, so search the whole database
+        if ( !seed_ranges.empty() &&
+             seed_length < kMaxIncrementalSeedFraction * kQueryLength) {
+            CRef<CSearchResultSet> results = x_Search(&seed_ranges);
+            x_CarryForwardHits(changed, *results);
+            m_Results = results;
+            x_SaveIterationState();
+            return m_Results;
+        }
+    }
+
+    m_Results = x_Search(NULL);
+    x_SaveIterationState();
+    return m_Results;
+}
+
+CRef<CSearchResultSet>
+CPsiBlastImpl::x_Search(const vector<TSeqRange>* seed_ranges)
 {
     CRef<CBlastOptions>
         opts(const_cast<CBlastOptions*>(&m_OptsHandle->GetOptions()));
@@ -129,24 +201,26 @@ CPsiBlastImpl::Run()
     m_Subject->ResetBlastSeqSrcIteration();
 
     // Run the preliminary stage
-    CBlastPrelimSearch prelim_search(m_Query, 
-                                     opts, 
-                                     m_Subject->MakeSeqSrc(), 
-                                     m_Pssm);
-    prelim_search.SetNumberOfThreads(GetNumberOfThreads());
-    CRef<SInternalData> core_data = prelim_search.Run();
+    unique_ptr<CBlastPrelimSearch> prelim_search
+        (seed_ranges
+         ? new CBlastPrelimSearch(m_Query, opts, m_Subject->MakeSeqSrc(),
+                                  m_Pssm, *seed_ranges)
+         : new CBlastPrelimSearch(m_Query, opts, m_Subject->MakeSeqSrc(),
+                                  m_Pssm));
+    prelim_search->SetNumberOfThreads(GetNumberOfThreads());
+    CRef<SInternalData> core_data = prelim_search->Run();
 
     // Run the traceback stage
     CRef<IBlastSeqInfoSrc> seqinfo_src(m_Subject->MakeSeqInfoSrc());
     _ASSERT(seqinfo_src.NotEmpty());
-    TSearchMessages search_messages = prelim_search.GetSearchMessages();
+    TSearchMessages search_messages = prelim_search->GetSearchMessages();
     CBlastTracebackSearch tback(m_Query, 
                                 core_data, 
                                 opts, 
                                 seqinfo_src,
                                 search_messages);
     tback.SetResultType(m_ResultType);
-    m_Results = tback.Run();
+    CRef<CSearchResultSet> retval = tback.Run();
 
     // Save the K&A values be as they might have been modified in the 
     // composition adjustment library
@@ -165,7 +239,365 @@ CPsiBlastImpl::Run()
         pssm.SetHUngapped
             (core_data->m_ScoreBlk->GetPointer()->kbp_psi[0]->H);
     }
-    return m_Results;
+    return retval;
+}
+
+bool
+CPsiBlastImpl::x_FindChangedColumns(vector<bool>& changed,
+                                    bool& identical) const
+{
+    changed.clear();
+    identical = false;
+    // Composition based statistics adjust the scores of every subject in the
+    // traceback, so alignments carried forward could not be rescored
+    if (m_IncrementalThreshold < 0 || m_ResultType != eDatabaseSearch ||
+        m_Pssm.Empty() || m_PrevScores.get() == NULL ||
+        m_Results.Empty() || m_Results->GetNumResults() != 1 ||
+        !m_Subject->IsBlastDb() ||
+        m_OptsHandle->GetOptions().GetCompositionBasedStats() !=
+            eNoCompositionBasedStats) {
+        return false;
+    }
+
+    unique_ptr< CNcbiMatrix<int> >
+        scores(CScorematPssmConverter::GetScores(*m_Pssm));
+    if (scores->GetRows() != m_PrevScores->GetRows() ||
+        scores->GetCols() != m_PrevScores->GetCols()) {
+        return false;
+    }
+
+    identical = true;
+    changed.resize(scores->GetCols(), false);
+    for (size_t col = 0; col < scores->GetCols(); col++) {
+        for (size_t row = 0; row < scores->GetRows(); row++) {
+            const int kDiff =
+                abs((*scores)(row, col) - (*m_PrevScores)(row, col));
+            if (kDiff != 0) {
+                identical = false;
+            }
+            if (kDiff > m_IncrementalThreshold) {
+                changed[col] = true;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+/// Alignments of a single subject sequence, ranked by the best of them
+struct SPsiSubjectHits {
+    /// Lowest e-value among the alignments
+    double m_Evalue;
+    /// Highest raw score among the alignments
+    int m_Score;
+    /// The alignments, in the order produced by the search
+    CSeq_align_set::Tdata m_Aligns;
+
+    /// Order subjects as the traceback stage does: best e-value first,
+    /// highest score among equal e-values
+    bool operator<(const SPsiSubjectHits& rhs) const {
+        if (m_Evalue != rhs.m_Evalue) {
+            return m_Evalue < rhs.m_Evalue;
+        }
+        return m_Score > rhs.m_Score;
+    }
+};
+
+/// Order the alignments of a subject by e-value, then by score
+/// @param lhs first alignment [in]
+/// @param rhs second alignment [in]
+static bool
+s_CompareAlignsByEvalue(const CRef<CSeq_align>& lhs,
+                        const CRef<CSeq_align>& rhs)
+{
+    double lhs_evalue = 0.0, rhs_evalue = 0.0;
+    int lhs_score = 0, rhs_score = 0;
+    lhs->GetNamedScore(CSeq_align::eScore_EValue, lhs_evalue);
+    rhs->GetNamedScore(CSeq_align::eScore_EValue, rhs_evalue);
+    if (lhs_evalue != rhs_evalue) {
+        return lhs_evalue < rhs_evalue;
+    }
+    lhs->GetNamedScore(CSeq_align::eScore_Score, lhs_score);
+    rhs->GetNamedScore(CSeq_align::eScore_Score, rhs_score);
+    return lhs_score > rhs_score;
+}
+
+/// Recompute the best e-value and score of a subject from its alignments
+/// @param hits the subject's alignments [in|out]
+static void
+s_UpdateSubjectRank(SPsiSubjectHits& hits)
+{
+    hits.m_Evalue = numeric_limits<double>::max();
+    hits.m_Score = 0;
+    ITERATE(CSeq_align_set::Tdata, itr, hits.m_Aligns) {
+        double evalue = 0.0;
+        int score = 0;
+        if ((*itr)->GetNamedScore(CSeq_align::eScore_EValue, evalue)) {
+            hits.m_Evalue = min(hits.m_Evalue, evalue);
+        }
+        if ((*itr)->GetNamedScore(CSeq_align::eScore_Score, score)) {
+            hits.m_Score = max(hits.m_Score, score);
+        }
+    }
+}
+
+/// Split the alignments of one query into groups for each subject
+/// @param aligns alignments, with those of each subject adjacent [in]
+/// @param retval the alignments of each subject [out]
+static void
+s_GroupAlignsBySubject(const CSeq_align_set::Tdata& aligns,
+                       vector<SPsiSubjectHits>& retval)
+{
+    retval.clear();
+    CConstRef<CSeq_id> previous_id;
+    ITERATE(CSeq_align_set::Tdata, itr, aligns) {
+        if ( !(*itr)->IsSetSegs() ) {
+            continue;
+        }
+        const CSeq_id& subject_id = (*itr)->GetSeq_id(1);
+        if (previous_id.Empty() || !subject_id.Match(*previous_id)) {
+            retval.push_back(SPsiSubjectHits());
+            previous_id.Reset(&subject_id);
+        }
+        retval.back().m_Aligns.push_back(*itr);
+    }
+    NON_CONST_ITERATE(vector<SPsiSubjectHits>, itr, retval) {
+        s_UpdateSubjectRank(*itr);
+    }
+}
+
+/// Statistics with which alignments carried forward from the previous
+/// iteration are rescored, as the traceback stage of the current one does
+struct SPsiRescoreParams {
+    /// Scores of the current PSSM (residues by query positions)
+    const CNcbiMatrix<int>* m_Scores;
+    /// Gap opening cost
+    int m_GapOpen;
+    /// Gap extension cost
+    int m_GapExtend;
+    /// Gapped Karlin-Altschul parameters of the current search
+    const Blast_KarlinBlk* m_Kbp;
+    /// Gumbel parameters of the current search, if e-values are computed
+    /// with Spouge's method
+    const Blast_GumbelBlk* m_Gbp;
+    /// Effective search space of the current search
+    Int8 m_SearchSpace;
+    /// Length of the query
+    int m_QueryLength;
+};
+
+/// Rescore an alignment with the scores and statistics of the current
+/// iteration
+/// @param align alignment to rescore; a copy is returned [in]
+/// @param subject subject sequence in ncbistdaa [in]
+/// @param subject_length length of the subject sequence [in]
+/// @param params current scores and statistics [in]
+/// @return the rescored alignment, or NULL if it cannot be rescored
+static CRef<CSeq_align>
+s_RescoreAlign(const CSeq_align& align,
+               const char* subject,
+               int subject_length,
+               const SPsiRescoreParams& params)
+{
+    CRef<CSeq_align> retval;
+    if ( !align.GetSegs().IsDenseg() ) {
+        return retval;
+    }
+    const CDense_seg& denseg = align.GetSegs().GetDenseg();
+    if (denseg.GetDim() != 2) {
+        return retval;
+    }
+
+    const CDense_seg::TStarts& starts = denseg.GetStarts();
+    const CDense_seg::TLens& lens = denseg.GetLens();
+    const size_t kNumRows = params.m_Scores->GetRows();
+    const size_t kNumCols = params.m_Scores->GetCols();
+    int score = 0;
+    for (CDense_seg::TNumseg seg = 0; seg < denseg.GetNumseg(); seg++) {
+        const TSignedSeqPos q_start = starts[2*seg];
+        const TSignedSeqPos s_start = starts[2*seg + 1];
+        const TSeqPos length = lens[seg];
+        if (q_start < 0 || s_start < 0) {
+            score -= params.m_GapOpen + params.m_GapExtend * (int)length;
+            continue;
+        }
+        if ((size_t)q_start + length > kNumCols ||
+            s_start + (int)length > subject_length) {
+            return retval;
+        }
+        for (TSeqPos i = 0; i < length; i++) {
+            const size_t kResidue = (unsigned char)subject[s_start + i];
+            if (kResidue >= kNumRows) {
+                return retval;
+            }
+            score += (*params.m_Scores)(kResidue, q_start + i);
+        }
+    }
+
+    double evalue = 0.0;
+    if (params.m_Gbp) {
+        evalue = BLAST_SpougeStoE(score,
+                                  const_cast<Blast_KarlinBlk*>(params.m_Kbp),
+                                  const_cast<Blast_GumbelBlk*>(params.m_Gbp),
+                                  params.m_QueryLength, subject_length);
+    } else {
+        evalue = BLAST_KarlinStoE_simple
+            (score, const_cast<Blast_KarlinBlk*>(params.m_Kbp),
+             params.m_SearchSpace);
+    }
+    const double kBitScore =
+        (score * params.m_Kbp->Lambda - params.m_Kbp->logK) / NCBIMATH_LN2;
+
+    retval.Reset(new CSeq_align);
+    retval->Assign(align);
+    retval->SetNamedScore(CSeq_align::eScore_Score, score);
+    retval->SetNamedScore(CSeq_align::eScore_BitScore, kBitScore);
+    retval->SetNamedScore(CSeq_align::eScore_EValue, evalue);
+    return retval;
+}
+
+/// Check whether two alignments of the same subject cover the same region
+/// @param lhs first alignment [in]
+/// @param rhs second alignment [in]
+static bool
+s_AlignsOverlap(const CSeq_align& lhs, const CSeq_align& rhs)
+{
+    return lhs.GetSeqRange(0).IntersectingWith(rhs.GetSeqRange(0)) &&
+           lhs.GetSeqRange(1).IntersectingWith(rhs.GetSeqRange(1));
+}
+
+void
+CPsiBlastImpl::x_CarryForwardHits(const vector<bool>& changed,
+                                  CSearchResultSet& results)
+{
+    _ASSERT(results.GetNumResults() == 1);
+    CRef<CSeq_align_set> aligns = results[0].SetSeqAlign();
+    CConstRef<CSeq_align_set> prev_aligns = (*m_Results)[0].GetSeqAlign();
+    CRef<CBlastAncillaryData> ancillary = results[0].GetAncillaryData();
+    if (aligns.Empty() || prev_aligns.Empty() || ancillary.Empty()) {
+        return;
+    }
+
+    unique_ptr< CNcbiMatrix<int> >
+        scores(CScorematPssmConverter::GetScores(*m_Pssm));
+    const CBlastOptions& opts = m_OptsHandle->GetOptions();
+    SPsiRescoreParams params;
+    params.m_Scores = scores.get();
+    params.m_GapOpen = opts.GetGapOpeningCost();
+    params.m_GapExtend = opts.GetGapExtensionCost();
+    params.m_Kbp = ancillary->GetPsiGappedKarlinBlk()
+        ? ancillary->GetPsiGappedKarlinBlk()
+        : ancillary->GetGappedKarlinBlk();
+    params.m_Gbp = ancillary->GetGumbelBlk();
+    params.m_SearchSpace = ancillary->GetSearchSpace();
+    params.m_QueryLength = (int)changed.size();
+    if (params.m_Kbp == NULL) {
+        return;
+    }
+
+    vector<SPsiSubjectHits> subjects;
+    s_GroupAlignsBySubject(aligns->Get(), subjects);
+    typedef map<CSeq_id_Handle, size_t> TSubjectIndex;
+    TSubjectIndex found;
+    for (size_t i = 0; i < subjects.size(); i++) {
+        found[CSeq_id_Handle::GetHandle
+              (subjects[i].m_Aligns.front()->GetSeq_id(1))] = i;
+    }
+
+    // The previous alignments that avoid the changed columns still hold,
+    // but are rescored with the current PSSM and statistics.  They are
+    // merged with the new alignments of their subject, unless they cover
+    // the same region as one of these
+    CRef<CSeqDB> seqdb = m_Subject->GetSearchDatabase()->GetSeqDb();
+    vector<SPsiSubjectHits> prev_subjects;
+    s_GroupAlignsBySubject(prev_aligns->Get(), prev_subjects);
+    size_t num_carried = 0;
+    ITERATE(vector<SPsiSubjectHits>, itr, prev_subjects) {
+        const CSeq_id& subject_id = itr->m_Aligns.front()->GetSeq_id(1);
+        TSubjectIndex::const_iterator new_hits =
+            found.find(CSeq_id_Handle::GetHandle(subject_id));
+
+        CSeq_align_set::Tdata stable;
+        ITERATE(CSeq_align_set::Tdata, align, itr->m_Aligns) {
+            const TSeqRange range = (*align)->GetSeqRange(0);
+            bool is_stable = true;
+            for (TSeqPos i = range.GetFrom();
+                 is_stable && i <= range.GetTo() && i < changed.size(); i++) {
+                is_stable = !changed[i];
+            }
+            if (is_stable && new_hits != found.end()) {
+                ITERATE(CSeq_align_set::Tdata, new_align,
+                        subjects[new_hits->second].m_Aligns) {
+                    if (s_AlignsOverlap(**align, **new_align)) {
+                        is_stable = false;
+                        break;
+                    }
+                }
+            }
+            if (is_stable) {
+                stable.push_back(*align);
+            }
+        }
+
+        int oid = -1;
+        if (stable.empty() || !seqdb->SeqidToOid(subject_id, oid)) {
+            continue;
+        }
+        const char* subject = NULL;
+        const int kSubjectLength = seqdb->GetSequence(oid, &subject);
+        CSeq_align_set::Tdata rescored;
+        ITERATE(CSeq_align_set::Tdata, align, stable) {
+            CRef<CSeq_align> new_align =
+                s_RescoreAlign(**align, subject, kSubjectLength, params);
+            double evalue = 0.0;
+            if (new_align.NotEmpty() &&
+                new_align->GetNamedScore(CSeq_align::eScore_EValue, evalue) &&
+                evalue <= opts.GetEvalueThreshold()) {
+                rescored.push_back(new_align);
+            }
+        }
+        seqdb->RetSequence(&subject);
+        if (rescored.empty()) {
+            continue;
+        }
+
+        if (new_hits == found.end()) {
+            subjects.push_back(SPsiSubjectHits());
+            subjects.back().m_Aligns.swap(rescored);
+        } else {
+            CSeq_align_set::Tdata& merged =
+                subjects[new_hits->second].m_Aligns;
+            merged.insert(merged.end(), rescored.begin(), rescored.end());
+        }
+        num_carried++;
+    }
+    if (num_carried == 0) {
+        return;
+    }
+
+    NON_CONST_ITERATE(vector<SPsiSubjectHits>, itr, subjects) {
+        itr->m_Aligns.sort(s_CompareAlignsByEvalue);
+        s_UpdateSubjectRank(*itr);
+    }
+    stable_sort(subjects.begin(), subjects.end());
+    aligns->Set().clear();
+    ITERATE(vector<SPsiSubjectHits>, itr, subjects) {
+        aligns->Set().insert(aligns->Set().end(),
+                             itr->m_Aligns.begin(), itr->m_Aligns.end());
+    }
+    results[0].TrimSeqAlign(m_OptsHandle->GetHitlistSize());
+}
+
+void
+CPsiBlastImpl::x_SaveIterationState()
+{
+    if (m_IncrementalThreshold < 0 || m_Pssm.Empty()) {
+        m_PrevPssm.Reset();
+        m_PrevScores.reset();
+        return;
+    }
+    m_PrevPssm = m_Pssm;
+    m_PrevScores.reset(CScorematPssmConverter::GetScores(*m_Pssm));
 }
 
 void
@@ -185,6 +617,12 @@ CPsiBlastImpl::SetResultType(EResultType type)
     m_ResultType = type;
 }
 
+void
+CPsiBlastImpl::SetIncrementalThreshold(int threshold)
+{
+    m_IncrementalThreshold = threshold;
+}
+
 CConstRef<CPssmWithParameters>
 CPsiBlastImpl::GetPssm() const 
 {
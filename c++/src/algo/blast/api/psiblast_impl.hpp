@@ -37,6 +37,7 @@
 #include <algo/blast/api/setup_factory.hpp>
 #include <algo/blast/api/uniform_search.hpp>
 #include <algo/blast/api/local_db_adapter.hpp>
+#include <util/math/matrix.hpp>
 
 /** @addtogroup AlgoBlast
  *
@@ -97,6 +98,12 @@ public:
     /// @param type of result requested [in]
     void SetResultType(EResultType type);
 
+    /// Enable or disable incremental iterations
+    /// @param threshold largest change in a PSSM score that leaves its
+    /// column unchanged, or a negative value to always search the whole
+    /// database [in]
+    void SetIncrementalThreshold(int threshold);
+
 private:
 
     /// PSSM to be used as query
@@ -117,6 +124,16 @@ private:
     /// Specifies how the results should be produced
     EResultType m_ResultType;
 
+    /// Largest change in a PSSM score that leaves its column unchanged in
+    /// incremental iterations (negative if these are disabled)
+    int m_IncrementalThreshold;
+
+    /// PSSM searched by the previous call to Run
+    CConstRef<objects::CPssmWithParameters> m_PrevPssm;
+
+    /// Scores of m_PrevPssm at the time it was searched
+    unique_ptr< CNcbiMatrix<int> > m_PrevScores;
+
     /// Prohibit copy constructor
     CPsiBlastImpl(const CPsiBlastImpl& rhs);
 
@@ -132,6 +149,30 @@ private:
     /// Auxiliary function to get the query sequence data from the ASN.1 PSSM
     /// Post-condition: (m_Query.Empty() == false)
     void x_ExtractQueryFromPssm();
+
+    /// Runs the preliminary and traceback stages of the search
+    /// @param seed_ranges if not NULL, only words within these query ranges
+    /// seed alignments [in]
+    CRef<CSearchResultSet> x_Search(const vector<TSeqRange>* seed_ranges);
+
+    /// Finds the PSSM columns whose scores changed by more than
+    /// m_IncrementalThreshold since the previous call to Run
+    /// @param changed true for every changed column [out]
+    /// @param identical true if no score changed at all [out]
+    /// @return false if this iteration cannot be run incrementally
+    bool x_FindChangedColumns(vector<bool>& changed, bool& identical) const;
+
+    /// Adds the alignments found by the previous iteration that avoid the
+    /// changed PSSM columns to the results of an incremental iteration,
+    /// rescored with the current PSSM and search statistics and merged
+    /// with the new alignments of their subjects
+    /// @param changed true for every changed column [in]
+    /// @param results results of the incremental iteration [in|out]
+    void x_CarryForwardHits(const vector<bool>& changed,
+                            CSearchResultSet& results);
+
+    /// Saves the PSSM that was just searched for the next iteration
+    void x_SaveIterationState();
 };
 
 END_SCOPE(blast)
@@ -383,12 +383,13 @@ CPssmEngine::x_CreatePssmFromMsa()
     CPSIMatrix pssm;
     CPSIDiagnosticsResponse diagnostics;
     int status = 
-        PSICreatePssmWithDiagnostics(m_PssmInput->GetData(),
-                                     m_PssmInput->GetOptions(),
-                                     m_ScoreBlk, 
-                                     m_PssmInput->GetDiagnosticsRequest(),
-                                     &pssm, 
-                                     &diagnostics);
+        PSICreatePssmWithDiagnostics_MT(m_PssmInput->GetData(),
+                                        m_PssmInput->GetOptions(),
+                                        m_ScoreBlk, 
+                                        m_PssmInput->GetDiagnosticsRequest(),
+                                        &pssm, 
+                                        &diagnostics,
+                                        GetNumberOfThreads());
     if (status != PSI_SUCCESS) {
         // FIXME: need to use core level perror-like facility
         string msg = x_ErrorCodeToString(status);
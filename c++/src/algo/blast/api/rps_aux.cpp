@@ -33,6 +33,7 @@
 
 #include <ncbi_pch.hpp>
 #include <corelib/ncbifile.hpp>
+#include <corelib/ncbimtx.hpp>
 #include <algo/blast/api/blast_exception.hpp>
 #include <objtools/blast/seqdb_reader/seqdb.hpp>
 #include <algo/blast/api/rps_aux.hpp>
@@ -504,6 +505,61 @@ CRpsFreqRatiosFile::operator()() const
     return m_Data;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+//
+// Shared memory mapped files
+//
+/////////////////////////////////////////////////////////////////////////////
+
+/// Memory mapped RPS-BLAST database files in use, by file name.  Concurrent
+/// searches of the same database (e.g.: the threads of CLocalRPSBlast, or the
+/// preliminary and traceback stages of one search) share one mapping of each
+/// file; a file is unmapped when the last CBlastRPSInfo using it goes away.
+typedef map<string, CRef<CRpsMmappedFile> > TRpsMmappedFiles;
+
+DEFINE_STATIC_FAST_MUTEX(s_RpsFilesMutex);
+
+/// Returns the files in use; never destroyed, so that CBlastRPSInfo objects
+/// released at exit can still use it
+static TRpsMmappedFiles& s_GetRpsFiles(void)
+{
+    static TRpsMmappedFiles* files = new TRpsMmappedFiles;
+    return *files;
+}
+
+/// Unmaps the files no longer used by any CBlastRPSInfo; the caller must
+/// hold s_RpsFilesMutex
+static void s_ReleaseRpsFiles(void)
+{
+    TRpsMmappedFiles& files = s_GetRpsFiles();
+    for (TRpsMmappedFiles::iterator it = files.begin(); it != files.end(); ) {
+        if (it->second->ReferencedOnlyOnce()) {
+            files.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/// Returns the mapping of an RPS-BLAST database file, mapping it if it is
+/// not in use yet
+/// @param filename_no_extn name of the file without extension
+template <class TFile>
+static CRef<TFile> s_OpenRpsFile(const string& filename_no_extn)
+{
+    const string kFilename(filename_no_extn + TFile::kExtension);
+    CFastMutexGuard guard(s_RpsFilesMutex);
+    TRpsMmappedFiles& files = s_GetRpsFiles();
+    TRpsMmappedFiles::iterator it = files.find(kFilename);
+    if (it == files.end()) {
+        // Also drops files left over by a CBlastRPSInfo that failed to load
+        s_ReleaseRpsFiles();
+        CRef<CRpsMmappedFile> file(new TFile(filename_no_extn));
+        it = files.insert(make_pair(kFilename, file)).first;
+    }
+    return CRef<TFile>(static_cast<TFile*>(it->second.GetPointer()));
+}
+
 
 CBlastRPSInfo::CBlastRPSInfo(const string& rps_dbname)
 {
@@ -556,7 +612,7 @@ void CBlastRPSInfo::x_Init(const string& rps_dbname, int flags)
     }
 
     if (flags & fLookupTableFile) {
-        m_LutFile.Reset(new CRpsLookupTblFile(path));
+        m_LutFile = s_OpenRpsFile<CRpsLookupTblFile>(path);
 
         // Note that these const_casts are only needed because the data structure
         // doesn't take const pointers, but these won't be modified at all
@@ -565,7 +621,7 @@ void CBlastRPSInfo::x_Init(const string& rps_dbname, int flags)
     }
 
     if (flags & fPssmFile) {
-        m_PssmFile.Reset(new CRpsPssmFile(path));
+        m_PssmFile = s_OpenRpsFile<CRpsPssmFile>(path);
 
         // Note that these const_casts are only needed because the data structure
         // doesn't take const pointers, but these won't be modified at all
@@ -574,7 +630,7 @@ void CBlastRPSInfo::x_Init(const string& rps_dbname, int flags)
     }
 
     if (flags & fFrequenciesFile) {
-        m_FreqsFile.Reset(new CRpsFreqsFile(path));
+        m_FreqsFile = s_OpenRpsFile<CRpsFreqsFile>(path);
 
         // Note that these const_casts are only needed because the data structure
         // doesn't take const pointers, but these won't be modified at all
@@ -583,7 +639,7 @@ void CBlastRPSInfo::x_Init(const string& rps_dbname, int flags)
     }
 
     if (flags & fObservationsFile) {
-        m_ObsrFile.Reset(new CRpsObsrFile(path));
+        m_ObsrFile = s_OpenRpsFile<CRpsObsrFile>(path);
 
         // Note that these const_casts are only needed because the data structure
         // doesn't take const pointers, but these won't be modified at all
@@ -594,7 +650,7 @@ void CBlastRPSInfo::x_Init(const string& rps_dbname, int flags)
     if (flags & fFreqRatiosFile) {
         try {
             // read frequency ratios data
-            m_FreqRatiosFile.Reset(new CRpsFreqRatiosFile(path));
+            m_FreqRatiosFile = s_OpenRpsFile<CRpsFreqRatiosFile>(path);
         } catch (const CBlastException& e) {
         	string msg = rps_dbname + " contains no frequency ratios needed for composition-based statistics.\n" \
         			     "Please disable composition-based statistics when searching against " + rps_dbname + ".";
@@ -605,10 +661,17 @@ void CBlastRPSInfo::x_Init(const string& rps_dbname, int flags)
     }
 }
 
-// Trivial at this point, but left out-of-line so that the header doesn't
-// need to pull in full declarations of the classes to which it takes CRefs.
+// Left out-of-line so that the header doesn't need to pull in full
+// declarations of the classes to which it takes CRefs.
 CBlastRPSInfo::~CBlastRPSInfo()
 {
+    CFastMutexGuard guard(s_RpsFilesMutex);
+    m_PssmFile.Reset();
+    m_LutFile.Reset();
+    m_FreqsFile.Reset();
+    m_ObsrFile.Reset();
+    m_FreqRatiosFile.Reset();
+    s_ReleaseRpsFiles();
 }
 
 const BlastRPSInfo*
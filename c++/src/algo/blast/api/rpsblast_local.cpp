@@ -247,6 +247,57 @@ static void s_MapDbToThread(vector<string> & db, unsigned int num_of_threads)
 
 }
 
+/// Splits the queries into num_of_groups contiguous groups with about the
+/// same number of residues each
+static void s_SplitQueries(const CBlastQueryVector & query_vector,
+						   unsigned int num_of_groups,
+						   vector<CRef<CBlastQueryVector> > & groups)
+{
+	const size_t num_of_queries = query_vector.Size();
+	_ASSERT(num_of_groups > 0 && num_of_groups <= num_of_queries);
+
+	vector<Uint8> lengths(num_of_queries);
+	Uint8 total_length = 0;
+	for(size_t i=0; i < num_of_queries; i++)
+	{
+		lengths[i] = query_vector[i]->GetLength();
+		total_length += lengths[i];
+	}
+
+	groups.clear();
+	groups.push_back(CRef<CBlastQueryVector>(new CBlastQueryVector));
+	Uint8 length = 0;
+	for(size_t i=0; i < num_of_queries; i++)
+	{
+		// Start the next group once this one has its share of the residues,
+		// or when each group left needs one of the remaining queries
+		if(!groups.back()->Empty() && groups.size() < num_of_groups &&
+		   (length * num_of_groups >= total_length * groups.size() ||
+		    num_of_queries - i == num_of_groups - groups.size()))
+		{
+			groups.push_back(CRef<CBlastQueryVector>(new CBlastQueryVector));
+		}
+		groups.back()->AddQuery(query_vector[i]);
+		length += lengths[i];
+	}
+	_ASSERT(groups.size() == num_of_groups);
+}
+
+/// Concatenates the results of searches of consecutive query groups
+static CRef<CSearchResultSet> s_ConcatSearchSets(vector<CRef<CSearchResultSet> > & t)
+{
+	CRef<CSearchResultSet>   concat_search_result_set (new CSearchResultSet());
+	for(unsigned int i=0; i < t.size(); i++)
+	{
+		for(unsigned int q=0; q < t[i]->GetNumQueries(); q++)
+		{
+			CRef<CSearchResults> results(&((*(t[i]))[q]));
+			concat_search_result_set->push_back(results);
+		}
+	}
+	return concat_search_result_set;
+}
+
 CRef<CSearchResultSet> s_RunLocalRpsSearch(const string & db,
 										   CBlastQueryVector  & query_vector,
 										   CRef<CBlastOptionsHandle> opt_handle)
@@ -340,7 +391,7 @@ CLocalRPSBlast::CLocalRPSBlast(CRef<CBlastQueryVector> query_vector,
 {
 	CSeqDB::FindVolumePaths(db, CSeqDB::eProtein, m_rps_databases, NULL, true, true);
 	m_num_of_dbs = m_rps_databases.size();
-	if( 1 == m_num_of_dbs)
+	if( 1 == m_num_of_dbs && kAutoThreadedSearch == m_num_of_threads)
 	{
 		m_num_of_threads = kDisableThreadedSearch;
 	}
@@ -410,42 +461,83 @@ CRef<CSearchResultSet> CLocalRPSBlast::RunThreadedSearch(void)
 {
 
    	s_ModifyVolumePaths(m_rps_databases);
+   	if(1 == m_num_of_dbs)
+   	{
+   		// Search the database as named, as the non-threaded search does, so
+   		// that the settings of an alias on top of the volume (e.g.: its
+   		// statistics) are kept
+   		m_rps_databases[0] = m_db_name;
+   	}
 
-   	if((kAutoThreadedSearch == m_num_of_threads) ||
-   	  (m_num_of_threads > m_rps_databases.size()))
+   	// Volumes (or groups of volumes) are searched by separate threads;
+   	// with more threads than volumes, each volume is searched by several
+   	// threads, each with its own part of the queries.  All threads share
+   	// the memory mapped files of a volume (see CBlastRPSInfo).
+   	unsigned int num_of_query_groups = 1;
+   	if(kAutoThreadedSearch == m_num_of_threads)
    	{
    		//Default num of thread : a thread for each db
    		m_num_of_threads = m_rps_databases.size();
    	}
+   	else if(m_num_of_threads > m_rps_databases.size())
+   	{
+   		num_of_query_groups = m_num_of_threads / m_rps_databases.size();
+   		if(num_of_query_groups > m_query_vector->Size())
+   			num_of_query_groups = m_query_vector->Size();
+   		m_num_of_threads = m_rps_databases.size();
+   	}
    	else if(m_num_of_threads < m_rps_databases.size())
    	{
    		// Combine databases, modified the size of rps_database
    		s_MapDbToThread(m_rps_databases, m_num_of_threads);
    	}
 
-   	vector<CRef<CSearchResultSet> * > 	thread_results(m_num_of_threads, NULL);
-   	vector <CRPSThread* >				thread(m_num_of_threads, NULL);
+   	vector<CRef<CBlastQueryVector> >	query_groups;
+   	if(num_of_query_groups > 1)
+   	{
+   		s_SplitQueries(*m_query_vector, num_of_query_groups, query_groups);
+   	}
+   	else
+   	{
+   		query_groups.push_back(m_query_vector);
+   	}
+
+   	const unsigned int					num_of_tasks = m_num_of_threads * num_of_query_groups;
+   	vector<CRef<CSearchResultSet> * > 	thread_results(num_of_tasks, NULL);
+   	vector <CRPSThread* >				thread(num_of_tasks, NULL);
    	vector<CRef<CSearchResultSet> >   results;
 
-   	for(unsigned int t=0; t < m_num_of_threads; t++)
+   	for(unsigned int t=0; t < num_of_tasks; t++)
    	{
    		// CThread destructor is protected, all threads destory themselves when terminated
-   		thread[t] = (new CRPSThread(m_query_vector, m_rps_databases[t], m_opt_handle->SetOptions().Clone()));
+   		thread[t] = (new CRPSThread(query_groups[t % num_of_query_groups],
+   		                            m_rps_databases[t / num_of_query_groups],
+   		                            m_opt_handle->SetOptions().Clone()));
    		thread[t]->Run();
    	}
 
-   	for(unsigned int t=0; t < m_num_of_threads; t++)
+   	for(unsigned int t=0; t < num_of_tasks; t++)
    	{
    		thread[t]->Join(reinterpret_cast<void**> (&thread_results[t]));
    	}
 
-   	for(unsigned int t=0; t < m_num_of_threads; t++)
+   	for(unsigned int t=0; t < num_of_tasks; t += num_of_query_groups)
    	{
-   		results.push_back(*(thread_results[t]));
+   		vector<CRef<CSearchResultSet> >   db_results;
+   		for(unsigned int q=0; q < num_of_query_groups; q++)
+   		{
+   			db_results.push_back(*(thread_results[t + q]));
+   			delete thread_results[t + q];
+   		}
+   		results.push_back(num_of_query_groups > 1 ? s_ConcatSearchSets(db_results) : db_results[0]);
    	}
 
    	CRef<CBlastRPSInfo>  rpsInfo = CSetupFactory::CreateRpsStructures(m_db_name,
    	            												CRef<CBlastOptions> (&(m_opt_handle->SetOptions())));
+   	if(1 == m_num_of_threads)
+   	{
+   		return results[0];
+   	}
    	return s_CombineSearchSets(results, m_num_of_threads);
 
 }
@@ -67,10 +67,14 @@ struct SSeqDB_SeqSrc_Data {
     {
     }
 
-    /// Make a copy of this object, sharing the same SeqDB object.
+    /// Make a copy of this object, sharing the same SeqDB object and chunk
+    /// bookmark.
     SSeqDB_SeqSrc_Data * clone()
     {
-        return new SSeqDB_SeqSrc_Data(&* seqdb, mask_algo_id, mask_type);
+        SSeqDB_SeqSrc_Data * retval =
+            new SSeqDB_SeqSrc_Data(&* seqdb, mask_algo_id, mask_type);
+        retval->oid_state = oid_state;
+        return retval;
     }
 
     /// Convenience to allow datap->method to use SeqDB methods.
@@ -90,6 +94,11 @@ struct SSeqDB_SeqSrc_Data {
     /// SeqDB object.
     CRef<CSeqDBExpert> seqdb;
 
+    /// Chunk bookmark shared by the copies of a BlastSeqSrc iterating
+    /// independently of the other users of the SeqDB object (NULL to use the
+    /// bookmark of the SeqDB object).
+    CRef< CObjectFor<int> > oid_state;
+
     /// Algorithm ID and type for mask data fetching.
     int mask_algo_id;
     ESubjectMaskingType mask_type;
@@ -467,13 +476,16 @@ s_SeqDbGetNextChunk(void* seqdb_handle, BlastSeqSrcIterator* itr)
     if (!seqdb_handle || !itr)
         return BLAST_SEQSRC_ERROR;
 
-    CSeqDB & seqdb = **(TSeqDBData *) seqdb_handle;
+    TSeqDBData * datap = (TSeqDBData *) seqdb_handle;
+    CSeqDB & seqdb = **datap;
 
     vector<int> oid_list;
 
     CSeqDB::EOidListType chunk_type =
         seqdb.GetNextOIDChunk(itr->oid_range[0], itr->oid_range[1],
-                              itr->chunk_sz, oid_list);
+                              itr->chunk_sz, oid_list,
+                              (datap->oid_state.NotEmpty()
+                               ? &datap->oid_state->GetData() : NULL));
 
     if (itr->oid_range[1] <= itr->oid_range[0])
         return BLAST_SEQSRC_EOF;
@@ -547,14 +559,22 @@ s_SeqDbIteratorNext(void* seqdb_handle, BlastSeqSrcIterator* itr)
     return retval;
 }
 
-/// Resets CSeqDB's internal chunk bookmark
+/// Resets CSeqDB's internal chunk bookmark, or the private chunk bookmark of
+/// the BlastSeqSrc if it has one
 /// @param seqdb_handle Reference to the database object, cast to void* to
 ///                     satisfy the signature requirement. [in]
 static void
 s_SeqDbResetChunkIterator(void* seqdb_handle)
 {
     _ASSERT(seqdb_handle);
-    CSeqDB & seqdb = **(TSeqDBData *) seqdb_handle;
+    TSeqDBData * datap = (TSeqDBData *) seqdb_handle;
+    if (datap->oid_state.NotEmpty()) {
+        // Other BlastSeqSrcs may be iterating over the same SeqDB object,
+        // so its caches are left alone
+        datap->oid_state->GetData() = 0;
+        return;
+    }
+    CSeqDB & seqdb = **datap;
     seqdb.ResetInternalChunkBookmark();
     seqdb.FlushOffsetRangeCache();
 }
@@ -792,6 +812,18 @@ SeqDbBlastSeqSrcInit(CSeqDB * seqdb,
     return seq_src;
 }
 
+bool
+SeqDbBlastSeqSrcSetPrivateChunkBookmark(BlastSeqSrc* seq_src)
+{
+    if ( !seq_src ||
+         _BlastSeqSrcImpl_GetIterNext(seq_src) != & s_SeqDbIteratorNext) {
+        return false;
+    }
+    TSeqDBData * datap = static_cast<TSeqDBData*>
+        (_BlastSeqSrcImpl_GetDataStructure(seq_src));
+    datap->oid_state.Reset(new CObjectFor<int>(0));
+    return true;
+}
 
 END_SCOPE(blast)
 END_NCBI_SCOPE
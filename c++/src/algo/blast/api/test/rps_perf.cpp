@@ -0,0 +1,226 @@
+/*  $Id$
+ * ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+/** @file rps_perf.cpp
+ * Command line tool to time the RPS-BLAST preliminary search with the hits
+ * of each lookup table bucket grouped by database block and left in the
+ * scan order.
+ */
+
+#include <ncbi_pch.hpp>
+#include <corelib/ncbiapp.hpp>
+#include <corelib/ncbitime.hpp>
+#include <objmgr/object_manager.hpp>
+#include <objmgr/scope.hpp>
+#include <objtools/readers/fasta.hpp>
+#include <algo/blast/api/blast_options_handle.hpp>
+#include <algo/blast/api/objmgr_query_data.hpp>
+#include <algo/blast/api/prelim_stage.hpp>
+#include <algo/blast/api/seqsrc_seqdb.hpp>
+#include <algo/blast/api/setup_factory.hpp>
+#include <algo/blast/core/blast_aalookup.h>
+#include "../blast_memento_priv.hpp"
+#include "../prelim_search_runner.hpp"
+
+#ifndef SKIP_DOXYGEN_PROCESSING
+USING_NCBI_SCOPE;
+USING_SCOPE(objects);
+USING_SCOPE(blast);
+#endif
+
+/// The application class
+class CRpsPerfApp : public CNcbiApplication
+{
+public:
+    /** @inheritDoc */
+    CRpsPerfApp() {}
+
+private:
+    /** @inheritDoc */
+    virtual void Init();
+    /** @inheritDoc */
+    virtual int Run();
+
+    /// Read the queries from the FASTA input
+    /// @return the queries
+    TSeqLocVector x_ReadQueries();
+
+    /// Run the preliminary search once more on the set up search
+    /// @param data the internal data of the set up search [in|out]
+    /// @param memento the search options [in]
+    /// @param sort_by_block whether the hits of each bucket are grouped
+    /// by database block [in]
+    /// @param num_hsps number of HSPs found [out]
+    /// @return the search time in seconds
+    double x_Search(SInternalData& data, const CBlastOptionsMemento* memento,
+                    bool sort_by_block, Int8& num_hsps);
+
+    /// The search object that set up the search
+    unique_ptr<CBlastPrelimSearch> m_PrelimSearch;
+};
+
+TSeqLocVector CRpsPerfApp::x_ReadQueries()
+{
+    CRef<CScope> scope(new CScope(*CObjectManager::GetInstance()));
+    CFastaReader reader(GetArgs()["query"].AsInputFile(),
+                        CFastaReader::fAssumeProt | CFastaReader::fForceType);
+    TSeqLocVector retval;
+
+    while ( !reader.AtEOF() ) {
+        CRef<CSeq_entry> entry = reader.ReadOneSeq();
+        scope->AddTopLevelSeqEntry(*entry);
+        CRef<CSeq_loc> loc(new CSeq_loc);
+        loc->SetWhole().Assign(*entry->GetSeq().GetFirstId());
+        retval.push_back(SSeqLoc(loc, scope));
+    }
+
+    if (retval.empty()) {
+        NCBI_THROW(CException, eInvalid, "No queries in the input");
+    }
+    return retval;
+}
+
+double CRpsPerfApp::x_Search(SInternalData& data,
+                             const CBlastOptionsMemento* memento,
+                             bool sort_by_block, Int8& num_hsps)
+{
+    BlastHSPStream* hsp_stream =
+        CSetupFactory::CreateHspStream(memento, data.m_QueryInfo->num_queries,
+            CSetupFactory::CreateHspWriter(memento, data.m_Queries,
+                                           data.m_QueryInfo));
+    data.m_HspStream.Reset(new TBlastHSPStream(hsp_stream, BlastHSPStreamFree));
+
+    BlastRPSLookupTable* lookup =
+        (BlastRPSLookupTable*) data.m_LookupTable->GetPointer()->lut;
+    lookup->sort_by_block = sort_by_block ? TRUE : FALSE;
+
+    CStopWatch sw(CStopWatch::eStart);
+    if (CPrelimSearchRunner(data, memento)() != 0) {
+        NCBI_THROW(CException, eUnknown, "Preliminary search failed");
+    }
+    double retval = sw.Elapsed();
+
+    CBlastHSPResults results(m_PrelimSearch->ComputeBlastHSPResults(
+                                      data.m_HspStream->GetPointer()));
+    num_hsps = 0;
+    for (int q = 0; q < results->num_queries; q++) {
+        const BlastHitList* hit_list = results->hitlist_array[q];
+        for (int i = 0; hit_list && i < hit_list->hsplist_count; i++) {
+            num_hsps += hit_list->hsplist_array[i]->hspcnt;
+        }
+    }
+    return retval;
+}
+
+void CRpsPerfApp::Init()
+{
+    HideStdArgs(fHideConffile | fHideFullVersion | fHideXmlHelp | fHideDryRun);
+
+    unique_ptr<CArgDescriptions> arg_desc(new CArgDescriptions);
+
+    arg_desc->SetUsageContext(GetArguments().GetProgramBasename(),
+                  "Time the RPS-BLAST preliminary search with grouped and "
+                  "ungrouped lookup table buckets");
+
+    arg_desc->AddKey("db", "database_name", "RPS-BLAST database",
+                     CArgDescriptions::eString);
+    arg_desc->AddKey("query", "fasta_file", "Protein FASTA queries",
+                     CArgDescriptions::eInputFile);
+    arg_desc->AddDefaultKey("repeats", "number",
+                            "Number of timed searches in each mode",
+                            CArgDescriptions::eInteger, "3");
+    arg_desc->SetConstraint("repeats", new CArgAllow_Integers(1, kMax_Int));
+
+    SetupArgDescriptions(arg_desc.release());
+}
+
+int CRpsPerfApp::Run(void)
+{
+    int status = 0;
+
+    try {
+        const CArgs& args = GetArgs();
+        TSeqLocVector queries = x_ReadQueries();
+
+        CBlastSeqSrc seq_src(SeqDbBlastSeqSrcInit(args["db"].AsString(),
+                                                  TRUE));
+        CRef<CBlastOptionsHandle> opts(
+                               CBlastOptionsFactory::Create(eRPSBlast));
+        CRef<CBlastOptions> options(&opts->SetOptions());
+        CRef<IQueryFactory> query_factory(new CObjMgr_QueryFactory(queries));
+
+        // the first search sets up the lookup table and warms up the
+        // memory mapped database files; it is not timed
+        m_PrelimSearch.reset(new CBlastPrelimSearch(query_factory, options,
+                                                    seq_src));
+        CRef<SInternalData> data(m_PrelimSearch->Run());
+        unique_ptr<const CBlastOptionsMemento>
+            memento(options->CreateSnapshot());
+
+        double time[2] = { 0.0, 0.0 };
+        Int8 num_hsps[2] = { 0, 0 };
+
+        // alternate the modes so that both see the same system state
+        for (int i = 0; i < args["repeats"].AsInteger(); i++) {
+            for (int grouped = 0; grouped < 2; grouped++) {
+                time[grouped] += x_Search(*data, memento.get(),
+                                          grouped != 0, num_hsps[grouped]);
+            }
+        }
+
+        static const char* kModes[2] = { "Scan order", "Grouped" };
+        cout << queries.size() << " queries, " << args["repeats"].AsInteger()
+             << " searches in each mode" << endl;
+        for (int grouped = 0; grouped < 2; grouped++) {
+            cout << kModes[grouped] << ": "
+                 << NStr::DoubleToString(time[grouped], 2) << " s, "
+                 << num_hsps[grouped] << " HSPs" << endl;
+        }
+        cout << "Speedup: "
+             << NStr::DoubleToString(time[0] / time[1], 2) << endl;
+
+        if (num_hsps[0] != num_hsps[1]) {
+            ERR_POST(Error << "The modes found different numbers of HSPs");
+            status = 1;
+        }
+    } catch (const exception& e) {
+        ERR_POST(Error << "Error: " << e.what());
+        status = 1;
+    } catch (...) {
+        cerr << "Unknown exception!" << endl;
+        status = 1;
+    }
+
+    return status;
+}
+
+#ifndef SKIP_DOXYGEN_PROCESSING
+int main(int argc, const char* argv[] /*, const char* envp[]*/)
+{
+    return CRpsPerfApp().AppMain(argc, argv);
+}
+#endif /* SKIP_DOXYGEN_PROCESSING */
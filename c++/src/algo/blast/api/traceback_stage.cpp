@@ -122,6 +122,12 @@ CBlastTracebackSearch::SetDBScanInfo(CRef<SDatabaseScanData> dbscan_info)
     m_DBscanInfo = dbscan_info;
 }
 
+void
+CBlastTracebackSearch::SetHSPResultsWriter(CRef<IBlastHSPResultsWriter> writer)
+{
+    m_HSPResultsWriter = writer;
+}
+
 void
 CBlastTracebackSearch::x_Init(CRef<IQueryFactory>   qf,
                               CRef<CBlastOptions>   opts,
@@ -264,15 +270,32 @@ CBlastTracebackSearch::Run()
     CRef<ILocalQueryData> qdata = m_QueryFactory->MakeLocalQueryData(m_Options);
     
     vector<TSeqLocInfoVector> subj_masks;
-    TSeqAlignVector aligns =
-        LocalBlastResults2SeqAlign(hsp_results,
-                                   *qdata,
-                                   *m_SeqInfoSrc,
-                                   m_OptsMemento->m_ProgramType,
-                                   m_Options->GetGappedMode(),
-                                   m_Options->GetOutOfFrameMode(),
-                                   subj_masks,
-                                   m_ResultType);
+    TSeqAlignVector aligns;
+
+    CSeqDbSeqInfoSrc* seqdb_src =
+        dynamic_cast<CSeqDbSeqInfoSrc*>(m_SeqInfoSrc.GetPointer());
+    if (m_HSPResultsWriter.NotEmpty() && seqdb_src != NULL &&
+        m_ResultType == eDatabaseSearch && !is_phi) {
+        // The writer renders the HSPs itself, so there is no need to
+        // create (and later fetch the subjects of) the Seq-aligns
+        m_HSPResultsWriter->Write(hsp_results, *qdata,
+                                  m_InternalData->m_Queries,
+                                  m_InternalData->m_QueryInfo,
+                                  *seqdb_src->m_iSeqDb,
+                                  m_OptsMemento->m_ProgramType);
+        for (size_t i = 0; i < qdata->GetNumQueries(); i++) {
+            aligns.push_back(CreateEmptySeq_align_set());
+        }
+    } else {
+        aligns = LocalBlastResults2SeqAlign(hsp_results,
+                                            *qdata,
+                                            *m_SeqInfoSrc,
+                                            m_OptsMemento->m_ProgramType,
+                                            m_Options->GetGappedMode(),
+                                            m_Options->GetOutOfFrameMode(),
+                                            subj_masks,
+                                            m_ResultType);
+    }
 
     vector< CConstRef<CSeq_id> > query_ids;
     query_ids.reserve(aligns.size());
@@ -291,6 +314,20 @@ CBlastTracebackSearch::Run()
                                      m_ResultType);
 }
 
+TSeqAlignVector
+BlastHSPResultsToSeqAligns(BlastHSPResults* results,
+                           ILocalQueryData& query_data,
+                           const IBlastSeqInfoSrc& seqinfo_src,
+                           const CBlastOptions& options,
+                           vector<TSeqLocInfoVector>& subj_masks)
+{
+    return LocalBlastResults2SeqAlign(results, query_data, seqinfo_src,
+                                      options.GetProgramType(),
+                                      options.GetGappedMode(),
+                                      options.GetOutOfFrameMode(),
+                                      subj_masks, eDatabaseSearch);
+}
+
 BlastHSPResults*
 CBlastTracebackSearch::RunSimple()
 {
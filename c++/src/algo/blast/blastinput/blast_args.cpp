@@ -2561,7 +2561,8 @@ CFormattingArgs::SetArgumentDescriptions(CArgDescriptions& arg_desc)
     if(m_FormatFlags & eIsSAM) {
     	kOutputFormatDescription += ",\n 17 = Sequence Alignment/Map (SAM)";
     }
-    kOutputFormatDescription += ",\n 18 = Organism Report\n\n";
+    kOutputFormatDescription += ",\n 18 = Organism Report,\n"
+        " 21 = Binary columnar hit table\n\n";
     if(m_FormatFlags & eIsSAM) {
     	kOutputFormatDescription +=
                 "Options 6, 7, 10 and 17 "
@@ -2705,7 +2706,9 @@ CFormattingArgs::ArchiveFormatRequested(const CArgs& args) const
     EOutputFormat output_fmt;
     string ignore1, ignore2;
     ParseFormattingString(args, output_fmt, ignore1, ignore2);
-    return (output_fmt == eArchiveFormat ? true : false);
+    // The hit table embeds the search strategy and statistics of the
+    // archive format, so it is written through the same calls
+    return (output_fmt == eArchiveFormat || output_fmt == eHitTable);
 }
 
 
@@ -3202,6 +3205,37 @@ CRemoteArgs::ExtractAlgorithmOptions(const CArgs& args, CBlastOptions& /* opts *
     }
 }
 
+void
+CLeanSearchArgs::SetArgumentDescriptions(CArgDescriptions& arg_desc)
+{
+    arg_desc.SetCurrentGroup("Miscellaneous options");
+    arg_desc.AddFlag(kArgLean, "Search the FASTA queries against a local "
+                     "BLAST database without the object manager, for faster "
+                     "start-up and lower per query overhead (tabular and "
+                     "comma-separated output only)", true);
+    arg_desc.SetDependency(kArgLean, CArgDescriptions::eExcludes, kArgRemote);
+    arg_desc.SetDependency(kArgLean, CArgDescriptions::eExcludes, kArgSubject);
+    arg_desc.SetDependency(kArgLean, CArgDescriptions::eExcludes,
+                           kArgQueryLocation);
+    arg_desc.SetDependency(kArgLean, CArgDescriptions::eExcludes,
+                           kArgUseLCaseMasking);
+    arg_desc.SetDependency(kArgLean, CArgDescriptions::eExcludes,
+                           kArgInputSearchStrategy);
+    arg_desc.SetDependency(kArgLean, CArgDescriptions::eExcludes,
+                           kArgOutputSearchStrategy);
+
+    arg_desc.SetCurrentGroup("");
+}
+
+void
+CLeanSearchArgs::ExtractAlgorithmOptions(const CArgs& args,
+                                         CBlastOptions& /* opts */)
+{
+    if (args.Exist(kArgLean)) {
+        m_IsLean = static_cast<bool>(args[kArgLean]);
+    }
+}
+
 void
 CDebugArgs::SetArgumentDescriptions(CArgDescriptions& arg_desc)
 {
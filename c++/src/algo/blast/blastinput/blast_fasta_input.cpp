@@ -47,6 +47,7 @@
 #include <algo/blast/blastinput/blast_input_aux.hpp>
 
 #include <objmgr/seq_vector_ci.hpp>
+#include <util/sequtil/sequtil_convert.hpp>
 
 BEGIN_NCBI_SCOPE
 BEGIN_SCOPE(blast)
@@ -483,7 +484,10 @@ CShortReadFastaInputSource::CShortReadFastaInputSource(CNcbiIstream& infile,
       m_IsPaired(paired),
       m_Format(format),
       m_Id(1),
-      m_ParseSeqIds(false)
+      m_ParseSeqIds(false),
+      m_EncodeSequences(false),
+      m_IsProtein(false),
+      m_LocalIdsFromDeflines(false)
 {
     // allocate sequence buffer
     m_Sequence.resize(m_SeqBuffLen + 1);
@@ -512,7 +516,10 @@ CShortReadFastaInputSource::CShortReadFastaInputSource(CNcbiIstream& infile1,
       m_IsPaired(true),
       m_Format(format),
       m_Id(1),
-      m_ParseSeqIds(false)
+      m_ParseSeqIds(false),
+      m_EncodeSequences(false),
+      m_IsProtein(false),
+      m_LocalIdsFromDeflines(false)
 {
     if (m_Format == eFastc) {
         m_LineReader.Reset();
@@ -742,8 +749,8 @@ CShortReadFastaInputSource::x_ReadFastc(CBioseq_set& bioseq_set)
     }
 
     // set up reads, there are two sequences in the same line separated
-    char* first = (char*)line.data();
-    char* second = (char*)line.data() + p + 2;
+    const char* first = line.data();
+    const char* second = line.data() + p + 2;
     size_t first_len = p;
     size_t second_len = line.length() - p - 2;
 
@@ -760,13 +767,12 @@ CShortReadFastaInputSource::x_ReadFastc(CBioseq_set& bioseq_set)
                 CRef<CSeqdesc> title(new CSeqdesc);
                 title->SetTitle(id + ".1");
                 bioseq.SetDescr().Set().push_back(title);
-                bioseq.SetId().push_back(x_GetNextSeqId());
+                bioseq.SetId().push_back(x_GetNextSeqId(title->GetTitle()));
             }
-            bioseq.SetInst().SetMol(CSeq_inst::eMol_na);
+            bioseq.SetInst().SetMol(m_IsProtein ? CSeq_inst::eMol_aa
+                                                    : CSeq_inst::eMol_na);
             bioseq.SetInst().SetRepr(CSeq_inst::eRepr_raw);
-            bioseq.SetInst().SetLength(first_len);
-            first[first_len] = 0;
-            bioseq.SetInst().SetSeq_data().SetIupacna(CIUPACna(first));
+            x_SetSequenceData(bioseq, first, first_len);
             bioseq.SetDescr().Set().push_back(seqdesc_first);
 
             // add a sequence to the batch
@@ -786,13 +792,12 @@ CShortReadFastaInputSource::x_ReadFastc(CBioseq_set& bioseq_set)
                 CRef<CSeqdesc> title(new CSeqdesc);
                 title->SetTitle(id + ".2");
                 bioseq.SetDescr().Set().push_back(title);
-                bioseq.SetId().push_back(x_GetNextSeqId());
+                bioseq.SetId().push_back(x_GetNextSeqId(title->GetTitle()));
             }
-            bioseq.SetInst().SetMol(CSeq_inst::eMol_na);
+            bioseq.SetInst().SetMol(m_IsProtein ? CSeq_inst::eMol_aa
+                                                    : CSeq_inst::eMol_na);
             bioseq.SetInst().SetRepr(CSeq_inst::eRepr_raw);
-            bioseq.SetInst().SetLength(second_len);
-            second[second_len] = 0;
-            bioseq.SetInst().SetSeq_data().SetIupacna(CIUPACna(second));
+            x_SetSequenceData(bioseq, second, second_len);
             bioseq.SetDescr().Set().push_back(seqdesc_last);
 
             // add a sequence to the batch
@@ -857,13 +862,12 @@ CShortReadFastaInputSource::x_ReadFastaOneSeq(CRef<ILineReader> line_reader)
             CRef<CSeqdesc> title(new CSeqdesc);
             title->SetTitle(defline_id);
             bioseq.SetDescr().Set().push_back(title);
-            bioseq.SetId().push_back(x_GetNextSeqId());
+            bioseq.SetId().push_back(x_GetNextSeqId(defline_id));
         }
-        bioseq.SetInst().SetMol(CSeq_inst::eMol_na);
+        bioseq.SetInst().SetMol(m_IsProtein ? CSeq_inst::eMol_aa
+                                                    : CSeq_inst::eMol_na);
         bioseq.SetInst().SetRepr(CSeq_inst::eRepr_raw);
-        bioseq.SetInst().SetLength(start);
-        m_Sequence[start] = 0;
-        bioseq.SetInst().SetSeq_data().SetIupacna(CIUPACna(&m_Sequence[0]));
+        x_SetSequenceData(bioseq, m_Sequence.data(), start);
 
         m_BasesAdded += start;
         return seq_entry;
@@ -923,20 +927,19 @@ CShortReadFastaInputSource::x_ReadFastqOneSeq(CRef<ILineReader> line_reader)
             CRef<CSeqdesc> title(new CSeqdesc);
             title->SetTitle(defline_id);
             bioseq.SetDescr().Set().push_back(title);
-            bioseq.SetId().push_back(x_GetNextSeqId());
+            bioseq.SetId().push_back(x_GetNextSeqId(defline_id));
         }
-        bioseq.SetInst().SetMol(CSeq_inst::eMol_na);
+        bioseq.SetInst().SetMol(m_IsProtein ? CSeq_inst::eMol_aa
+                                                    : CSeq_inst::eMol_na);
         bioseq.SetInst().SetRepr(CSeq_inst::eRepr_raw);
         // + read instead of a sequence means that the sequence is empty and
         // we reached the second defline
         if (line[0] == '+') {
-            bioseq.SetInst().SetLength(0);
-            bioseq.SetInst().SetSeq_data().SetIupacna(CIUPACna(""));
+            x_SetSequenceData(bioseq, "", 0);
             empty_sequence = true;
         }
         else {
-            bioseq.SetInst().SetLength(line.length());
-            bioseq.SetInst().SetSeq_data().SetIupacna(CIUPACna(line.data()));
+            x_SetSequenceData(bioseq, line.data(), line.length());
             m_BasesAdded += line.length();
         }
 
@@ -1021,6 +1024,41 @@ CShortReadFastaInputSource::x_ReadFromTwoFiles(CBioseq_set& bioseq_set,
 }
 
 
+void
+CShortReadFastaInputSource::x_SetSequenceData(CBioseq& bioseq,
+                                              const char* sequence,
+                                              TSeqPos length)
+{
+    CSeq_inst& inst = bioseq.SetInst();
+    inst.SetLength(length);
+    if (m_IsProtein) {
+        // ncbieaa holds upper case residues only
+        string residues(sequence, length);
+        NStr::ToUpper(residues);
+        if (m_EncodeSequences) {
+            CSeqConvert::Convert(residues, CSeqUtil::e_Ncbieaa, 0, length,
+                                 inst.SetSeq_data().SetNcbistdaa().Set(),
+                                 CSeqUtil::e_Ncbistdaa);
+        }
+        else {
+            inst.SetSeq_data().SetNcbieaa().Set().swap(residues);
+        }
+    }
+    else if (m_EncodeSequences) {
+        // two residues per byte
+        vector<char>& data = inst.SetSeq_data().SetNcbi4na().Set();
+        data.resize((length + 1) / 2);
+        if (length > 0) {
+            CSeqConvert::Convert(sequence, CSeqUtil::e_Iupacna, 0, length,
+                                 &data[0], CSeqUtil::e_Ncbi4na);
+        }
+    }
+    else {
+        inst.SetSeq_data().SetIupacna().Set().assign(sequence, length);
+    }
+}
+
+
 CTempString CShortReadFastaInputSource::x_ParseDefline(CTempString& line)
 {
     // set local sequence id for the new sequence as the string between '>'
@@ -1032,9 +1070,14 @@ CTempString CShortReadFastaInputSource::x_ParseDefline(CTempString& line)
 }
 
 
-CRef<CSeq_id> CShortReadFastaInputSource::x_GetNextSeqId(void)
+CRef<CSeq_id>
+CShortReadFastaInputSource::x_GetNextSeqId(const CTempString& defline_id)
 {
     CRef<CSeq_id> seqid(new CSeq_id);
+    if (m_LocalIdsFromDeflines && !defline_id.empty()) {
+        seqid->SetLocal().SetStr(defline_id);
+        return seqid;
+    }
     seqid->Set(CSeq_id::e_Local, NStr::IntToString(m_Id));
     m_Id++;
 
@@ -37,6 +37,8 @@
 #include <objmgr/scope.hpp>
 #include <algo/blast/blastinput/blast_input.hpp>
 #include <objtools/readers/reader_exception.hpp> // for CObjReaderParseException
+#include <corelib/ncbithr.hpp>
+#include <exception>
 
 #include <objmgr/seq_vector.hpp>
 #include <objmgr/seq_vector_ci.hpp>
@@ -291,33 +293,138 @@ CBlastBioseqMaker::IsEmptyBioseq(const CBioseq& bioseq)
 
 }
 
+/// Reads a batch of sequences while the previous one is being searched
+class CBlastInputOMF::CPrefetchThread : public CThread
+{
+public:
+    CPrefetchThread(CBlastInputOMF& input)
+        : m_Input(input),
+          m_BatchSize(input.GetBatchSize()),
+          m_MaxNumSeqs(input.GetMaxBatchNumSeqs()),
+          m_Batch(new CBioseq_set),
+          m_NumSeqs(0),
+          m_NumBases(0)
+    {}
+
+    /// Get the sequences read, rethrows the exception thrown while reading
+    /// them, if any; call after Join()
+    CRef<CBioseq_set> GetBatch(TSeqPos& num_seqs, TSeqPos& num_bases) {
+        if (m_Error) {
+            rethrow_exception(m_Error);
+        }
+        num_seqs = m_NumSeqs;
+        num_bases = m_NumBases;
+        return m_Batch;
+    }
+
+protected:
+    virtual void* Main(void) {
+        try {
+            m_Input.x_ReadSeqBatch(m_BatchSize, m_MaxNumSeqs, *m_Batch,
+                                   m_NumSeqs, m_NumBases);
+        }
+        catch (...) {
+            m_Error = current_exception();
+        }
+        return NULL;
+    }
+
+private:
+    CBlastInputOMF& m_Input;
+    TSeqPos m_BatchSize;
+    TSeqPos m_MaxNumSeqs;
+    CRef<CBioseq_set> m_Batch;
+    TSeqPos m_NumSeqs;
+    TSeqPos m_NumBases;
+    exception_ptr m_Error;
+};
+
 CBlastInputOMF::CBlastInputOMF(CBlastInputSourceOMF* source,
                                TSeqPos batch_size)
     : m_Source(source),
       m_BatchSize(batch_size),
       m_MaxNumSequences(5000000),
       m_BioseqSet(new CBioseq_set),
+      m_Prefetch(false),
       m_NumSeqs(0),
       m_TotalLength(0)
     
 {}
 
+CBlastInputOMF::~CBlastInputOMF()
+{
+    // the thread uses the source, which may be destroyed next
+    if (m_PrefetchThread.NotEmpty()) {
+        m_PrefetchThread->Join();
+    }
+}
+
+bool
+CBlastInputOMF::End(void)
+{
+    // a batch being read is still to be returned
+    if (m_PrefetchThread.NotEmpty()) {
+        return false;
+    }
+    return m_Source->End();
+}
+
 void
-CBlastInputOMF::GetNextSeqBatch(CBioseq_set& bioseq_set)
+CBlastInputOMF::x_ReadSeqBatch(TSeqPos batch_size, TSeqPos max_num_seqs,
+                               CBioseq_set& bioseq_set, TSeqPos& num_seqs,
+                               TSeqPos& num_bases)
 {
-    TSeqPos bases_added = 0;
-    TSeqPos num_sequences = 0;
-    while (bases_added < m_BatchSize && num_sequences < m_MaxNumSequences &&
+    num_bases = 0;
+    num_seqs = 0;
+    while (num_bases < batch_size && num_seqs < max_num_seqs &&
            !m_Source->End()) {
 
         CBioseq_set one_seq;
-        bases_added += m_Source->GetNextSequence(one_seq);
+        num_bases += m_Source->GetNextSequence(one_seq);
 
         for (auto it: one_seq.GetSeq_set()) {
-            num_sequences++;
+            num_seqs++;
             bioseq_set.SetSeq_set().push_back(it);
         }
     }
+}
+
+void
+CBlastInputOMF::x_StartPrefetch(void)
+{
+    m_PrefetchThread.Reset(new CPrefetchThread(*this));
+    m_PrefetchThread->Run();
+}
+
+void
+CBlastInputOMF::GetNextSeqBatch(CBioseq_set& bioseq_set)
+{
+    TSeqPos bases_added = 0;
+    TSeqPos num_sequences = 0;
+    if ( !m_Prefetch && m_PrefetchThread.Empty() ) {
+        x_ReadSeqBatch(m_BatchSize, m_MaxNumSequences, bioseq_set,
+                       num_sequences, bases_added);
+    }
+    else {
+        if (m_PrefetchThread.Empty()) {
+            if (m_Source->End()) {
+                return;
+            }
+            x_StartPrefetch();
+        }
+        CRef<CPrefetchThread> thread(m_PrefetchThread);
+        m_PrefetchThread.Reset();
+        thread->Join();
+        CRef<CBioseq_set> batch = thread->GetBatch(num_sequences,
+                                                   bases_added);
+        bioseq_set.SetSeq_set().splice(bioseq_set.SetSeq_set().end(),
+                                       batch->SetSeq_set());
+
+        // read the next batch while this one is searched
+        if (m_Prefetch && !m_Source->End()) {
+            x_StartPrefetch();
+        }
+    }
     m_NumSeqs += (Int8)num_sequences;
     m_TotalLength += (Int8)bases_added;
 }
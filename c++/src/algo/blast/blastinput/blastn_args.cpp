@@ -113,6 +113,9 @@ CBlastnAppArgs::CBlastnAppArgs()
     arg.Reset(m_RemoteArgs);
     m_Args.push_back(arg);
 
+    arg.Reset(new CLeanSearchArgs);
+    m_Args.push_back(arg);
+
     m_DebugArgs.Reset(new CDebugArgs);
     arg.Reset(m_DebugArgs);
     m_Args.push_back(arg);
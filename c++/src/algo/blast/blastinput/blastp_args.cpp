@@ -107,6 +107,9 @@ CBlastpAppArgs::CBlastpAppArgs()
     arg.Reset(m_RemoteArgs);
     m_Args.push_back(arg);
 
+    arg.Reset(new CLeanSearchArgs);
+    m_Args.push_back(arg);
+
     arg.Reset(new CCompositionBasedStatsArgs);
     m_Args.push_back(arg);
 
@@ -274,6 +274,7 @@ const string kArgUnalignedFormat("unaligned_fmt");
 const string kArgUserTag("tag");
 
 const string kArgMTMode("mt_mode");
+const string kArgLean("lean");
 
 END_SCOPE(blast)
 END_NCBI_SCOPE
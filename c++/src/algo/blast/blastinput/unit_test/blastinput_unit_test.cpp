@@ -53,6 +53,7 @@
 #include <algo/blast/blastinput/blast_asn1_input.hpp>
 #include <objmgr/util/sequence.hpp>
 #include <objmgr/seq_vector.hpp>
+#include <util/sequtil/sequtil_convert.hpp>
 
 #include <algo/blast/blastinput/blastp_args.hpp>
 #include <algo/blast/blastinput/blastn_args.hpp>
@@ -3049,6 +3050,100 @@ BOOST_AUTO_TEST_CASE(TestPairedReadsFromFastQ) {
     BOOST_REQUIRE_EQUAL(ref_flags.size(), count);
 }
 
+BOOST_AUTO_TEST_CASE(TestPrefetchEncodedReadsFromFastQ) {
+
+    CNcbiIfstream istr("data/paired_reads.fastq");
+    BOOST_REQUIRE(istr);
+    CShortReadFastaInputSource input_source(istr,
+                                     CShortReadFastaInputSource::eFastq,
+                                     true);
+    CBlastInputOMF input(&input_source, 1000);
+    CRef<CBioseq_set> expected(new CBioseq_set);
+    input.GetNextSeqBatch(*expected);
+    BOOST_REQUIRE(input.End());
+
+    // read one pair per batch, in the background, encoded in ncbi4na
+    CNcbiIfstream istr_prefetch("data/paired_reads.fastq");
+    BOOST_REQUIRE(istr_prefetch);
+    CShortReadFastaInputSource prefetch_source(istr_prefetch,
+                                     CShortReadFastaInputSource::eFastq,
+                                     true);
+    prefetch_source.SetEncodeSequences(true);
+    CBlastInputOMF prefetch_input(&prefetch_source, 1);
+    prefetch_input.SetPrefetch(true);
+    CRef<CBioseq_set> queries(new CBioseq_set);
+    size_t num_batches = 0;
+    while (!prefetch_input.End()) {
+        prefetch_input.GetNextSeqBatch(*queries);
+        num_batches++;
+    }
+    BOOST_REQUIRE_EQUAL(num_batches, 3u);
+    BOOST_REQUIRE_EQUAL(prefetch_input.GetNumSeqsProcessed(),
+                        input.GetNumSeqsProcessed());
+    BOOST_REQUIRE_EQUAL(prefetch_input.GetTotalLengthProcessed(),
+                        input.GetTotalLengthProcessed());
+    BOOST_REQUIRE_EQUAL(queries->GetSeq_set().size(),
+                        expected->GetSeq_set().size());
+
+    auto expected_it = expected->GetSeq_set().begin();
+    for (auto it : queries->GetSeq_set()) {
+        const CBioseq& bioseq = it->GetSeq();
+        const CBioseq& expected_bioseq = (*expected_it)->GetSeq();
+        BOOST_REQUIRE_EQUAL(s_GetSequenceId(bioseq),
+                            s_GetSequenceId(expected_bioseq));
+        BOOST_REQUIRE_EQUAL(s_GetSegmentFlags(bioseq),
+                            s_GetSegmentFlags(expected_bioseq));
+
+        const CSeq_inst& inst = bioseq.GetInst();
+        const CSeq_inst& expected_inst = expected_bioseq.GetInst();
+        BOOST_REQUIRE_EQUAL(inst.GetLength(), expected_inst.GetLength());
+        BOOST_REQUIRE(inst.GetSeq_data().IsNcbi4na());
+        string sequence;
+        CSeqConvert::Convert(inst.GetSeq_data().GetNcbi4na().Get(),
+                             CSeqUtil::e_Ncbi4na, 0, inst.GetLength(),
+                             sequence, CSeqUtil::e_Iupacna);
+        BOOST_REQUIRE_EQUAL(sequence,
+                            expected_inst.GetSeq_data().GetIupacna().Get());
+        ++expected_it;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestEncodedProteinsWithDeflineIds) {
+
+    const string input(">prot1 first protein\nmkv*\nLLa\n"
+                       ">NP_000001.1 second protein\nACDEFGHIKLMNPQRSTVWY\n");
+    istringstream instream(input);
+    CShortReadFastaInputSource input_source(instream);
+    input_source.SetProtein(true);
+    input_source.SetLocalIdsFromDeflines(true);
+    input_source.SetEncodeSequences(true);
+    CBlastInputOMF omf_input(&input_source, 1000);
+    CRef<CBioseq_set> queries = omf_input.GetNextSeqBatch();
+    BOOST_REQUIRE(omf_input.End());
+    BOOST_REQUIRE_EQUAL(queries->GetSeq_set().size(), 2u);
+
+    const string kIds[] = {"lcl|prot1", "lcl|NP_000001.1"};
+    const string kSequences[] = {"MKV*LLA", "ACDEFGHIKLMNPQRSTVWY"};
+    size_t index = 0;
+    for (auto it : queries->GetSeq_set()) {
+        const CBioseq& bioseq = it->GetSeq();
+        // the first word of the defline is used as a local id, as is
+        BOOST_REQUIRE_EQUAL(bioseq.GetId().front()->AsFastaString(),
+                            kIds[index]);
+
+        const CSeq_inst& inst = bioseq.GetInst();
+        BOOST_REQUIRE(inst.IsAa());
+        BOOST_REQUIRE_EQUAL(inst.GetLength(), kSequences[index].length());
+        BOOST_REQUIRE(inst.GetSeq_data().IsNcbistdaa());
+        string sequence;
+        CSeqConvert::Convert(inst.GetSeq_data().GetNcbistdaa().Get(),
+                             CSeqUtil::e_Ncbistdaa, 0, inst.GetLength(),
+                             sequence, CSeqUtil::e_Ncbieaa);
+        BOOST_REQUIRE_EQUAL(sequence, kSequences[index]);
+        index++;
+    }
+}
+
 BOOST_AUTO_TEST_CASE(TestPairedReadsFromTwoFastQFiles) {
 
     CNcbiIfstream istr1("data/paired_reads_1.fastq");
@@ -33,6 +33,17 @@
 #include <algo/blast/core/blast_aascan.h>
 #include <algo/blast/core/blast_util.h>
 
+/** How many hits ahead of the current one the RPS word finders
+    request the PSSM row of the concatenated database */
+#define RPS_PREFETCH_DISTANCE 8
+
+#if defined(__GNUC__) || defined(__clang__)
+/** Hint that the memory at addr will soon be read */
+#define RPS_PREFETCH(addr) __builtin_prefetch((addr), 0, 1)
+#else
+#define RPS_PREFETCH(addr)
+#endif
+
 /** Scan a subject sequence for word hits and trigger two-hit extensions.
  *
  * @param subject the subject sequence [in]
@@ -345,6 +356,11 @@ s_BlastRPSWordFinder_TwoHit(const BLAST_SequenceBlk * subject,
                 Uint4 query_offset = offset_pairs[j].qs_offsets.q_off;
                 Uint4 subject_offset = offset_pairs[j].qs_offsets.s_off;
 
+                if (j + RPS_PREFETCH_DISTANCE < hits) {
+                    RPS_PREFETCH(matrix[offset_pairs[j +
+                                 RPS_PREFETCH_DISTANCE].qs_offsets.q_off]);
+                }
+
                 /* calculate the diagonal associated with this query-subject
                    pair */
 
@@ -674,6 +690,12 @@ s_BlastRPSWordFinder_OneHit(const BLAST_SequenceBlk * subject,
             for (j = 0; j < hits; ++j) {
                 Uint4 query_offset = offset_pairs[j].qs_offsets.q_off;
                 Uint4 subject_offset = offset_pairs[j].qs_offsets.s_off;
+
+                if (j + RPS_PREFETCH_DISTANCE < hits) {
+                    RPS_PREFETCH(matrix[offset_pairs[j +
+                                 RPS_PREFETCH_DISTANCE].qs_offsets.q_off]);
+                }
+
                 diag_coord = (subject_offset - query_offset) & diag_mask;
                 diff = subject_offset -
                     (diag_array[diag_coord].last_hit - diag_offset);
@@ -206,6 +206,11 @@ Int2 RPSLookupTableNew(const BlastRPSInfo * info, BlastRPSLookupTable * *lut)
                                                           (BlastOffsetPair));
     }
 
+    /* hits within a bucket are extended in order of PSSM row block, so
+       that neighboring extensions read neighboring parts of the PSSM */
+
+    lookup->sort_by_block = TRUE;
+
     return 0;
 }
 
@@ -217,6 +222,7 @@ BlastRPSLookupTable *RPSLookupTableDestruct(BlastRPSLookupTable * lookup)
     for (i = 0; i < lookup->num_buckets; i++)
         sfree(lookup->bucket_array[i].offset_pairs);
     sfree(lookup->bucket_array);
+    sfree(lookup->block_buffer);
 
     sfree(lookup->rps_pssm);
     sfree(lookup->pv);
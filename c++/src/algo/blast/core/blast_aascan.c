@@ -435,6 +435,68 @@ static void s_AddToRPSBucket(RPSBucket * b, Uint4 q_off, Uint4 s_off)
     b->num_filled++;
 }
 
+/** Group the hits in one bucket by blocks of RPS_BLOCK_SIZE PSSM rows.
+ *  The grouping is a stable counting sort, so hits within a block stay in
+ *  order of increasing subject offset. Hits on the same diagonal have query
+ *  offsets that grow with the subject offset, so they never change order
+ *  relative to each other and the extensions that follow are unaffected.
+ * @param lookup the lookup table, which owns the scratch buffer [in/out]
+ * @param b the bucket to reorder [in/out]
+ */
+static void s_GroupRPSBucketByBlock(BlastRPSLookupTable * lookup,
+                                    RPSBucket * b)
+{
+    const Int4 kNumBlocks = RPS_BUCKET_SIZE / RPS_BLOCK_SIZE;
+    Int4 block_start[RPS_BUCKET_SIZE / RPS_BLOCK_SIZE + 1];
+    BlastOffsetPair *src = b->offset_pairs;
+    BlastOffsetPair *dest;
+    Int4 num_filled = b->num_filled;
+    Int4 i, block;
+
+    if (num_filled <= 1)
+        return;
+
+    memset(block_start, 0, sizeof(block_start));
+    for (i = 0; i < num_filled; i++) {
+        block = (src[i].qs_offsets.q_off % RPS_BUCKET_SIZE) / RPS_BLOCK_SIZE;
+        block_start[block + 1]++;
+    }
+
+    /* nothing to do if all the hits fall in a single block */
+    for (block = 0; block < kNumBlocks; block++) {
+        if (block_start[block + 1] == num_filled)
+            return;
+        block_start[block + 1] += block_start[block];
+    }
+
+    /* the contents of the scratch buffer are disposable, so grow it
+       without copying */
+    if (lookup->block_buffer_alloc < b->num_alloc) {
+        sfree(lookup->block_buffer);
+        lookup->block_buffer = (BlastOffsetPair *)
+                    malloc(b->num_alloc * sizeof(BlastOffsetPair));
+        if (lookup->block_buffer == NULL) {
+            /* leave the hits in scan order */
+            lookup->block_buffer_alloc = 0;
+            return;
+        }
+        lookup->block_buffer_alloc = b->num_alloc;
+    }
+
+    dest = lookup->block_buffer;
+    for (i = 0; i < num_filled; i++) {
+        block = (src[i].qs_offsets.q_off % RPS_BUCKET_SIZE) / RPS_BLOCK_SIZE;
+        dest[block_start[block]++] = src[i];
+    }
+
+    /* swap the bucket list with the scratch buffer */
+    lookup->block_buffer = src;
+    b->offset_pairs = dest;
+    i = lookup->block_buffer_alloc;
+    lookup->block_buffer_alloc = b->num_alloc;
+    b->num_alloc = i;
+}
+
 /**
  * Scans the RPS query sequence from "offset" to the end of the sequence.
  * Copies at most array_size hits.
@@ -547,6 +609,11 @@ Int4 BlastRPSScanSubject(const LookupTableWrap * lookup_wrap,
     /* if we get here, we fell off the end of the sequence */
     *offset = s - abs_start;
 
+    if (lookup->sort_by_block) {
+        for (index = 0; index < lookup->num_buckets; index++)
+            s_GroupRPSBucketByBlock(lookup, bucket_array + index);
+    }
+
     return totalhits;
 }
 
@@ -108,6 +108,19 @@ PSICreatePssmWithDiagnostics(const PSIMsa* msap,                    /* [in] */
                              const PSIDiagnosticsRequest* request,  /* [in] */
                              PSIMatrix** pssm,                      /* [out] */
                              PSIDiagnosticsResponse** diagnostics)  /* [out] */
+{
+    return PSICreatePssmWithDiagnostics_MT(msap, options, sbp, request,
+                                           pssm, diagnostics, 1);
+}
+
+int
+PSICreatePssmWithDiagnostics_MT(const PSIMsa* msap,                 /* [in] */
+                                const PSIBlastOptions* options,     /* [in] */
+                                BlastScoreBlk* sbp,                 /* [in] */
+                                const PSIDiagnosticsRequest* request,/* [in] */
+                                PSIMatrix** pssm,                   /* [out] */
+                                PSIDiagnosticsResponse** diagnostics,/* [out] */
+                                size_t num_threads)                 /* [in] */
 {
     _PSIMsa* msa = NULL;
     _PSIAlignedBlock* aligned_block = NULL;
@@ -124,7 +137,7 @@ PSICreatePssmWithDiagnostics(const PSIMsa* msap,                    /* [in] */
 
     /*** Run the engine's stages ***/
 
-    status = _PSIPurgeBiasedSegments(packed_msa);
+    status = _PSIPurgeBiasedSegments(packed_msa, num_threads);
     if (status != PSI_SUCCESS) {
         s_PSICreatePssmCleanUp(pssm, packed_msa, msa, aligned_block, 
                                seq_weights, internal_pssm);
@@ -169,7 +182,7 @@ PSICreatePssmWithDiagnostics(const PSIMsa* msap,                    /* [in] */
 
     status = _PSIComputeSequenceWeights(msa, aligned_block, 
                                         options->nsg_compatibility_mode,
-                                        seq_weights);
+                                        seq_weights, num_threads);
     if (status != PSI_SUCCESS) {
         s_PSICreatePssmCleanUp(pssm, packed_msa, msa, aligned_block, 
                                seq_weights, internal_pssm);
@@ -179,7 +192,7 @@ PSICreatePssmWithDiagnostics(const PSIMsa* msap,                    /* [in] */
     status = _PSIComputeFreqRatios(msa, seq_weights, sbp, aligned_block, 
                                    options->pseudo_count, 
                                    options->nsg_compatibility_mode,
-                                   internal_pssm);
+                                   internal_pssm, num_threads);
     if (status != PSI_SUCCESS) {
         s_PSICreatePssmCleanUp(pssm, packed_msa, msa, aligned_block, 
                                seq_weights, internal_pssm);
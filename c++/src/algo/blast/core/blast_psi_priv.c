@@ -913,16 +913,18 @@ _PSIValidateCdMSA(const PSICdMsa* cd_msa, Uint4 alphabet_size)
 
 /** Remove those sequences which are identical to the query sequence 
  * @param msa multiple sequence alignment data structure [in]
+ * @param num_threads number of OpenMP threads to use [in]
  */
 static void
-s_PSIPurgeSelfHits(_PSIPackedMsa* msa);
+s_PSIPurgeSelfHits(_PSIPackedMsa* msa, size_t num_threads);
 
 /** Keeps only one copy of any aligned sequences which are >kPSINearIdentical%
  * identical to one another
  * @param msa multiple sequence alignment data structure [in]
+ * @param num_threads number of OpenMP threads to use [in]
  */
 static void
-s_PSIPurgeNearIdenticalAlignments(_PSIPackedMsa* msa);
+s_PSIPurgeNearIdenticalAlignments(_PSIPackedMsa* msa, size_t num_threads);
 
 /** This function compares the sequences in the msa->cell
  * structure indexed by sequence_index1 and seq_index2. If it finds aligned 
@@ -935,56 +937,181 @@ s_PSIPurgeNearIdenticalAlignments(_PSIPackedMsa* msa);
  * @param max_percent_identity percent identity needed to drop sequence
  * identified by seq_index2 from the multiple sequence alignment data structure
  * [in]
+ * @return TRUE if any region of seq_index2 was purged, FALSE otherwise
  */
-static void
+static Boolean
 s_PSIPurgeSimilarAlignments(_PSIPackedMsa* msa,
                             Uint4 seq_index1,
                             Uint4 seq_index2,
                             double max_percent_identity);
+
+/** Letters and alignment flags of a _PSIPackedMsa stored as two separate
+ * byte matrices (one row of query_length bytes per sequence), so that pairs
+ * of sequences can be compared without unpacking the cells' bit fields */
+typedef struct _PSIPackedMsaPlanes {
+    Uint1* letters;     /**< letters in ncbistdaa encoding, dimensions are
+                          (num_seqs+1) by query_length */
+    Uint1* aligned;     /**< 1 if the letter is aligned, 0 otherwise, same
+                          dimensions as letters */
+    Uint4 query_length; /**< length of each row */
+} _PSIPackedMsaPlanes;
+
+/** Allocates a _PSIPackedMsaPlanes structure and copies the contents of msa
+ * into it
+ * @param msa multiple sequence alignment data structure [in]
+ * @return newly allocated structure or NULL in case of memory allocation
+ * failure
+ */
+static _PSIPackedMsaPlanes*
+s_PSIPackedMsaPlanesNew(const _PSIPackedMsa* msa);
+
+/** Deallocates a _PSIPackedMsaPlanes structure
+ * @param planes structure to deallocate [in]
+ * @return NULL
+ */
+static _PSIPackedMsaPlanes*
+s_PSIPackedMsaPlanesFree(_PSIPackedMsaPlanes* planes);
+
+/** Copies the sequence identified by seq_index from msa into planes, to be
+ * called after that sequence has been purged
+ * @param planes structure to update [in|out]
+ * @param msa multiple sequence alignment data structure [in]
+ * @param seq_index index of the sequence to copy [in]
+ */
+static void
+s_PSIPackedMsaPlanesUpdateRow(_PSIPackedMsaPlanes* planes,
+                              const _PSIPackedMsa* msa,
+                              Uint4 seq_index);
+
+/** Read-only version of s_PSIPurgeSimilarAlignments: determines whether
+ * s_PSIPurgeSimilarAlignments would purge any region of seq_index2 when
+ * comparing it to seq_index1, which must not be the query sequence
+ * @param planes letters and alignment flags of the multiple sequence
+ * alignment [in]
+ * @param seq_index1 index of the sequence of interest [in]
+ * @param seq_index2 index of the sequence of interest [in]
+ * @param max_percent_identity percent identity needed to drop sequence
+ * identified by seq_index2 [in]
+ * @return TRUE if some region of seq_index2 would be purged
+ */
+static Boolean
+s_PSIIsPurgeCandidate(const _PSIPackedMsaPlanes* planes,
+                      Uint4 seq_index1,
+                      Uint4 seq_index2,
+                      double max_percent_identity);
 /****************************************************************************/
 
 /**************** PurgeMatches stage of PSSM creation ***********************/
 int
-_PSIPurgeBiasedSegments(_PSIPackedMsa* msa)
+_PSIPurgeBiasedSegments(_PSIPackedMsa* msa, size_t num_threads)
 {
     if ( !msa ) {
         return PSIERR_BADPARAM;
     }
 
-    s_PSIPurgeSelfHits(msa);
-    s_PSIPurgeNearIdenticalAlignments(msa);
+    s_PSIPurgeSelfHits(msa, num_threads);
+    s_PSIPurgeNearIdenticalAlignments(msa, num_threads);
 
     return PSI_SUCCESS;
 }
 
 static void
-s_PSIPurgeSelfHits(_PSIPackedMsa* msa)
+s_PSIPurgeSelfHits(_PSIPackedMsa* msa, size_t num_threads)
 {
-    Uint4 s = 0;        /* index on sequences */
+    int s = 0;          /* index on sequences */
+    int num_seqs = 0;   /* number of sequences including the query */
+#ifdef _OPENMP
+    const int actual_num_threads = (int) num_threads;
+#endif
 
     ASSERT(msa);
 
-    for (s = kQueryIndex + 1; s < msa->dimensions->num_seqs + 1; s++) {
-        s_PSIPurgeSimilarAlignments(msa, kQueryIndex, s, kPSIIdentical);
+    num_seqs = (int) msa->dimensions->num_seqs + 1;
+
+    /* Each comparison only modifies the sequence compared to the query, so
+     * the comparisons are independent of one another */
+#pragma omp parallel for num_threads(actual_num_threads) \
+    if(actual_num_threads > 1) schedule(dynamic, 16)
+    for (s = kQueryIndex + 1; s < num_seqs; s++) {
+        s_PSIPurgeSimilarAlignments(msa, kQueryIndex, (Uint4) s,
+                                    kPSIIdentical);
     }
 }
 
 static void
-s_PSIPurgeNearIdenticalAlignments(_PSIPackedMsa* msa)
+s_PSIPurgeNearIdenticalAlignments(_PSIPackedMsa* msa, size_t num_threads)
 {
     Uint4 i = 0;
     Uint4 j = 0;
+    Uint4 num_seqs = 0;        /* number of sequences including the query */
+    _PSIPackedMsaPlanes* planes = NULL;
+    Boolean* is_candidate = NULL;   /* is_candidate[j] is TRUE if pair
+                                       (j, i + j) must be purged as of the
+                                       start of distance i */
+    Boolean* is_modified = NULL;    /* TRUE for sequences purged so far at
+                                       distance i */
+#ifdef _OPENMP
+    const int actual_num_threads = (int) num_threads;
+#endif
 
     ASSERT(msa);
 
-    for (i = 1; i < msa->dimensions->num_seqs + 1; i++) { 
-        for (j = 1; (i + j) < msa->dimensions->num_seqs + 1; j++) {
+    num_seqs = msa->dimensions->num_seqs + 1;
+
+    planes = s_PSIPackedMsaPlanesNew(msa);
+    is_candidate = (Boolean*) calloc(num_seqs, sizeof(Boolean));
+    is_modified = (Boolean*) calloc(num_seqs, sizeof(Boolean));
+
+    if ( !planes || !is_candidate || !is_modified ) {
+        for (i = 1; i < num_seqs; i++) { 
+            for (j = 1; (i + j) < num_seqs; j++) {
+                s_PSIPurgeSimilarAlignments(msa, j, (i + j),
+                                            kPSINearIdentical);
+            }
+        }
+        s_PSIPackedMsaPlanesFree(planes);
+        sfree(is_candidate);
+        sfree(is_modified);
+        return;
+    }
+
+    for (i = 1; i < num_seqs; i++) { 
+        const int kNumPairs = (int) (num_seqs - i - 1);
+        int k = 0;
+
+        /* Compare all pairs at this distance against the alignment as it
+         * was before any of them is purged... */
+#pragma omp parallel for num_threads(actual_num_threads) \
+    if(actual_num_threads > 1) schedule(dynamic, 8)
+        for (k = 0; k < kNumPairs; k++) {
+            const Uint4 kSeq1 = (Uint4) k + 1;
+            const Uint4 kSeq2 = kSeq1 + i;
+            is_candidate[kSeq1] = msa->use_sequence[kSeq1] &&
+                msa->use_sequence[kSeq2] &&
+                s_PSIIsPurgeCandidate(planes, kSeq1, kSeq2,
+                                      kPSINearIdentical);
+        }
+
+        /* ... then purge them in order. A pair whose sequences were not
+         * modified by an earlier pair at this distance sees the same data
+         * as above, any other pair is compared again. */
+        memset((void*) is_modified, 0, num_seqs * sizeof(Boolean));
+        for (j = 1; (i + j) < num_seqs; j++) {
             /* N.B.: The order of comparison of sequence pairs is deliberate,
              * tests on real data indicated that this approach allowed more
              * sequences to be purged */
-            s_PSIPurgeSimilarAlignments(msa, j, (i + j), kPSINearIdentical);
+            if ( (is_candidate[j] || is_modified[j] || is_modified[i + j]) &&
+                 s_PSIPurgeSimilarAlignments(msa, j, (i + j),
+                                             kPSINearIdentical) ) {
+                is_modified[i + j] = TRUE;
+                s_PSIPackedMsaPlanesUpdateRow(planes, msa, i + j);
+            }
         }
     }
+
+    s_PSIPackedMsaPlanesFree(planes);
+    sfree(is_candidate);
+    sfree(is_modified);
 }
 
 void
@@ -1071,13 +1198,16 @@ _PSIResetAlignmentTraits(_PSIAlignmentTraits* traits, Uint4 position)
     traits->start = position;
 }
 
-/** Handles neither is aligned event FIXME: document better */
-static NCBI_INLINE void
+/** Handles neither is aligned event FIXME: document better
+ * @return TRUE if the aligned region was purged */
+static NCBI_INLINE Boolean
 _handleNeitherAligned(_PSIAlignmentTraits* traits, 
                       _EPSIPurgeFsmState* state,
                       _PSIPackedMsa* msa, Uint4 seq_index, 
                       double max_percent_identity)
 {
+    Boolean purged = FALSE;
+
     ASSERT(traits);
     ASSERT(state);
 
@@ -1096,6 +1226,7 @@ _handleNeitherAligned(_PSIAlignmentTraits* traits,
                                                     traits->start, align_stop);
                     ASSERT(rv == PSI_SUCCESS);
                     rv += 0;  /* dummy code to avoid warning in release mode */
+                    purged = TRUE;
                 }
             }
         }
@@ -1110,6 +1241,8 @@ _handleNeitherAligned(_PSIAlignmentTraits* traits,
     default:
         abort();
     }
+
+    return purged;
 }
 
 /** Handle event when both positions are aligned, using the same residue, but
@@ -1182,7 +1315,7 @@ _handleEitherAlignedNeitherX(_PSIAlignmentTraits* traits,
     }
 }
 
-static void
+static Boolean
 s_PSIPurgeSimilarAlignments(_PSIPackedMsa* msa,
                             Uint4 seq_index1,
                             Uint4 seq_index2,
@@ -1196,13 +1329,14 @@ s_PSIPurgeSimilarAlignments(_PSIPackedMsa* msa,
     _PSIPackedMsaCell* seq1 = 0;    /* array of cells for sequence 1 in MSA */
     _PSIPackedMsaCell* seq2 = 0;    /* array of cells for sequence 2 in MSA */
     Uint4 p = 0;                    /* position on alignment */
+    Boolean purged = FALSE;         /* was any region of seq_index2 purged? */
 
     /* Nothing to do if sequences are the same or not selected for further
        processing */
     if ( seq_index1 == seq_index2 ||
          !msa->use_sequence[seq_index1] ||
          !msa->use_sequence[seq_index2] ) {
-        return;
+        return FALSE;
     }
 
     _PSIResetAlignmentTraits(&traits, p);
@@ -1227,8 +1361,8 @@ s_PSIPurgeSimilarAlignments(_PSIPackedMsa* msa,
 
         /* if neither position is aligned */
         if (!kPos1Aligned && !kPos2Aligned) { 
-            _handleNeitherAligned(&traits, &state, msa, seq_index2,
-                                  max_percent_identity);
+            purged |= _handleNeitherAligned(&traits, &state, msa, seq_index2,
+                                            max_percent_identity);
         } else {
 
             /* Define vars for events interesting to the finite state machine */
@@ -1249,8 +1383,140 @@ s_PSIPurgeSimilarAlignments(_PSIPackedMsa* msa,
             } 
         }
     }
-    _handleNeitherAligned(&traits, &state, msa, seq_index2,
-                          max_percent_identity);
+    purged |= _handleNeitherAligned(&traits, &state, msa, seq_index2,
+                                    max_percent_identity);
+    return purged;
+}
+
+static _PSIPackedMsaPlanes*
+s_PSIPackedMsaPlanesNew(const _PSIPackedMsa* msa)
+{
+    _PSIPackedMsaPlanes* retval = NULL;
+    const Uint4 kNumSeqs = msa->dimensions->num_seqs + 1;
+    const size_t kNumCells = (size_t) kNumSeqs * msa->dimensions->query_length;
+    Uint4 s = 0;
+
+    retval = (_PSIPackedMsaPlanes*) calloc(1, sizeof(_PSIPackedMsaPlanes));
+    if ( !retval ) {
+        return NULL;
+    }
+    retval->query_length = msa->dimensions->query_length;
+    retval->letters = (Uint1*) malloc(kNumCells * sizeof(Uint1));
+    retval->aligned = (Uint1*) malloc(kNumCells * sizeof(Uint1));
+    if ( !retval->letters || !retval->aligned ) {
+        return s_PSIPackedMsaPlanesFree(retval);
+    }
+
+    for (s = 0; s < kNumSeqs; s++) {
+        s_PSIPackedMsaPlanesUpdateRow(retval, msa, s);
+    }
+    return retval;
+}
+
+static _PSIPackedMsaPlanes*
+s_PSIPackedMsaPlanesFree(_PSIPackedMsaPlanes* planes)
+{
+    if ( !planes ) {
+        return NULL;
+    }
+    sfree(planes->letters);
+    sfree(planes->aligned);
+    sfree(planes);
+    return NULL;
+}
+
+static void
+s_PSIPackedMsaPlanesUpdateRow(_PSIPackedMsaPlanes* planes,
+                              const _PSIPackedMsa* msa,
+                              Uint4 seq_index)
+{
+    const size_t kOffset = (size_t) seq_index * planes->query_length;
+    const _PSIPackedMsaCell* cell = msa->data[seq_index];
+    Uint1* letters = planes->letters + kOffset;
+    Uint1* aligned = planes->aligned + kOffset;
+    Uint4 p = 0;
+
+    for (p = 0; p < planes->query_length; p++) {
+        letters[p] = (Uint1) cell[p].letter;
+        aligned[p] = (Uint1) cell[p].is_aligned;
+    }
+}
+
+/** Checks whether the percent identity of an aligned region computed in
+ * s_PSIIsPurgeCandidate reaches the purging threshold (same test as in
+ * _handleNeitherAligned) */
+#define PSI_REGION_EXCEEDS_IDENTITY(n_identical, effective_length, max_pct) \
+    ((effective_length) > 0 && \
+     ((double)(n_identical)) / (effective_length) >= (max_pct))
+
+static Boolean
+s_PSIIsPurgeCandidate(const _PSIPackedMsaPlanes* planes,
+                      Uint4 seq_index1,
+                      Uint4 seq_index2,
+                      double max_percent_identity)
+{
+    /* Number of positions examined at a time: blocks which are entirely
+     * within an aligned region are tallied without branches */
+    const Uint4 kBlockSize = 32;
+    const Uint1 kXResidue = AMINOACID_TO_NCBISTDAA['X'];
+    const Uint4 kQueryLength = planes->query_length;
+    const Uint1* letters1 =
+        planes->letters + (size_t) seq_index1 * kQueryLength;
+    const Uint1* letters2 =
+        planes->letters + (size_t) seq_index2 * kQueryLength;
+    const Uint1* aligned1 =
+        planes->aligned + (size_t) seq_index1 * kQueryLength;
+    const Uint1* aligned2 =
+        planes->aligned + (size_t) seq_index2 * kQueryLength;
+    /* Counts for the current aligned region, as in _PSIAlignmentTraits */
+    Uint4 effective_length = 0;
+    Uint4 n_identical = 0;
+    Uint4 block_start = 0;
+    Uint4 block_end = 0;
+    Uint4 p = 0;
+
+    ASSERT(seq_index1 != kQueryIndex);
+
+    for (block_start = 0; block_start < kQueryLength;
+         block_start = block_end) {
+        Uint1 either_aligned = 1;
+
+        block_end = MIN(block_start + kBlockSize, kQueryLength);
+        for (p = block_start; p < block_end; p++) {
+            either_aligned &= aligned1[p] | aligned2[p];
+        }
+
+        if (either_aligned) {
+            for (p = block_start; p < block_end; p++) {
+                const Uint4 kNeitherX =
+                    (letters1[p] != kXResidue) & (letters2[p] != kXResidue);
+                effective_length += kNeitherX;
+                n_identical += kNeitherX & aligned1[p] & aligned2[p] &
+                    (letters1[p] == letters2[p]);
+            }
+            continue;
+        }
+
+        for (p = block_start; p < block_end; p++) {
+            if (aligned1[p] | aligned2[p]) {
+                const Uint4 kNeitherX =
+                    (letters1[p] != kXResidue) & (letters2[p] != kXResidue);
+                effective_length += kNeitherX;
+                n_identical += kNeitherX & aligned1[p] & aligned2[p] &
+                    (letters1[p] == letters2[p]);
+            } else {
+                /* end of an aligned region */
+                if (PSI_REGION_EXCEEDS_IDENTITY(n_identical, effective_length,
+                                                max_percent_identity)) {
+                    return TRUE;
+                }
+                effective_length = n_identical = 0;
+            }
+        }
+    }
+
+    return PSI_REGION_EXCEEDS_IDENTITY(n_identical, effective_length,
+                                       max_percent_identity);
 }
 
 /****************************************************************************/
@@ -1490,6 +1756,9 @@ _PSIGetAlignedSequencesForPosition(
  * @param aligned_seqs array containing the indices of the sequences 
  * participating in the multiple sequence alignment at the requested 
  * position [in]
+ * @param norm_seq_weights normalized sequence weights, only the entries of
+ * the sequences in aligned_seqs are set (length: num_seqs + 1) [out]
+ * @param row_sigma scratch array of length num_seqs + 1 [out]
  * @param seq_weights sequence weights data structure [out]
  */
 static void
@@ -1498,6 +1767,8 @@ _PSICalculateNormalizedSequenceWeights(
     const _PSIAlignedBlock* aligned_blocks,
     Uint4 position,
     const SDynamicUint4Array* aligned_seqs,
+    double* norm_seq_weights,
+    double* row_sigma,
     _PSISequenceWeights* seq_weights);
 
 /** Calculate the weighted observed sequence weights
@@ -1507,6 +1778,8 @@ _PSICalculateNormalizedSequenceWeights(
  * @param aligned_seqs array containing the indices of the sequences 
  * participating in the multiple sequence alignment at the requested 
  * position [in]
+ * @param norm_seq_weights normalized sequence weights calculated by
+ * _PSICalculateNormalizedSequenceWeights [in]
  * @param seq_weights sequence weights data structure [in|out]
  */
 static void
@@ -1514,6 +1787,7 @@ _PSICalculateMatchWeights(
     const _PSIMsa* msa,
     Uint4 position,
     const SDynamicUint4Array* aligned_seqs,
+    const double* norm_seq_weights,
     _PSISequenceWeights* seq_weights);
 
 /** Uses disperse method of spreading the gap weights
@@ -1552,75 +1826,79 @@ int
 _PSIComputeSequenceWeights(const _PSIMsa* msa,                      /* [in] */
                            const _PSIAlignedBlock* aligned_blocks,  /* [in] */
                            Boolean nsg_compatibility_mode,          /* [in] */
-                           _PSISequenceWeights* seq_weights)        /* [out] */
-{
-    SDynamicUint4Array* aligned_seqs = 0;     /* list of indices of sequences
-                                       which participate in an
-                                       aligned position */
-    SDynamicUint4Array* prev_pos_aligned_seqs = 0; /* list of indices of 
-                                       sequences for the previous position in 
-                                       the query (i.e.: column in MSA). */
-    Uint4 kQueryLength = 0;         /* length of the query */
-    Uint4 pos = 0;                  /* position index */
+                           _PSISequenceWeights* seq_weights,        /* [out] */
+                           size_t num_threads)                      /* [in] */
+{
+    int kQueryLength = 0;           /* length of the query */
     int retval = PSI_SUCCESS;       /* return value */
     const Uint4 kExpectedNumMatchingSeqs = nsg_compatibility_mode ? 0 : 1;
-    Uint4 last_calc_pos = 0;
+#ifdef _OPENMP
+    const int actual_num_threads = (int) num_threads;
+#endif
 
     if ( !msa || !aligned_blocks || !seq_weights ) {
         return PSIERR_BADPARAM;
     }
 
-    aligned_seqs = DynamicUint4ArrayNewEx(msa->dimensions->num_seqs + 1);
-    prev_pos_aligned_seqs = DynamicUint4Array_Dup(aligned_seqs);
-    if ( !aligned_seqs || !prev_pos_aligned_seqs ) {
-        return PSIERR_OUTOFMEM;
-    }
-    kQueryLength = msa->dimensions->query_length;
-
-    for (pos = 0; pos < kQueryLength; pos++) {
-
-        /* ignore positions of no interest */
-        if (aligned_blocks->size[pos] == 0 || 
-            msa->num_matching_seqs[pos] <= kExpectedNumMatchingSeqs) {
-            continue;
-        }
+    kQueryLength = (int) msa->dimensions->query_length;
 
-        DynamicUint4Array_Copy(prev_pos_aligned_seqs, aligned_seqs);
-        _PSIGetAlignedSequencesForPosition(msa, pos, aligned_seqs);
-        ASSERT(msa->num_matching_seqs[pos] == aligned_seqs->num_used);
-        if (aligned_seqs->num_used <= kExpectedNumMatchingSeqs) {
-            continue;
-        }
-        last_calc_pos = pos;
+    /* The weights of each position only depend on the alignment, so the
+     * positions are processed in parallel, each thread with its own list of
+     * participating sequences and sequence weights */
+#pragma omp parallel num_threads(actual_num_threads) \
+    if(actual_num_threads > 1)
+    {
+        const Uint4 kNumSeqs = msa->dimensions->num_seqs + 1;
+        /* list of indices of sequences which participate in an aligned
+         * position */
+        SDynamicUint4Array* aligned_seqs = DynamicUint4ArrayNewEx(kNumSeqs);
+        double* norm_seq_weights = (double*) malloc(kNumSeqs*sizeof(double));
+        double* row_sigma = (double*) malloc(kNumSeqs*sizeof(double));
+        const Boolean kAllocated = 
+            (aligned_seqs && norm_seq_weights && row_sigma);
+        int pos = 0;                /* position index */
+
+        if ( !kAllocated ) {
+#pragma omp critical(psi_sequence_weights)
+            retval = PSIERR_OUTOFMEM;
+        }
+
+#pragma omp for schedule(dynamic, 16)
+        for (pos = 0; pos < kQueryLength; pos++) {
+
+            /* ignore positions of no interest */
+            if ( !kAllocated ||
+                 aligned_blocks->size[pos] == 0 || 
+                 msa->num_matching_seqs[pos] <= kExpectedNumMatchingSeqs) {
+                continue;
+            }
 
-        if (last_calc_pos != pos - 1 ||
-            !DynamicUint4Array_AreEqual(aligned_seqs, prev_pos_aligned_seqs)) {
+            _PSIGetAlignedSequencesForPosition(msa, (Uint4) pos,
+                                               aligned_seqs);
+            ASSERT(msa->num_matching_seqs[pos] == aligned_seqs->num_used);
+            if (aligned_seqs->num_used <= kExpectedNumMatchingSeqs) {
+                continue;
+            }
 
-            memset((void*)seq_weights->norm_seq_weights, 0, 
-                   sizeof(double)*(msa->dimensions->num_seqs+1));
-            memset((void*)seq_weights->row_sigma, 0,
-                   sizeof(double)*(msa->dimensions->num_seqs+1));
+            _PSICalculateNormalizedSequenceWeights(msa, aligned_blocks,
+                                                   (Uint4) pos, aligned_seqs,
+                                                   norm_seq_weights,
+                                                   row_sigma, seq_weights);
+            seq_weights->posNumParticipating[pos] = aligned_seqs->num_used;
 
-            _PSICalculateNormalizedSequenceWeights(msa, aligned_blocks, pos, 
-                                                   aligned_seqs, seq_weights);
-        } else {
-            int index;
-            seq_weights->sigma[pos] = seq_weights->sigma[pos-1];
-            for (index = 0; index <= EFFECTIVE_ALPHABET; index++) {
-               seq_weights->posDistinctDistrib[pos][index] = seq_weights->posDistinctDistrib[pos-1][index];
-            }
-            /* seq_weights->norm_seq_weights are unchanged from the previous
-             * iteration, leaving them ready to be used in
-             * _PSICalculateMatchWeights */
+            /* Uses norm_seq_weights to populate match_weights */
+            _PSICalculateMatchWeights(msa, (Uint4) pos, aligned_seqs,
+                                      norm_seq_weights, seq_weights);
         }
-        seq_weights->posNumParticipating[pos] = aligned_seqs->num_used;
 
-        /* Uses seq_weights->norm_seq_weights to populate match_weights */
-        _PSICalculateMatchWeights(msa, pos, aligned_seqs, seq_weights);
+        DynamicUint4ArrayFree(aligned_seqs);
+        sfree(norm_seq_weights);
+        sfree(row_sigma);
     }
 
-    DynamicUint4ArrayFree(aligned_seqs);
-    DynamicUint4ArrayFree(prev_pos_aligned_seqs);
+    if (retval != PSI_SUCCESS) {
+        return retval;
+    }
 
     /* Check that the sequence weights add up to 1 in each column */
     retval = _PSICheckSequenceWeights(msa, seq_weights, 
@@ -1752,7 +2030,9 @@ _PSICalculateNormalizedSequenceWeights(
     const _PSIAlignedBlock* aligned_blocks, /* [in] */
     Uint4 position,                        /* [in] */
     const SDynamicUint4Array* aligned_seqs,             /* [in] */
-    _PSISequenceWeights* seq_weights)       /* [out] norm_seq_weights, sigma */
+    double* norm_seq_weights,               /* [out] */
+    double* row_sigma,                      /* [out] */
+    _PSISequenceWeights* seq_weights)       /* [out] sigma */
 {
     const Uint1 kGapResidue = AMINOACID_TO_NCBISTDAA['-'];
     const Uint1 kXResidue = AMINOACID_TO_NCBISTDAA['X'];
@@ -1780,8 +2060,14 @@ _PSICalculateNormalizedSequenceWeights(
     ASSERT(aligned_blocks);
     ASSERT(seq_weights);
     ASSERT(aligned_seqs && aligned_seqs->num_used);
+    ASSERT(norm_seq_weights && row_sigma);
     ASSERT(position < msa->dimensions->query_length);
 
+    /* Only the entries of the participating sequences are used below */
+    for (asi = 0; asi < aligned_seqs->num_used; asi++) {
+        row_sigma[aligned_seqs->data[asi]] = 0.0;
+    }
+
     for (i = (Uint4)aligned_blocks->pos_extnt[position].left; 
          i <= (Uint4)aligned_blocks->pos_extnt[position].right; i++) {
 
@@ -1829,7 +2115,7 @@ _PSICalculateNormalizedSequenceWeights(
             /* This is a modified version of the Henikoff's idea in
              * "Position-based sequence weights" paper. The modification
              * consists in using the alignment extents. */
-            seq_weights->row_sigma[seq_idx] += 
+            row_sigma[seq_idx] += 
                 (1.0 / (double) 
                  (residue_counts_for_column[residue] * 
                   num_distinct_residues_for_column) );
@@ -1844,17 +2130,16 @@ _PSICalculateNormalizedSequenceWeights(
 
         for (asi = 0; asi < aligned_seqs->num_used; asi++) {
             const Uint4 seq_idx = aligned_seqs->data[asi];
-            seq_weights->norm_seq_weights[seq_idx] = 
-                seq_weights->row_sigma[seq_idx] / 
+            norm_seq_weights[seq_idx] = row_sigma[seq_idx] / 
                 (aligned_blocks->pos_extnt[position].right -
                  aligned_blocks->pos_extnt[position].left + 1);
-            weight_sum += seq_weights->norm_seq_weights[seq_idx];
+            weight_sum += norm_seq_weights[seq_idx];
         }
 
         /* Normalize */
         for (asi = 0; asi < aligned_seqs->num_used; asi++) {
             const Uint4 seq_idx = aligned_seqs->data[asi];
-            seq_weights->norm_seq_weights[seq_idx] /= weight_sum;
+            norm_seq_weights[seq_idx] /= weight_sum;
         }
 
     } else {
@@ -1863,7 +2148,7 @@ _PSICalculateNormalizedSequenceWeights(
          * all participating sequences */
         for (asi = 0; asi < aligned_seqs->num_used; asi++) {
             const Uint4 seq_idx = aligned_seqs->data[asi];
-            seq_weights->norm_seq_weights[seq_idx] = 
+            norm_seq_weights[seq_idx] = 
                 (1.0/(double) aligned_seqs->num_used);
         }
     }
@@ -1876,6 +2161,7 @@ _PSICalculateMatchWeights(
     const _PSIMsa* msa,  /* [in] */
     Uint4 position,                     /* [in] */
     const SDynamicUint4Array* aligned_seqs,          /* [in] */
+    const double* norm_seq_weights,      /* [in] */
     _PSISequenceWeights* seq_weights)    /* [out] */
 {
     const Uint1 kGapResidue = AMINOACID_TO_NCBISTDAA['-'];
@@ -1883,6 +2169,7 @@ _PSICalculateMatchWeights(
 
     ASSERT(msa);
     ASSERT(aligned_seqs && aligned_seqs->num_used);
+    ASSERT(norm_seq_weights);
     ASSERT(seq_weights);
 
     for (asi = 0; asi < aligned_seqs->num_used; asi++) {
@@ -1890,12 +2177,12 @@ _PSICalculateMatchWeights(
         const Uint1 residue = msa->cell[seq_idx][position].letter;
 
         seq_weights->match_weights[position][residue] += 
-            seq_weights->norm_seq_weights[seq_idx];
+            norm_seq_weights[seq_idx];
 
         /* Collected for diagnostics information, not used elsewhere */
         if (residue != kGapResidue) {
             seq_weights->gapless_column_weights[position] +=
-             seq_weights->norm_seq_weights[seq_idx];
+             norm_seq_weights[seq_idx];
         }
     }
 }
@@ -2074,13 +2361,18 @@ _PSIComputeFreqRatios(const _PSIMsa* msa,
                       const _PSIAlignedBlock* aligned_blocks,
                       Int4 pseudo_count,
                       Boolean nsg_compatibility_mode,
-                      _PSIInternalPssmData* internal_pssm)
+                      _PSIInternalPssmData* internal_pssm,
+                      size_t num_threads)
 {
     /* Subscripts are indicated as follows: N_i, where i is a subscript of N */
     const Uint1 kXResidue = AMINOACID_TO_NCBISTDAA['X'];
     SFreqRatios* freq_ratios = NULL;/* matrix-specific frequency ratios */
-    Uint4 p = 0;                    /* index on positions */
-    Uint4 r = 0;                    /* index on residues */
+    int p = 0;                      /* index on positions */
+    int query_length = 0;           /* length of the query */
+    int retval = PSI_SUCCESS;       /* return value */
+#ifdef _OPENMP
+    const int actual_num_threads = (int) num_threads;
+#endif
     const double kZeroObsPseudo = 30.0; /*arbitrary constant to use for columns with
                              zero observations in actual data (ZERO_OBS_PSEUDO in posit.c) */
     double  expno[MAX_IND_OBSERVATIONS+1]; /*table of expectations*/
@@ -2095,7 +2387,14 @@ _PSIComputeFreqRatios(const _PSIMsa* msa,
 
     s_initializeExpNumObservations(&(expno[0]),  backgroundProbabilities);
 
-    for (p = 0; p < msa->dimensions->query_length; p++) {
+    query_length = (int) msa->dimensions->query_length;
+
+    /* Each column's effective number of observations, pseudocounts and
+     * frequency ratios only depend on that column's sequence weights */
+#pragma omp parallel for num_threads(actual_num_threads) \
+    if(actual_num_threads > 1) schedule(dynamic, 16)
+    for (p = 0; p < query_length; p++) {
+        Uint4 r = 0;               /* index on residues */
         double columnCounts = 0.0; /*column-specific pseudocounts*/
         double observations = 0.0;
         double pseudoWeight; /*multiplier for pseudocounts term*/
@@ -2160,7 +2459,9 @@ _PSIComputeFreqRatios(const _PSIMsa* msa,
                 denominator = observations + kBeta;
 
                 if (nsg_compatibility_mode && denominator == 0.0) {
-                    return PSIERR_UNKNOWN;
+#pragma omp critical(psi_freq_ratios)
+                    retval = PSIERR_UNKNOWN;
+                    break;
                 } else {
                     ASSERT(denominator != 0.0);
                 }
@@ -2177,7 +2478,7 @@ _PSIComputeFreqRatios(const _PSIMsa* msa,
 
     freq_ratios = _PSIMatrixFrequencyRatiosFree(freq_ratios);
 
-    return PSI_SUCCESS;
+    return retval;
 }
 
 
@@ -399,11 +399,13 @@ _PSISequenceWeightsFree(_PSISequenceWeights* seq_weights);
  * data will not be modified.
  * @sa implementation of PSICreatePssmWithDiagnostics
  * @param msa multiple sequence alignment data structure [in]
+ * @param num_threads number of OpenMP threads to use, the result does not
+ * depend on this value [in]
  * @return PSIERR_BADPARAM if alignment is NULL; PSI_SUCCESS otherwise
  */
 NCBI_XBLAST_EXPORT 
 int 
-_PSIPurgeBiasedSegments(_PSIPackedMsa* msa);
+_PSIPurgeBiasedSegments(_PSIPackedMsa* msa, size_t num_threads);
 
 /** Main validation function for multiple sequence alignment structure. Should
  * be called after _PSIPurgeBiasedSegments.
@@ -442,6 +444,8 @@ _PSIComputeAlignmentBlocks(const _PSIMsa* msa,
  * [in]
  * @param seq_weights data structure containing the data needed to compute the
  * sequence weights [out]
+ * @param num_threads number of OpenMP threads to use, the result does not
+ * depend on this value [in]
  * @return PSIERR_BADPARAM if arguments are NULL, PSIERR_OUTOFMEM in case of
  * memory allocation failure, PSIERR_BADSEQWEIGHTS if the sequence weights fail
  * to add up to 1.0, PSI_SUCCESS otherwise
@@ -451,7 +455,8 @@ int
 _PSIComputeSequenceWeights(const _PSIMsa* msa,
                            const _PSIAlignedBlock* aligned_blocks,
                            Boolean nsg_compatibility_mode,
-                          _PSISequenceWeights* seq_weights);
+                           _PSISequenceWeights* seq_weights,
+                           size_t num_threads);
 
 /** Main function to calculate CD weights and combine weighted residue counts
  * from matched CDs
@@ -482,6 +487,8 @@ _PSIComputeFrequenciesFromCDs(const PSICdMsa* cd_msa,
  * @param nsg_compatibility_mode set to true to emulate the structure group's
  * use of PSSM engine in the cddumper application. By default should be FALSE
  * @param internal_pssm PSSM being computed [out]
+ * @param num_threads number of OpenMP threads to use, the result does not
+ * depend on this value [in]
  * @return PSIERR_BADPARAM if arguments are NULL, PSI_SUCCESS otherwise
  */
 NCBI_XBLAST_EXPORT 
@@ -492,7 +499,8 @@ _PSIComputeFreqRatios(const _PSIMsa* msa,
                       const _PSIAlignedBlock* aligned_blocks,
                       Int4 pseudo_count,
                       Boolean nsg_compatibility_mode,
-                      _PSIInternalPssmData* internal_pssm);
+                      _PSIInternalPssmData* internal_pssm,
+                      size_t num_threads);
 
 /** Main function to compute CD-based PSSM's frequency ratios
  * @param cd_msa multiple alignment of CDs [in]
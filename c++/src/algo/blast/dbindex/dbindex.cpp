@@ -168,6 +168,11 @@ CRef< CIndexSuperHeader_Base > GetIndexSuperHeader(
                     CIndexSuperHeader_Base::INDEX_FORMAT_VERSION_1 >(
                 file_size, endianness, version, fname, is ) );
 
+        case CIndexSuperHeader_Base::INDEX_FORMAT_VERSION_2:
+            return TRet( new CIndexSuperHeader< 
+                    CIndexSuperHeader_Base::INDEX_FORMAT_VERSION_2 >(
+                file_size, endianness, version, fname, is ) );
+
         default: 
         { 
             std::ostringstream os;
@@ -237,6 +242,15 @@ CIndexSuperHeader<
 {
 }
 
+//-------------------------------------------------------------------------
+CIndexSuperHeader< 
+    CIndexSuperHeader_Base::INDEX_FORMAT_VERSION_1 >::CIndexSuperHeader( 
+        Uint4 n_seq, Uint4 n_vol, Uint4 version )
+    : CIndexSuperHeader_Base( version ),
+      num_seq_( n_seq ), num_vol_( n_vol )
+{
+}
+
 //-------------------------------------------------------------------------
 void CIndexSuperHeader< 
     CIndexSuperHeader_Base::INDEX_FORMAT_VERSION_1 >::Save( 
@@ -322,6 +336,7 @@ const SIndexHeader ReadIndexHeader< true >( void * map )
     result.stop_chunk_  = (TSeqNum)(*ptr++);
 
     result.legacy_ = true;
+    result.compressed_ = false;
     return result;
 }
 
@@ -344,6 +359,7 @@ const SIndexHeader ReadIndexHeader< false >( void * map )
     result.stop_chunk_  = (TSeqNum)(*ptr++);
 
     result.legacy_ = false;
+    result.compressed_ = false;
     return result;
 }
 
@@ -385,6 +401,7 @@ CDbIndex::SOptions CDbIndex::DefaultSOptions()
     SOptions result = {
         false,                  // do not create id map by default
         true,                   // for now, use legacy format by default
+        false,                  // do not compress offset lists by default
         STRIDE,                 // default stride for legacy indices
         28,                     // default word size for legacy indices
         12,                     // default Nmer size
@@ -392,6 +409,7 @@ CDbIndex::SOptions CDbIndex::DefaultSOptions()
         DBSEQ_CHUNK_OVERLAP,    // defined by BLAST
         REPORT_NORMAL,          // normal level of progress reporting
         1536,                   // max index size if 1.5 Gb by default
+        1,                      // build offset lists on one thread by default
     };
 
     return result;
@@ -424,8 +442,9 @@ CRef< CDbIndex > CDbIndex::Load( const std::string & fname, bool nomap )
     index_stream.close();
 
     switch( version ) {
-        case VERSION:     return LoadIndex< true >( fname, nomap );
-        case VERSION + 1: return LoadIndex< false >( fname, nomap );
+        case VERSION:     return LoadIndex< true, false >( fname, nomap );
+        case VERSION + 1: return LoadIndex< false, false >( fname, nomap );
+        case VERSION + 2: return LoadIndex< false, true >( fname, nomap );
         default: 
             
             NCBI_THROW( 
@@ -563,6 +582,57 @@ COffsetData_Base::COffsetData_Base(
     }
 }
 
+//-------------------------------------------------------------------------
+SGroupVarintTables::SGroupVarintTables()
+{
+    for( unsigned long ctrl = 0; ctrl < 256; ++ctrl ) {
+        unsigned long pos = 0;
+
+        for( unsigned long i = 0; i < 4; ++i ) {
+            unsigned long len = ((ctrl>>(2*i))&0x3) + 1;
+
+            for( unsigned long j = 0; j < 4; ++j ) {
+                shuffle[ctrl][4*i + j] = (j < len) ? (Uint1)(pos++) : 0x80;
+            }
+        }
+
+        length[ctrl] = (Uint1)pos;
+    }
+}
+
+//-------------------------------------------------------------------------
+const SGroupVarintTables & GetGroupVarintTables()
+{
+    static const SGroupVarintTables tables;
+    return tables;
+}
+
+//-------------------------------------------------------------------------
+void EncodeGroupVarint( 
+        const std::vector< TWord > & values, std::vector< Uint1 > & out )
+{
+    out.clear();
+
+    for( std::vector< TWord >::size_type i = 0; i < values.size(); i += 4 ) {
+        std::vector< Uint1 >::size_type ctrl_pos = out.size();
+        Uint1 ctrl = 0;
+        out.push_back( 0 );
+
+        for( unsigned long j = 0; j < 4; ++j ) {
+            TWord value = (i + j < values.size()) ? values[i + j] : 0;
+            unsigned long len = 1;
+            while( len < 4 && (value>>(8*len)) != 0 ) ++len;
+            ctrl |= (Uint1)((len - 1)<<(2*j));
+
+            for( unsigned long k = 0; k < len; ++k ) {
+                out.push_back( (Uint1)(value>>(8*k)) );
+            }
+        }
+
+        out[ctrl_pos] = ctrl;
+    }
+}
+
 END_SCOPE( blastdbindex )
 END_NCBI_SCOPE
 
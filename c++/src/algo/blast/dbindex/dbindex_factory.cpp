@@ -35,7 +35,10 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <exception>
+#include <memory>
 #include <corelib/ncbi_limits.hpp>
+#include <corelib/ncbithr.hpp>
 
 #include <objmgr/object_manager.hpp>
 #include <objmgr/seq_vector.hpp>
@@ -49,11 +52,13 @@
 
 #include "sequence_istream_fasta.hpp"
 #include "dbindex.hpp"
+#include "dbindex_sp.hpp"
 
 #else
 
 #include <algo/blast/dbindex/sequence_istream_fasta.hpp>
 #include <algo/blast/dbindex/dbindex.hpp>
+#include <algo/blast/dbindex/dbindex_sp.hpp>
 
 #endif
 
@@ -521,6 +526,33 @@ class CSubjectMap_Factory : public CSubjectMap_Factory_TBase
         */
         TWord MakeOffset( TSeqNum seq, TSeqPos off ) const;
 
+        /** Get the local sequence id of a sequence chunk.
+            @param snum internal oid of the chunk
+            @return the local id the chunk was added to
+        */
+        TSeqNum GetLId( TSeqNum snum ) const;
+
+        /** Same as CheckOffset( seq, off ), but with the local id 
+            containing the offset known.
+            @param seq Start of the buffer containing the compressed sequence.
+            @param off Offset relative to the start of seq.
+            @param lid Local id of the sequence.
+            @return true if information about this offset should be in the index;
+                    false otherwise.
+        */
+        bool CheckOffset( 
+                const Uint1 * seq, TSeqPos off, TSeqNum lid ) const;
+
+        /** Same as MakeOffset( seq, off ), but with the local id
+            containing the offset known.
+            @param seq start of the buffer containing the compressed sequence
+            @param off offset relative to the start of seq
+            @param lid local id of the sequence
+            @return encoded offset that can be added to an offset list
+        */
+        TWord MakeOffset( 
+                const Uint1 * seq, TSeqPos off, TSeqNum lid ) const;
+
         /** Save the subject map and sequence info.
             @param os output stream open in binary mode
         */
@@ -902,6 +934,45 @@ inline TWord CSubjectMap_Factory::MakeOffset(
     return result;
 }
 
+//-------------------------------------------------------------------------
+inline CSubjectMap_Factory::TSeqNum CSubjectMap_Factory::GetLId( 
+        TSeqNum snum ) const
+{
+    // The local ids are ordered by their first chunk.
+    //
+    TLIdMap::size_type b = 0, e = lid_map_.size();
+
+    while( e - b > 1 ) {
+        TLIdMap::size_type m = (b + e)/2;
+        if( lid_map_[m].start_ < snum ) b = m;
+        else e = m;
+    }
+
+    return (TSeqNum)b;
+}
+
+//-------------------------------------------------------------------------
+inline bool CSubjectMap_Factory::CheckOffset( 
+        const Uint1 * seq, TSeqPos off, TSeqNum lid ) const
+{
+    TSeqPos soff = seq - &(this->seq_store_[0]);
+    ASSERT( lid_map_[lid].seq_start_ <= soff );
+    off += (soff - lid_map_[lid].seq_start_)*CR;
+    return (off%stride_ == 0);
+}
+
+//-------------------------------------------------------------------------
+inline TWord CSubjectMap_Factory::MakeOffset(
+        const Uint1 * seq, TSeqPos off, TSeqNum lid ) const
+{
+    TSeqPos soff = seq - &(this->seq_store_[0]);
+    ASSERT( lid_map_[lid].seq_start_ <= soff );
+    off += (soff - lid_map_[lid].seq_start_)*CR;
+    off /= stride_;
+    off += min_offset_;
+    return (((TWord)lid)<<offset_bits_) + off;
+}
+
 //-------------------------------------------------------------------------
 inline TWord CSubjectMap_Factory::MakeOffset(
         TSeqNum seqnum, TSeqPos off ) const
@@ -982,6 +1053,16 @@ class COffsetList
         */
         void Save( CNcbiOstream & os ) const;
 
+        /** Get the values of the compressed representation of the 
+            offset list.
+            The words of the list are produced in the order used by
+            Save(). Each pass over the list is preceded by the number
+            of words in the pass. Offsets are replaced by min_offset_ 
+            plus the difference from the previous offset of the pass.
+            @param values [O] the values of the compressed list
+        */
+        void GetCompressedValues( std::vector< TWord > & values ) const;
+
     public: // for Solaris
 
         struct SDataUnit;
@@ -1251,6 +1332,51 @@ inline void COffsetList::Save( CNcbiOstream & os) const
     }
 }
 
+//-------------------------------------------------------------------------
+inline void COffsetList::GetCompressedValues( 
+        std::vector< TWord > & values ) const
+{
+    values.clear();
+    if( data_.empty() ) return;
+    unsigned long m = mult_;
+
+    do {
+        std::vector< TWord >::size_type count = values.size();
+        TWord prev = min_offset_;
+        values.push_back( 0 );
+
+        for( TData::const_iterator cit = data_.begin();
+                cit != data_.end(); ++cit ) {
+            TWord offset = *cit;
+
+            if( offset < min_offset_ ) {
+                if( m != mult_ ) { ++cit; continue; }
+                values.push_back( offset );
+                offset = *(++cit);
+            }
+            else {
+                bool skip = (offset%m != 0);
+
+                for( unsigned long n = mult_; !skip && n > m; --n )
+                    if( offset%n == 0 ) skip = true;
+
+                if( skip ) continue;
+            }
+
+            if( offset < prev ) {
+                NCBI_THROW( 
+                        CDbIndex_Exception, eBadData,
+                        "offset list is not sorted" );
+            }
+
+            values.push_back( offset - prev + min_offset_ );
+            prev = offset;
+        }
+
+        values[count] = (TWord)(values.size() - count - 1);
+    } while( --m > 0 );
+}
+
 //-------------------------------------------------------------------------
 inline void COffsetList::AddData( TWord item, TWord & total )
 {
@@ -1310,7 +1436,10 @@ class COffsetData_Factory
               hkey_width_( options.hkey_width ),
               last_seq_( 0 ),
               options_( options ),
-              code_bits_( GetCodeBits( options.stride ) )
+              code_bits_( GetCodeBits( options.stride ) ),
+              num_threads_( options.num_threads ),
+              truncated_( false ),
+              trunc_offset_( 0 )
         {
             for( THashTable::iterator i = hash_table_.begin();
                     i != hash_table_.end(); ++i ) {
@@ -1326,6 +1455,9 @@ class COffsetData_Factory
 
         /** Bring offset lists up to date with the corresponding
             subject map instance.
+
+            With more than one thread, only the size of the offset 
+            lists is updated; the lists are built by Save().
         */
         void Update();
 
@@ -1336,6 +1468,16 @@ class COffsetData_Factory
 
     private:
 
+        /** Save the offset lists in compressed form.
+            @param os output stream; must be open in binary mode
+        */
+        void SaveCompressed( CNcbiOstream & os );
+
+        /** Write the offset list sizes to the statistics file, if
+            one was requested.
+        */
+        void SaveStats() const;
+
         /** Type used for individual offset lists. */
         typedef COffsetList TOffsetList;
 
@@ -1355,35 +1497,165 @@ class COffsetData_Factory
         */
         void Truncate();
 
-        /** Update offset lists with information corresponding to
-            the given sequence.
-            @param sinfo new sequence information
+        /** Offset list words sink that appends the words to the 
+            offset lists.
+        */
+        struct SListSink
+        {
+            /** Append a word to an offset list.
+                @param nmer the Nmer value
+                @param word the offset list word
+            */
+            void operator()( TWord nmer, TWord word )
+            { 
+                hash_table_[(THashTable::size_type)nmer].AddData( 
+                        word, total_ ); 
+            }
+
+            THashTable & hash_table_;   /**< The offset lists. */
+            TWord & total_;             /**< Total size of the lists. */
+        };
+
+        /** Offset list words sink that only counts the words. */
+        struct SCountSink
+        {
+            /** Count a word. */
+            void operator()( TWord, TWord ) { ++count_; }
+
+            TWord count_;               /**< Number of words. */
+        };
+
+        /** Offset list words sink that saves (Nmer, word) pairs 
+            into per thread buckets, by Nmer range.
+        */
+        struct SBucketSink
+        {
+            /** Save a word in the bucket of its Nmer range.
+                @param nmer the Nmer value
+                @param word the offset list word
+            */
+            void operator()( TWord nmer, TWord word )
+            {
+                std::vector< TWord > & bucket = 
+                    buckets_[(((Uint8)nmer)*num_buckets_)>>nmer_bits_];
+                bucket.push_back( nmer );
+                bucket.push_back( word );
+            }
+
+            std::vector< TWord > * buckets_;    /**< The buckets. */
+            unsigned long num_buckets_;         /**< Number of buckets. */
+            unsigned long nmer_bits_;           /**< Nmer width in bits. */
+        };
+
+        /** Thread filling one part of the offset lists. */
+        class CBuildThread : public CThread
+        {
+            public:
+
+                /** Object constructor.
+                    @param factory      [I]     the offset data object
+                    @param part         [I]     part to process
+                    @param merge        [I]     merge the buckets of 
+                                                the part if true; fill
+                                                them otherwise
+                */
+                CBuildThread( 
+                        COffsetData_Factory & factory, 
+                        unsigned long part, bool merge )
+                    : factory_( factory ), part_( part ), merge_( merge )
+                {}
+
+                /** Rethrow the exception the thread failed with, if any. */
+                void CheckError() const
+                {
+                    if( error_ ) std::rethrow_exception( error_ );
+                }
+
+            protected:
+
+                /** Thread entry point. */
+                virtual void * Main()
+                {
+                    try { factory_.BuildPart( part_, merge_ ); }
+                    catch( ... ) { error_ = std::current_exception(); }
+                    return 0;
+                }
+
+            private:
+
+                COffsetData_Factory & factory_; /**< The offset data object. */
+                unsigned long part_;            /**< Part to process. */
+                bool merge_;                    /**< Merge or fill buckets. */
+                std::exception_ptr error_;      /**< Exception thrown by the thread. */
+        };
+
+        /** Maximum number of offset list words collected into the 
+            buckets at a time by BuildLists().
         */
-        void AddSeqInfo( const TSeqInfo & sinfo );
+        static const Uint8 ROUND_WORDS = 32*1024*1024ULL;
 
-        /** Update offset lists with information corresponding to
-            the given valid segment of a sequence.
+        /** Produce the offset list words corresponding to the given 
+            sequence.
+            @param snum internal oid of the sequence
+            @param sinfo sequence information
+            @param sink receives the Nmer values and offset list words
+        */
+        template< typename sink_t >
+        void AddSeqInfo( 
+                TSeqNum snum, const TSeqInfo & sinfo, sink_t & sink ) const;
+
+        /** Produce the offset list words corresponding to the given 
+            valid segment of a sequence.
             @param seq points to the start of the sequence
-            @param seqlen length of seq
+            @param lid local id of the sequence
             @param start start of the segment
             @param stop one past the end of the segment
+            @param sink receives the Nmer values and offset list words
         */
+        template< typename sink_t >
         void AddSeqSeg( 
-                const Uint1 * seq, TWord seqlen,
-                TSeqPos start, TSeqPos stop );
+                const Uint1 * seq, TSeqNum lid,
+                TSeqPos start, TSeqPos stop, sink_t & sink ) const;
 
-        /** Encode the offset data and add to the offset list 
-            corresponding to the given Nmer value.
+        /** Encode the offset data and pass it to the sink together
+            with the given Nmer value.
             @param nmer the Nmer value
             @param start start of the current valid segment
             @param stop one past the end of the current valid segment
             @param curr end of the Nmer within the sequence
             @param offset offset encoded with subject map instance
+            @param sink receives the Nmer values and offset list words
         */
+        template< typename sink_t >
         void EncodeAndAddOffset( 
                 TWord nmer,
                 TSeqPos start, TSeqPos stop,
-                TSeqPos curr, TWord offset );
+                TSeqPos curr, TWord offset, sink_t & sink ) const;
+
+        /** Build the offset lists of the sequences counted by Update()
+            using num_threads_ threads.
+
+            The sequences are split into consecutive ranges, one per 
+            thread. Each thread saves the words of its range in buckets
+            by Nmer range. Then each thread appends the words of one
+            Nmer range to the offset lists, taking the buckets in the 
+            order of the sequence ranges. The lists are therefore the 
+            same as those built by a single thread.
+        */
+        void BuildLists();
+
+        /** Run BuildPart() on all parts, one thread per part.
+            @param merge passed to BuildPart()
+        */
+        void RunParts( bool merge );
+
+        /** Fill or merge the buckets of one part.
+            @param part the part to process
+            @param merge if true, append the words of Nmer range part
+                         to the offset lists; otherwise save the words
+                         of sequence range part in the buckets
+        */
+        void BuildPart( unsigned long part, bool merge );
 
         TSubjectMap & subject_map_;     /**< Instance of subject map structure. */
         THashTable hash_table_;         /**< Mapping from Nmer values to the corresponding offset lists. */
@@ -1393,32 +1665,122 @@ class COffsetData_Factory
 
         const CDbIndex::SOptions & options_; /**< Index options. */
         unsigned long code_bits_;            /**< Number of bits to encode special offset prefixes. */
+
+        /** @name Multi-threaded offset list construction. */
+        /**@{*/
+        unsigned long num_threads_;          /**< Number of threads. */
+        std::vector< TWord > seq_words_;     /**< Number of offset list words of each sequence. */
+        bool truncated_;                     /**< Truncate() was called. */
+        TWord trunc_offset_;                 /**< Offset value passed to TruncateList(). */
+
+        /** (first, one past the last) sequence of each sequence range. */
+        std::vector< std::pair< TSeqNum, TSeqNum > > ranges_;
+
+        /** Buckets of (Nmer, word) pairs by sequence range and Nmer range. */
+        std::vector< std::vector< std::vector< TWord > > > buckets_;
+
+        std::vector< TWord > part_totals_;   /**< Number of words merged by each thread. */
+
+        /** Data pools of offset lists filled by threads other than the first. */
+        std::vector< std::unique_ptr< COffsetList::CDataPool > > pools_;
+        /**@}*/
 };
 
 //-------------------------------------------------------------------------
-void COffsetData_Factory::Save( CNcbiOstream & os ) 
+void COffsetData_Factory::SaveStats() const
 {
-    ++this->total_;
+    if( options_.stat_file_name.empty() ) return;
+    CNcbiOfstream stats( options_.stat_file_name.c_str() );
+    unsigned long nmer = 0;
+
+    for( THashTable::const_iterator cit = hash_table_.begin();
+            cit != hash_table_.end(); ++cit, ++nmer ) {
+        if( cit->Size() > 0 ) {
+            stats << hex << setw( 10 ) << nmer 
+                  << " " << dec << cit->Size() << endl;
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+void COffsetData_Factory::SaveCompressed( CNcbiOstream & os )
+{
+    // Extra bytes at the end of the list data so that the decoder can
+    // always load 16 bytes following a control byte.
+    static const Uint8 PADDING = 16;
+
+    std::vector< TWord > values;
+    std::vector< Uint1 > data;
+    std::vector< TWord > starts( hash_table_.size(), 0 );
+    Uint8 size = sizeof( TWord );
+
+    for( THashTable::size_type i = 0; i < hash_table_.size(); ++i ) {
+        if( hash_table_[i].Size() != 0 ) {
+            hash_table_[i].GetCompressedValues( values );
+            EncodeGroupVarint( values, data );
+            starts[i] = (TWord)size;
+            size += data.size();
+
+            if( size + PADDING > (Uint8)kMax_UI4 ) {
+                NCBI_THROW( 
+                        CDbIndex_Exception, eBadOption,
+                        "compressed offset data exceeds 4GB; "
+                        "use a smaller volume size" );
+            }
+        }
+    }
+
+    TWord total = 
+        (TWord)((size + PADDING + sizeof( TWord ) - 1)/sizeof( TWord ));
+    WriteWord( os, total );
+
+    for( std::vector< TWord >::const_iterator cit = starts.begin();
+            cit != starts.end(); ++cit ) {
+        WriteWord( os, *cit );
+    }
+
+    WriteWord( os, total );
+    WriteWord( os, (TWord)0 );
 
     for( THashTable::const_iterator cit = hash_table_.begin();
             cit != hash_table_.end(); ++cit ) {
-        if( cit->Size() > 0 ) ++this->total_;
+        if( cit->Size() != 0 ) {
+            cit->GetCompressedValues( values );
+            EncodeGroupVarint( values, data );
+            os.write( (const char *)&data[0], data.size() );
+        }
     }
 
-    bool stat = !options_.stat_file_name.empty();
-    std::unique_ptr< CNcbiOfstream > stats;
+    for( Uint8 i = size; i < sizeof( TWord )*(Uint8)total; ++i ) {
+        WriteWord( os, (Uint1)0 );
+    }
 
-    if( stat ) {
-        stats.reset( 
-                new CNcbiOfstream( options_.stat_file_name.c_str() ) );
+    SaveStats();
+    os << std::flush;
+}
+
+//-------------------------------------------------------------------------
+void COffsetData_Factory::Save( CNcbiOstream & os ) 
+{
+    if( num_threads_ > 1 ) BuildLists();
+
+    if( options_.compressed ) {
+        SaveCompressed( os );
+        return;
+    }
+
+    ++this->total_;
+
+    for( THashTable::const_iterator cit = hash_table_.begin();
+            cit != hash_table_.end(); ++cit ) {
+        if( cit->Size() > 0 ) ++this->total_;
     }
 
     WriteWord( os, total() );
     TWord tot = 0;
-    unsigned long nmer = 0;
 
     for( THashTable::const_iterator cit = hash_table_.begin();
-            cit != hash_table_.end(); ++cit, ++nmer ) {
+            cit != hash_table_.end(); ++cit ) {
         if( cit->Size() != 0 ) {
             ++tot;
         }
@@ -1428,13 +1790,10 @@ void COffsetData_Factory::Save( CNcbiOstream & os )
         else WriteWord( os, (TWord)0 );
 
         tot += cit->Size();
-
-        if( stat && cit->Size() > 0 ) {
-            *stats << hex << setw( 10 ) << nmer 
-                   << " " << dec << cit->Size() << endl;
-        }
     }
 
+    SaveStats();
+
     WriteWord( os, total() );
     WriteWord( os, (TWord)0 );
 
@@ -1447,9 +1806,10 @@ void COffsetData_Factory::Save( CNcbiOstream & os )
 }
 
 //-------------------------------------------------------------------------
-void COffsetData_Factory::EncodeAndAddOffset(
+template< typename sink_t >
+inline void COffsetData_Factory::EncodeAndAddOffset(
         TWord nmer, TSeqPos start, TSeqPos stop, 
-        TSeqPos curr, TWord offset )
+        TSeqPos curr, TWord offset, sink_t & sink ) const
 {
     TSeqPos start_diff = curr + 2 - hkey_width_ - start;
     TSeqPos end_diff = stop - curr;
@@ -1458,17 +1818,17 @@ void COffsetData_Factory::EncodeAndAddOffset(
         if( start_diff > options_.stride ) start_diff = 0;
         if( end_diff > options_.stride ) end_diff = 0;
         TWord code = (start_diff<<code_bits_) + end_diff;
-        hash_table_[(THashTable::size_type)nmer].AddData( 
-                code, total_ );
+        sink( nmer, code );
     }
 
-    hash_table_[(THashTable::size_type)nmer].AddData( 
-            offset, total_ );
+    sink( nmer, offset );
 }
 
 //-------------------------------------------------------------------------
+template< typename sink_t >
 void COffsetData_Factory::AddSeqSeg(
-        const Uint1 * seq, TWord , TSeqPos start, TSeqPos stop )
+        const Uint1 * seq, TSeqNum lid, TSeqPos start, TSeqPos stop, 
+        sink_t & sink ) const
 {
     const TWord nmer_mask = (((TWord)1)<<(2*hkey_width_)) - 1;
     const Uint1 letter_mask = 0x3;
@@ -1481,22 +1841,26 @@ void COffsetData_Factory::AddSeqSeg(
         nmer = ((nmer<<2)&nmer_mask) + letter;
 
         if( count >= hkey_width_ - 1 ) {
-            if( subject_map_.CheckOffset( seq, curr ) ) {
-                TWord offset = subject_map_.MakeOffset( seq, curr );
-                EncodeAndAddOffset( nmer, start, stop, curr, offset );
+            if( subject_map_.CheckOffset( seq, curr, lid ) ) {
+                TWord offset = subject_map_.MakeOffset( seq, curr, lid );
+                EncodeAndAddOffset( nmer, start, stop, curr, offset, sink );
             }
         }
     }
 }
 
 //-------------------------------------------------------------------------
-void COffsetData_Factory::AddSeqInfo( const TSeqInfo & sinfo )
+template< typename sink_t >
+void COffsetData_Factory::AddSeqInfo( 
+        TSeqNum snum, const TSeqInfo & sinfo, sink_t & sink ) const
 {
+    TSeqNum lid = subject_map_.GetLId( snum );
+
     for( TSeqInfo::TSegs::const_iterator it = sinfo.segs_.begin();
             it != sinfo.segs_.end(); ++it ) {
         AddSeqSeg( 
                 subject_map_.seq_store_start() + sinfo.seq_start_, 
-                sinfo.len_, it->start_, it->stop_ );
+                lid, it->start_, it->stop_, sink );
     }
 }
 
@@ -1506,6 +1870,21 @@ void COffsetData_Factory::Truncate()
     last_seq_ = subject_map_.LastGoodSequence();
     TWord offset = subject_map_.MakeOffset( last_seq_, 0 );
 
+    if( num_threads_ > 1 ) {
+        // The lists are not built yet. BuildLists() truncates them
+        // the same way once they are.
+        //
+        truncated_ = true;
+        trunc_offset_ = offset;
+
+        while( seq_words_.size() > last_seq_ ) {
+            total_ -= *seq_words_.rbegin();
+            seq_words_.pop_back();
+        }
+
+        return;
+    }
+
     for( THashTable::iterator it = hash_table_.begin();
             it != hash_table_.end(); ++it ) {
         it->TruncateList( offset, total_ );
@@ -1522,11 +1901,157 @@ void COffsetData_Factory::Update()
     const TSeqInfo * sinfo;
 
     while( (sinfo = subject_map_.GetSeqInfo( last_seq_ + 1 )) != 0 ) {
-        AddSeqInfo( *sinfo );
+        if( num_threads_ > 1 ) {
+            SCountSink sink = { 0 };
+            AddSeqInfo( last_seq_ + 1, *sinfo, sink );
+            seq_words_.push_back( sink.count_ );
+            total_ += sink.count_;
+        }
+        else {
+            SListSink sink = { hash_table_, total_ };
+            AddSeqInfo( last_seq_ + 1, *sinfo, sink );
+        }
+
         ++last_seq_;
     }
 }
 
+//-------------------------------------------------------------------------
+void COffsetData_Factory::BuildPart( unsigned long part, bool merge )
+{
+    if( merge ) {
+        TWord total = 0;
+
+        for( unsigned long i = 0; i < num_threads_; ++i ) {
+            const std::vector< TWord > & bucket = buckets_[i][part];
+
+            for( std::vector< TWord >::size_type j = 0; 
+                    j < bucket.size(); j += 2 ) {
+                hash_table_[(THashTable::size_type)bucket[j]].AddData( 
+                        bucket[j + 1], total );
+            }
+        }
+
+        part_totals_[part] = total;
+    }
+    else {
+        std::vector< std::vector< TWord > > & buckets = buckets_[part];
+
+        for( unsigned long i = 0; i < num_threads_; ++i ) {
+            buckets[i].clear();
+        }
+
+        SBucketSink sink = { &buckets[0], num_threads_, 2*hkey_width_ };
+
+        for( TSeqNum snum = ranges_[part].first; 
+                snum < ranges_[part].second; ++snum ) {
+            AddSeqInfo( snum, *subject_map_.GetSeqInfo( snum ), sink );
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+void COffsetData_Factory::RunParts( bool merge )
+{
+    typedef std::vector< CRef< CBuildThread > > TThreads;
+    TThreads threads;
+
+    for( unsigned long i = 1; i < num_threads_; ++i ) {
+        threads.push_back( CRef< CBuildThread >( 
+                    new CBuildThread( *this, i, merge ) ) );
+        (*threads.rbegin())->Run();
+    }
+
+    std::exception_ptr error;
+    try { BuildPart( 0, merge ); }
+    catch( ... ) { error = std::current_exception(); }
+
+    for( TThreads::iterator i = threads.begin(); i != threads.end(); ++i ) {
+        (*i)->Join();
+    }
+
+    if( error ) std::rethrow_exception( error );
+
+    for( TThreads::iterator i = threads.begin(); i != threads.end(); ++i ) {
+        (*i)->CheckError();
+    }
+}
+
+//-------------------------------------------------------------------------
+void COffsetData_Factory::BuildLists()
+{
+    unsigned long n = num_threads_;
+
+    // The lists of each Nmer range are filled by a different thread,
+    // so each range needs its own data pool.
+    //
+    pools_.clear();
+
+    for( unsigned long i = 1; i < n; ++i ) {
+        pools_.push_back( std::unique_ptr< COffsetList::CDataPool >( 
+                    new COffsetList::CDataPool ) );
+    }
+
+    for( THashTable::size_type i = 0; i < hash_table_.size(); ++i ) {
+        unsigned long part = (unsigned long)((((Uint8)i)*n)>>(2*hkey_width_));
+        if( part > 0 ) hash_table_[i].SetDataPool( pools_[part - 1].get() );
+    }
+
+    ranges_.resize( n );
+    part_totals_.resize( n );
+    buckets_.assign( n, std::vector< std::vector< TWord > >( n ) );
+    total_ = 0;
+    TSeqNum num_seq = (TSeqNum)seq_words_.size(), first = 1;
+
+    // Limit the memory used by the buckets by processing the sequences 
+    // in rounds.
+    //
+    while( first <= num_seq ) {
+        TSeqNum last = first;
+        Uint8 words = 0;
+
+        while( last <= num_seq && 
+                (last == first || 
+                 words + seq_words_[last - 1] <= ROUND_WORDS) ) {
+            words += seq_words_[last++ - 1];
+        }
+
+        TSeqNum start = first;
+        Uint8 acc = 0;
+        unsigned long part = 0;
+
+        for( TSeqNum snum = first; snum < last; ++snum ) {
+            acc += seq_words_[snum - 1];
+
+            while( part + 1 < n && acc*n >= words*(part + 1) ) {
+                ranges_[part++] = std::make_pair( start, snum + 1 );
+                start = snum + 1;
+            }
+        }
+
+        for( ; part < n; ++part ) {
+            ranges_[part] = std::make_pair( start, last );
+            start = last;
+        }
+
+        RunParts( false );
+        RunParts( true );
+
+        for( unsigned long i = 0; i < n; ++i ) total_ += part_totals_[i];
+        first = last;
+    }
+
+    buckets_.clear();
+    seq_words_.clear();
+
+    if( truncated_ ) {
+        for( THashTable::iterator it = hash_table_.begin();
+                it != hash_table_.end(); ++it ) {
+            it->TruncateList( trunc_offset_, total_ );
+        }
+    }
+}
+
 //-------------------------------------------------------------------------
 /** Index factory implementation.
   */
@@ -1609,7 +2134,7 @@ void CDbIndex_Factory::SaveHeader(
                 TSeqNum stop,
                 TSeqNum stop_chunk )
 {
-    if( options.legacy ) {
+    if( options.legacy && !options.compressed ) {
         WriteWord( os, (unsigned char)VERSION );
         for( int i = 0; i < 7; ++i ) WriteWord( os, (unsigned char)0 );
         WriteWord( os, (Uint8)WIDTH_32 );
@@ -1618,7 +2143,10 @@ void CDbIndex_Factory::SaveHeader(
         WriteWord( os, (TWord)UNCOMPRESSED );
     }
     else {
-        WriteWord( os, (unsigned char)(VERSION + 1) );
+        WriteWord( 
+                os, 
+                (unsigned char)(options.compressed ? VERSION + 2 
+                                                   : VERSION + 1) );
         for( int i = 0; i < 7; ++i ) WriteWord( os, (unsigned char)0 );
         WriteWord( os, (Uint8)WIDTH_32 );
         WriteWord( os, (TWord)options.hkey_width );
@@ -34,8 +34,11 @@
 
 #include <list>
 #include <algorithm>
+#include <exception>
+#include <memory>
 
 #include <corelib/ncbifile.hpp>
+#include <corelib/ncbithr.hpp>
 
 #include <algo/blast/core/blast_extend.h>
 #include <algo/blast/core/blast_gapalign.h>
@@ -62,6 +65,8 @@ typedef CDbIndex::TWord TWord;
 
 //-------------------------------------------------------------------------
 /** Memory map a file and return a pointer to the mapped area.
+    The file is mapped read-only and shared, so that all processes
+    searching the same index volume use a single copy of it.
     @param fname        [I]     file name
     @return pointer to the start of the mapped memory area
 */
@@ -70,7 +75,8 @@ CMemoryFile * MapFile( const std::string & fname )
     CMemoryFile * result = 0;
 
     try {
-        result = new CMemoryFile( fname );
+        result = new CMemoryFile( 
+                fname, CMemoryFile::eMMP_Read, CMemoryFile::eMMS_Shared );
     }
     catch( ... ) { result = 0; }
 
@@ -262,6 +268,22 @@ class CSeedRoots
         const SSeedRoot * GetSubjRoots( TSeqNum subject ) const
         { return roots_ + (subject<<subj_roots_len_bits_); }
 
+        /** Get the number of roots stored for a particular subject.
+            @param subject      [I]     local subject id
+            @return number of roots of the given subject
+        */
+        unsigned long NumSubjRoots( TSeqNum subject ) const
+        {
+            const SSubjRootsInfo & rinfo = rinfo_[subject];
+            return rinfo.len_ + 
+                (rinfo.extra_roots_ == 0 ? 0 : rinfo.extra_roots_->size());
+        }
+
+        /** Get the total number of stored roots.
+            @return number of roots of all subjects
+        */
+        unsigned long NumRoots() const { return total_; }
+
         /** Check if the max number of elements is reached.
             @return true if LIM_ROOTS is exceeded, false otherwise
         */
@@ -845,15 +867,11 @@ bool CTrackedSeeds< TWO_HIT >::EvalAndUpdate( TTrackedSeed & seed )
 }
 
 //-------------------------------------------------------------------------
-// Forward declaration.
-//
-template< bool LEGACY > class CDbIndex_Impl;
-
 /** This is the object representing the state of a search over the index.
     Use of a separate class for searches allows for multiple simultaneous
     searches against the same index.
 */
-template< bool LEGACY, unsigned long NHITS, typename derived_t >
+template< typename index_impl_t, unsigned long NHITS, typename derived_t >
 class CSearch_Base
 {
     protected:
@@ -864,7 +882,7 @@ class CSearch_Base
 
         /** @name Aliases for convenience. */
         /**@{*/
-        typedef CDbIndex_Impl< LEGACY > TIndex_Impl;
+        typedef index_impl_t TIndex_Impl;
         typedef typename TIndex_Impl::TSubjectMap TSubjectMap;
         typedef CTrackedSeeds< NHITS > TTrackedSeeds;
         typedef derived_t TDerived;
@@ -882,6 +900,15 @@ class CSearch_Base
                 const BlastSeqLoc * locs,
                 const TSearchOptions & options );
 
+        /** Worker object constructor.
+            The worker object shares the collected roots and the tracked
+            seeds with the master search object, but has its own current
+            subject and offsets, so that it can compute the seeds of a 
+            range of subjects concurrently with the master object.
+            @param master       [I]     the master search object
+        */
+        explicit CSearch_Base( CSearch_Base * master );
+
         /** Performs the search.
             @return the set of seeds matching the query to the sequences
                     present in the index
@@ -897,6 +924,49 @@ class CSearch_Base
         */
         typedef std::vector< TTrackedSeeds > TTrackedSeedsSet;     
 
+        /** Thread computing the seeds of a range of subjects. */
+        class CSeedsThread : public CThread
+        {
+            public:
+
+                /** Object constructor.
+                    @param master       [I]     the master search object
+                    @param first        [I]     first subject of the range
+                    @param last         [I]     one past the last subject
+                                                of the range
+                */
+                CSeedsThread( 
+                        TDerived * master, TSeqNum first, TSeqNum last )
+                    : search_( master ), first_( first ), last_( last )
+                {}
+
+                /** Rethrow the exception the thread failed with, if any. */
+                void CheckError() const
+                {
+                    if( error_ ) std::rethrow_exception( error_ );
+                }
+
+            protected:
+
+                /** Thread entry point. */
+                virtual void * Main()
+                {
+                    try { search_.ComputeSeeds( first_, last_ ); }
+                    catch( ... ) { error_ = std::current_exception(); }
+                    return 0;
+                }
+
+            private:
+
+                TDerived search_;               /**< Worker search object. */
+                TSeqNum first_;                 /**< First subject. */
+                TSeqNum last_;                  /**< One past the last subject. */
+                std::exception_ptr error_;      /**< Exception thrown by the thread. */
+        };
+
+        /** Minimum number of roots per seed computation thread. */
+        static const unsigned long MIN_THREAD_ROOTS = 64*1024;
+
         /** Helper method to search a particular segment of the query. 
             The segment is taken from state of the search object.
         */
@@ -939,9 +1009,19 @@ class CSearch_Base
         void ExtendRight( 
                 TTrackedSeed & seed, TSeqPos nmax = ~(TSeqPos)0 ) const;
 
-        /** Compute the seeds after all roots are collected. */
+        /** Compute the seeds after all roots are collected. 
+            The subjects are split between up to options_.num_threads
+            threads in ranges holding about the same number of roots.
+        */
         void ComputeSeeds();
 
+        /** Compute the seeds of a range of subjects.
+            @param first        [I]     first subject of the range
+            @param last         [I]     one past the last subject of 
+                                        the range
+        */
+        void ComputeSeeds( TSeqNum first, TSeqNum last );
+
         /** Process a single root.
             @param seeds        [I/O]   information on currently tracked seeds
             @param root         [I]     root to process
@@ -954,7 +1034,10 @@ class CSearch_Base
         const BlastSeqLoc * locs_;              /**< Set of query locations to search. */
         TSearchOptions options_;                /**< Search options. */
 
-        TTrackedSeedsSet seeds_; /**< The set of currently tracked seeds. */
+        TTrackedSeedsSet own_seeds_;            /**< Tracked seeds owned by this object. */
+        std::unique_ptr< CSeedRoots > own_roots_; /**< Roots owned by this object. */
+
+        TTrackedSeedsSet & seeds_; /**< The set of currently tracked seeds. */
         TSeqNum subject_;        /**< Logical id of the subject sequence containing the offset
                                       value currently being considered. */
         TWord subj_start_off_;   /**< Start offset of subject_. */
@@ -965,22 +1048,24 @@ class CSearch_Base
         TSeqPos soff_;           /**< Current subject offset. */
         TSeqPos qstart_;         /**< Start of the current query segment. */
         TSeqPos qstop_;          /**< One past the end of the current query segment. */
-        CSeedRoots roots_;       /**< Collection of initial soff/qoff pairs. */
+        CSeedRoots & roots_;     /**< Collection of initial soff/qoff pairs. */
 
         unsigned long code_bits_;  /**< Number of bits to represent special offset prefix. */
         unsigned long min_offset_; /**< Minumum offset used by the index. */
 };
 
 //-------------------------------------------------------------------------
-template< bool LEGACY, unsigned long NHITS, typename derived_t >
-CSearch_Base< LEGACY, NHITS, derived_t >::CSearch_Base(
+template< typename index_impl_t, unsigned long NHITS, typename derived_t >
+CSearch_Base< index_impl_t, NHITS, derived_t >::CSearch_Base(
         const TIndex_Impl & index_impl,
         const BLAST_SequenceBlk * query,
         const BlastSeqLoc * locs,
         const TSearchOptions & options )
     : index_impl_( index_impl ), query_( query ), locs_( locs ),
-      options_( options ), subject_( 0 ), subj_end_off_( 0 ),
-      roots_( index_impl_.NumSubjects() ),
+      options_( options ), 
+      own_roots_( new CSeedRoots( index_impl_.NumSubjects() ) ),
+      seeds_( own_seeds_ ), subject_( 0 ), subj_end_off_( 0 ),
+      roots_( *own_roots_ ),
       code_bits_( GetCodeBits( index_impl.GetSubjectMap().GetStride() ) ),
       min_offset_( GetMinOffset( index_impl.GetSubjectMap().GetStride() ) )
 {
@@ -993,9 +1078,20 @@ CSearch_Base< LEGACY, NHITS, derived_t >::CSearch_Base(
 }
 
 //-------------------------------------------------------------------------
-template< bool LEGACY, unsigned long NHITS, typename derived_t >
+template< typename index_impl_t, unsigned long NHITS, typename derived_t >
+CSearch_Base< index_impl_t, NHITS, derived_t >::CSearch_Base(
+        CSearch_Base * master )
+    : index_impl_( master->index_impl_ ), query_( master->query_ ), 
+      locs_( master->locs_ ), options_( master->options_ ), 
+      seeds_( master->seeds_ ), subject_( 0 ), subj_end_off_( 0 ),
+      roots_( master->roots_ ),
+      code_bits_( master->code_bits_ ), min_offset_( master->min_offset_ )
+{}
+
+//-------------------------------------------------------------------------
+template< typename index_impl_t, unsigned long NHITS, typename derived_t >
 INLINE
-void CSearch_Base< LEGACY, NHITS, derived_t >::ExtendLeft( 
+void CSearch_Base< index_impl_t, NHITS, derived_t >::ExtendLeft( 
         TTrackedSeed & seed, TSeqPos nmax ) const
 {
     static const unsigned long CR = CDbIndex::CR;
@@ -1065,9 +1161,9 @@ void CSearch_Base< LEGACY, NHITS, derived_t >::ExtendLeft(
 }
 
 //-------------------------------------------------------------------------
-template< bool LEGACY, unsigned long NHITS, typename derived_t >
+template< typename index_impl_t, unsigned long NHITS, typename derived_t >
 INLINE
-void CSearch_Base< LEGACY, NHITS, derived_t >::ExtendRight( 
+void CSearch_Base< index_impl_t, NHITS, derived_t >::ExtendRight( 
         TTrackedSeed & seed, TSeqPos nmax ) const
 {
     static const unsigned long CR = CDbIndex::CR;
@@ -1137,9 +1233,9 @@ void CSearch_Base< LEGACY, NHITS, derived_t >::ExtendRight(
 }
 
 //-------------------------------------------------------------------------
-template< bool LEGACY, unsigned long NHITS, typename derived_t >
+template< typename index_impl_t, unsigned long NHITS, typename derived_t >
 INLINE
-void CSearch_Base< LEGACY, NHITS, derived_t >::ProcessBoundaryOffset( 
+void CSearch_Base< index_impl_t, NHITS, derived_t >::ProcessBoundaryOffset( 
         TWord offset, TWord bounds )
 {
     TSeqPos nmaxleft  = (TSeqPos)(bounds>>code_bits_);
@@ -1172,9 +1268,9 @@ void CSearch_Base< LEGACY, NHITS, derived_t >::ProcessBoundaryOffset(
 }
 
 //-------------------------------------------------------------------------
-template< bool LEGACY, unsigned long NHITS, typename derived_t >
+template< typename index_impl_t, unsigned long NHITS, typename derived_t >
 INLINE
-void CSearch_Base< LEGACY, NHITS, derived_t >::ProcessOffset( TWord offset )
+void CSearch_Base< index_impl_t, NHITS, derived_t >::ProcessOffset( TWord offset )
 {
     TTrackedSeed seed(
         qoff_, (TSeqPos)offset, index_impl_.hkey_width(), qoff_ );
@@ -1189,9 +1285,9 @@ void CSearch_Base< LEGACY, NHITS, derived_t >::ProcessOffset( TWord offset )
 }
 
 //-------------------------------------------------------------------------
-template< bool LEGACY, unsigned long NHITS, typename derived_t >
+template< typename index_impl_t, unsigned long NHITS, typename derived_t >
 INLINE
-unsigned long CSearch_Base< LEGACY, NHITS, derived_t >::ProcessRoot( 
+unsigned long CSearch_Base< index_impl_t, NHITS, derived_t >::ProcessRoot( 
         TTrackedSeeds & seeds, const SSeedRoot * root )
 {
     if( qoff_ != root->qoff_ ) {
@@ -1219,13 +1315,74 @@ unsigned long CSearch_Base< LEGACY, NHITS, derived_t >::ProcessRoot(
 }
 
 //-------------------------------------------------------------------------
-template< bool LEGACY, unsigned long NHITS, typename derived_t >
-INLINE
-void CSearch_Base< LEGACY, NHITS, derived_t >::ComputeSeeds()
+template< typename index_impl_t, unsigned long NHITS, typename derived_t >
+void CSearch_Base< index_impl_t, NHITS, derived_t >::ComputeSeeds()
 {
     TSeqNum num_subjects = index_impl_.NumSubjects() - 1;
+    unsigned long total = roots_.NumRoots();
+    unsigned long num_threads = options_.num_threads;
+
+    if( num_threads > total/MIN_THREAD_ROOTS ) {
+        num_threads = total/MIN_THREAD_ROOTS;
+    }
+
+    if( num_threads <= 1 ) {
+        ComputeSeeds( 0, num_subjects );
+        return;
+    }
 
-    for( subject_ = 0; subject_ < num_subjects; ++subject_ ) {
+    // The roots of each subject are processed independently of other 
+    // subjects, so the seeds are the same as with a single thread.
+    //
+    typedef std::vector< CRef< CSeedsThread > > TThreads;
+    TThreads threads;
+    TDerived * self = static_cast< TDerived * >( this );
+    TSeqNum first = 0;
+    unsigned long roots = 0;
+
+    for( TSeqNum subject = 0; 
+            subject < num_subjects && threads.size() + 1 < num_threads;
+            ++subject ) {
+        roots += roots_.NumSubjRoots( subject );
+
+        if( roots*num_threads >= total*(threads.size() + 1) ) {
+            threads.push_back( CRef< CSeedsThread >( 
+                        new CSeedsThread( self, first, subject + 1 ) ) );
+            first = subject + 1;
+        }
+    }
+
+    for( typename TThreads::iterator i = threads.begin(); 
+            i != threads.end(); ++i ) {
+        (*i)->Run();
+    }
+
+    // This thread computes the seeds of the last range.
+    //
+    std::exception_ptr error;
+    try { ComputeSeeds( first, num_subjects ); }
+    catch( ... ) { error = std::current_exception(); }
+
+    for( typename TThreads::iterator i = threads.begin(); 
+            i != threads.end(); ++i ) {
+        (*i)->Join();
+    }
+
+    if( error ) std::rethrow_exception( error );
+
+    for( typename TThreads::iterator i = threads.begin(); 
+            i != threads.end(); ++i ) {
+        (*i)->CheckError();
+    }
+}
+
+//-------------------------------------------------------------------------
+template< typename index_impl_t, unsigned long NHITS, typename derived_t >
+INLINE
+void CSearch_Base< index_impl_t, NHITS, derived_t >::ComputeSeeds( 
+        TSeqNum first, TSeqNum last )
+{
+    for( subject_ = first; subject_ < last; ++subject_ ) {
         TDerived * self = static_cast< TDerived * >( this );
         self->SetSubjInfo();
         TTrackedSeeds & seeds = seeds_[subject_];
@@ -1255,9 +1412,9 @@ void CSearch_Base< LEGACY, NHITS, derived_t >::ComputeSeeds()
 }
 
 //-------------------------------------------------------------------------
-template< bool LEGACY, unsigned long NHITS, typename derived_t >
+template< typename index_impl_t, unsigned long NHITS, typename derived_t >
 INLINE
-void CSearch_Base< LEGACY, NHITS, derived_t >::SearchInt()
+void CSearch_Base< index_impl_t, NHITS, derived_t >::SearchInt()
 {
     CNmerIterator nmer_it( 
             index_impl_.hkey_width(), query_->sequence, qstart_, qstop_ );
@@ -1305,9 +1462,9 @@ void CSearch_Base< LEGACY, NHITS, derived_t >::SearchInt()
 }
 
 //-------------------------------------------------------------------------
-template< bool LEGACY, unsigned long NHITS, typename derived_t >
+template< typename index_impl_t, unsigned long NHITS, typename derived_t >
 CConstRef< CDbIndex::CSearchResults > 
-CSearch_Base< LEGACY, NHITS, derived_t >::operator()()
+CSearch_Base< index_impl_t, NHITS, derived_t >::operator()()
 {
     const BlastSeqLoc * curloc = locs_;
 
@@ -1346,17 +1503,17 @@ CSearch_Base< LEGACY, NHITS, derived_t >::operator()()
 
 //-------------------------------------------------------------------------
 /** CSearch CRTP (to be removed). */
-template< bool LEGACY, unsigned long NHITS >
+template< typename index_impl_t, unsigned long NHITS >
 class CSearch;
 
 //-------------------------------------------------------------------------
-template< bool LEGACY, unsigned long NHITS >
+template< typename index_impl_t, unsigned long NHITS >
 class CSearch
-    : public CSearch_Base< LEGACY, NHITS, CSearch< LEGACY, NHITS > >
+    : public CSearch_Base< index_impl_t, NHITS, CSearch< index_impl_t, NHITS > >
 {
     /** @name Convenience declarations. */
     /**@{*/
-    typedef CSearch_Base< LEGACY, NHITS, CSearch > TBase;
+    typedef CSearch_Base< index_impl_t, NHITS, CSearch > TBase;
     typedef typename TBase::TIndex_Impl TIndex_Impl;
     typedef typename TBase::TSearchOptions TSearchOptions;
     /**@}*/
@@ -1377,6 +1534,11 @@ class CSearch
             : TBase( index_impl, query, locs, options )
         {}
 
+        /** Worker object constructor.
+            @param master       [I]     the master search object
+        */
+        explicit CSearch( CSearch * master ) : TBase( master ) {}
+
 
         /** Set the parameters of the current subject sequence. */
         void SetSubjInfo()
@@ -1407,33 +1569,49 @@ class CSearch
         }
 };
 
+//-------------------------------------------------------------------------
+/** Run a search against an index implementation of a given type.
+    @param index_impl       [I]     the index implementation object
+    @param query            [I]     query data encoded in BLASTNA
+    @param locs             [I]     set of query locations to search
+    @param search_options   [I]     search options
+    @return the search results
+*/
+template< typename index_impl_t >
+static CConstRef< CDbIndex::CSearchResults > s_Search(
+        const index_impl_t & index_impl,
+        const BLAST_SequenceBlk * query, const BlastSeqLoc * locs,
+        const CDbIndex::SSearchOptions & search_options )
+{
+    if( search_options.two_hits == 0 ) {
+        CSearch< index_impl_t, ONE_HIT > searcher(
+                index_impl, query, locs, search_options );
+        return searcher();
+    }
+    else {
+        CSearch< index_impl_t, TWO_HIT > searcher(
+                index_impl, query, locs, search_options );
+        return searcher();
+    }
+}
+
 //-------------------------------------------------------------------------
 CConstRef< CDbIndex::CSearchResults > CDbIndex::Search( 
         const BLAST_SequenceBlk * query, const BlastSeqLoc * locs, 
         const SSearchOptions & search_options )
 {
-    if( search_options.two_hits == 0 )
-        if( header_.legacy_ ) {
-            CSearch< true, ONE_HIT > searcher(
-                    dynamic_cast< CDbIndex_Impl< true > & >(*this), query, locs, search_options );
-            return searcher();
-        }
-        else {
-            CSearch< false, ONE_HIT > searcher(
-                    dynamic_cast< CDbIndex_Impl< false > & >(*this), query, locs, search_options );
-            return searcher();
-        }
+    if( header_.compressed_ )
+        return s_Search( 
+                dynamic_cast< CDbIndex_Impl< false, true > & >(*this), 
+                query, locs, search_options );
+    else if( header_.legacy_ )
+        return s_Search( 
+                dynamic_cast< CDbIndex_Impl< true > & >(*this), 
+                query, locs, search_options );
     else
-        if( header_.legacy_ ) {
-            CSearch< true, TWO_HIT > searcher(
-                    dynamic_cast< CDbIndex_Impl< true > & >(*this), query, locs, search_options );
-            return searcher();
-        }
-        else {
-            CSearch< false, TWO_HIT > searcher(
-                    dynamic_cast< CDbIndex_Impl< false > & >(*this), query, locs, search_options );
-            return searcher();
-        }
+        return s_Search( 
+                dynamic_cast< CDbIndex_Impl< false > & >(*this), 
+                query, locs, search_options );
 }
 
 END_SCOPE( blastdbindex )
@@ -61,6 +61,30 @@ USING_SCOPE( blastdbindex );
 const char * const CMkIndexApplication::USAGE_LINE = 
     "Create a BLAST database index.";
 
+//------------------------------------------------------------------------------
+/** Save the index superheader.
+    @param fname        [I]     superheader file name
+    @param num_seq      [I]     number of sequences in the index
+    @param num_vol      [I]     number of index volumes
+    @param compressed   [I]     the index has compressed offset lists
+*/
+static void SaveSuperHeader( 
+        const string & fname, Uint4 num_seq, Uint4 num_vol, bool compressed )
+{
+    if( compressed ) {
+        CIndexSuperHeader< 
+            CIndexSuperHeader_Base::INDEX_FORMAT_VERSION_2 > shdr(
+                    num_seq, num_vol );
+        shdr.Save( fname );
+    }
+    else {
+        CIndexSuperHeader< 
+            CIndexSuperHeader_Base::INDEX_FORMAT_VERSION_1 > shdr(
+                    num_seq, num_vol );
+        shdr.Save( fname );
+    }
+}
+
 //------------------------------------------------------------------------------
 void CMkIndexApplication::Init()
 {
@@ -85,6 +109,11 @@ void CMkIndexApplication::Init()
             "legacy", "use_legacy_index_format",
             "use legacy (0-terminated offset lists) dbindex format",
             CArgDescriptions::eBoolean, "true" );
+    arg_desc->AddDefaultKey(
+            "compress", "compress_offset_lists",
+            "store offset lists in compressed form "
+            "(implies non-legacy index format)",
+            CArgDescriptions::eBoolean, "false" );
     arg_desc->AddDefaultKey(
             "idmap", "generate_idmap",
             "generate id map for the sequences in the index",
@@ -118,6 +147,10 @@ void CMkIndexApplication::Init()
             "stride", "stride",
             "distance between stored database positions",
             CArgDescriptions::eInteger );
+    arg_desc->AddDefaultKey(
+            "num_threads", "num_threads",
+            "number of threads used to build the offset lists",
+            CArgDescriptions::eInteger, "1" );
     arg_desc->AddDefaultKey(
             "old_style_index", "boolean",
             "Use old style index (deprecated)",
@@ -134,6 +167,9 @@ void CMkIndexApplication::Init()
     arg_desc->SetConstraint(
             "stride",
             new CArgAllow_Integers( 1, kMax_Int ) );
+    arg_desc->SetConstraint(
+            "num_threads",
+            new CArgAllow_Integers( 1, kMax_Int ) );
     arg_desc->SetConstraint(
             "ws_hint",
             new CArgAllow_Integers( 1, kMax_Int ) );
@@ -176,6 +212,9 @@ int CMkIndexApplication::Run()
 
     options.legacy = GetArgs()["legacy"].AsBoolean();
     options.idmap  = GetArgs()["idmap"].AsBoolean();
+    options.compressed = GetArgs()["compress"].AsBoolean();
+    options.num_threads = GetArgs()["num_threads"].AsInteger();
+    if( options.compressed ) options.legacy = false;
 
     if( GetArgs()["stride"] ) {
         if( options.legacy ) {
@@ -334,10 +373,9 @@ int CMkIndexApplication::Run()
                 return 1;
             }
 
-            CIndexSuperHeader< 
-                CIndexSuperHeader_Base::INDEX_FORMAT_VERSION_1 > shdr( 
-                        num_seq, num_vol );
-            shdr.Save( dbv_name + ".shd" );
+            SaveSuperHeader( 
+                    dbv_name + ".shd", num_seq, num_vol, 
+                    options.compressed );
             ERR_POST( Info << 
                       "index generated for BLAST database volume " <<
                       dbv_name << " with " << num_seq << " sequences" );
@@ -368,10 +406,8 @@ int CMkIndexApplication::Run()
     }while( start != stop );
 
     if( !old_style ) {
-        CIndexSuperHeader< 
-            CIndexSuperHeader_Base::INDEX_FORMAT_VERSION_1 > shdr(
-                    num_seq, num_vol );
-        shdr.Save( ofname_base + ".shd" );
+        SaveSuperHeader( 
+                ofname_base + ".shd", num_seq, num_vol, options.compressed );
     }
 
     return 0;
@@ -0,0 +1,317 @@
+/*  $Id$
+ * ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+/** @file dbindex_perf.cpp
+ * Command line tool to compare the size and the seed search speed of
+ * plain and compressed megablast database indices.
+ */
+
+#include <ncbi_pch.hpp>
+#include <corelib/ncbiapp.hpp>
+#include <corelib/ncbifile.hpp>
+#include <corelib/ncbitime.hpp>
+#include <util/random_gen.hpp>
+#include <algo/blast/core/blast_encoding.h>
+#include <algo/blast/core/blast_filter.h>
+#include <algo/blast/dbindex/dbindex.hpp>
+#include <algo/blast/dbindex/dbindex_sp.hpp>
+#include <algo/blast/dbindex/sequence_istream_fasta.hpp>
+
+#ifndef SKIP_DOXYGEN_PROCESSING
+USING_NCBI_SCOPE;
+USING_SCOPE(blastdbindex);
+#endif
+
+/// The application class
+class CDbIndexPerfApp : public CNcbiApplication
+{
+public:
+    /** @inheritDoc */
+    CDbIndexPerfApp() {}
+
+private:
+    /** @inheritDoc */
+    virtual void Init();
+    /** @inheritDoc */
+    virtual int Run();
+
+    /// Queries in BLASTNA encoding, with a sentinel at each end
+    typedef vector< vector<Uint1> > TQueries;
+
+    /// Make the queries out of mutated pieces of the input sequences
+    void x_MakeQueries();
+
+    /// Build the index volumes for the input and search them with the
+    /// queries, reporting the index size and the seed search rate
+    /// @param compressed build the index with compressed offset lists
+    void x_Measure(bool compressed);
+
+    /// Search one index volume with all queries
+    /// @param index the index volume
+    /// @return number of seeds found
+    template <typename TIndex>
+    Uint8 x_Search(TIndex& index) const;
+
+    /// The queries
+    TQueries m_Queries;
+};
+
+void CDbIndexPerfApp::x_MakeQueries()
+{
+    const CArgs& args = GetArgs();
+    const size_t kQueryLength = args["query_length"].AsInteger();
+    CNcbiIfstream in(args["in"].AsString().c_str());
+    vector<string> seqs;
+    string line;
+
+    while (NcbiGetlineEOL(in, line)) {
+        if ( !line.empty() && line[0] == '>' ) {
+            seqs.push_back(kEmptyStr);
+        } else if ( !seqs.empty() ) {
+            seqs.back() += line;
+        }
+    }
+
+    vector<const string*> long_seqs;
+    ITERATE(vector<string>, seq, seqs) {
+        if (seq->size() > kQueryLength) {
+            long_seqs.push_back(&*seq);
+        }
+    }
+
+    if (long_seqs.empty()) {
+        NCBI_THROW(CException, eInvalid,
+                   "No input sequence is longer than -query_length");
+    }
+
+    CRandom rnd(1);
+
+    for (int i = 0; i < args["num_queries"].AsInteger(); ++i) {
+        const string& seq =
+            *long_seqs[rnd.GetRand(0, (CRandom::TValue)long_seqs.size() - 1)];
+        size_t from =
+            rnd.GetRand(0, (CRandom::TValue)(seq.size() - kQueryLength));
+        vector<Uint1> query(1, kNuclSentinel);
+
+        for (size_t j = from; j < from + kQueryLength; ++j) {
+            char c = toupper((unsigned char)seq[j]);
+
+            // 2% substitutions
+            if (rnd.GetRand(0, 99) < 2) {
+                c = "ACGT"[rnd.GetRand(0, 3)];
+            }
+
+            switch (c) {
+            case 'A': query.push_back(0); break;
+            case 'C': query.push_back(1); break;
+            case 'G': query.push_back(2); break;
+            case 'T': query.push_back(3); break;
+            default:  query.push_back(14); break;
+            }
+        }
+
+        query.push_back(kNuclSentinel);
+        m_Queries.push_back(query);
+    }
+}
+
+template <typename TIndex>
+Uint8 CDbIndexPerfApp::x_Search(TIndex& index) const
+{
+    const CArgs& args = GetArgs();
+    CDbIndex::SSearchOptions search_options = {
+        (unsigned long)args["word_size"].AsInteger(), 0,
+        (unsigned long)args["num_threads"].AsInteger()
+    };
+    Uint8 retval = 0;
+
+    ITERATE(TQueries, query, m_Queries) {
+        BLAST_SequenceBlk query_blk;
+        memset(&query_blk, 0, sizeof(query_blk));
+        query_blk.sequence = const_cast<Uint1*>(&(*query)[1]);
+        query_blk.length = (Int4)(query->size() - 2);
+
+        BlastSeqLoc* locs = NULL;
+        BlastSeqLocNew(&locs, 0, query_blk.length - 1);
+        CConstRef<CDbIndex::CSearchResults> results =
+            index.Search(&query_blk, locs, search_options);
+        BlastSeqLocFree(locs);
+
+        for (CDbIndex::TSeqNum i = 1; i <= index.NumChunks(); ++i) {
+            const BlastInitHitList* hits = results->GetResults(i);
+            if (hits != NULL) {
+                retval += hits->total;
+            }
+        }
+    }
+
+    return retval;
+}
+
+void CDbIndexPerfApp::x_Measure(bool compressed)
+{
+    const CArgs& args = GetArgs();
+    const string kBase = args["out"].AsString() +
+        (compressed ? ".compressed" : ".plain");
+
+    CDbIndex::SOptions options = CDbIndex::DefaultSOptions();
+    options.legacy = false;
+    options.compressed = compressed;
+    options.report_level = REPORT_QUIET;
+    options.max_index_size = args["volsize"].AsInteger();
+    options.num_threads = args["num_threads"].AsInteger();
+    options.ws_hint = args["word_size"].AsInteger();
+
+    CStopWatch sw(CStopWatch::eStart);
+    CSequenceIStreamFasta input(args["in"].AsString());
+    vector<string> volumes;
+    CDbIndex::TSeqNum start, stop = 0;
+
+    do {
+        start = stop;
+        stop = kMax_UI4;
+        string name = kBase + "." +
+            NStr::SizetToString(volumes.size()) + ".idx";
+        CDbIndex::MakeIndex(input, name, start, stop, options);
+
+        if (start != stop) {
+            volumes.push_back(name);
+        }
+    } while (start != stop);
+
+    double build_time = sw.Elapsed();
+    Uint8 index_size = 0;
+    Uint8 num_seeds = 0;
+
+    ITERATE(vector<string>, volume, volumes) {
+        index_size += CFile(*volume).GetLength();
+    }
+
+    sw.Restart();
+
+    ITERATE(vector<string>, volume, volumes) {
+        CRef<CDbIndex> index = CDbIndex::Load(*volume);
+
+        if (compressed) {
+            num_seeds += x_Search(
+                    dynamic_cast<CDbIndex_Impl<false, true>&>(*index));
+        } else {
+            num_seeds += x_Search(
+                    dynamic_cast<CDbIndex_Impl<false, false>&>(*index));
+        }
+    }
+
+    double search_time = sw.Elapsed();
+
+    ITERATE(vector<string>, volume, volumes) {
+        CFile(*volume).Remove();
+    }
+
+    cout << (compressed ? "Compressed" : "Plain") << " index: "
+         << NStr::UInt8ToString_DataSize(index_size) << " in "
+         << volumes.size() << " volume(s), built in "
+         << NStr::DoubleToString(build_time, 2) << " s" << endl;
+    cout << "    " << m_Queries.size() << " queries, "
+         << NStr::UInt8ToString(num_seeds, NStr::fWithCommas)
+         << " seeds in " << NStr::DoubleToString(search_time, 2) << " s: "
+         << NStr::UInt8ToString((Uint8)(num_seeds / search_time),
+                                NStr::fWithCommas) << " seeds/second, "
+         << NStr::DoubleToString(m_Queries.size() / search_time, 1)
+         << " queries/second" << endl;
+}
+
+void CDbIndexPerfApp::Init()
+{
+    HideStdArgs(fHideConffile | fHideFullVersion | fHideXmlHelp | fHideDryRun);
+
+    unique_ptr<CArgDescriptions> arg_desc(new CArgDescriptions);
+
+    arg_desc->SetUsageContext(GetArguments().GetProgramBasename(),
+                  "Compare plain and compressed megablast database indices");
+
+    arg_desc->SetCurrentGroup("Index options");
+    arg_desc->AddKey("in", "fasta_file", "Nucleotide FASTA input",
+                     CArgDescriptions::eInputFile);
+    arg_desc->AddDefaultKey("out", "index_name",
+                            "Base name of the index files, which are "
+                            "removed when done",
+                            CArgDescriptions::eString, "dbindex_perf");
+    arg_desc->AddDefaultKey("volsize", "volume_size",
+                            "Maximum index volume size in megabytes",
+                            CArgDescriptions::eInteger, "1536");
+    arg_desc->SetConstraint("volsize", new CArgAllow_Integers(1, kMax_Int));
+
+    arg_desc->SetCurrentGroup("Search options");
+    arg_desc->AddDefaultKey("num_queries", "number",
+                            "Number of queries taken from the input",
+                            CArgDescriptions::eInteger, "1000");
+    arg_desc->SetConstraint("num_queries",
+                            new CArgAllow_Integers(1, kMax_Int));
+    arg_desc->AddDefaultKey("query_length", "length",
+                            "Length of the queries",
+                            CArgDescriptions::eInteger, "500");
+    arg_desc->SetConstraint("query_length",
+                            new CArgAllow_Integers(28, kMax_Int));
+    arg_desc->AddDefaultKey("word_size", "word_size",
+                            "Seed length, also used as the index word "
+                            "size hint",
+                            CArgDescriptions::eInteger, "28");
+    arg_desc->SetConstraint("word_size", new CArgAllow_Integers(16, 32));
+    arg_desc->AddDefaultKey("num_threads", "number",
+                            "Number of threads building and searching "
+                            "the index",
+                            CArgDescriptions::eInteger, "1");
+    arg_desc->SetConstraint("num_threads", new CArgAllow_Integers(1, kMax_Int));
+
+    SetupArgDescriptions(arg_desc.release());
+}
+
+int CDbIndexPerfApp::Run(void)
+{
+    int status = 0;
+
+    try {
+        x_MakeQueries();
+        x_Measure(false);
+        x_Measure(true);
+    } catch (const exception& e) {
+        ERR_POST(Error << "Error: " << e.what());
+        status = 1;
+    } catch (...) {
+        cerr << "Unknown exception!" << endl;
+        status = 1;
+    }
+
+    return status;
+}
+
+#ifndef SKIP_DOXYGEN_PROCESSING
+int main(int argc, const char* argv[] /*, const char* envp[]*/)
+{
+    return CDbIndexPerfApp().AppMain(argc, argv);
+}
+#endif /* SKIP_DOXYGEN_PROCESSING */
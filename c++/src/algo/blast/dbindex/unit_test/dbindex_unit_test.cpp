@@ -0,0 +1,446 @@
+/*  $Id$
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+* File Description:
+*   Unit tests for the megablast database index library.
+*
+* ===========================================================================
+*/
+
+#define NCBI_TEST_APPLICATION
+#include <ncbi_pch.hpp>
+
+#include <corelib/ncbifile.hpp>
+#include <corelib/ncbistre.hpp>
+#include <util/random_gen.hpp>
+
+#include <algo/blast/core/blast_encoding.h>
+#include <algo/blast/core/blast_filter.h>
+#include <algo/blast/dbindex/dbindex.hpp>
+#include <algo/blast/dbindex/dbindex_sp.hpp>
+#include <algo/blast/dbindex/sequence_istream_fasta.hpp>
+
+#include <corelib/test_boost.hpp>
+
+USING_NCBI_SCOPE;
+USING_SCOPE(blastdbindex);
+
+/// Index volume files and the sequence ranges they hold.  The files are
+/// removed with the object.
+struct SIndexVolumes
+{
+    ~SIndexVolumes()
+    {
+        ITERATE (vector<string>, it, names) {
+            CFile(*it).Remove();
+        }
+    }
+
+    vector< string > names;                 ///< Names of the volume files.
+    vector< CDbIndex::TSeqNum > stops;      ///< Sequence ranges ends.
+};
+
+/// Random sequences with lower case and ambiguous stretches, and with
+/// sequences longer than the chunk size.
+static vector<string> s_MakeSequences(int num_seqs, int seq_len,
+                                      CRandom::TValue seed)
+{
+    static const char kNucl[] = "ACGT";
+    CRandom rnd(seed);
+    vector<string> result;
+
+    for (int i = 0; i < num_seqs; ++i) {
+        int len = seq_len + (i % 10 == 0 ? 2*seq_len : 0);
+        string seq;
+
+        for (int j = 0; j < len; ++j) {
+            seq += kNucl[rnd.GetRand(0, 3)];
+        }
+
+        if (i % 7 == 0) {
+            seq.replace(len/3, 200, string(200, 'N'));
+        }
+
+        if (i % 5 == 0) {
+            seq.replace(len/2, 300, string(300, 'a'));
+        }
+
+        result.push_back(seq);
+    }
+
+    return result;
+}
+
+static string s_MakeFastaData(const vector<string>& seqs)
+{
+    string result;
+
+    for (size_t i = 0; i < seqs.size(); ++i) {
+        result += ">lcl|seq" + NStr::SizetToString(i) + "\n";
+
+        for (size_t j = 0; j < seqs[i].size(); j += 80) {
+            result += seqs[i].substr(j, 80) + "\n";
+        }
+    }
+
+    return result;
+}
+
+/// Build the index volumes the way makembindex does.
+static void s_MakeIndex(const string& fasta,
+                        const CDbIndex::SOptions& options,
+                        SIndexVolumes& volumes)
+{
+    CNcbiIstrstream is(fasta);
+    CSequenceIStreamFasta input(is);
+    CDbIndex::TSeqNum start, stop = 0;
+
+    do {
+        start = stop;
+        stop = kMax_UI4;
+        string fname = CDirEntry::GetTmpName();
+        CDbIndex::MakeIndex(input, fname, start, stop, options);
+
+        if (start != stop) {
+            volumes.names.push_back(fname);
+            volumes.stops.push_back(stop);
+        }
+    } while (start != stop);
+}
+
+static string s_ReadFile(const string& fname)
+{
+    CNcbiIfstream is(fname.c_str(), IOS_BASE::binary);
+    CNcbiOstrstream os;
+    NcbiStreamCopy(os, is);
+    return CNcbiOstrstreamToString(os);
+}
+
+static CDbIndex::SOptions s_GetOptions(bool compressed)
+{
+    CDbIndex::SOptions options = CDbIndex::DefaultSOptions();
+    options.legacy = false;
+    options.compressed = compressed;
+    options.stride = 5;
+    options.ws_hint = 12;
+    options.hkey_width = 8;
+    options.chunk_size = 8000;
+    options.report_level = REPORT_QUIET;
+    options.max_index_size = 1;
+    return options;
+}
+
+/// Index files built on several threads must be byte-identical to the
+/// ones built on one thread.  The volume size limit forces rollbacks, so
+/// that the truncation of the threaded offset lists is exercised too.
+static void s_CheckThreadedBuild(bool compressed)
+{
+    string fasta = s_MakeFastaData(s_MakeSequences(400, 5000, 1));
+    CDbIndex::SOptions options = s_GetOptions(compressed);
+
+    SIndexVolumes expected;
+    s_MakeIndex(fasta, options, expected);
+    BOOST_REQUIRE(expected.names.size() > 1);
+
+    options.num_threads = 4;
+    SIndexVolumes actual;
+    s_MakeIndex(fasta, options, actual);
+    BOOST_REQUIRE_EQUAL(expected.names.size(), actual.names.size());
+
+    for (size_t i = 0; i < expected.names.size(); ++i) {
+        BOOST_CHECK_EQUAL(expected.stops[i], actual.stops[i]);
+        BOOST_CHECK(s_ReadFile(expected.names[i]) == 
+                    s_ReadFile(actual.names[i]));
+    }
+}
+
+/// Decode group varint data the way CCompressedOffsetIterator does, with
+/// either decoder.
+static vector<TWord> s_DecodeGroupVarint(const vector<Uint1>& data,
+                                         bool scalar)
+{
+    const SGroupVarintTables& tables = GetGroupVarintTables();
+    vector<Uint1> padded(data);
+    padded.resize(data.size() + 16, 0xFF);
+    vector<TWord> result;
+    size_t pos = 0;
+
+    while (pos < data.size()) {
+        Uint1 ctrl = padded[pos++];
+        TWord values[4];
+#if NCBI_SSE >= 40
+        if ( !scalar ) {
+            DecodeGroupVarintSSE(tables, ctrl, &padded[pos], values);
+        } else
+#endif
+        DecodeGroupVarintScalar(ctrl, &padded[pos], values);
+        result.insert(result.end(), values, values + 4);
+        pos += tables.length[ctrl];
+    }
+
+    BOOST_CHECK_EQUAL(pos, data.size());
+    return result;
+}
+
+/// Offset lists of an index volume, for all Nmers, as seen through the
+/// offset iterators with the given word size.  Each pass over a list is
+/// terminated with kMax_UI4.  Empty passes at the end of a list are
+/// dropped: the 0 terminator of a plain list ends all remaining passes,
+/// while a compressed list goes through them.
+template <typename TIndex>
+static void s_GetOffsetLists(const TIndex& index, unsigned long ws,
+                             vector<TWord>& lists)
+{
+    typedef typename TIndex::TOffsetIterator TIterator;
+    TWord num_nmers = ((TWord)1)<<(2*index.hkey_width());
+
+    for (TWord nmer = 0; nmer < num_nmers; ++nmer) {
+        TIterator it(index.OffsetIterator(nmer, ws));
+        vector<TWord>::size_type start = lists.size();
+
+        while (it.More()) {
+            while (it.Next()) {
+                lists.push_back(it.Offset());
+            }
+
+            lists.push_back(kMax_UI4);
+        }
+
+        while (lists.size() > start + 1 && 
+               lists[lists.size() - 2] == kMax_UI4) {
+            lists.pop_back();
+        }
+    }
+}
+
+/// Seeds found in an index volume, as (chunk, query offset, subject
+/// offset) triples.
+typedef vector< pair<CDbIndex::TSeqNum, pair<Uint4, Uint4> > > TSeeds;
+
+template <typename TIndex>
+static void s_Search(TIndex& index, const vector<Uint1>& query,
+                     const CDbIndex::SSearchOptions& search_options,
+                     TSeeds& seeds)
+{
+    BLAST_SequenceBlk query_blk;
+    memset(&query_blk, 0, sizeof(query_blk));
+    query_blk.sequence = const_cast<Uint1*>(&query[1]);
+    query_blk.length = (Int4)(query.size() - 2);
+
+    BlastSeqLoc* locs = NULL;
+    BlastSeqLocNew(&locs, 0, query_blk.length - 1);
+    CConstRef<CDbIndex::CSearchResults> results =
+        index.Search(&query_blk, locs, search_options);
+    BlastSeqLocFree(locs);
+
+    for (CDbIndex::TSeqNum i = 1; i <= index.NumChunks(); ++i) {
+        BlastInitHitList* hits = results->GetResults(i);
+
+        for (Int4 j = 0; hits != NULL && j < hits->total; ++j) {
+            const BlastOffsetPair& offsets = hits->init_hsp_array[j].offsets;
+            seeds.push_back(make_pair(i, make_pair(offsets.qs_offsets.q_off,
+                                                   offsets.qs_offsets.s_off)));
+        }
+    }
+
+    sort(seeds.begin(), seeds.end());
+}
+
+/// A query in BLASTNA encoding made of mutated pieces of the sequences,
+/// with a sentinel at each end.
+static vector<Uint1> s_MakeQuery(const vector<string>& seqs,
+                                 CRandom::TValue seed)
+{
+    CRandom rnd(seed);
+    vector<Uint1> result(1, kNuclSentinel);
+
+    for (int i = 0; i < 40; ++i) {
+        const string& seq = seqs[rnd.GetRand(0, (CRandom::TValue)seqs.size() - 1)];
+        size_t from = rnd.GetRand(0, (CRandom::TValue)seq.size() - 400);
+
+        for (size_t j = from; j < from + 400; ++j) {
+            char c = toupper((unsigned char)seq[j]);
+
+            if (rnd.GetRand(0, 99) < 3) {
+                c = "ACGT"[rnd.GetRand(0, 3)];
+            }
+
+            switch (c) {
+            case 'A': result.push_back(0); break;
+            case 'C': result.push_back(1); break;
+            case 'G': result.push_back(2); break;
+            case 'T': result.push_back(3); break;
+            default:  result.push_back(14); break;
+            }
+        }
+    }
+
+    result.push_back(kNuclSentinel);
+    return result;
+}
+
+BOOST_AUTO_TEST_SUITE(dbindex)
+
+BOOST_AUTO_TEST_CASE(ThreadedBuildMatchesSingleThread)
+{
+    s_CheckThreadedBuild(false);
+}
+
+BOOST_AUTO_TEST_CASE(ThreadedCompressedBuildMatchesSingleThread)
+{
+    s_CheckThreadedBuild(true);
+}
+
+/// Group varint coding of values of every byte length, of sequences that
+/// do not fill the last group, and of every control byte.  The SSE
+/// decoder, where available, must agree with the scalar one.
+BOOST_AUTO_TEST_CASE(GroupVarintRoundTrip)
+{
+    static const TWord kBoundaries[] = {
+        0, 1, 0xFF, 0x100, 0xFFFF, 0x10000, 0xFFFFFF, 0x1000000, 0xFFFFFFFF
+    };
+    CRandom rnd(1);
+    vector<TWord> values;
+    vector<Uint1> data;
+
+    for (size_t n = 0; n < 20; ++n) {
+        values.assign(kBoundaries, kBoundaries + 
+                      sizeof(kBoundaries)/sizeof(kBoundaries[0]));
+
+        for (size_t i = 0; i < n; ++i) {
+            values.push_back(rnd.GetRand() >> (8*rnd.GetRand(0, 3)));
+        }
+
+        EncodeGroupVarint(values, data);
+        vector<TWord> expected(values);
+        expected.resize((values.size() + 3)/4*4, 0);
+
+        BOOST_CHECK(s_DecodeGroupVarint(data, true) == expected);
+        BOOST_CHECK(s_DecodeGroupVarint(data, false) == expected);
+    }
+
+    // Every control byte with arbitrary value bytes
+    for (unsigned int ctrl = 0; ctrl < 256; ++ctrl) {
+        data.assign(1, (Uint1)ctrl);
+
+        for (size_t i = 0; i < GetGroupVarintTables().length[ctrl]; ++i) {
+            data.push_back((Uint1)rnd.GetRand(0, 255));
+        }
+
+        vector<TWord> decoded = s_DecodeGroupVarint(data, true);
+        BOOST_CHECK(s_DecodeGroupVarint(data, false) == decoded);
+
+        EncodeGroupVarint(decoded, data);
+        BOOST_CHECK(s_DecodeGroupVarint(data, true) == decoded);
+    }
+}
+
+/// Compressed offset lists must hold the same words, in the same passes,
+/// as the plain ones, for every word size the index supports.  With the
+/// word size hint of 28 each list has four passes, and the sequence and
+/// ambiguity boundaries add special offsets to the lists.  The short hash
+/// keys make the lists long enough for the compression to pay off.
+BOOST_AUTO_TEST_CASE(CompressedListsMatchPlainLists)
+{
+    string fasta = s_MakeFastaData(s_MakeSequences(100, 5000, 2));
+    CDbIndex::SOptions options = s_GetOptions(false);
+    options.ws_hint = 28;
+    options.hkey_width = 6;
+    options.max_index_size = 4;
+
+    SIndexVolumes plain, compressed;
+    s_MakeIndex(fasta, options, plain);
+    options.compressed = true;
+    s_MakeIndex(fasta, options, compressed);
+    BOOST_REQUIRE_EQUAL(plain.names.size(), compressed.names.size());
+
+    for (size_t i = 0; i < plain.names.size(); ++i) {
+        CRef<CDbIndex> plain_index = CDbIndex::Load(plain.names[i]);
+        CRef<CDbIndex> compressed_index = CDbIndex::Load(compressed.names[i]);
+        const CDbIndex_Impl<false, false>* plain_impl =
+            dynamic_cast<const CDbIndex_Impl<false, false>*>(
+                    plain_index.GetPointer());
+        const CDbIndex_Impl<false, true>* compressed_impl =
+            dynamic_cast<const CDbIndex_Impl<false, true>*>(
+                    compressed_index.GetPointer());
+        BOOST_REQUIRE(plain_impl != NULL);
+        BOOST_REQUIRE(compressed_impl != NULL);
+        BOOST_CHECK(CFile(compressed.names[i]).GetLength() <
+                    CFile(plain.names[i]).GetLength());
+
+        for (unsigned long ws = 12; ws <= 28; ws += 4) {
+            vector<TWord> expected, actual;
+            s_GetOffsetLists(*plain_impl, ws, expected);
+            s_GetOffsetLists(*compressed_impl, ws, actual);
+            BOOST_CHECK(expected.size() > 0);
+            BOOST_CHECK(expected == actual);
+        }
+    }
+}
+
+/// Searches of plain and compressed indices must find the same seeds.
+BOOST_AUTO_TEST_CASE(CompressedIndexSearchMatchesPlainIndex)
+{
+    vector<string> seqs = s_MakeSequences(200, 5000, 3);
+    string fasta = s_MakeFastaData(seqs);
+    vector<Uint1> query = s_MakeQuery(seqs, 4);
+    CDbIndex::SOptions options = s_GetOptions(false);
+    options.ws_hint = 20;
+
+    SIndexVolumes plain, compressed;
+    s_MakeIndex(fasta, options, plain);
+    options.compressed = true;
+    s_MakeIndex(fasta, options, compressed);
+    BOOST_REQUIRE(plain.names.size() > 1);
+    BOOST_REQUIRE_EQUAL(plain.names.size(), compressed.names.size());
+
+    static const CDbIndex::SSearchOptions kSearchOptions[] = {
+        { 12, 0, 1 }, { 16, 0, 1 }, { 20, 0, 1 }, { 16, 64, 1 }, { 16, 0, 4 }
+    };
+
+    for (size_t i = 0; i < plain.names.size(); ++i) {
+        CRef<CDbIndex> plain_index = CDbIndex::Load(plain.names[i]);
+        CRef<CDbIndex> compressed_index = CDbIndex::Load(compressed.names[i]);
+        CDbIndex_Impl<false, false>* plain_impl =
+            dynamic_cast<CDbIndex_Impl<false, false>*>(
+                    plain_index.GetPointer());
+        CDbIndex_Impl<false, true>* compressed_impl =
+            dynamic_cast<CDbIndex_Impl<false, true>*>(
+                    compressed_index.GetPointer());
+        BOOST_REQUIRE(plain_impl != NULL);
+        BOOST_REQUIRE(compressed_impl != NULL);
+
+        for (size_t j = 0; 
+             j < sizeof(kSearchOptions)/sizeof(kSearchOptions[0]); ++j) {
+            TSeeds expected, actual;
+            s_Search(*plain_impl, query, kSearchOptions[j], expected);
+            s_Search(*compressed_impl, query, kSearchOptions[j], actual);
+            BOOST_CHECK(expected.size() > 0);
+            BOOST_CHECK(expected == actual);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -34,14 +34,47 @@
 #include <algo/blast/format/blast_async_format.hpp>
 
 
-// Global mutex
-CFastMutex blastProcessGuard;
-
-
 USING_NCBI_SCOPE;
 USING_SCOPE(objects);
 USING_SCOPE(blast);
 
+/// Print all results of a batch with their formatters
+static void
+s_FormatBatch(vector<SFormatResultValues>& values)
+{
+	NON_CONST_ITERATE(vector<SFormatResultValues>, vecitr, values)
+	{
+		ITERATE(CSearchResultSet, result, *((*vecitr).blastResults))
+			(*vecitr).formatter->PrintOneResultSet(**result, (*vecitr).qVec);
+	}
+}
+
+/// Thread formatting buffered batches for a CBlastAsyncFormatThread
+class CBlastFormatWorkerThread : public CThread
+{
+public:
+	CBlastFormatWorkerThread(CBlastAsyncFormatThread& owner) : m_Owner(owner) {}
+
+protected:
+	virtual ~CBlastFormatWorkerThread(void) {}
+
+	virtual void* Main(void)
+	{
+		m_Owner.x_FormatBufferedBatches();
+		return (void*) NULL;
+	}
+private:
+	CBlastAsyncFormatThread& m_Owner;
+};
+
+CBlastAsyncFormatThread::CBlastAsyncFormatThread(int num_threads,
+                                                 CNcbiOstream* out,
+                                                 int max_pending)
+	: m_ResultsMap(), m_Done(false), m_NumThreads(max(num_threads, 1)),
+	  m_Out(out), m_MaxPending(max(max_pending, 0)), m_NextBatch(0)
+{
+}
+
 CBlastAsyncFormatThread::~CBlastAsyncFormatThread()
 {
 }
@@ -50,84 +83,170 @@ void
 CBlastAsyncFormatThread::QueueResults(int batchNumber,
 	vector<SFormatResultValues> results)
 {
+	bool buffered = !results.empty();
+	ITERATE(vector<SFormatResultValues>, itr, results) {
+		if ( !itr->buffer ) {
+			buffered = false;
+			break;
+		}
+	}
+	if (buffered && m_Out == NULL) {
+		NCBI_THROW(CException, eInvalid,
+		           "Buffered results queued without an output stream");
+	}
+
+	CFastMutexGuard guard(m_Mutex);
 	if (m_Done == true)
 		NCBI_THROW(CException, eUnknown, "QueueResults called after Finalize");
-        if (m_ResultsMap.find(batchNumber) != m_ResultsMap.end())
-        {
+	if (m_ResultsMap.find(batchNumber) != m_ResultsMap.end() ||
+	    batchNumber < m_NextBatch)
+	{
 		string message = "Duplicate batchNumber entered: " + NStr::NumericToString(batchNumber);
-		NCBI_THROW(CException, eUnknown, "message");
+		NCBI_THROW(CException, eUnknown, message);
 	}
-	blastProcessGuard.Lock();
-	m_ResultsMap.insert(std::pair<int, vector<SFormatResultValues>>(batchNumber, results));
-	blastProcessGuard.Unlock();
-	m_Semaphore.Post();
+	// Keep the searchers from running too far ahead of the output; the
+	// next batch to print is never held back.
+	while (m_MaxPending > 0 && batchNumber - m_NextBatch >= m_MaxPending) {
+		m_Event.WaitForSignal(m_Mutex);
+	}
+	SBatch& batch = m_ResultsMap[batchNumber];
+	batch.values.swap(results);
+	batch.buffered = buffered;
+	batch.state = eQueued;
+	m_Event.SignalAll();
 }
 
 
 void 
 CBlastAsyncFormatThread::Finalize()
 {
-	blastProcessGuard.Lock();
-        m_Done=true;
-	blastProcessGuard.Unlock();
-	m_Semaphore.Post();
+	CFastMutexGuard guard(m_Mutex);
+	m_Done=true;
+	m_Event.SignalAll();
 }
 
 void
 CBlastAsyncFormatThread::Join()
 {
-	if(m_Done == false)
-		Finalize();
-
+	Finalize();
 	CThread::Join();	
+	if ( !m_Error.empty() )
+		NCBI_THROW(CException, eUnknown, m_Error);
 }
 
+void
+CBlastAsyncFormatThread::x_FormatBatch(int batch_number,
+                                       vector<SFormatResultValues>& values)
+{
+	string error;
+	try {
+		s_FormatBatch(values);
+	} catch (const CException& e) {
+		error = e.GetMsg();
+	} catch (const exception& e) {
+		error = e.what();
+	} catch (...) {
+		error = "unknown exception";
+	}
+	if (error.empty())
+		return;
+
+	error = "Formatting of batch " + NStr::IntToString(batch_number) +
+	        " failed: " + error;
+	ERR_POST(Error << error);
+	CFastMutexGuard guard(m_Mutex);
+	if (m_Error.empty())
+		m_Error = error;
+}
 
-void* CBlastAsyncFormatThread::Main(void)
+void
+CBlastAsyncFormatThread::x_FormatBufferedBatches()
 {
-	const int kVecSize=5000;  // Large array so we should not wrap around.
-	vector<vector<SFormatResultValues>> results_v;
-	results_v.resize(kVecSize);
-	int currNum=0;
-	int lastNum=0;
 	while (1)
 	{
-		m_Semaphore.Wait();
-		blastProcessGuard.Lock();  
-		for(std::map<int, vector<SFormatResultValues>>::iterator itr=m_ResultsMap.begin(); itr != m_ResultsMap.end(); itr++)
-        	{
-			if (itr->first < currNum)
-				continue;
-			else if (itr->first > currNum)
+		std::map<int, SBatch>::iterator itr;
+		{
+			CFastMutexGuard guard(m_Mutex);
+			while (1)
+			{
+				for (itr = m_ResultsMap.begin(); itr != m_ResultsMap.end(); ++itr) {
+					if (itr->second.buffered && itr->second.state == eQueued)
+						break;
+				}
+				if (itr != m_ResultsMap.end() || m_Done)
+					break;
+				m_Event.WaitForSignal(m_Mutex);
+			}
+			if (itr == m_ResultsMap.end())
 				break;
-
-               		results_v[currNum%kVecSize].swap(itr->second);
-			currNum++;
+			itr->second.state = eFormatting;
 		}
-		blastProcessGuard.Unlock();
 
-		for (int index=lastNum; index<currNum; ++index)
-		{
-               		for(vector<SFormatResultValues>::iterator vecitr=results_v[index%kVecSize].begin(); 
-				vecitr != results_v[index%kVecSize].end(); vecitr++)
-                	{
-				ITERATE(CSearchResultSet, result, *((*vecitr).blastResults))
-					(*vecitr).formatter->PrintOneResultSet(**result, (*vecitr).qVec);
-                	}
-			results_v[index%kVecSize].clear();
-        	}
-		lastNum=currNum;
-		if (m_Done == true) // All worker threads done.
+		// Map iterators stay valid while the batch is formatting, as only
+		// formatted batches are erased.
+		x_FormatBatch(itr->first, itr->second.values);
+
+		CFastMutexGuard guard(m_Mutex);
+		itr->second.state = eFormatted;
+		m_Event.SignalAll();
+	}
+}
+
+void* CBlastAsyncFormatThread::Main(void)
+{
+	vector< CRef<CThread> > workers;
+	for (int i = 1; i < m_NumThreads; i++) {
+		CRef<CThread> t(new CBlastFormatWorkerThread(*this));
+		t->Run();
+		workers.push_back(t);
+	}
+
+	while (1)
+	{
+		vector<SFormatResultValues> values;
+		bool buffered = false;
 		{
-			if (m_ResultsMap.size() != currNum)
-			{  // More results that have been loaded but not printed.
-				m_Semaphore.Post();
-				continue;
+			CFastMutexGuard guard(m_Mutex);
+			std::map<int, SBatch>::iterator itr;
+			while ((itr = m_ResultsMap.find(m_NextBatch)) == m_ResultsMap.end() &&
+			       !m_Done) {
+				m_Event.WaitForSignal(m_Mutex);
 			}
-			else
-				break;
+			if (itr == m_ResultsMap.end())
+				break;  // All worker threads done.
+
+			SBatch& batch = itr->second;
+			buffered = batch.buffered;
+			if (batch.state == eQueued) {
+				// Nobody has picked it up yet, so format it here; this
+				// also serializes the batches without buffers.
+				batch.state = eFormatting;
+				guard.Release();
+				x_FormatBatch(m_NextBatch, batch.values);
+				guard.Guard(m_Mutex);
+				batch.state = eFormatted;
+			}
+			while (batch.state != eFormatted) {
+				m_Event.WaitForSignal(m_Mutex);
+			}
+			values.swap(batch.values);
+			m_ResultsMap.erase(itr);
+			m_NextBatch++;
+			m_Event.SignalAll();
+		}
+
+		// Copy the formatted buffers to the output in one pass
+		if (buffered) {
+			ITERATE(vector<SFormatResultValues>, vecitr, values) {
+				const string text = CNcbiOstrstreamToString(*vecitr->buffer);
+				m_Out->write(text.data(), text.size());
+			}
+			m_Out->flush();
 		}
 	}
+
+	NON_CONST_ITERATE(vector< CRef<CThread> >, t, workers) {
+		(*t)->Join();
+	}
 	return (void*) NULL;
 }
-
@@ -50,6 +50,7 @@ Author: Jason Papadopoulos
 #include <algo/blast/format/blastxml2_format.hpp>
 #include <algo/blast/format/data4xml2format.hpp>       /* NCBI_FAKE_WARNING */
 #include <algo/blast/format/build_archive.hpp>
+#include <algo/blast/format/blast_hsp_tabular.hpp>
 #include <misc/jsonwrapp/jsonwrapp.hpp>
 #include <objtools/blast/seqdb_reader/seqdb.hpp>   // for CSeqDB
 #include <serial/objostrxml.hpp>
@@ -347,6 +348,20 @@ CBlastFormat::GetDbTotalLength()
 void 
 CBlastFormat::PrintProlog()
 {
+    // BAM can only be written from the HSPs (@sa GetHSPResultsWriter)
+    if (m_FormatType == CFormattingArgs::eSAM && m_HSPSAMWriter.Empty() &&
+        CBlastHSPSAMWriter::IsBAM(m_CustomOutputFormatSpec)) {
+        NCBI_THROW(CInputException, eInvalidInput,
+                   "BAM output is only available for gapped blastn "
+                   "database searches");
+    }
+    if (m_FormatType == CFormattingArgs::eHitTable &&
+        m_HitTableWriter.Empty()) {
+        NCBI_THROW(CInputException, eInvalidInput,
+                   "The binary hit table is only available for gapped "
+                   "blastn and blastp database searches");
+    }
+
     // no header for some output types
     if (m_FormatType >= CFormattingArgs::eXml) {
     	if(m_FormatType == CFormattingArgs::eXml2_S) {
@@ -1103,6 +1118,10 @@ CBlastFormat::WriteArchive(blast::IQueryFactory& queries,
     if(msg.size() > 0) {
     	archive->SetMessages() = msg;
     }
+    if (m_HitTableWriter.NotEmpty()) {
+        m_HitTableWriter->WriteChunk(*archive);
+        return;
+    }
     PrintArchive(archive, m_Outfile);
 }
 
@@ -2217,6 +2236,17 @@ CBlastFormat::PrintEpilog(const blast::CBlastOptions& options)
     	return;
     }
 
+    if (m_FormatType == CFormattingArgs::eHitTable) {
+        if (m_HitTableWriter.NotEmpty()) {
+            m_HitTableWriter->Close();
+        }
+        return;
+    }
+    if (m_FormatType == CFormattingArgs::eSAM && m_HSPSAMWriter.NotEmpty()) {
+        m_HSPSAMWriter->Flush();
+        return;
+    }
+
     if (m_FormatType == CFormattingArgs::eTabularWithComments) {
         CBlastTabularInfo tabinfo(m_Outfile, m_CustomOutputFormatSpec);
         tabinfo.PrintNumProcessed(m_QueriesFormatted);
@@ -2300,6 +2330,61 @@ void CBlastFormat::ResetScopeHistory()
     }
 }
 
+CRef<blast::IBlastHSPResultsWriter>
+CBlastFormat::GetHSPResultsWriter(int num_threads)
+{
+    CRef<blast::IBlastHSPResultsWriter> retval;
+
+    // Only plain tabular and SAM reports and the hit table of gapped blastn
+    // and blastp database searches are rendered from the HSPs; everything
+    // else (including the comment lines of -outfmt 7) is formatted from the
+    // Seq-aligns.
+    if ((m_FormatType != CFormattingArgs::eTabular &&
+         m_FormatType != CFormattingArgs::eCommaSeparatedValues &&
+         m_FormatType != CFormattingArgs::eSAM &&
+         m_FormatType != CFormattingArgs::eHitTable) ||
+        m_IsHTML || m_IsRemoteSearch || m_IsBl2Seq || m_IsDbScan ||
+        m_IsUngappedSearch || m_IsIterative || m_IgOptions.NotEmpty() ||
+        m_QueryRange.NotEmpty() || m_DbName.empty()) {
+        return retval;
+    }
+    const string program = NStr::ToLower(m_Program);
+    if (program != "blastn" && program != "blastp") {
+        return retval;
+    }
+    if (m_FormatType == CFormattingArgs::eHitTable) {
+        m_HitTableWriter.Reset(new CBlastHitTableWriter(m_Outfile));
+        retval.Reset(m_HitTableWriter.GetPointer());
+        return retval;
+    }
+    if (m_FormatType == CFormattingArgs::eSAM) {
+        if (program == "blastn") {
+            m_HSPSAMWriter.Reset(new CBlastHSPSAMWriter(m_Outfile,
+                                                        m_CustomOutputFormatSpec,
+                                                        x_GetSAMProgramInfo(),
+                                                        *m_Scope, m_HitlistSize,
+                                                        num_threads));
+            retval.Reset(m_HSPSAMWriter.GetPointer());
+        }
+        return retval;
+    }
+    if ( !CBlastHSPTabularWriter::CanFormat(m_CustomOutputFormatSpec) ) {
+        return retval;
+    }
+
+    string delim = (m_FormatType == CFormattingArgs::eCommaSeparatedValues)
+        ? "," : "\t";
+    if ( !m_CustomDelim.empty() ) {
+        delim = m_CustomDelim;
+    }
+    retval.Reset(new CBlastHSPTabularWriter(m_Outfile,
+                                            m_CustomOutputFormatSpec,
+                                            delim, m_Scope.GetPointer(),
+                                            m_BelieveQuery,
+                                            m_HitlistSize, num_threads));
+    return retval;
+}
+
 static string s_GetBaseName(const string & baseFile, bool isXML, bool withPath)
 {
 	string dir = kEmptyStr;
@@ -2444,12 +2529,18 @@ void CBlastFormat::x_GenerateJSONMasterFile(void)
 	m_Outfile << "\t]\n}";
 }
 
-void CBlastFormat::x_InitSAMFormatter()
+CSAM_Formatter::SProgramInfo CBlastFormat::x_GetSAMProgramInfo() const
 {
 	CSAM_Formatter::SProgramInfo  pg("0", blast::CBlastVersion().Print(), m_Cmdline);
    	pg.m_Name = m_Program;
+	return pg;
+}
+
+void CBlastFormat::x_InitSAMFormatter()
+{
     m_SamFormatter.reset(new CBlast_SAM_Formatter(m_Outfile, *m_Scope,
-        		                                  m_CustomOutputFormatSpec, pg));
+        		                                  m_CustomOutputFormatSpec,
+        		                                  x_GetSAMProgramInfo()));
 }
 
 bool s_SetCompBasedStats(EProgram program)
@@ -0,0 +1,597 @@
+/* $Id$
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's offical duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*/
+
+/** @file blast_hit_table.cpp
+ * Binary, column-oriented hit table written directly from the HSPs of a
+ * BLAST database search, and read back through a memory mapping.
+*/
+
+#include <ncbi_pch.hpp>
+#include <algo/blast/format/blast_hit_table.hpp>
+#include <algo/blast/core/blast_hits.h>
+#include <algo/blast/core/blast_util.h>
+#include <objects/blast/Blas_get_searc_resul_reply.hpp>
+#include <serial/serial.hpp>
+#include <serial/objostr.hpp>
+
+BEGIN_NCBI_SCOPE
+USING_SCOPE(objects);
+USING_SCOPE(blast);
+
+/// Magic string at the start of a hit table file
+static const char kHitTableMagic[8] = { 'B','L','A','S','T','H','T','\0' };
+/// Marker of the byte order of the numbers in the file
+static const Uint4 kHitTableByteOrder = 0x01020304;
+/// Current version of the format
+static const Uint4 kHitTableVersion = 1;
+/// Alignment of the columns
+static const size_t kColumnAlignment = 8;
+
+/// Size of a column of a chunk
+struct SHitTableColumn {
+    size_t elem_size;       ///< Size of one element
+    Uint8 count;            ///< Number of elements
+};
+
+/// Compute the sizes of the columns of a chunk, in file order
+/// @param header Chunk header [in]
+/// @param columns The column sizes [out]
+static void
+s_GetColumns(const SHitTableChunkHeader& header,
+             vector<SHitTableColumn>& columns)
+{
+    const Uint8 nq = header.num_queries;
+    const Uint8 ns = header.num_subjects;
+    const Uint8 nh = header.num_hsps;
+    const SHitTableColumn kColumns[] = {
+        // queries: first HSP, length, Seq-id
+        { sizeof(Uint4), nq + 1 }, { sizeof(Uint4), nq }, { sizeof(Uint4), nq },
+        // subjects: ordinal id, length, Seq-id
+        { sizeof(Int4), ns }, { sizeof(Uint4), ns }, { sizeof(Uint4), ns },
+        // HSPs: query, subject, context, score, identities, positives,
+        // sum statistics count, composition adjustment
+        { sizeof(Uint4), nh }, { sizeof(Uint4), nh }, { sizeof(Int4), nh },
+        { sizeof(Int4), nh }, { sizeof(Int4), nh }, { sizeof(Int4), nh },
+        { sizeof(Int4), nh }, { sizeof(Int4), nh },
+        // HSPs: e-value, bit score
+        { sizeof(double), nh }, { sizeof(double), nh },
+        // HSPs: query offset, end, frame, subject offset, end, frame
+        { sizeof(Int4), nh }, { sizeof(Int4), nh }, { sizeof(Int4), nh },
+        { sizeof(Int4), nh }, { sizeof(Int4), nh }, { sizeof(Int4), nh },
+        // HSPs: first edit script operation
+        { sizeof(Uint8), nh + 1 },
+        // edit script operations, Seq-id strings, BLAST archive
+        { sizeof(Uint4), header.num_ops },
+        { 1, header.strings_size },
+        { 1, header.archive_size }
+    };
+    columns.assign(kColumns, kColumns + ArraySize(kColumns));
+}
+
+/// Size of a column, including its padding
+static Uint8
+s_PaddedSize(const SHitTableColumn& column)
+{
+    const Uint8 size = column.elem_size * column.count;
+    return (size + kColumnAlignment - 1) / kColumnAlignment * kColumnAlignment;
+}
+
+CBlastHitTableWriter::CBlastHitTableWriter(CNcbiOstream& out)
+    : m_Out(out),
+      m_HeaderWritten(false),
+      m_Program(eBlastTypeUndefined)
+{
+}
+
+string
+CBlastHitTableWriter::x_GetIdString(const list< CRef<CSeq_id> >& ids)
+{
+    CRef<CSeq_id> best = FindBestChoice(ids, CSeq_id::BestRank);
+    return best.Empty() ? kEmptyStr : best->AsFastaString();
+}
+
+Uint4
+CBlastHitTableWriter::x_AddString(const string& str)
+{
+    const Uint4 retval = (Uint4)m_Strings.size();
+    m_Strings.append(str);
+    m_Strings += '\0';
+    return retval;
+}
+
+void
+CBlastHitTableWriter::Write(BlastHSPResults* results,
+                            ILocalQueryData& query_data,
+                            const BLAST_SequenceBlk* /* queries */,
+                            const BlastQueryInfo* /* query_info */,
+                            CSeqDB& seqdb,
+                            EBlastProgramType program)
+{
+    m_Program = program;
+    const int kNumContexts = (int)BLAST_GetNumberOfContexts(program);
+
+    const size_t kNumQueries = query_data.GetNumQueries();
+    for (size_t qi = 0; qi < kNumQueries; qi++) {
+        const Uint4 query_index = (Uint4)m_QueryLength.size();
+        const CSeq_loc* loc = query_data.GetSeq_loc(qi);
+        m_QueryFirstHSP.push_back((Uint4)m_HSPQuery.size());
+        m_QueryLength.push_back((Uint4)query_data.GetSeqLength(qi));
+        m_QueryId.push_back(x_AddString(loc->GetId()->AsFastaString()));
+
+        BlastHitList* hit_list = (results && (int)qi < results->num_queries)
+            ? results->hitlist_array[qi] : NULL;
+        if (hit_list == NULL) {
+            continue;
+        }
+        for (int i = 0; i < hit_list->hsplist_count; i++) {
+            BlastHSPList* hsp_list = hit_list->hsplist_array[i];
+            if (hsp_list == NULL || hsp_list->hspcnt == 0) {
+                continue;
+            }
+
+            Uint4 subject_index;
+            map<int, Uint4>::const_iterator s =
+                m_SubjectIndex.find(hsp_list->oid);
+            if (s != m_SubjectIndex.end()) {
+                subject_index = s->second;
+            } else {
+                // Subjects without (unfiltered) Seq-ids have no Seq-aligns
+                list< CRef<CSeq_id> > ids = seqdb.GetSeqIDs(hsp_list->oid);
+                if (ids.empty()) {
+                    continue;
+                }
+                subject_index = (Uint4)m_SubjectOid.size();
+                m_SubjectIndex[hsp_list->oid] = subject_index;
+                m_SubjectOid.push_back(hsp_list->oid);
+                m_SubjectLength.push_back((Uint4)seqdb.GetSeqLength(hsp_list->oid));
+                m_SubjectId.push_back(x_AddString(x_GetIdString(ids)));
+            }
+
+            Blast_HSPListSortByEvalue(hsp_list);
+            for (int h = 0; h < hsp_list->hspcnt; h++) {
+                const BlastHSP* hsp = hsp_list->hsp_array[h];
+                if (hsp == NULL) {
+                    continue;
+                }
+                m_HSPQuery.push_back(query_index);
+                m_HSPSubject.push_back(subject_index);
+                m_HSPContext.push_back(hsp->context - (int)qi * kNumContexts);
+                m_HSPScore.push_back(hsp->score);
+                m_HSPNumIdent.push_back(hsp->num_ident);
+                m_HSPNumPositives.push_back(hsp->num_positives);
+                m_HSPNum.push_back(hsp->num);
+                m_HSPCompAdjustment.push_back(hsp->comp_adjustment_method);
+                m_HSPEvalue.push_back(hsp->evalue);
+                m_HSPBitScore.push_back(hsp->bit_score);
+                m_HSPQueryOffset.push_back(hsp->query.offset);
+                m_HSPQueryEnd.push_back(hsp->query.end);
+                m_HSPQueryFrame.push_back(hsp->query.frame);
+                m_HSPSubjectOffset.push_back(hsp->subject.offset);
+                m_HSPSubjectEnd.push_back(hsp->subject.end);
+                m_HSPSubjectFrame.push_back(hsp->subject.frame);
+                m_HSPFirstOp.push_back(m_Ops.size());
+                const GapEditScript* esp = hsp->gap_info;
+                for (int k = 0; esp != NULL && k < esp->size; k++) {
+                    m_Ops.push_back(((Uint4)esp->num[k] << 4) |
+                                    (Uint4)esp->op_type[k]);
+                }
+            }
+        }
+    }
+}
+
+void
+CBlastHitTableWriter::x_WriteFileHeader(void)
+{
+    if (m_HeaderWritten) {
+        return;
+    }
+    SHitTableFileHeader header;
+    memcpy(header.magic, kHitTableMagic, sizeof(header.magic));
+    header.byte_order = kHitTableByteOrder;
+    header.version = kHitTableVersion;
+    m_Out.write((const char*)&header, sizeof(header));
+    m_HeaderWritten = true;
+}
+
+/// Write a column followed by its padding
+template <class T>
+static void
+s_WriteColumn(CNcbiOstream& out, const T* data, const SHitTableColumn& column)
+{
+    static const char kPadding[kColumnAlignment] = { 0 };
+    const size_t size = (size_t)(column.elem_size * column.count);
+    if (size > 0) {
+        out.write((const char*)data, size);
+    }
+    out.write(kPadding, (size_t)(s_PaddedSize(column) - size));
+}
+
+void
+CBlastHitTableWriter::WriteChunk(const CBlast4_archive& archive)
+{
+    x_WriteFileHeader();
+
+    // The alignments are what the columns hold
+    CConstRef<CBlast4_archive> shell(&archive);
+    if (archive.GetResults().IsSetAlignments() &&
+        !archive.GetResults().GetAlignments().IsEmpty()) {
+        CRef<CBlast4_archive> copy(new CBlast4_archive);
+        copy->Assign(archive);
+        copy->SetResults().ResetAlignments();
+        shell = copy;
+    }
+    CNcbiOstrstream ostr;
+    ostr << MSerial_AsnBinary << *shell;
+    const string blob = CNcbiOstrstreamToString(ostr);
+
+    m_QueryFirstHSP.push_back((Uint4)m_HSPQuery.size());
+    m_HSPFirstOp.push_back(m_Ops.size());
+
+    SHitTableChunkHeader header;
+    header.size = 0;
+    header.num_queries = (Uint4)m_QueryLength.size();
+    header.num_subjects = (Uint4)m_SubjectOid.size();
+    header.num_hsps = (Uint4)m_HSPQuery.size();
+    header.program = (Uint4)m_Program;
+    header.num_ops = m_Ops.size();
+    header.strings_size = m_Strings.size();
+    header.archive_size = blob.size();
+
+    vector<SHitTableColumn> columns;
+    s_GetColumns(header, columns);
+    header.size = sizeof(header);
+    ITERATE(vector<SHitTableColumn>, column, columns) {
+        header.size += s_PaddedSize(*column);
+    }
+    m_Out.write((const char*)&header, sizeof(header));
+
+    size_t c = 0;
+    s_WriteColumn(m_Out, m_QueryFirstHSP.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_QueryLength.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_QueryId.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_SubjectOid.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_SubjectLength.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_SubjectId.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPQuery.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPSubject.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPContext.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPScore.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPNumIdent.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPNumPositives.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPNum.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPCompAdjustment.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPEvalue.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPBitScore.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPQueryOffset.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPQueryEnd.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPQueryFrame.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPSubjectOffset.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPSubjectEnd.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPSubjectFrame.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_HSPFirstOp.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_Ops.data(), columns[c++]);
+    s_WriteColumn(m_Out, m_Strings.data(), columns[c++]);
+    s_WriteColumn(m_Out, blob.data(), columns[c++]);
+    _ASSERT(c == columns.size());
+
+    m_QueryFirstHSP.clear();
+    m_QueryLength.clear();
+    m_QueryId.clear();
+    m_SubjectOid.clear();
+    m_SubjectLength.clear();
+    m_SubjectId.clear();
+    m_HSPQuery.clear();
+    m_HSPSubject.clear();
+    m_HSPContext.clear();
+    m_HSPScore.clear();
+    m_HSPNumIdent.clear();
+    m_HSPNumPositives.clear();
+    m_HSPNum.clear();
+    m_HSPCompAdjustment.clear();
+    m_HSPEvalue.clear();
+    m_HSPBitScore.clear();
+    m_HSPQueryOffset.clear();
+    m_HSPQueryEnd.clear();
+    m_HSPQueryFrame.clear();
+    m_HSPSubjectOffset.clear();
+    m_HSPSubjectEnd.clear();
+    m_HSPSubjectFrame.clear();
+    m_HSPFirstOp.clear();
+    m_Ops.clear();
+    m_Strings.erase();
+    m_SubjectIndex.clear();
+}
+
+void
+CBlastHitTableWriter::Close(void)
+{
+    x_WriteFileHeader();
+    const Uint8 kEnd = 0;
+    m_Out.write((const char*)&kEnd, sizeof(kEnd));
+    m_Out.flush();
+}
+
+bool
+CBlastHitTableReader::IsHitTable(const string& path)
+{
+    CNcbiIfstream in(path.c_str(), IOS_BASE::in | IOS_BASE::binary);
+    char magic[sizeof(kHitTableMagic)];
+    if ( !in.read(magic, sizeof(magic)) ) {
+        return false;
+    }
+    return memcmp(magic, kHitTableMagic, sizeof(magic)) == 0;
+}
+
+/// Check that the columns of a chunk are consistent, so that the HSPs can
+/// be rebuilt without reading outside of the chunk
+/// @param chunk Columns of the chunk [in]
+/// @param error Message of the exception thrown on failure [in]
+static void
+s_ValidateChunk(const SHitTableChunk& chunk, const string& error)
+{
+    const SHitTableChunkHeader& header = *chunk.header;
+    const Uint4 nq = header.num_queries;
+    const Uint4 ns = header.num_subjects;
+    const Uint4 nh = header.num_hsps;
+
+    // The Seq-id strings are NUL terminated within the string column
+    if (header.strings_size > 0 &&
+        chunk.strings[header.strings_size - 1] != '\0') {
+        NCBI_THROW(CException, eUnknown, error);
+    }
+    for (Uint4 q = 0; q < nq; q++) {
+        if (chunk.query_id[q] >= header.strings_size) {
+            NCBI_THROW(CException, eUnknown, error);
+        }
+    }
+    for (Uint4 s = 0; s < ns; s++) {
+        if (chunk.subject_id[s] >= header.strings_size) {
+            NCBI_THROW(CException, eUnknown, error);
+        }
+    }
+
+    // The HSPs are grouped by query, in query order
+    if (chunk.query_first_hsp[0] != 0 || chunk.query_first_hsp[nq] != nh) {
+        NCBI_THROW(CException, eUnknown, error);
+    }
+    for (Uint4 q = 0; q < nq; q++) {
+        if (chunk.query_first_hsp[q] > chunk.query_first_hsp[q + 1]) {
+            NCBI_THROW(CException, eUnknown, error);
+        }
+        for (Uint4 i = chunk.query_first_hsp[q];
+             i < chunk.query_first_hsp[q + 1]; i++) {
+            if (chunk.hsp_query[i] != q) {
+                NCBI_THROW(CException, eUnknown, error);
+            }
+        }
+    }
+
+    // The edit scripts of the HSPs follow each other
+    if (chunk.hsp_first_op[0] != 0 || chunk.hsp_first_op[nh] != header.num_ops) {
+        NCBI_THROW(CException, eUnknown, error);
+    }
+    for (Uint4 i = 0; i < nh; i++) {
+        if (chunk.hsp_first_op[i] > chunk.hsp_first_op[i + 1] ||
+            chunk.hsp_subject[i] >= ns) {
+            NCBI_THROW(CException, eUnknown, error);
+        }
+        const Uint4 kQuery = chunk.hsp_query[i];
+        const Uint4 kSubject = chunk.hsp_subject[i];
+        if (chunk.hsp_query_offset[i] < 0 ||
+            chunk.hsp_query_offset[i] > chunk.hsp_query_end[i] ||
+            (Uint4)chunk.hsp_query_end[i] > chunk.query_length[kQuery] ||
+            chunk.hsp_subject_offset[i] < 0 ||
+            chunk.hsp_subject_offset[i] > chunk.hsp_subject_end[i] ||
+            (Uint4)chunk.hsp_subject_end[i] > chunk.subject_length[kSubject]) {
+            NCBI_THROW(CException, eUnknown, error);
+        }
+    }
+    for (Uint8 k = 0; k < header.num_ops; k++) {
+        if ((chunk.ops[k] & 0xf) >= eGapAlignInvalid) {
+            NCBI_THROW(CException, eUnknown, error);
+        }
+    }
+}
+
+/// Point to a column of a chunk and advance past it
+template <class T>
+static void
+s_SetColumn(const T*& column, const char*& ptr, const SHitTableColumn& size)
+{
+    column = (const T*)ptr;
+    ptr += s_PaddedSize(size);
+}
+
+CBlastHitTableReader::CBlastHitTableReader(const string& path)
+{
+    m_File.reset(new CMemoryFile(path));
+    const char* data = (const char*)m_File->GetPtr();
+    const Uint8 kFileSize = m_File->GetSize();
+
+    const SHitTableFileHeader* file_header =
+        (const SHitTableFileHeader*)data;
+    if (kFileSize < sizeof(*file_header) ||
+        memcmp(file_header->magic, kHitTableMagic,
+               sizeof(kHitTableMagic)) != 0) {
+        NCBI_THROW(CException, eUnknown, path + " is not a BLAST hit table");
+    }
+    if (file_header->byte_order != kHitTableByteOrder) {
+        NCBI_THROW(CException, eUnknown,
+                   path + " was written on a host with a different byte order");
+    }
+    if (file_header->version != kHitTableVersion) {
+        NCBI_THROW(CException, eUnknown,
+                   "Unsupported BLAST hit table version " +
+                   NStr::UIntToString(file_header->version));
+    }
+
+    const string kTruncated(path + " is truncated or corrupt");
+    Uint8 offset = sizeof(*file_header);
+    while (true) {
+        if (offset + sizeof(Uint8) > kFileSize) {
+            NCBI_THROW(CException, eUnknown, kTruncated);
+        }
+        const SHitTableChunkHeader* header =
+            (const SHitTableChunkHeader*)(data + offset);
+        if (header->size == 0) {
+            break;
+        }
+        if (header->size < sizeof(*header) ||
+            header->size > kFileSize - offset) {
+            NCBI_THROW(CException, eUnknown, kTruncated);
+        }
+
+        vector<SHitTableColumn> columns;
+        s_GetColumns(*header, columns);
+        Uint8 size = sizeof(*header);
+        ITERATE(vector<SHitTableColumn>, column, columns) {
+            // Also keeps the size computations from overflowing
+            if (column->count > header->size / column->elem_size) {
+                NCBI_THROW(CException, eUnknown, kTruncated);
+            }
+            size += s_PaddedSize(*column);
+        }
+        if (size != header->size) {
+            NCBI_THROW(CException, eUnknown, kTruncated);
+        }
+
+        SHitTableChunk chunk;
+        chunk.header = header;
+        const char* ptr = data + offset + sizeof(*header);
+        size_t c = 0;
+        s_SetColumn(chunk.query_first_hsp, ptr, columns[c++]);
+        s_SetColumn(chunk.query_length, ptr, columns[c++]);
+        s_SetColumn(chunk.query_id, ptr, columns[c++]);
+        s_SetColumn(chunk.subject_oid, ptr, columns[c++]);
+        s_SetColumn(chunk.subject_length, ptr, columns[c++]);
+        s_SetColumn(chunk.subject_id, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_query, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_subject, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_context, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_score, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_num_ident, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_num_positives, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_num, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_comp_adjustment_method, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_evalue, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_bit_score, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_query_offset, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_query_end, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_query_frame, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_subject_offset, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_subject_end, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_subject_frame, ptr, columns[c++]);
+        s_SetColumn(chunk.hsp_first_op, ptr, columns[c++]);
+        s_SetColumn(chunk.ops, ptr, columns[c++]);
+        s_SetColumn(chunk.strings, ptr, columns[c++]);
+        s_SetColumn(chunk.archive, ptr, columns[c++]);
+        _ASSERT(c == columns.size());
+        s_ValidateChunk(chunk, kTruncated);
+        m_Chunks.push_back(chunk);
+
+        offset += header->size;
+    }
+}
+
+TSeqAlignVector
+CBlastHitTableReader::GetSeqAligns(size_t index,
+                                   ILocalQueryData& query_data,
+                                   const IBlastSeqInfoSrc& seqinfo_src,
+                                   const CBlastOptions& options,
+                                   vector<TSeqLocInfoVector>& subj_masks) const
+{
+    const SHitTableChunk& chunk = m_Chunks[index];
+    const Uint4 kNumQueries = (Uint4)query_data.GetNumQueries();
+    const Uint4 kNumHSPs = chunk.header->num_hsps;
+    const int kNumContexts =
+        (int)BLAST_GetNumberOfContexts(options.GetProgramType());
+    if (chunk.header->num_queries != kNumQueries) {
+        NCBI_THROW(CException, eUnknown,
+                   "The queries of the BLAST hit table do not match its "
+                   "BLAST archive");
+    }
+
+    BlastHSPResults* results = Blast_HSPResultsNew(kNumQueries);
+    CRef< CStructWrapper<BlastHSPResults> > wrapper
+        (WrapStruct(results, Blast_HSPResultsFree));
+
+    // The HSPs are grouped by query, then by subject; the columns were
+    // validated when the file was opened
+    for (Uint4 first = 0, last = 0; first < kNumHSPs; first = last) {
+        const Uint4 q = chunk.hsp_query[first];
+        const Uint4 s = chunk.hsp_subject[first];
+        for (last = first + 1; last < kNumHSPs &&
+             chunk.hsp_query[last] == q && chunk.hsp_subject[last] == s;
+             last++) ;
+
+        BlastHitList*& hit_list = results->hitlist_array[q];
+        if (hit_list == NULL) {
+            hit_list = Blast_HitListNew(chunk.query_first_hsp[q + 1] -
+                                        chunk.query_first_hsp[q]);
+        }
+        BlastHSPList* hsp_list = Blast_HSPListNew(last - first);
+        hsp_list->oid = chunk.subject_oid[s];
+        hsp_list->query_index = q;
+        for (Uint4 i = first; i < last; i++) {
+            GapEditScript* esp = NULL;
+            const Uint8 kFirstOp = chunk.hsp_first_op[i];
+            const Uint8 kNumOps = chunk.hsp_first_op[i + 1] - kFirstOp;
+            if (kNumOps > 0) {
+                esp = GapEditScriptNew((Int4)kNumOps);
+                for (Uint8 k = 0; k < kNumOps; k++) {
+                    const Uint4 op = chunk.ops[kFirstOp + k];
+                    esp->op_type[k] = (EGapAlignOpType)(op & 0xf);
+                    esp->num[k] = (Int4)(op >> 4);
+                }
+            }
+            BlastHSP* hsp = NULL;
+            Blast_HSPInit(chunk.hsp_query_offset[i], chunk.hsp_query_end[i],
+                          chunk.hsp_subject_offset[i],
+                          chunk.hsp_subject_end[i],
+                          chunk.hsp_query_offset[i],
+                          chunk.hsp_subject_offset[i],
+                          chunk.hsp_context[i] + (int)q * kNumContexts,
+                          (Int2)chunk.hsp_query_frame[i],
+                          (Int2)chunk.hsp_subject_frame[i],
+                          chunk.hsp_score[i], &esp, &hsp);
+            hsp->num_ident = chunk.hsp_num_ident[i];
+            hsp->num_positives = chunk.hsp_num_positives[i];
+            hsp->num = chunk.hsp_num[i];
+            hsp->comp_adjustment_method =
+                chunk.hsp_comp_adjustment_method[i];
+            hsp->evalue = chunk.hsp_evalue[i];
+            hsp->bit_score = chunk.hsp_bit_score[i];
+            Blast_HSPListSaveHSP(hsp_list, hsp);
+        }
+        Blast_HitListUpdate(hit_list, hsp_list);
+    }
+
+    return BlastHSPResultsToSeqAligns(results, query_data, seqinfo_src,
+                                      options, subj_masks);
+}
+
+END_NCBI_SCOPE
@@ -0,0 +1,677 @@
+/* $Id$
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's offical duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*/
+
+/** @file blast_hsp_sam.cpp
+ * SAM output rendered directly from the HSPs of a blastn database search.
+ *
+ * The records follow the rules of CSAM_Formatter for the Seq-aligns which
+ * the search would otherwise have produced: by default the query is the
+ * reference sequence and the subject is the read, and the "SR" format
+ * specifier swaps the two.  The HSP lists of a query are rendered in
+ * parallel, each into its own buffer, and appended in their original order.
+ * With the "BAM" format specifier the same records are written as BAM,
+ * compressed into BGZF blocks as they are added.
+*/
+
+#include <ncbi_pch.hpp>
+#include <algo/blast/format/blast_hsp_sam.hpp>
+#include <algo/blast/core/blast_hits.h>
+#include <algo/blast/core/blast_encoding.h>
+#include <objmgr/bioseq_handle.hpp>
+#include <objmgr/util/sequence.hpp>
+#include <util/compress/zlib.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+BEGIN_NCBI_SCOPE
+USING_SCOPE(objects);
+USING_SCOPE(blast);
+
+/// Smallest e-value reported as such in the Seq-align scores
+/// (@sa BuildScoreList in blast_seqalign.cpp)
+static const double kMinEvalue = 1.0e-180;
+
+/// Largest amount of data compressed into one BGZF block
+static const size_t kBGZFBlockSize = 0xff00;
+/// Largest size of a BGZF block
+static const size_t kBGZFMaxBlockSize = 0x10000;
+/// Size of the gzip header written by CZipCompression
+static const size_t kGZipHeaderSize = 10;
+/// Empty BGZF block which marks the end of a BAM file
+static const char kBGZFEof[] =
+    "\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43\x02\x00"
+    "\x1b\x00\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+/// BAM CIGAR operation codes, in the order of their numeric values
+static const char kBAMCigarOps[] = "MIDNSHP=X";
+/// BAM sequence codes, in the order of their numeric values
+static const char kBAMBases[] = "=ACMGRSVTWYHKDBN";
+
+/// Append a little-endian 16-bit integer to a buffer
+static void
+s_PutUint2(string& dst, Uint2 value)
+{
+    dst += (char)(value & 0xff);
+    dst += (char)(value >> 8);
+}
+
+/// Append a little-endian 32-bit integer to a buffer
+static void
+s_PutUint4(string& dst, Uint4 value)
+{
+    for (int i = 0; i < 4; i++) {
+        dst += (char)(value & 0xff);
+        value >>= 8;
+    }
+}
+
+/// Append a BAM tag with a 32-bit integer value
+static void
+s_PutIntTag(string& dst, const char* tag, Int4 value)
+{
+    dst.append(tag, 2);
+    dst += 'i';
+    s_PutUint4(dst, (Uint4)value);
+}
+
+/// Append a BAM tag with a single precision floating point value
+static void
+s_PutFloatTag(string& dst, const char* tag, double value)
+{
+    float f = (float)value;
+    Uint4 bits;
+    memcpy(&bits, &f, sizeof(bits));
+    dst.append(tag, 2);
+    dst += 'f';
+    s_PutUint4(dst, bits);
+}
+
+/// Compute the BAM index bin of a zero-based, half-open reference range
+static Uint2
+s_Reg2Bin(TSeqPos beg, TSeqPos end)
+{
+    --end;
+    if (beg >> 14 == end >> 14) return ((1 << 15) - 1) / 7 + (beg >> 14);
+    if (beg >> 17 == end >> 17) return ((1 << 12) - 1) / 7 + (beg >> 17);
+    if (beg >> 20 == end >> 20) return ((1 << 9) - 1) / 7 + (beg >> 20);
+    if (beg >> 23 == end >> 23) return ((1 << 6) - 1) / 7 + (beg >> 23);
+    if (beg >> 26 == end >> 26) return ((1 << 3) - 1) / 7 + (beg >> 26);
+    return 0;
+}
+
+/// Complement of an IUPACna residue
+static char
+s_Complement(char c)
+{
+    switch (c) {
+    case 'A': return 'T';
+    case 'C': return 'G';
+    case 'G': return 'C';
+    case 'T': return 'A';
+    case 'R': return 'Y';
+    case 'Y': return 'R';
+    case 'M': return 'K';
+    case 'K': return 'M';
+    case 'B': return 'V';
+    case 'V': return 'B';
+    case 'D': return 'H';
+    case 'H': return 'D';
+    default:  return c;
+    }
+}
+
+/// Compress one BGZF block
+/// @param data Data to compress, at most kBGZFBlockSize bytes [in]
+/// @param length Length of the data [in]
+/// @param dst Buffer the block is appended to [in|out]
+static void
+s_BGZFCompressBlock(const char* data, size_t length, string& dst)
+{
+    _ASSERT(length > 0 && length <= kBGZFBlockSize);
+
+    // A BGZF block is a gzip member with the block size in an extra field;
+    // the deflate stream and the gzip trailer are used as they are
+    vector<char> buffer(2 * kBGZFMaxBlockSize);
+    size_t out_len = 0;
+    CZipCompression zip;
+    zip.SetFlags(CZipCompression::fWriteGZipFormat);
+    bool ok = zip.CompressBuffer(data, length, &buffer[0], buffer.size(),
+                                 &out_len);
+    if (ok && out_len + 8 > kBGZFMaxBlockSize) {
+        // Incompressible data, store it
+        zip.SetLevel(CCompression::eLevel_NoCompression);
+        ok = zip.CompressBuffer(data, length, &buffer[0], buffer.size(),
+                                &out_len);
+    }
+    if ( !ok ) {
+        NCBI_THROW(CException, eUnknown,
+                   "BGZF compression failed: " + zip.GetErrorDescription());
+    }
+
+    const size_t kPayload = out_len - kGZipHeaderSize;
+    static const char kHeader[] =
+        "\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43\x02\x00";
+    dst.append(kHeader, sizeof(kHeader) - 1);
+    s_PutUint2(dst, (Uint2)(sizeof(kHeader) - 1 + 2 + kPayload - 1));
+    dst.append(&buffer[kGZipHeaderSize], kPayload);
+}
+
+/// Compress data into as many BGZF blocks as needed
+static void
+s_BGZFCompress(const string& data, string& dst)
+{
+    for (size_t offset = 0; offset < data.size(); offset += kBGZFBlockSize) {
+        s_BGZFCompressBlock(data.data() + offset,
+                            min(kBGZFBlockSize, data.size() - offset), dst);
+    }
+}
+
+/// Select the accession of a sequence from its Seq-ids the same way as the
+/// object manager does (@sa CScope::GetAccVer)
+static CConstRef<CSeq_id>
+s_GetAccVer(const list< CRef<CSeq_id> >& ids)
+{
+    CConstRef<CSeq_id> retval;
+    ITERATE(list< CRef<CSeq_id> >, id, ids) {
+        const CTextseq_id* text_id = (*id)->GetTextseq_Id();
+        if (text_id != NULL) {
+            retval = *id;
+            if (text_id->IsSetAccession() && text_id->IsSetVersion()) {
+                break;
+            }
+        }
+    }
+    return retval;
+}
+
+CBlastHSPSAMWriter::CBlastHSPSAMWriter(CNcbiOstream& out,
+                                       const string& custom_spec,
+                                       const CSAM_Formatter::SProgramInfo& info,
+                                       CScope& scope,
+                                       int hitlist_size,
+                                       int num_threads)
+    : m_Out(out),
+      m_ProgramInfo(info),
+      m_Scope(&scope),
+      m_QueryIsRef(true),
+      m_SeqData(false),
+      m_BAM(false),
+      m_HitlistSize(hitlist_size),
+      m_NumThreads(max(num_threads, 1))
+{
+    vector<string> format_tokens;
+    NStr::Split(custom_spec, " ", format_tokens);
+    ITERATE(vector<string>, iter, format_tokens) {
+        if (*iter == "SR") {
+            m_QueryIsRef = false;
+        } else if (*iter == "SQ") {
+            m_SeqData = true;
+        } else if (*iter == "BAM") {
+            m_BAM = true;
+        }
+    }
+}
+
+bool
+CBlastHSPSAMWriter::IsBAM(const string& custom_spec)
+{
+    vector<string> format_tokens;
+    NStr::Split(custom_spec, " ", format_tokens);
+    return find(format_tokens.begin(), format_tokens.end(), "BAM") !=
+        format_tokens.end();
+}
+
+bool
+CBlastHSPSAMWriter::x_ComparePosition(const SRecord& a, const SRecord& b)
+{
+    if (a.pos != b.pos) {
+        return a.pos < b.pos;
+    }
+    return a.evalue < b.evalue;
+}
+
+bool
+CBlastHSPSAMWriter::x_FormatHSPList(const BlastHSPList* hsp_list,
+                                    const string& query_label,
+                                    TSeqPos query_length,
+                                    TSeqPos q_shift,
+                                    const BLAST_SequenceBlk* queries,
+                                    const BlastQueryInfo* query_info,
+                                    CSeqDB& seqdb,
+                                    vector<SRecord>& records)
+{
+    list< CRef<CSeq_id> > ids = seqdb.GetSeqIDs(hsp_list->oid);
+    if (ids.empty()) {
+        return false;
+    }
+    // The Seq-align names the subject with its best ranking Seq-id, which
+    // CSAM_Formatter replaces with the accession of the sequence
+    CConstRef<CSeq_id> subject_id = s_GetAccVer(ids);
+    if (subject_id.Empty()) {
+        subject_id = FindBestChoice(ids, CSeq_id::BestRank);
+    }
+    const string subject_label = subject_id->GetSeqIdString(true);
+    const TSeqPos subject_length = seqdb.GetSeqLength(hsp_list->oid);
+
+    const char* subject_seq = NULL;
+    if (m_SeqData && m_QueryIsRef) {
+        seqdb.GetAmbigSeq(hsp_list->oid, &subject_seq, kSeqDBNuclBlastNA8);
+    }
+
+    for (int h = 0; h < hsp_list->hspcnt; h++) {
+        const BlastHSP* hsp = hsp_list->hsp_array[h];
+        if (hsp == NULL) {
+            continue;
+        }
+        const BlastContextInfo& ctx = query_info->contexts[hsp->context];
+
+        // The subject of a blastn HSP is always on the plus strand
+        SRecord rec;
+        rec.reverse = (hsp->query.frame < 0);
+        TSeqPos q_from, q_to;
+        if (rec.reverse) {
+            q_from = ctx.query_length - hsp->query.end + q_shift;
+            q_to = ctx.query_length - hsp->query.offset + q_shift;
+        } else {
+            q_from = hsp->query.offset + q_shift;
+            q_to = hsp->query.end + q_shift;
+        }
+        const TSeqPos s_from = hsp->subject.offset;
+        const TSeqPos s_to = hsp->subject.end;
+
+        // CIGAR operations with the subject as the reference, in the order
+        // of the edit script
+        TCigar ops;
+        TSeqPos aligned = 0;
+        rec.num_dif = 0;
+        const GapEditScript* esp = hsp->gap_info;
+        if (esp == NULL) {
+            aligned = hsp->query.end - hsp->query.offset;
+            ops.push_back(make_pair('M', aligned));
+        } else {
+            for (int i = 0; i < esp->size; i++) {
+                char op;
+                switch (esp->op_type[i]) {
+                case eGapAlignSub:
+                    op = 'M';
+                    aligned += esp->num[i];
+                    break;
+                case eGapAlignDel:
+                    op = 'D';
+                    rec.num_dif += esp->num[i];
+                    break;
+                case eGapAlignIns:
+                    op = 'I';
+                    rec.num_dif += esp->num[i];
+                    break;
+                default:
+                    continue;
+                }
+                if ( !ops.empty() && ops.back().first == op ) {
+                    ops.back().second += esp->num[i];
+                } else {
+                    ops.push_back(make_pair(op, (TSeqPos)esp->num[i]));
+                }
+            }
+        }
+
+        TSeqPos read_from, read_to, read_length;
+        if (m_QueryIsRef) {
+            // Insertions become deletions, and the operations follow the
+            // plus strand of the query
+            NON_CONST_ITERATE(TCigar, op, ops) {
+                if (op->first == 'I') {
+                    op->first = 'D';
+                } else if (op->first == 'D') {
+                    op->first = 'I';
+                }
+            }
+            if (rec.reverse) {
+                reverse(ops.begin(), ops.end());
+            }
+            rec.read = subject_label;
+            rec.ref = query_label;
+            rec.ref_length = query_length;
+            rec.pos = q_from;
+            read_from = s_from;
+            read_to = s_to;
+            read_length = subject_length;
+        } else {
+            rec.read = query_label;
+            rec.ref = subject_label;
+            rec.ref_length = subject_length;
+            rec.pos = s_from;
+            read_from = q_from;
+            read_to = q_to;
+            read_length = query_length;
+        }
+
+        // Unaligned ends of the read are hard clipped
+        TSeqPos clip_front = 0, clip_back = 0;
+        (rec.reverse ? clip_back : clip_front) = read_from;
+        if (read_to < read_length) {
+            (rec.reverse ? clip_front : clip_back) = read_length - read_to;
+        }
+        if (clip_front > 0) {
+            rec.cigar.push_back(make_pair('H', clip_front));
+        }
+        rec.cigar.insert(rec.cigar.end(), ops.begin(), ops.end());
+        if (clip_back > 0) {
+            rec.cigar.push_back(make_pair('H', clip_back));
+        }
+
+        if (m_SeqData) {
+            if (m_QueryIsRef) {
+                rec.seq.reserve(s_to - s_from);
+                for (TSeqPos i = s_from; i < s_to; i++) {
+                    rec.seq += BLASTNA_TO_IUPACNA[(int)subject_seq[i]];
+                }
+                if (rec.reverse) {
+                    reverse(rec.seq.begin(), rec.seq.end());
+                    NON_CONST_ITERATE(string, c, rec.seq) {
+                        *c = s_Complement(*c);
+                    }
+                }
+            } else {
+                // The context of a minus strand HSP already holds the
+                // reverse complement of the query
+                const Uint1* q = queries->sequence_nomask + ctx.query_offset;
+                rec.seq.reserve(hsp->query.end - hsp->query.offset);
+                for (int i = hsp->query.offset; i < hsp->query.end; i++) {
+                    rec.seq += BLASTNA_TO_IUPACNA[q[i]];
+                }
+            }
+        }
+
+        rec.score = hsp->score;
+        rec.evalue = hsp->evalue < kMinEvalue ? 0.0 : hsp->evalue;
+        rec.has_evalue = (hsp->num <= 1 && rec.evalue >= 0.0);
+        rec.bit_score = hsp->bit_score;
+        rec.pct_identity = 100.0;
+        if (hsp->num_ident != (int)aligned) {
+            rec.pct_identity =
+                min(99.99, 100.0 * ((double)hsp->num_ident) / aligned);
+        }
+        records.push_back(rec);
+    }
+
+    if (subject_seq) {
+        seqdb.RetAmbigSeq(&subject_seq);
+    }
+    return true;
+}
+
+void
+CBlastHSPSAMWriter::x_AddRecord(const SRecord& record)
+{
+    int ref_id;
+    map<string, int>::const_iterator ref = m_RefIndex.find(record.ref);
+    if (ref == m_RefIndex.end()) {
+        ref_id = (int)m_Refs.size();
+        m_RefIndex[record.ref] = ref_id;
+        m_Refs.push_back(make_pair(record.ref, record.ref_length));
+    } else {
+        ref_id = ref->second;
+    }
+
+    if ( !m_BAM ) {
+        string& line = m_Body;
+        line += record.read;
+        line += '\t';
+        line += NStr::UIntToString(record.reverse ? 0x10 : 0);
+        line += '\t';
+        line += record.ref;
+        line += '\t';
+        line += NStr::UIntToString(record.pos + 1);
+        line += "\t255\t";
+        ITERATE(TCigar, op, record.cigar) {
+            line += NStr::UIntToString(op->second);
+            line += op->first;
+        }
+        line += "\t*\t0\t0\t";
+        line += record.seq.empty() ? string("*") : record.seq;
+        line += "\t*";
+        if (record.score != 0) {
+            line += "\tAS:i:" + NStr::IntToString(record.score);
+        }
+        if (record.has_evalue) {
+            line += "\tEV:f:" + NStr::DoubleToString(record.evalue);
+        }
+        line += "\tNM:i:" + NStr::IntToString(record.num_dif);
+        line += "\tPI:f:" + NStr::DoubleToString(record.pct_identity, 2);
+        if (record.bit_score >= 0.0) {
+            line += "\tBS:f:" + NStr::DoubleToString(record.bit_score);
+        }
+        line += '\n';
+        return;
+    }
+
+    TSeqPos ref_span = 0;
+    ITERATE(TCigar, op, record.cigar) {
+        if (op->first == 'M' || op->first == 'D') {
+            ref_span += op->second;
+        }
+    }
+    const string read = record.read.substr(0, 254);
+
+    string bam;
+    s_PutUint4(bam, (Uint4)ref_id);
+    s_PutUint4(bam, record.pos);
+    bam += (char)(read.size() + 1);
+    bam += (char)255;
+    s_PutUint2(bam, s_Reg2Bin(record.pos, record.pos + max(ref_span, 1u)));
+    s_PutUint2(bam, (Uint2)record.cigar.size());
+    s_PutUint2(bam, record.reverse ? 0x10 : 0);
+    s_PutUint4(bam, (Uint4)record.seq.size());
+    s_PutUint4(bam, (Uint4)-1);
+    s_PutUint4(bam, (Uint4)-1);
+    s_PutUint4(bam, 0);
+    bam += read;
+    bam += '\0';
+    ITERATE(TCigar, op, record.cigar) {
+        Uint4 code = (Uint4)(strchr(kBAMCigarOps, op->first) - kBAMCigarOps);
+        s_PutUint4(bam, (op->second << 4) | code);
+    }
+    for (size_t i = 0; i < record.seq.size(); i += 2) {
+        Uint1 hi = (Uint1)(strchr(kBAMBases, record.seq[i]) - kBAMBases);
+        Uint1 lo = 0;
+        if (i + 1 < record.seq.size()) {
+            lo = (Uint1)(strchr(kBAMBases, record.seq[i + 1]) - kBAMBases);
+        }
+        bam += (char)((hi << 4) | lo);
+    }
+    bam.append(record.seq.size(), (char)0xff);
+    if (record.score != 0) {
+        s_PutIntTag(bam, "AS", record.score);
+    }
+    if (record.has_evalue) {
+        s_PutFloatTag(bam, "EV", record.evalue);
+    }
+    s_PutIntTag(bam, "NM", record.num_dif);
+    s_PutFloatTag(bam, "PI", record.pct_identity);
+    if (record.bit_score >= 0.0) {
+        s_PutFloatTag(bam, "BS", record.bit_score);
+    }
+
+    s_PutUint4(m_BAMBuffer, (Uint4)bam.size());
+    m_BAMBuffer += bam;
+    if (m_BAMBuffer.size() >= kBGZFBlockSize) {
+        size_t offset = 0;
+        for ( ; m_BAMBuffer.size() - offset >= kBGZFBlockSize;
+              offset += kBGZFBlockSize) {
+            s_BGZFCompressBlock(m_BAMBuffer.data() + offset, kBGZFBlockSize,
+                                m_Body);
+        }
+        m_BAMBuffer.erase(0, offset);
+    }
+}
+
+string
+CBlastHSPSAMWriter::x_GetHeader(void) const
+{
+    string header = "@HD\tVN:1.2";
+    header += m_QueryIsRef ? "\tSO:coordinate\tGO:reference" : "\tGO:query";
+    header += '\n';
+    ITERATE(TRefs, ref, m_Refs) {
+        header += "@SQ\tSN:" + ref->first +
+            "\tLN:" + NStr::UInt8ToString(ref->second) + '\n';
+    }
+    if ( !m_ProgramInfo.m_Id.empty() ) {
+        header += "@PG\tID:" + m_ProgramInfo.m_Id;
+        if ( !m_ProgramInfo.m_Version.empty() ) {
+            header += "\tVN:" + m_ProgramInfo.m_Version;
+        }
+        if ( !m_ProgramInfo.m_CmdLine.empty() ) {
+            header += "\tCL:" + m_ProgramInfo.m_CmdLine;
+        }
+        if ( !m_ProgramInfo.m_Desc.empty() ) {
+            header += "\tDS:" + m_ProgramInfo.m_Desc;
+        }
+        if ( !m_ProgramInfo.m_Name.empty() ) {
+            header += "\tPN:" + m_ProgramInfo.m_Name;
+        }
+        header += '\n';
+    }
+    return header;
+}
+
+void
+CBlastHSPSAMWriter::Write(BlastHSPResults* results,
+                          ILocalQueryData& query_data,
+                          const BLAST_SequenceBlk* queries,
+                          const BlastQueryInfo* query_info,
+                          CSeqDB& seqdb,
+                          EBlastProgramType /* program */)
+{
+    if (results == NULL) {
+        return;
+    }
+
+    for (int qi = 0; qi < results->num_queries; qi++) {
+        BlastHitList* hit_list = results->hitlist_array[qi];
+        if (hit_list == NULL || hit_list->hsplist_count == 0) {
+            continue;
+        }
+
+        const CSeq_loc* loc = query_data.GetSeq_loc(qi);
+        const TSeqPos q_shift = loc->IsInt() ? loc->GetInt().GetFrom() : 0;
+        CConstRef<CSeq_id> query_id(loc->GetId());
+        CSeq_id_Handle acc = sequence::GetId(*query_id, *m_Scope,
+                                             sequence::eGetId_ForceAcc);
+        if (acc) {
+            query_id = acc.GetSeqId();
+        }
+        const string query_label = query_id->GetSeqIdString(true);
+        CBioseq_Handle bh = m_Scope->GetBioseqHandle(*loc->GetId());
+        const TSeqPos query_length = bh ? bh.GetBioseqLength()
+                                        : query_data.GetSeqLength(qi);
+
+        const int num_lists = hit_list->hsplist_count;
+        vector< vector<SRecord> > records(num_lists);
+        vector<char> found(num_lists, 0);
+        // Exceptions cannot leave the parallel loop
+        exception_ptr error;
+
+#pragma omp parallel for num_threads(m_NumThreads) schedule(dynamic, 1)
+        for (int i = 0; i < num_lists; i++) {
+            BlastHSPList* hsp_list = hit_list->hsplist_array[i];
+            if (hsp_list == NULL) {
+                continue;
+            }
+            try {
+                Blast_HSPListSortByEvalue(hsp_list);
+                found[i] = x_FormatHSPList(hsp_list, query_label,
+                                           query_length, q_shift, queries,
+                                           query_info, seqdb, records[i])
+                    ? 1 : 0;
+            } catch (...) {
+#pragma omp critical(blast_hsp_sam_error)
+                if ( !error ) {
+                    error = current_exception();
+                }
+            }
+        }
+        if (error) {
+            rethrow_exception(error);
+        }
+
+        // Print the same subjects as the Seq-align based report
+        vector<SRecord> query_records;
+        int num_subjects = 0;
+        for (int i = 0; i < num_lists && num_subjects < m_HitlistSize; i++) {
+            if (found[i]) {
+                query_records.insert(query_records.end(),
+                                     records[i].begin(), records[i].end());
+                ++num_subjects;
+            }
+        }
+        if (m_QueryIsRef) {
+            stable_sort(query_records.begin(), query_records.end(),
+                        x_ComparePosition);
+        }
+        ITERATE(vector<SRecord>, rec, query_records) {
+            x_AddRecord(*rec);
+        }
+    }
+}
+
+void
+CBlastHSPSAMWriter::Flush(void)
+{
+    if ( !m_BAM ) {
+        // As CSAM_Formatter, print nothing if there are no records
+        if ( !m_Refs.empty() ) {
+            m_Out << x_GetHeader() << m_Body;
+        }
+    } else {
+        const string text = x_GetHeader();
+        string header("BAM\1", 4);
+        s_PutUint4(header, (Uint4)text.size());
+        header += text;
+        s_PutUint4(header, (Uint4)m_Refs.size());
+        ITERATE(TRefs, ref, m_Refs) {
+            s_PutUint4(header, (Uint4)(ref->first.size() + 1));
+            header += ref->first;
+            header += '\0';
+            s_PutUint4(header, ref->second);
+        }
+        string blocks;
+        s_BGZFCompress(header, blocks);
+        s_BGZFCompress(m_BAMBuffer, m_Body);
+        m_Out.write(blocks.data(), blocks.size());
+        m_Out.write(m_Body.data(), m_Body.size());
+        m_Out.write(kBGZFEof, sizeof(kBGZFEof) - 1);
+    }
+    m_Out.flush();
+
+    m_Refs.clear();
+    m_RefIndex.clear();
+    m_Body.erase();
+    m_BAMBuffer.erase();
+}
+
+END_NCBI_SCOPE
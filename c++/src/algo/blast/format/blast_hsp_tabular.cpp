@@ -0,0 +1,510 @@
+/* $Id$
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's offical duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*/
+
+/** @file blast_hsp_tabular.cpp
+ * Tabular output rendered directly from the HSPs of a database search.
+ *
+ * The rows are produced from the BlastHSP scores and edit scripts, the
+ * query sequence data and the BLAST database headers, following the same
+ * rules as CBlastTabularInfo::SetFields for the Seq-aligns which the search
+ * would otherwise have produced.  The HSP lists of a query are rendered in
+ * parallel and written in their original order.
+*/
+
+#include <ncbi_pch.hpp>
+#include <algo/blast/format/blast_hsp_tabular.hpp>
+#include <algo/blast/core/blast_hits.h>
+#include <objtools/align_format/align_format_util.hpp>
+#include <objtools/align_format/showdefline.hpp>
+#include <objects/blastdb/Blast_def_line.hpp>
+#include <objects/blastdb/Blast_def_line_set.hpp>
+#include <objects/general/Object_id.hpp>
+#include <objmgr/bioseq_handle.hpp>
+#include <objmgr/util/sequence.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+BEGIN_NCBI_SCOPE
+USING_SCOPE(objects);
+USING_SCOPE(blast);
+USING_SCOPE(align_format);
+
+/// Smallest e-value reported as such in the Seq-align scores
+/// (@sa BuildScoreList in blast_seqalign.cpp)
+static const double kMinEvalue = 1.0e-180;
+
+/// Parse a tabular format specification the same way as CBlastTabularInfo
+/// @param format_spec Format specification [in]
+/// @param fields Fields to print, in order [out]
+/// @param unsupported Set to true if a field is not supported here [out]
+static void
+s_ParseFormatSpec(const string& format_spec, vector<ETabularField>& fields,
+                  bool& unsupported)
+{
+    map<string, ETabularField> field_map;
+    for (size_t i = 0; i < kNumTabularOutputFormatSpecifiers; i++) {
+        field_map.insert(make_pair(sc_FormatSpecifiers[i].name,
+                                   sc_FormatSpecifiers[i].field));
+    }
+
+    vector<string> dflt_tokens;
+    NStr::Split(kDfltArgTabularOutputFmt, " ", dflt_tokens);
+    vector<string> format_tokens;
+    NStr::Split(format_spec, " ", format_tokens);
+    if (format_tokens.empty()) {
+        format_tokens.push_back(kDfltArgTabularOutputFmtTag);
+    }
+
+    list<ETabularField> to_show;
+    ITERATE(vector<string>, iter, format_tokens) {
+        if (*iter == kDfltArgTabularOutputFmtTag) {
+            ITERATE(vector<string>, d, dflt_tokens) {
+                ETabularField field = field_map[*d];
+                if (find(to_show.begin(), to_show.end(), field) == to_show.end())
+                    to_show.push_back(field);
+            }
+        } else if ( !iter->empty() && (*iter)[0] == '-') {
+            map<string, ETabularField>::const_iterator f =
+                field_map.find(iter->substr(1));
+            if (f != field_map.end())
+                to_show.remove(f->second);
+        } else {
+            map<string, ETabularField>::const_iterator f =
+                field_map.find(*iter);
+            if (f != field_map.end() &&
+                find(to_show.begin(), to_show.end(), f->second) == to_show.end())
+                to_show.push_back(f->second);
+        }
+    }
+    if (to_show.empty()) {
+        ITERATE(vector<string>, d, dflt_tokens) {
+            to_show.push_back(field_map[*d]);
+        }
+    }
+
+    unsupported = false;
+    fields.assign(to_show.begin(), to_show.end());
+    ITERATE(vector<ETabularField>, f, fields) {
+        switch (*f) {
+        case eQuerySeqId: case eQueryAccession: case eQueryAccessionVersion:
+        case eQueryLength:
+        case eSubjectSeqId: case eSubjectAccession: case eSubjAccessionVersion:
+        case eSubjectLength:
+        case eQueryStart: case eQueryEnd: case eSubjectStart: case eSubjectEnd:
+        case eEvalue: case eBitScore: case eScore:
+        case eAlignmentLength: case ePercentIdentical: case eNumIdentical:
+        case eMismatches: case eGapOpenings: case eGaps:
+            break;
+        default:
+            unsupported = true;
+            break;
+        }
+    }
+}
+
+/// Compute the id labels as CBlastTabularInfo prints them
+/// @param ids Seq-ids of the sequence [in]
+/// @param seqid Full Seq-id(s) label [out]
+/// @param acc Accession label [out]
+/// @param accver Accession.version label [out]
+static void
+s_SetIdLabels(const list< CRef<CSeq_id> >& ids, string& seqid, string& acc,
+              string& accver)
+{
+    seqid = CShowBlastDefline::GetSeqIdListString(ids, true);
+    acc.erase();
+    accver.erase();
+    CConstRef<CSeq_id> accid = FindBestChoice(ids, CSeq_id::Score);
+    if (accid.NotEmpty()) {
+        accid->GetLabel(&acc, CSeq_id::eContent, 0);
+        accid->GetLabel(&accver, CSeq_id::eContent, CSeq_id::fLabel_Version);
+    }
+    if (seqid.empty())
+        seqid = "Unknown";
+    if (acc.empty())
+        acc = "Unknown";
+    if (accver.empty())
+        accver = "Unknown";
+}
+
+/// Replace a local id with a local id labelled with the first token of the
+/// title, unless parse_local is set (@sa CBlastTabularInfo::SetQueryId)
+static CRef<CSeq_id>
+s_ReplaceLocalId(const string& title, const CSeq_id& id, bool parse_local)
+{
+    CRef<CSeq_id> retval(new CSeq_id);
+    if (id.IsLocal()) {
+        string id_token;
+        vector<string> title_tokens;
+        NStr::Split(title, " ", title_tokens);
+        if ( !title_tokens.empty() ) {
+            id_token = title_tokens[0];
+        }
+        if (id_token.empty() || parse_local) {
+            const CObject_id& obj_id = id.GetLocal();
+            id_token = obj_id.IsStr() ? obj_id.GetStr()
+                                      : NStr::IntToString(obj_id.GetId());
+        }
+        retval->SetLocal().SetStr(id_token);
+    } else {
+        retval->Assign(id);
+    }
+    return retval;
+}
+
+CBlastHSPTabularWriter::CBlastHSPTabularWriter(CNcbiOstream& out,
+                                               const string& format_spec,
+                                               const string& delim,
+                                               CScope* scope,
+                                               bool believe_query,
+                                               int hitlist_size,
+                                               int num_threads)
+    : m_Out(out),
+      m_Delim(delim),
+      m_Scope(scope),
+      m_BelieveQuery(believe_query),
+      m_HitlistSize(hitlist_size),
+      m_NumThreads(max(num_threads, 1))
+{
+    bool unsupported = false;
+    s_ParseFormatSpec(format_spec, m_Fields, unsupported);
+    if (unsupported) {
+        NCBI_THROW(CException, eInvalid,
+                   "Tabular format specification is not supported by "
+                   "CBlastHSPTabularWriter");
+    }
+}
+
+bool
+CBlastHSPTabularWriter::CanFormat(const string& format_spec)
+{
+    vector<ETabularField> fields;
+    bool unsupported = false;
+    s_ParseFormatSpec(format_spec, fields, unsupported);
+    return !unsupported;
+}
+
+void
+CBlastHSPTabularWriter::x_GetQueryLabels(ILocalQueryData& query_data,
+                                         size_t index, SSeqLabels& labels)
+{
+    const CSeq_loc* loc = query_data.GetSeq_loc(index);
+    list< CRef<CSeq_id> > ids;
+    CBioseq_Handle bh;
+    if (m_Scope.NotEmpty()) {
+        bh = m_Scope->GetBioseqHandle(*loc->GetId());
+    }
+    if (bh) {
+        string title = CAlignFormatUtil::GetTitle(bh);
+        ITERATE(CBioseq_Handle::TId, itr, bh.GetId()) {
+            ids.push_back(s_ReplaceLocalId(title, *itr->GetSeqId(),
+                                           m_BelieveQuery));
+        }
+        labels.length = bh.GetBioseqLength();
+    } else {
+        CRef<CSeq_id> id(new CSeq_id);
+        id->Assign(*loc->GetId());
+        ids.push_back(id);
+        labels.length = query_data.GetSeqLength(index);
+    }
+    s_SetIdLabels(ids, labels.seqid, labels.acc, labels.accver);
+}
+
+bool
+CBlastHSPTabularWriter::x_GetSubjectLabels(CSeqDB& seqdb, int oid,
+                                           SSeqLabels& labels)
+{
+    CRef<CBlast_def_line_set> hdr = seqdb.GetHdr(oid);
+    if (hdr.Empty() || !hdr->IsSet() || hdr->Get().empty()) {
+        return false;
+    }
+
+    // The Seq-align names the subject with its best ranking gi, or else the
+    // first Seq-id; the subject Bioseq is then built from the defline
+    // holding that Seq-id (@sa GetSequenceLengthAndId)
+    list< CRef<CSeq_id> > all_ids;
+    ITERATE(CBlast_def_line_set::Tdata, dl, hdr->Get()) {
+        all_ids.insert(all_ids.end(), (*dl)->GetSeqid().begin(),
+                       (*dl)->GetSeqid().end());
+    }
+    CRef<CSeq_id> best = FindBestChoice(all_ids, CSeq_id::BestRank);
+    if (best.Empty()) {
+        return false;
+    }
+    CConstRef<CBlast_def_line> defline = hdr->Get().front();
+    if (best->IsGi()) {
+        ITERATE(CBlast_def_line_set::Tdata, dl, hdr->Get()) {
+            bool found = false;
+            ITERATE(CBlast_def_line::TSeqid, id, (*dl)->GetSeqid()) {
+                if ((*id)->Match(*best)) {
+                    found = true;
+                    break;
+                }
+            }
+            if (found) {
+                defline = *dl;
+                break;
+            }
+        }
+    }
+
+    const string title = defline->IsSetTitle() ? defline->GetTitle() : kEmptyStr;
+    list< CRef<CSeq_id> > ids;
+    ITERATE(CBlast_def_line::TSeqid, itr, defline->GetSeqid()) {
+        // Subject local ids are parsed as they are, but the artificial ids
+        // of databases without parsed Seq-ids are replaced with the first
+        // token of the title (@sa CShowBlastDefline::GetSeqIdList)
+        CRef<CSeq_id> id = s_ReplaceLocalId(title, **itr, true);
+        const string fasta = id->AsFastaString();
+        if ((id->IsGeneral() && fasta.find("gnl|BL_ORD_ID") != NPOS) ||
+            fasta.find("lcl|Subject_") != NPOS) {
+            vector<string> title_tokens;
+            NStr::Split(title, " ", title_tokens);
+            if ( !title_tokens.empty() && !title_tokens[0].empty() ) {
+                id.Reset(new CSeq_id);
+                id->SetLocal().SetStr(title_tokens[0]);
+            }
+        }
+        ids.push_back(id);
+    }
+    s_SetIdLabels(ids, labels.seqid, labels.acc, labels.accver);
+    labels.length = seqdb.GetSeqLength(oid);
+    return true;
+}
+
+bool
+CBlastHSPTabularWriter::x_FormatHSPList(const BlastHSPList* hsp_list,
+                                        const SSeqLabels& query,
+                                        TSeqPos q_shift,
+                                        const BLAST_SequenceBlk* queries,
+                                        const BlastQueryInfo* query_info,
+                                        CSeqDB& seqdb,
+                                        EBlastProgramType program,
+                                        string& rows)
+{
+    SSeqLabels subject;
+    if ( !x_GetSubjectLabels(seqdb, hsp_list->oid, subject) ) {
+        return false;
+    }
+
+    // Identities of nucleotide alignments are taken from the traceback, as
+    // CBlastTabularInfo does for blastn; protein alignments are compared
+    // residue by residue
+    const bool kCountIdentities = (program != eBlastTypeBlastn);
+    const char* subject_seq = NULL;
+    if (kCountIdentities) {
+        seqdb.GetSequence(hsp_list->oid, &subject_seq);
+    }
+
+    CNcbiOstrstream os;
+    for (int h = 0; h < hsp_list->hspcnt; h++) {
+        const BlastHSP* hsp = hsp_list->hsp_array[h];
+        if (hsp == NULL) {
+            continue;
+        }
+        const BlastContextInfo& ctx = query_info->contexts[hsp->context];
+
+        int q_start, q_end, s_start, s_end;
+        if (hsp->query.frame < 0) {
+            // Minus strand query: the plus strand of the query is shown,
+            // and the subject coordinates are reversed
+            q_start = ctx.query_length - hsp->query.end + q_shift + 1;
+            q_end = ctx.query_length - hsp->query.offset + q_shift;
+            s_start = hsp->subject.end;
+            s_end = hsp->subject.offset + 1;
+        } else {
+            q_start = hsp->query.offset + q_shift + 1;
+            q_end = hsp->query.end + q_shift;
+            s_start = hsp->subject.offset + 1;
+            s_end = hsp->subject.end;
+        }
+
+        int align_length = 0, num_gaps = 0, num_gap_opens = 0;
+        int num_ident = kCountIdentities ? 0 : hsp->num_ident;
+        const Uint1* q = queries->sequence_nomask + ctx.query_offset +
+            hsp->query.offset;
+        const Uint1* s = (const Uint1*) subject_seq + hsp->subject.offset;
+        const GapEditScript* esp = hsp->gap_info;
+        if (esp == NULL) {
+            align_length = hsp->query.end - hsp->query.offset;
+            if (kCountIdentities) {
+                for (int k = 0; k < align_length; k++) {
+                    if (q[k] == s[k])
+                        ++num_ident;
+                }
+            }
+        } else {
+            for (int i = 0; i < esp->size; i++) {
+                const int n = esp->num[i];
+                align_length += n;
+                switch (esp->op_type[i]) {
+                case eGapAlignSub:
+                    if (kCountIdentities) {
+                        for (int k = 0; k < n; k++) {
+                            if (q[k] == s[k])
+                                ++num_ident;
+                        }
+                    }
+                    q += n;
+                    s += n;
+                    break;
+                case eGapAlignDel:
+                    s += n;
+                    num_gaps += n;
+                    ++num_gap_opens;
+                    break;
+                case eGapAlignIns:
+                    q += n;
+                    num_gaps += n;
+                    ++num_gap_opens;
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+
+        double evalue = hsp->evalue < kMinEvalue ? 0.0 : hsp->evalue;
+        double bit_score = hsp->bit_score >= 0 ? hsp->bit_score : 0.0;
+        string evalue_str, bit_score_str, total_bit_str, raw_score_str;
+        CAlignFormatUtil::GetScoreString(evalue, bit_score, 0, hsp->score,
+                                         evalue_str, bit_score_str,
+                                         total_bit_str, raw_score_str);
+        if ((evalue >= kMinEvalue) && (evalue < 0.0009)) {
+            evalue_str = NStr::DoubleToString(evalue, 2,
+                                              NStr::fDoubleScientific);
+        }
+
+        ITERATE(vector<ETabularField>, f, m_Fields) {
+            if (f != m_Fields.begin())
+                os << m_Delim;
+            switch (*f) {
+            case eQuerySeqId:            os << query.seqid; break;
+            case eQueryAccession:        os << query.acc; break;
+            case eQueryAccessionVersion: os << query.accver; break;
+            case eQueryLength:           os << query.length; break;
+            case eSubjectSeqId:          os << subject.seqid; break;
+            case eSubjectAccession:      os << subject.acc; break;
+            case eSubjAccessionVersion:  os << subject.accver; break;
+            case eSubjectLength:         os << subject.length; break;
+            case eQueryStart:            os << q_start; break;
+            case eQueryEnd:              os << q_end; break;
+            case eSubjectStart:          os << s_start; break;
+            case eSubjectEnd:            os << s_end; break;
+            case eEvalue:                os << evalue_str; break;
+            case eBitScore:              os << bit_score_str; break;
+            case eScore:                 os << hsp->score; break;
+            case eAlignmentLength:       os << align_length; break;
+            case ePercentIdentical:
+                os << NStr::DoubleToString(align_length > 0 ?
+                          ((double)num_ident)/align_length * 100 : 0, 3);
+                break;
+            case eNumIdentical:          os << num_ident; break;
+            case eMismatches:
+                os << align_length - num_ident - num_gaps;
+                break;
+            case eGapOpenings:           os << num_gap_opens; break;
+            case eGaps:                  os << num_gaps; break;
+            default: break;
+            }
+        }
+        os << "\n";
+    }
+
+    if (subject_seq) {
+        seqdb.RetSequence(&subject_seq);
+    }
+    rows = CNcbiOstrstreamToString(os);
+    return true;
+}
+
+void
+CBlastHSPTabularWriter::Write(BlastHSPResults* results,
+                              ILocalQueryData& query_data,
+                              const BLAST_SequenceBlk* queries,
+                              const BlastQueryInfo* query_info,
+                              CSeqDB& seqdb,
+                              EBlastProgramType program)
+{
+    if (results == NULL) {
+        return;
+    }
+
+    for (int qi = 0; qi < results->num_queries; qi++) {
+        BlastHitList* hit_list = results->hitlist_array[qi];
+        if (hit_list == NULL || hit_list->hsplist_count == 0) {
+            continue;
+        }
+
+        SSeqLabels query;
+        x_GetQueryLabels(query_data, qi, query);
+        const CSeq_loc* loc = query_data.GetSeq_loc(qi);
+        const TSeqPos q_shift = loc->IsInt() ? loc->GetInt().GetFrom() : 0;
+
+        const int num_lists = hit_list->hsplist_count;
+        vector<string> rows(num_lists);
+        vector<char> found(num_lists, 0);
+        // Exceptions cannot leave the parallel loop
+        exception_ptr error;
+
+#pragma omp parallel for num_threads(m_NumThreads) schedule(dynamic, 1)
+        for (int i = 0; i < num_lists; i++) {
+            BlastHSPList* hsp_list = hit_list->hsplist_array[i];
+            if (hsp_list == NULL) {
+                continue;
+            }
+            try {
+                Blast_HSPListSortByEvalue(hsp_list);
+                found[i] = x_FormatHSPList(hsp_list, query, q_shift, queries,
+                                           query_info, seqdb, program,
+                                           rows[i]) ? 1 : 0;
+            } catch (...) {
+#pragma omp critical(blast_hsp_tabular_error)
+                if ( !error ) {
+                    error = current_exception();
+                }
+            }
+        }
+        if (error) {
+            rethrow_exception(error);
+        }
+
+        // Print the same subjects as the Seq-align based report
+        // (@sa CBlastFormatUtil::PruneSeqalign)
+        int num_subjects = 0;
+        for (int i = 0; i < num_lists && num_subjects < m_HitlistSize; i++) {
+            if (found[i]) {
+                m_Out << rows[i];
+                ++num_subjects;
+            }
+        }
+    }
+    m_Out.flush();
+}
+
+END_NCBI_SCOPE
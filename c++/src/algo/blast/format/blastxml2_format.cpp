@@ -51,6 +51,7 @@
 #include <objects/blastxml2/blastxml2__.hpp>
 #include <serial/objostrxml.hpp>
 #include <serial/objostrjson.hpp>
+#include <serial/objectio.hpp>
 
 #include <algo/blast/api/version.hpp>
 #include <sstream>
@@ -454,10 +455,13 @@ s_GetSubjectId(const CSeq_align& align)
 
 
 /// Fills the list of blastxml2::CHit objects, given a list of Seq-aligns.
-/// @param hits List of blastxml2::CHit objects to fill [in] [out]
+/// @param hits List of blastxml2::CHit objects to fill, ignored if NULL [in] [out]
+/// @param out Container to write each hit to as soon as it is created,
+///            ignored if NULL [in] [out]
 
 static void
-s_SetBlastXMlHitList(list<CRef<blastxml2::CHit> >& hits, const IBlastXML2ReportData* data, int num)
+s_SetBlastXMlHitList(list<CRef<blastxml2::CHit> >* hits, COStreamContainer* out,
+                     const IBlastXML2ReportData* data, int num)
 {
     
 
@@ -502,10 +506,52 @@ s_SetBlastXMlHitList(list<CRef<blastxml2::CHit> >& hits, const IBlastXML2ReportD
                                mask_info, ungapped, master_gentice_code, slave_genetic_code, hasTaxDB);
         }
         
-        hits.push_back(new_hit);
+        if (out) {
+            *out << *new_hit;
+        }
+        else {
+            hits->push_back(new_hit);
+        }
     }
 }
 
+/// Writes the hits of the searches directly to the object stream, so that
+/// only one blastxml2::CHit is held in memory at a time.
+class CBlastXML2HitsWriteHook : public CWriteClassMemberHook
+{
+public:
+    CBlastXML2HitsWriteHook(const IBlastXML2ReportData* data)
+        : m_Data(data) {}
+
+    /// Register a search whose hits are to be written by the hook
+    /// @param search Search object with an empty hit list [in]
+    /// @param num Index of the search results [in]
+    void AddSearch(const blastxml2::CSearch& search, int num)
+    {
+        m_Searches[&search] = num;
+    }
+
+    virtual void WriteClassMember(CObjectOStream& out,
+                                  const CConstObjectInfoMI& member)
+    {
+        const blastxml2::CSearch* search = (const blastxml2::CSearch*)
+            member.GetClassObject().GetObjectPtr();
+        map<const blastxml2::CSearch*, int>::const_iterator itr =
+            m_Searches.find(search);
+        if (itr == m_Searches.end()) {
+            DefaultWrite(out, member);
+            return;
+        }
+        COStreamClassMember hits_member(out, member);
+        COStreamContainer hits(out, member.GetMemberType());
+        s_SetBlastXMlHitList(NULL, &hits, m_Data, itr->second);
+    }
+
+private:
+    const IBlastXML2ReportData* m_Data;
+    map<const blastxml2::CSearch*, int> m_Searches;
+};
+
 
 /// Fills the parameters part of the BLAST XML output.
 /// @param bxmlout BLAST XML output object [in] [out]
@@ -577,7 +623,8 @@ s_SetBlastXMLStatistics(blastxml2::CStatistics & stats,
 
 static void
 s_SetBlastXMLSearch(blastxml2::CSearch & search,
-                    const IBlastXML2ReportData* data, int num)
+                    const IBlastXML2ReportData* data, int num,
+                    CBlastXML2HitsWriteHook* hits_hook)
 {
 	 CConstRef<objects::CSeq_loc> q_loc = data->GetQuerySeqLoc();
 	 const CSeq_id * q_id = q_loc->GetId();
@@ -626,7 +673,11 @@ s_SetBlastXMLSearch(blastxml2::CSearch & search,
 	   	search.SetMessage(msg);
 
 	list<CRef<blastxml2::CHit> > & hit_list = search.SetHits();
-	s_SetBlastXMlHitList(hit_list, data, num);
+	if(hits_hook) {
+		hits_hook->AddSearch(search, num);
+		return;
+	}
+	s_SetBlastXMlHitList(&hit_list, NULL, data, num);
 }
 
 /// Given BLAST task, returns enumerated value for the publication to be 
@@ -653,7 +704,14 @@ s_GetBlastPublication(EProgram program)
     return publication;
 }
 
-static void s_FillBlastOutput(blastxml2::CBlastOutput2 & bxmlout, const IBlastXML2ReportData* data)
+/// Fills the BLAST XML output object.
+/// @param bxmlout BLAST XML output object [in] [out]
+/// @param data Data structure, from which all necessary information can be
+///             retrieved [in]
+/// @param hits_hook If not NULL, the hit lists are left empty and are
+///             registered with this hook to be written on output [in]
+static void s_FillBlastOutput(blastxml2::CBlastOutput2 & bxmlout, const IBlastXML2ReportData* data,
+                              CBlastXML2HitsWriteHook* hits_hook = NULL)
 {
 	if(data == NULL)
 		 NCBI_THROW(CException, eUnknown, "blastxml2: NULL XML2ReportData pointer");
@@ -680,7 +738,7 @@ static void s_FillBlastOutput(blastxml2::CBlastOutput2 & bxmlout, const IBlastXM
 		list<CRef<blastxml2::CSearch> > & bl2seq = results.SetBl2seq();
 		for(int i=0; i < data->GetNumOfSearchResults(); i++ ) {
 			CRef<blastxml2::CSearch>  search (new blastxml2::CSearch);
-			s_SetBlastXMLSearch(*search, data, i);
+			s_SetBlastXMLSearch(*search, data, i, hits_hook);
 			bl2seq.push_back(search);
 		}
 
@@ -691,13 +749,13 @@ static void s_FillBlastOutput(blastxml2::CBlastOutput2 & bxmlout, const IBlastXM
 			CRef<blastxml2::CIteration> itr (new blastxml2::CIteration);
 			itr->SetIter_num(i+1);
 			blastxml2::CSearch & search = itr->SetSearch();
-			s_SetBlastXMLSearch(search, data, i);
+			s_SetBlastXMLSearch(search, data, i, hits_hook);
 			iterations.push_back(itr);
 		}
 	}
 	else {
 		blastxml2::CSearch & search = results.SetSearch();
-		s_SetBlastXMLSearch(search, data, 0);
+		s_SetBlastXMLSearch(search, data, 0, hits_hook);
 	}
 
 }
@@ -714,19 +772,25 @@ public:
 };
 
 static void
-s_WriteXML2ObjectNoHeader(blastxml2::CBlastOutput2 & bxmlout, CNcbiOstream *out_stream)
+s_WriteXML2ObjectNoHeader(blastxml2::CBlastOutput2 & bxmlout, CNcbiOstream *out_stream,
+                           CBlastXML2HitsWriteHook* hits_hook = NULL)
 {
     TTypeInfo typeInfo = bxmlout.GetThisTypeInfo();
     unique_ptr<CBlastOStreamXml> xml_out(new CBlastOStreamXml (*out_stream, eNoOwnership));
     xml_out->SetEncoding(eEncoding_Ascii);
     xml_out->SetVerifyData( eSerialVerifyData_No );
     xml_out->SetEnforcedStdXml();
+    if (hits_hook) {
+        CObjectTypeInfo(CType<blastxml2::CSearch>()).FindMember("hits")
+            .SetLocalWriteHook(*xml_out, hits_hook);
+    }
     xml_out->Write(&bxmlout, typeInfo );
 }
 
 
 static void
-s_WriteXML2Object(blastxml2::CBlastOutput2 & bxmlout, CNcbiOstream *out_stream)
+s_WriteXML2Object(blastxml2::CBlastOutput2 & bxmlout, CNcbiOstream *out_stream,
+                   CBlastXML2HitsWriteHook* hits_hook = NULL)
 {
     TTypeInfo typeInfo = bxmlout.GetThisTypeInfo();
     unique_ptr<CObjectOStreamXml> xml_out(new CObjectOStreamXml (*out_stream, eNoOwnership));
@@ -738,6 +802,10 @@ s_WriteXML2Object(blastxml2::CBlastOutput2 & bxmlout, CNcbiOstream *out_stream)
     xml_out->SetEnforcedStdXml();
     xml_out->SetDTDFilePrefix("http://www.ncbi.nlm.nih.gov/data_specs/schema_alt/");
     xml_out->SetDefaultSchemaNamespace("http://www.ncbi.nlm.nih.gov");
+    if (hits_hook) {
+        CObjectTypeInfo(CType<blastxml2::CSearch>()).FindMember("hits")
+            .SetLocalWriteHook(*xml_out, hits_hook);
+    }
     xml_out->Write(&bxmlout, typeInfo );
 }
 
@@ -751,8 +819,9 @@ BlastXML2_FormatReport(const IBlastXML2ReportData* data, CNcbiOstream *out_strea
 {
 	blastxml2::CBlastOutput2 bxmlout;
 	try {
-		s_FillBlastOutput(bxmlout, data);
-		s_WriteXML2ObjectNoHeader(bxmlout, out_stream);
+		CRef<CBlastXML2HitsWriteHook> hits_hook(new CBlastXML2HitsWriteHook(data));
+		s_FillBlastOutput(bxmlout, data, hits_hook.GetPointer());
+		s_WriteXML2ObjectNoHeader(bxmlout, out_stream, hits_hook.GetPointer());
 	}
 	catch(CException &e){
 	    ERR_POST(Error << e.GetMsg() << e.what() );
@@ -773,8 +842,16 @@ BlastXML2_FormatReport(const IBlastXML2ReportData* data, string file_name)
 		if(!out_stream.is_open())
 			 NCBI_THROW(CArgException, eInvalidArg, "Cannot open output file");
 
-		s_FillBlastOutput(bxmlout, data);
-		s_WriteXML2Object(bxmlout, &out_stream);
+		CRef<CBlastXML2HitsWriteHook> hits_hook(new CBlastXML2HitsWriteHook(data));
+		s_FillBlastOutput(bxmlout, data, hits_hook.GetPointer());
+		s_WriteXML2Object(bxmlout, &out_stream, hits_hook.GetPointer());
+}
+
+void
+BlastXML2_FillReport(blastxml2::CBlastOutput2& bxmlout,
+                     const IBlastXML2ReportData* data)
+{
+	s_FillBlastOutput(bxmlout, data);
 }
 
 void
@@ -837,25 +914,35 @@ BlastJSON_PrintHeader(CNcbiOstream *out_stream)
 }
 
 static void
-s_WriteJSONObjectNoHeader(blastxml2::CBlastOutput2 & bxmlout, CNcbiOstream *out_stream)
+s_WriteJSONObjectNoHeader(blastxml2::CBlastOutput2 & bxmlout, CNcbiOstream *out_stream,
+                           CBlastXML2HitsWriteHook* hits_hook = NULL)
 {
     TTypeInfo typeInfo = bxmlout.GetThisTypeInfo();
     unique_ptr<CObjectOStreamJson> json_out(new CBlastOStreamJson (*out_stream, eNoOwnership));
     json_out->SetDefaultStringEncoding(eEncoding_Ascii);
     //json_out.SetUseIndentation(true);
     //json_out.SetUseEol(true);
+    if (hits_hook) {
+        CObjectTypeInfo(CType<blastxml2::CSearch>()).FindMember("hits")
+            .SetLocalWriteHook(*json_out, hits_hook);
+    }
     json_out->Write(&bxmlout, typeInfo );
 }
 
 
 static void
-s_WriteJSONObject(blastxml2::CBlastOutput2 & bxmlout, CNcbiOstream *out_stream)
+s_WriteJSONObject(blastxml2::CBlastOutput2 & bxmlout, CNcbiOstream *out_stream,
+                   CBlastXML2HitsWriteHook* hits_hook = NULL)
 {
     TTypeInfo typeInfo = bxmlout.GetThisTypeInfo();
     unique_ptr<CObjectOStreamJson> json_out(new CObjectOStreamJson (*out_stream, eNoOwnership));
     json_out->SetDefaultStringEncoding(eEncoding_Ascii);
     //json_out.SetUseIndentation(true);
     //json_out.SetUseEol(true);
+    if (hits_hook) {
+        CObjectTypeInfo(CType<blastxml2::CSearch>()).FindMember("hits")
+            .SetLocalWriteHook(*json_out, hits_hook);
+    }
     json_out->Write(&bxmlout, typeInfo );
 }
 
@@ -869,8 +956,9 @@ BlastJSON_FormatReport(const IBlastXML2ReportData* data, string file_name)
 		if(!out_stream.is_open())
 			 NCBI_THROW(CArgException, eInvalidArg, "Cannot open output file");
 
-		s_FillBlastOutput(bxmlout, data);
-		s_WriteJSONObject(bxmlout, &out_stream);
+		CRef<CBlastXML2HitsWriteHook> hits_hook(new CBlastXML2HitsWriteHook(data));
+		s_FillBlastOutput(bxmlout, data, hits_hook.GetPointer());
+		s_WriteJSONObject(bxmlout, &out_stream, hits_hook.GetPointer());
 }
 
 void
@@ -878,8 +966,9 @@ BlastJSON_FormatReport(const IBlastXML2ReportData* data, CNcbiOstream *out_strea
 {
 	blastxml2::CBlastOutput2 bxmlout;
 	try {
-		s_FillBlastOutput(bxmlout, data);
-		s_WriteJSONObjectNoHeader(bxmlout, out_stream);
+		CRef<CBlastXML2HitsWriteHook> hits_hook(new CBlastXML2HitsWriteHook(data));
+		s_FillBlastOutput(bxmlout, data, hits_hook.GetPointer());
+		s_WriteJSONObjectNoHeader(bxmlout, out_stream, hits_hook.GetPointer());
 	}
 	catch(CException &e){
 	    ERR_POST(Error << e.GetMsg() << e.what() );
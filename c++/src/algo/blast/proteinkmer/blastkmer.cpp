@@ -176,62 +176,85 @@ s_GetAllGis(vector<TGi>& retvalue, TBlastKmerPrelimScoreVector results, CRef<CSe
 	}
 }
 
+/// Marks a query as failed; it is skipped by the search and reported
+/// as an error or warning in the results.
+static void
+s_SetQueryError(SOneBlastKmerSearch& kmerSearch, const string& msg, EBlastSeverity severity)
+{
+	kmerSearch.status=1;
+	kmerSearch.errDescription=msg;
+	kmerSearch.severity=severity;
+}
+
 CRef<CBlastKmerResultsSet>
 CBlastKmer::x_SearchMultipleQueries(int firstQuery, int numQuery, const SBlastKmerParameters& kmerParams, uint32_t *a, uint32_t *b, vector < vector<int> >& kValues, vector<int> badMers)
 {
 	TQueryMessages errs;
 	int numThreads = (int) GetNumberOfThreads();
 	int numFiles = m_KmerFiles.size();
-	if (numThreads > numQuery)
-		numThreads = numFiles;
 
-	vector<SOneBlastKmerSearch> kmerSearchVector;
-	kmerSearchVector.reserve(numQuery);
+	// The sequences are fetched from the scope serially, the query
+	// hashes are then computed in parallel.
+	vector<SOneBlastKmerSearch> kmerSearchVector(numQuery, SOneBlastKmerSearch(numFiles));
+	vector<string> querySeqs(numQuery);
 	for (int i=0; i<numQuery; i++)
 	{
-		SOneBlastKmerSearch kmerSearch(numFiles);
+		SOneBlastKmerSearch& kmerSearch = kmerSearchVector[i];
 		try {
-			string query_seq; 
 			CRef<CSeq_id> qseqid; 
-			s_GetQuerySequence(m_QueryVector, query_seq, qseqid, i+firstQuery);
-			if (query_seq.length() < static_cast<string::size_type>(kmerParams.kmerNum))
-				NCBI_THROW(CException, eUnknown, "WARNING: Query shorter than KMER length");
-
+			s_GetQuerySequence(m_QueryVector, querySeqs[i], qseqid, i+firstQuery);
 			kmerSearch.qSeqid = qseqid;
-			x_ProcessQuery(query_seq, kmerSearch, kmerParams, a, b, kValues, badMers);
-		 } catch (const ncbi::CException& e) {
-			kmerSearch.status=1;
-			string msg = e.GetMsg();
-			kmerSearch.errDescription=msg;
-			if (msg.find("WARNING:") != std::string::npos)
-				kmerSearch.severity=eBlastSevWarning;
-			else
-				kmerSearch.severity=eBlastSevError;
+		} catch (const ncbi::CException& e) {
+			s_SetQueryError(kmerSearch, e.GetMsg(), eBlastSevError);
 		} catch (const std::exception& e) {
-			kmerSearch.status=1;
-			kmerSearch.errDescription=string(e.what());
-			kmerSearch.severity=eBlastSevError;
+			s_SetQueryError(kmerSearch, string(e.what()), eBlastSevError);
 		} catch (...) {
-			kmerSearch.status=1;
-			kmerSearch.errDescription=string("Unknown error");
-			kmerSearch.severity=eBlastSevError;
+			s_SetQueryError(kmerSearch, string("Unknown error"), eBlastSevError);
 		}
-		kmerSearchVector.push_back(kmerSearch);
 	}
 
-#pragma omp parallel for num_threads(numThreads)
-for(int index=0; index<numFiles; index++)
+#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+for (int i=0; i<numQuery; i++)
 {
-	CMinHashFile mhfile(m_KmerFiles[index]);
-	for (int i=0; i<numQuery; i++)
-	{
-		SOneBlastKmerSearch& kmerSearch = kmerSearchVector[i];
-		if (kmerSearch.status)
-			continue;
-		x_RunKmerFile(kmerSearch.queryHash, kmerSearch.queryLSHHash, mhfile, kmerSearch.scoreVector[index], (kmerSearch.kmerStatsVector[index]));
+	SOneBlastKmerSearch& kmerSearch = kmerSearchVector[i];
+	if (kmerSearch.status)
+		continue;
+	try {
+		if (querySeqs[i].length() < static_cast<string::size_type>(kmerParams.kmerNum))
+			NCBI_THROW(CException, eUnknown, "WARNING: Query shorter than KMER length");
+
+		x_ProcessQuery(querySeqs[i], kmerSearch, kmerParams, a, b, kValues, badMers);
+	} catch (const ncbi::CException& e) {
+		string msg = e.GetMsg();
+		if (msg.find("WARNING:") != std::string::npos)
+			s_SetQueryError(kmerSearch, msg, eBlastSevWarning);
+		else
+			s_SetQueryError(kmerSearch, msg, eBlastSevError);
+	} catch (const std::exception& e) {
+		s_SetQueryError(kmerSearch, string(e.what()), eBlastSevError);
+	} catch (...) {
+		s_SetQueryError(kmerSearch, string("Unknown error"), eBlastSevError);
 	}
 }
 
+	// Every (volume, query) pair is a separate task, so all threads are
+	// busy even with few volumes.  The memory mapped index volumes are
+	// opened once and shared read-only by the threads; tasks of one volume
+	// are handed out together so its LSH table and signatures stay cached.
+	int numPairs = numFiles*numQuery;
+	if (numThreads > numPairs)
+		numThreads = max(numPairs, 1);
+
+#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+for (int task=0; task<numPairs; task++)
+{
+	int index = task/numQuery;
+	SOneBlastKmerSearch& kmerSearch = kmerSearchVector[task%numQuery];
+	if (kmerSearch.status)
+		continue;
+	x_RunKmerFile(kmerSearch.queryHash, kmerSearch.queryLSHHash, *m_MinHashFiles[index], kmerSearch.scoreVector[index], (kmerSearch.kmerStatsVector[index]));
+}
+
 
         CRef<CBlastKmerResultsSet> kmerResultSet(new CBlastKmerResultsSet()); 
         for (int i=0; i<numQuery; i++)
@@ -323,7 +346,12 @@ CBlastKmer::RunSearches() {
 
 CRef<CBlastKmerResultsSet> 
 CBlastKmer::Run() {
-	CMinHashFile mhfile(m_KmerFiles[0]);
+	if (m_MinHashFiles.empty())
+	{
+		ITERATE(vector<string>, file, m_KmerFiles)
+			m_MinHashFiles.push_back(CRef<CMinHashFile>(new CMinHashFile(*file)));
+	}
+	const CMinHashFile& mhfile = *m_MinHashFiles.front();
 	int kmerVer = mhfile.GetVersion();
         int num_hashes = mhfile.GetNumHashes();
         int samples = mhfile.GetSegStatus();
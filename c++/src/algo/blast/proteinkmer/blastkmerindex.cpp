@@ -134,38 +134,6 @@ CBlastKmerBuildIndex::CBlastKmerBuildIndex(CRef<CSeqDB> seqdb,
 		m_Samples=0; // Occupies the seg position in version 1
 }
 
-// universal hashing mod 1048583.
-inline uint32_t uhash(uint64_t x, uint64_t a, uint64_t b)
-{
-                uint32_t p=PKMER_PRIME;
-                        return ( (a*x + b) % p );
-}
-
-
-/// FNV Hash.  See http://www.isthe.com/chongo/tech/comp/fnv/index.html
-static Uint4 FNV_hash(uint32_t num)
-{
-     const Uint4 fnv_prime = 16777619u;
-     const Uint4 fnv_offset_basis = 2166136261u;
-     Int4 i;
-     Uint4 hash;
-
-     Uint1 key[4];
-     key[0] = num & 0xff;
-     key[1] = (num >> 8) & 0xff;
-     key[2] = (num >> 16) & 0xff;
-     key[3] = (num >> 24) & 0xff;
-     
-
-     hash = fnv_offset_basis;
-     for (i = 0;i < 4;i++) {
-         hash *= fnv_prime;
-         hash ^= key[i];
-     }
-
-     return hash;
-}
-
 // compute kmer set and minhash signature for a query
 void s_MinhashSequences(uint32_t q_oid,
 				   CSeqDB & db,
@@ -203,30 +171,8 @@ void s_MinhashSequences(uint32_t q_oid,
 		}
 
 	
-		vector<uint32_t> idx_tmp(num_hashes);
-		vector<uint32_t> hash_tmp(num_hashes);
-	
-		for(int h=0;h<num_hashes;h++)
-		{
-			hash_tmp[h]=0xffffffff;
-			idx_tmp[h]=0xffffffff;
-		}
-	
-		// for each kmer in the sequence,
-		for(set<uint32_t>::iterator i=seq_kmer.begin(); i != seq_kmer.end(); ++i)
-		{
-			// compute hashes and track their minima
-			for(int h=0;h<num_hashes;h++)
-			{
-				uint32_t hashval = uhash(*i, a[h], b[h]);
-			
-				if (hashval < hash_tmp[h])
-				{
-					hash_tmp[h] = hashval;
-					idx_tmp[h]  = *i;
-				}
-			}
-		} // end each kmer
+		vector<uint32_t> idx_tmp;
+		BlastKmerGetMinHashSignature(seq_kmer, num_hashes, a, b, idx_tmp);
 
 		if (first_time == false)
 		{
@@ -295,27 +241,8 @@ void s_MinhashSequences2(uint32_t q_oid,
 		}
 
 	
-		vector<uint32_t> hash_values;
-		vector<uint32_t> idx_tmp(num_hashes);
-	
-		// for each kmer in the sequence,
-		for(set<uint32_t>::iterator i=seq_kmer.begin(); i != seq_kmer.end(); ++i)
-		{
-			uint32_t hashval = FNV_hash(*i);
-			hash_values.push_back(hashval);
-	
-		} // end each kmer
-		if (hash_values.size() < static_cast<size_t>(num_hashes))
-		{
-			int rem = 1 + num_hashes - hash_values.size();
-			uint32_t hashval = 0xffffffff;  // Fill in empties
-			for (int i=0; i<rem; i++)
-				hash_values.push_back(hashval);
-		}
-		std::sort(hash_values.begin(), hash_values.end());
-		
-		for(int i=0; i<num_hashes; i++)
-			idx_tmp[i] = hash_values[i];
+		vector<uint32_t> idx_tmp;
+		BlastKmerGetMinHashSignature2(seq_kmer, num_hashes, idx_tmp);
 
 		if (first_time == false)
 		{
@@ -38,6 +38,13 @@
 #include <algo/blast/core/blast_encoding.h>
 #include <math.h>
 
+#if NCBI_SSE >= 20
+#  include <emmintrin.h>
+#endif
+#if NCBI_SSE >= 41
+#  include <smmintrin.h>
+#endif
+
 #include <algo/blast/proteinkmer/blastkmerutils.hpp>
 #include <algo/blast/proteinkmer/mhfile.hpp>
 
@@ -85,16 +92,54 @@ static uint32_t FNV_hash(uint32_t num)
 }
 
 
+#if NCBI_SSE >= 20
+// Lanes of a 16 byte register comparing equal, as one bit per byte.
+template <typename T>
+inline int s_CompareEqual(const T* a, const T* b);
+
+template <>
+inline int s_CompareEqual<uint8_t>(const uint8_t* a, const uint8_t* b)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b)));
+}
+
+template <>
+inline int s_CompareEqual<uint16_t>(const uint16_t* a, const uint16_t* b)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b)));
+}
+
+template <>
+inline int s_CompareEqual<uint32_t>(const uint32_t* a, const uint32_t* b)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b)));
+}
+
+// Number of bits set in a 16 bit mask.
+inline int s_BitCount16(unsigned int x)
+{
+	x = x - ((x >> 1) & 0x5555);
+	x = (x & 0x3333) + ((x >> 2) & 0x3333);
+	x = (x + (x >> 4)) & 0x0f0f;
+	return (x + (x >> 8)) & 0x1f;
+}
+#endif
+
 // estimate Jaccard similarity using minhashes
-inline double estimate_jaccard(vector<uint32_t>& query_hash, vector<uint32_t>& subject, int num_hashes)
+template <typename T>
+inline double estimate_jaccard(const T* a, const T* b, int num_hashes)
 {
 	int score=0;
-	
-	// help the compiler vectorize
-	uint32_t *a=&(query_hash[0]);
-	uint32_t *b=&(subject[0]);
-	
-	for(int h=0;h<num_hashes;h++)
+	int h=0;
+
+#if NCBI_SSE >= 20
+	const int kLanes = 16/sizeof(T);
+	for (; h+kLanes <= num_hashes; h += kLanes)
+		score += s_BitCount16(s_CompareEqual<T>(a+h, b+h));
+	score /= sizeof(T);
+#endif
+
+	for(;h<num_hashes;h++)
 	{
 		if (a[h] == b[h])
 			score++;
@@ -105,14 +150,11 @@ inline double estimate_jaccard(vector<uint32_t>& query_hash, vector<uint32_t>& s
 
 
 // estimate Jaccard similarity with one hash function
-inline double estimate_jaccard2(vector<uint32_t>& query_hash, vector<uint32_t>& subject, int num_hashes)
+template <typename T>
+inline double estimate_jaccard2(const T* a, const T* b, int num_hashes)
 {
 	int score=0;
 	
-	// help the compiler vectorize
-	uint32_t *a=&(query_hash[0]);
-	uint32_t *b=&(subject[0]);
-
 	int bindex=0;
 	for(int h=0;h<num_hashes;h++)
 	{	// DOes a[h] < b[bindex] make any sense?
@@ -129,6 +171,151 @@ inline double estimate_jaccard2(vector<uint32_t>& query_hash, vector<uint32_t>&
 	return (double) score / num_hashes;
 }
 
+// estimate Jaccard similarity of a query signature and a signature
+// read in place from the index; both have values width bytes wide.
+static double s_EstimateJaccard(const unsigned char* query, const unsigned char* subject, int width, int num_hashes, int kmerVer)
+{
+	if (width == 1)
+	{
+		const uint8_t* a = (const uint8_t*) query;
+		const uint8_t* b = (const uint8_t*) subject;
+		return kmerVer < 3 ? estimate_jaccard(a, b, num_hashes) : estimate_jaccard2(a, b, num_hashes);
+	}
+	else if (width == 2)
+	{
+		const uint16_t* a = (const uint16_t*) query;
+		const uint16_t* b = (const uint16_t*) subject;
+		return kmerVer < 3 ? estimate_jaccard(a, b, num_hashes) : estimate_jaccard2(a, b, num_hashes);
+	}
+	const uint32_t* a = (const uint32_t*) query;
+	const uint32_t* b = (const uint32_t*) subject;
+	return kmerVer < 3 ? estimate_jaccard(a, b, num_hashes) : estimate_jaccard2(a, b, num_hashes);
+}
+
+// Copy a signature to values width bytes wide, as they are in the index.
+template <typename T>
+static void s_PackSignature(const vector<uint32_t>& signature, vector<unsigned char>& packed)
+{
+	packed.resize(signature.size()*sizeof(T));
+	T* array = (T*) &packed[0];
+	for (size_t i=0; i<signature.size(); i++)
+		array[i] = (T) signature[i];
+}
+
+#if NCBI_SSE >= 20
+// uhash for the kmer x and four hash functions at once.  All values are
+// reduced modulo the prime first, so a*x+b is below 2^41 and exact in
+// double precision; the quotient estimate is off by at most one.
+inline __m128i s_UHash4(__m128d x, const double* a, const double* b)
+{
+	const __m128d kPrime = _mm_set1_pd((double)PKMER_PRIME);
+	const __m128d kInvPrime = _mm_set1_pd(1.0/PKMER_PRIME);
+
+	__m128d v0 = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(a), x), _mm_loadu_pd(b));
+	__m128d v1 = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(a+2), x), _mm_loadu_pd(b+2));
+	__m128d q0 = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_mul_pd(v0, kInvPrime)));
+	__m128d q1 = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_mul_pd(v1, kInvPrime)));
+	__m128i r = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_sub_pd(v0, _mm_mul_pd(q0, kPrime))),
+	                               _mm_cvttpd_epi32(_mm_sub_pd(v1, _mm_mul_pd(q1, kPrime))));
+
+	const __m128i kPrimeInt = _mm_set1_epi32(PKMER_PRIME);
+	r = _mm_add_epi32(r, _mm_and_si128(_mm_cmplt_epi32(r, _mm_setzero_si128()), kPrimeInt));
+	r = _mm_sub_epi32(r, _mm_andnot_si128(_mm_cmplt_epi32(r, kPrimeInt), kPrimeInt));
+	return r;
+}
+#endif
+
+void BlastKmerGetMinHashSignature(const set<uint32_t>& kmers, int num_hashes, const uint32_t* a, const uint32_t* b, vector<uint32_t>& signature)
+{
+	signature.assign(num_hashes, 0xffffffff);
+	int h=0;
+
+#if NCBI_SSE >= 20
+	int num_simd = num_hashes - num_hashes%4;
+	if (num_simd > 0)
+	{
+		vector<double> a_mod(num_simd), b_mod(num_simd), x_mod;
+		for (int i=0; i<num_simd; i++)
+		{
+			a_mod[i] = a[i]%PKMER_PRIME;
+			b_mod[i] = b[i]%PKMER_PRIME;
+		}
+		x_mod.reserve(kmers.size());
+		for(set<uint32_t>::const_iterator i=kmers.begin(); i != kmers.end(); ++i)
+			x_mod.push_back(*i%PKMER_PRIME);
+
+		// four hash functions per pass, tracking their minima over all
+		// kmers; hash values are below 2^31, so signed compares are fine.
+		for (; h<num_simd; h += 4)
+		{
+			__m128i hash_min = _mm_set1_epi32(0x7fffffff);
+			__m128i idx_min = _mm_set1_epi32(-1);
+			size_t k=0;
+			for(set<uint32_t>::const_iterator i=kmers.begin(); i != kmers.end(); ++i, k++)
+			{
+				__m128i hashval = s_UHash4(_mm_set1_pd(x_mod[k]), &a_mod[h], &b_mod[h]);
+				__m128i less = _mm_cmplt_epi32(hashval, hash_min);
+				hash_min = _mm_or_si128(_mm_and_si128(less, hashval), _mm_andnot_si128(less, hash_min));
+				idx_min = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi32(*i)), _mm_andnot_si128(less, idx_min));
+			}
+			_mm_storeu_si128((__m128i*)&signature[h], idx_min);
+		}
+	}
+#endif
+
+	for (; h<num_hashes; h++)
+	{
+		uint32_t hash_min=0xffffffff;
+		for(set<uint32_t>::const_iterator i=kmers.begin(); i != kmers.end(); ++i)
+		{
+			uint32_t hashval = uhash(*i, a[h], b[h]);
+			if (hashval < hash_min)
+			{
+				hash_min = hashval;
+				signature[h] = *i;
+			}
+		}
+	}
+}
+
+void BlastKmerGetMinHashSignature2(const set<uint32_t>& kmers, int num_hashes, vector<uint32_t>& signature)
+{
+	vector<uint32_t> hash_values(kmers.begin(), kmers.end());
+	size_t num = hash_values.size();
+	size_t k=0;
+
+#if NCBI_SSE >= 41
+	// FNV hash of four kmers at once
+	const __m128i kPrime = _mm_set1_epi32(16777619u);
+	const __m128i kLowByte = _mm_set1_epi32(0xff);
+	for (; k+4 <= num; k += 4)
+	{
+		__m128i key = _mm_loadu_si128((const __m128i*)&hash_values[k]);
+		__m128i hash = _mm_set1_epi32(2166136261u);
+		hash = _mm_xor_si128(_mm_mullo_epi32(hash, kPrime), _mm_and_si128(key, kLowByte));
+		hash = _mm_xor_si128(_mm_mullo_epi32(hash, kPrime), _mm_and_si128(_mm_srli_epi32(key, 8), kLowByte));
+		hash = _mm_xor_si128(_mm_mullo_epi32(hash, kPrime), _mm_and_si128(_mm_srli_epi32(key, 16), kLowByte));
+		hash = _mm_xor_si128(_mm_mullo_epi32(hash, kPrime), _mm_srli_epi32(key, 24));
+		_mm_storeu_si128((__m128i*)&hash_values[k], hash);
+	}
+#endif
+	for (; k<num; k++)
+		hash_values[k] = FNV_hash(hash_values[k]);
+
+	// Only the smallest values are needed, in ascending order.
+	if (num > static_cast<size_t>(num_hashes))
+	{
+		std::partial_sort(hash_values.begin(), hash_values.begin()+num_hashes, hash_values.end());
+		hash_values.resize(num_hashes);
+	}
+	else
+	{
+		std::sort(hash_values.begin(), hash_values.end());
+		hash_values.resize(num_hashes, 0xffffffff);  // Fill in empties
+	}
+	signature.swap(hash_values);
+}
+
 set<uint32_t> BlastKmerGetKmerSetStats(const string& query_sequence, int kmerNum, map<string, int>& kmerCount, map<string, int>& kmerCountPlus, int alphabetChoice, bool perQuery)
 {
 	// the set of unique kmers
@@ -429,8 +616,6 @@ bool minhash_query(const string& query,
 	seq_hash.resize(chunk_num);
 	bool seg = (do_seg > 0) ? true : false;
 
-	vector<uint32_t> idx_tmp(num_hashes);
-	vector<uint32_t> hash_tmp(num_hashes);
 	int chunk_iter=0;
     for(vector<TSeqRange>::iterator iter=range_v.begin(); iter != range_v.end(); ++iter, chunk_iter++)
     {
@@ -444,33 +629,8 @@ bool minhash_query(const string& query,
 	
 		kmersFound = true;
 	
-		for(int h=0;h<num_hashes;h++)
-		{
-			hash_tmp[h]=0xffffffff;
-			idx_tmp[h]=0xffffffff;
-		}
-	
-		// for each kmer in the sequence,
-		for(set<uint32_t>::iterator i=seq_kmer.begin(); i != seq_kmer.end(); ++i)
-		{
-			// compute hashes and track their minima
-			for(int h=0;h<num_hashes;h++)
-			{
-				uint32_t hashval = uhash(*i, a[h], b[h]);
-				
-				if (hashval < hash_tmp[h])
-				{
-					hash_tmp[h] = hashval;
-					idx_tmp[h]  = *i;
-				}
-			}
-		} // end each kmer
-	
 		// save the kmers with the minimum hash values
-		for(int h=0;h<num_hashes;h++)
-		{
-			seq_hash[chunk_iter][h] = idx_tmp[h];
-		}
+		BlastKmerGetMinHashSignature(seq_kmer, num_hashes, a, b, seq_hash[chunk_iter]);
 	}
 	return kmersFound;
 }
@@ -490,11 +650,9 @@ bool minhash_query2(const string& query,
 	int chunk_num = BlastKmerBreakUpSequence(seq_length, range_v, chunkSize);
 	seq_hash.resize(chunk_num);
 
-	vector<uint32_t> hash_values;
 	int chunk_iter=0;
     for(vector<TSeqRange>::iterator iter=range_v.begin(); iter != range_v.end(); ++iter, chunk_iter++)
     {
-		hash_values.clear();
 		seq_hash[chunk_iter].resize(numHashes);
 
 		set<uint32_t> seq_kmer = BlastKmerGetKmerSet2(query, *iter, kmerNum, alphabetChoice, badMers);
@@ -504,26 +662,7 @@ bool minhash_query2(const string& query,
 	
 		kmersFound = true;
 	
-		// for each kmer in the sequence,
-		for(set<uint32_t>::iterator i=seq_kmer.begin(); i != seq_kmer.end(); ++i)
-		{
-			uint32_t hashval = FNV_hash(*i);
-			hash_values.push_back(hashval);
-				
-		} // end each kmer
-		
-		if (hash_values.size() < static_cast<size_t>(numHashes))
-        {
-            int rem = 1 + numHashes - hash_values.size();
-            uint32_t hashval = 0xffffffff;  // Fill in empties
-            for (int i=0; i<rem; i++)
-                    hash_values.push_back(hashval);
-        }
-        std::sort(hash_values.begin(), hash_values.end());
-
-		// save the kmers with the minimum hash values
-		for(int h=0;h<numHashes;h++)
-			seq_hash[chunk_iter][h] = hash_values[h];
+		BlastKmerGetMinHashSignature2(seq_kmer, numHashes, seq_hash[chunk_iter]);
 	}
 	return kmersFound;
 }
@@ -788,10 +927,21 @@ void neighbor_query(const vector < vector <uint32_t> >& query_hash,
 	}
 
 	vector < vector <uint32_t> > query_hash_hash; 
-	s_HashHashQuery(query_hash, query_hash_hash, mhfile.GetDataWidth(), mhfile.GetVersion());
+	int width = mhfile.GetDataWidth();
+	s_HashHashQuery(query_hash, query_hash_hash, width, mhfile.GetVersion());
 
-	vector <uint32_t> subject_hash;
-	subject_hash.resize(num_hashes);
+	// Query signatures with the width of the index, so the subject
+	// signatures can be compared in place.
+	vector < vector <unsigned char> > query_signature(num_chunks);
+	for (int n=0; n<num_chunks; n++)
+	{
+		if (width == 1)
+			s_PackSignature<uint8_t>(query_hash_hash[n], query_signature[n]);
+		else if (width == 2)
+			s_PackSignature<uint16_t>(query_hash_hash[n], query_signature[n]);
+		else
+			s_PackSignature<uint32_t>(query_hash_hash[n], query_signature[n]);
+	}
 
 	map< int, double > score_map;
 	typedef map< int, double >::value_type score_mapValType;
@@ -821,12 +971,8 @@ void neighbor_query(const vector < vector <uint32_t> >& query_hash,
 	
 			int oid = *i;
    			int subject_oid=0;
-			mhfile.GetMinHits(oid, subject_oid, subject_hash);
-			double current_score=0;
-			if (kmerVer < 3)
-				current_score = estimate_jaccard(query_hash_hash[n], subject_hash, num_hashes);
-			else
-				current_score = estimate_jaccard2(query_hash_hash[n], subject_hash, num_hashes);
+			const unsigned char* subject_hash = mhfile.GetSignature(oid, subject_oid);
+			double current_score = s_EstimateJaccard(&query_signature[n][0], subject_hash, width, num_hashes, kmerVer);
 			kmer_stats.jd_count++;
 			if (current_score < thresh)
 				continue;
@@ -173,6 +173,7 @@ CRef<CSearchResultSet> CBlastKmerSearch::Run(void)
 		_ASSERT(!tsl_v.empty());
 	}
 	CRef<CBlastKmer> blastkmer(new CBlastKmer(tsl_v, opts, seqdb));
+	blastkmer->SetNumberOfThreads(GetNumberOfThreads());
 	if (!m_GIList.Empty())
 		blastkmer->SetGiListLimit(m_GIList);
 	else if(!m_NegGIList.Empty())
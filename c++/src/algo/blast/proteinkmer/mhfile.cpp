@@ -98,6 +98,17 @@ CMinHashFile::GetMinHits(int oid, int& subject_oid, vector<uint32_t>& hits) cons
 	}
 }
 
+const unsigned char*
+CMinHashFile::GetSignature(int oid, int& subject_oid) const
+{
+	int width = GetDataWidth();
+	int numHashes = GetNumHashes();
+	const unsigned char* array = m_MinHitsData + (uint64_t)(width*numHashes+4)*oid;
+	subject_oid = *(const uint32_t*) (array + width*numHashes);
+
+	return array;
+}
+
 uint32_t* 
 CMinHashFile::GetRandomNumbers(void) const 
 {
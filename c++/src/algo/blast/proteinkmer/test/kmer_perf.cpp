@@ -0,0 +1,195 @@
+/*  $Id$
+ * ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+/** @file kmer_perf.cpp
+ * Command line tool to time KMER BLAST searches with a growing number of
+ * threads.
+ */
+
+#include <ncbi_pch.hpp>
+#include <corelib/ncbiapp.hpp>
+#include <corelib/ncbitime.hpp>
+#include <objmgr/object_manager.hpp>
+#include <objmgr/scope.hpp>
+#include <objects/seqalign/Seq_align_set.hpp>
+#include <objtools/readers/fasta.hpp>
+#include <algo/blast/api/blastp_kmer_options.hpp>
+#include <algo/blast/api/local_db_adapter.hpp>
+#include <algo/blast/api/objmgr_query_data.hpp>
+#include <algo/blast/proteinkmer/kblastapi.hpp>
+
+#ifndef SKIP_DOXYGEN_PROCESSING
+USING_NCBI_SCOPE;
+USING_SCOPE(objects);
+USING_SCOPE(blast);
+#endif
+
+/// The application class
+class CKmerPerfApp : public CNcbiApplication
+{
+public:
+    /** @inheritDoc */
+    CKmerPerfApp() {}
+
+private:
+    /** @inheritDoc */
+    virtual void Init();
+    /** @inheritDoc */
+    virtual int Run();
+
+    /// Search all queries with the given number of threads
+    /// @param num_threads number of threads [in]
+    /// @param num_aligns number of alignments found [out]
+    /// @return the search time in seconds
+    double x_Search(size_t num_threads, size_t& num_aligns);
+
+    /// The queries as read from the FASTA input
+    vector< CRef<CSeq_entry> > m_Queries;
+};
+
+double CKmerPerfApp::x_Search(size_t num_threads, size_t& num_aligns)
+{
+    // CBlastKmerSearch adds the subject sequences to the scope of the
+    // queries, so each search gets a fresh one
+    CRef<CScope> scope(new CScope(*CObjectManager::GetInstance()));
+    TSeqLocVector query_vector;
+    ITERATE(vector< CRef<CSeq_entry> >, entry, m_Queries) {
+        scope->AddTopLevelSeqEntry(**entry);
+        CRef<CSeq_loc> loc(new CSeq_loc);
+        loc->SetWhole().Assign(*(*entry)->GetSeq().GetFirstId());
+        query_vector.push_back(SSeqLoc(loc, scope));
+    }
+
+    CRef<IQueryFactory> query_factory(new CObjMgr_QueryFactory(query_vector));
+    CRef<CBlastpKmerOptionsHandle> opts(new CBlastpKmerOptionsHandle);
+    CSearchDatabase dbinfo(GetArgs()["db"].AsString(),
+                           CSearchDatabase::eBlastDbIsProtein);
+    CRef<CLocalDbAdapter> db(new CLocalDbAdapter(dbinfo));
+
+    CStopWatch sw(CStopWatch::eStart);
+    CBlastKmerSearch search(query_factory, opts, db);
+    search.SetNumberOfThreads(num_threads);
+    CRef<CSearchResultSet> results = search.Run();
+    double retval = sw.Elapsed();
+
+    num_aligns = 0;
+    ITERATE(CSearchResultSet, result, *results) {
+        if ((*result)->HasAlignments()) {
+            num_aligns += (*result)->GetSeqAlign()->Get().size();
+        }
+    }
+    return retval;
+}
+
+void CKmerPerfApp::Init()
+{
+    HideStdArgs(fHideConffile | fHideFullVersion | fHideXmlHelp | fHideDryRun);
+
+    unique_ptr<CArgDescriptions> arg_desc(new CArgDescriptions);
+
+    arg_desc->SetUsageContext(GetArguments().GetProgramBasename(),
+                  "Time KMER BLAST searches with 1, 2, 4, ... threads");
+
+    arg_desc->AddKey("db", "database_name",
+                     "Protein BLAST database with a KMER index",
+                     CArgDescriptions::eString);
+    arg_desc->AddKey("query", "fasta_file", "Protein FASTA queries",
+                     CArgDescriptions::eInputFile);
+    arg_desc->AddDefaultKey("max_threads", "number",
+                            "Largest number of threads to time",
+                            CArgDescriptions::eInteger, "8");
+    arg_desc->SetConstraint("max_threads",
+                            new CArgAllow_Integers(1, kMax_Int));
+
+    SetupArgDescriptions(arg_desc.release());
+}
+
+int CKmerPerfApp::Run(void)
+{
+    int status = 0;
+
+    try {
+        const CArgs& args = GetArgs();
+        CFastaReader reader(args["query"].AsInputFile(),
+                            CFastaReader::fAssumeProt |
+                            CFastaReader::fForceType);
+        while ( !reader.AtEOF() ) {
+            m_Queries.push_back(reader.ReadOneSeq());
+        }
+        if (m_Queries.empty()) {
+            NCBI_THROW(CException, eInvalid, "No queries in the input");
+        }
+
+        // the first search warms up the memory mapped database and index
+        // files; it is not timed
+        size_t expected = 0;
+        x_Search(1, expected);
+
+        cout << m_Queries.size() << " queries, " << expected
+             << " alignments" << endl;
+
+        double single_thread_time = 0.0;
+        for (size_t num_threads = 1;
+             num_threads <= (size_t)args["max_threads"].AsInteger();
+             num_threads *= 2) {
+            size_t num_aligns = 0;
+            double time = x_Search(num_threads, num_aligns);
+            if (num_threads == 1) {
+                single_thread_time = time;
+            }
+
+            cout << num_threads << " thread(s): "
+                 << NStr::DoubleToString(time, 2) << " s, "
+                 << NStr::DoubleToString(m_Queries.size() / time, 1)
+                 << " queries/second, speedup "
+                 << NStr::DoubleToString(single_thread_time / time, 2)
+                 << endl;
+
+            if (num_aligns != expected) {
+                ERR_POST(Error << num_threads << " thread(s) found "
+                         << num_aligns << " alignments instead of "
+                         << expected);
+                status = 1;
+            }
+        }
+    } catch (const exception& e) {
+        ERR_POST(Error << "Error: " << e.what());
+        status = 1;
+    } catch (...) {
+        cerr << "Unknown exception!" << endl;
+        status = 1;
+    }
+
+    return status;
+}
+
+#ifndef SKIP_DOXYGEN_PROCESSING
+int main(int argc, const char* argv[] /*, const char* envp[]*/)
+{
+    return CKmerPerfApp().AppMain(argc, argv);
+}
+#endif /* SKIP_DOXYGEN_PROCESSING */
@@ -519,6 +519,52 @@ BOOST_AUTO_TEST_CASE(CheckQueryHashesVersion3)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(CheckMinHashSignature)
+{
+	// Not a multiple of the SIMD width, so both code paths are used.
+	const int kNumHashes=38;
+	uint32_t a[kNumHashes];
+	uint32_t b[kNumHashes];
+	s_GetRandomNumbers(a, b, kNumHashes);
+
+	set<uint32_t> kmers;
+	CRandom random(7);
+	while (kmers.size() < 100)
+		kmers.insert(1 + random.GetRand() % 0xfffff);
+
+	vector<uint32_t> signature;
+	BlastKmerGetMinHashSignature(kmers, kNumHashes, a, b, signature);
+	BOOST_REQUIRE_EQUAL(signature.size(), kNumHashes);
+	for (int h=0; h<kNumHashes; h++)
+	{
+		uint64_t min_hash = PKMER_PRIME;
+		uint32_t min_kmer = 0;
+		for (set<uint32_t>::iterator i=kmers.begin(); i != kmers.end(); ++i)
+		{
+			uint64_t hashval = ((uint64_t)a[h]*(*i) + b[h]) % PKMER_PRIME;
+			if (hashval < min_hash)
+			{
+				min_hash = hashval;
+				min_kmer = *i;
+			}
+		}
+		BOOST_REQUIRE_EQUAL(signature[h], min_kmer);
+	}
+
+	// Fewer kmers than hashes: sorted and padded.
+	set<uint32_t> few_kmers;
+	few_kmers.insert(12345);
+	few_kmers.insert(54321);
+	few_kmers.insert(99999);
+	BlastKmerGetMinHashSignature2(few_kmers, kNumHashes, signature);
+	BOOST_REQUIRE_EQUAL(signature.size(), kNumHashes);
+	BOOST_REQUIRE(signature[0] < signature[1]);
+	BOOST_REQUIRE(signature[1] < signature[2]);
+	BOOST_REQUIRE(signature[2] < 0xffffffff);
+	BOOST_REQUIRE_EQUAL(signature[3], 0xffffffff);
+	BOOST_REQUIRE_EQUAL(signature[kNumHashes-1], 0xffffffff);
+}
+
 int s_GetNumLSHHits(uint64_t* lsh, int lshSize)
 {
 	int count=0;
@@ -559,6 +605,59 @@ BOOST_AUTO_TEST_CASE(BuildIndex)
 	BOOST_REQUIRE_EQUAL(187, lsh_counts);
 }
 
+BOOST_AUTO_TEST_CASE(MultiThreadedSearch)
+{
+        CRef<CSeqDB> seqdb(new CSeqDB("data/nr_test", CSeqDB::eProtein));
+
+        CBlastKmerBuildIndex build_index(seqdb, 5, 32);
+
+	string index_name("nr_test");
+	CFileDeleteAtExit::Add(index_name + ".pki");
+	CFileDeleteAtExit::Add(index_name + ".pkd");
+        build_index.Build();
+
+	CRef<CScope> scope(CSimpleOM::NewScope(false));
+	TSeqLocVector query_vector;
+	const char* kQueryFiles[] = { "data/129295.stdaa", "data/129296.ncbieaa" };
+	for (int i=0; i<2; i++)
+	{
+		CRef<CBioseq> bioseq(new CBioseq);
+		CNcbiIfstream i_file(kQueryFiles[i]);
+		unique_ptr<CObjectIStream> is(CObjectIStream::Open(eSerial_AsnText, i_file));
+		*is >> *bioseq;
+		scope->AddBioseq(*bioseq);
+		CRef<CSeq_loc> loc(new CSeq_loc);
+		loc->SetWhole().Assign(*(bioseq->GetId().front()));
+		query_vector.push_back(SSeqLoc(*loc, *scope));
+	}
+	CRef<CBlastKmerOptions> options(new CBlastKmerOptions());
+	options->SetThresh(0.1);
+
+	// Searching (query, volume) pairs on several threads gives the
+	// same results as one thread.
+	CBlastKmer kmersearch1(query_vector, options, seqdb, index_name);
+	CRef<CBlastKmerResultsSet> resultSet1 = kmersearch1.Run();
+	CBlastKmer kmersearch4(query_vector, options, seqdb, index_name);
+	kmersearch4.SetNumberOfThreads(4);
+	CRef<CBlastKmerResultsSet> resultSet4 = kmersearch4.Run();
+
+	BOOST_REQUIRE_EQUAL(resultSet1->GetNumQueries(), 2);
+	BOOST_REQUIRE_EQUAL(resultSet4->GetNumQueries(), 2);
+	for (int i=0; i<2; i++)
+	{
+		const TBlastKmerScoreVector& scores1 = (*resultSet1)[i].GetScores();
+		const TBlastKmerScoreVector& scores4 = (*resultSet4)[i].GetScores();
+		BOOST_REQUIRE(scores1.size() > 0);
+		BOOST_REQUIRE_EQUAL(scores1.size(), scores4.size());
+		for (size_t index=0; index<scores1.size(); index++)
+		{
+			BOOST_REQUIRE(scores1[index].first->Equals(*scores4[index].first));
+			BOOST_REQUIRE_EQUAL(scores1[index].second, scores4[index].second);
+		}
+		BOOST_REQUIRE_EQUAL((*resultSet1)[i].GetStats().jd_count, (*resultSet4)[i].GetStats().jd_count);
+	}
+}
+
 BOOST_AUTO_TEST_CASE(BuildIndexRepeats)
 {
         CRef<CSeqDB> seqdb(new CSeqDB("data/XP_001468867", CSeqDB::eProtein));
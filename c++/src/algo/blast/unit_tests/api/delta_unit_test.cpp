@@ -724,6 +724,62 @@ BOOST_AUTO_TEST_CASE(TestMultipleQueries)
      "H70430");
 }
 
+// Verify that domain hits and PSSMs read from the domain cache match those
+// computed from a domain search
+BOOST_AUTO_TEST_CASE(TestDomainCache)
+{
+    CDir cache_dir(CDirEntry::GetTmpName());
+    BOOST_REQUIRE(cache_dir.Create());
+    CNcbiEnvironment env;
+    env.Set("DELTABLAST_CDD_CACHE", cache_dir.GetPath());
+
+    CRef<CLocalDbAdapter> dbadapter(new CLocalDbAdapter(*m_SearchDb));
+    CRef<CLocalDbAdapter> domain_dbadapter(new CLocalDbAdapter(*m_DomainDb));
+
+    // search with the first query fills the cache
+    TSeqLocVector first_query;
+    first_query.push_back(SSeqLoc(*m_Seq_locs.front(), *m_Scope));
+    CRef<IQueryFactory> first_factory(new CObjMgr_QueryFactory(first_query));
+    CDeltaBlast first(first_factory, dbadapter, domain_dbadapter,
+                      m_OptHandle);
+    first.Run();
+
+    // the first query is read from the cache, the second one is searched
+    TSeqLocVector queries;
+    ITERATE (vector< CRef<CSeq_loc> >, it, m_Seq_locs) {
+        queries.push_back(SSeqLoc(**it, *m_Scope));
+    }
+    CRef<IQueryFactory> query_factory(new CObjMgr_QueryFactory(queries));
+    CDeltaBlast deltablast(query_factory, dbadapter, domain_dbadapter,
+                           m_OptHandle);
+    CSearchResultSet results(*deltablast.Run());
+
+    env.Unset("DELTABLAST_CDD_CACHE");
+    cache_dir.Remove();
+
+    BOOST_REQUIRE_EQUAL(results.size(), 2u);
+    BOOST_REQUIRE(results[0].GetErrors().empty());
+    BOOST_REQUIRE(results[1].GetErrors().empty());
+
+    CSearchResultSet& domains = *deltablast.GetDomainResults();
+    CSearchResultSet& first_domains = *first.GetDomainResults();
+    BOOST_REQUIRE_EQUAL(domains.size(), 2u);
+    BOOST_REQUIRE_EQUAL(domains[0].GetSeqAlign()->Get().size(),
+                        first_domains[0].GetSeqAlign()->Get().size());
+    BOOST_REQUIRE_EQUAL(
+              domains[0].GetSeqAlign()->Get().front()->GetSeq_id(0).GetGi(),
+              GI_CONST(129295));
+    BOOST_REQUIRE_EQUAL(
+           domains[0].GetAncillaryData()->GetGappedKarlinBlk()->Lambda,
+           first_domains[0].GetAncillaryData()->GetGappedKarlinBlk()->Lambda);
+
+    BOOST_REQUIRE(deltablast.GetPssm(0)->GetPssm().Equals(
+                                                   first.GetPssm(0)->GetPssm()));
+    BOOST_REQUIRE_EQUAL(
+     deltablast.GetPssm(1)->GetQuery().GetSeq().GetFirstId()->GetPir().GetName(),
+     "H70430");
+}
+
 // Verify that null inputs result in exceptions
 BOOST_AUTO_TEST_CASE(TestNullQuery)
 {
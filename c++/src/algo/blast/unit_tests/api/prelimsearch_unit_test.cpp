@@ -74,6 +74,49 @@ void x_ValidateResultsForShortProteinSearch(CBlastPrelimSearch& blaster,
 
 }
 
+/// HSPs found by the preliminary search, as (query, oid, score, query
+/// offset, query end, subject offset, subject end), sorted
+typedef vector< vector<Int4> > TPrelimHsps;
+
+/// Run the preliminary search with the given number of threads
+static TPrelimHsps
+s_RunPrelimSearch(CRef<IQueryFactory> query_factory,
+                  CRef<CBlastOptions> options,
+                  const CSearchDatabase& dbinfo,
+                  size_t num_threads)
+{
+    CBlastPrelimSearch prelim_search(query_factory, options, dbinfo);
+    prelim_search.SetNumberOfThreads(num_threads);
+    CRef<SInternalData> results = prelim_search.Run();
+    BOOST_REQUIRE(results.GetPointer() != 0);
+    BOOST_REQUIRE(results->m_HspStream != 0);
+
+    CBlastHSPResults hsp_results
+        (prelim_search.ComputeBlastHSPResults
+                            (results->m_HspStream->GetPointer()));
+    TPrelimHsps retval;
+    for (Int4 q = 0; q < hsp_results->num_queries; q++) {
+        const BlastHitList* hit_list = hsp_results->hitlist_array[q];
+        for (Int4 i = 0; hit_list && i < hit_list->hsplist_count; i++) {
+            const BlastHSPList* hsp_list = hit_list->hsplist_array[i];
+            for (Int4 j = 0; j < hsp_list->hspcnt; j++) {
+                const BlastHSP* hsp = hsp_list->hsp_array[j];
+                vector<Int4> row;
+                row.push_back(q);
+                row.push_back(hsp_list->oid);
+                row.push_back(hsp->score);
+                row.push_back(hsp->query.offset);
+                row.push_back(hsp->query.end);
+                row.push_back(hsp->subject.offset);
+                row.push_back(hsp->subject.end);
+                retval.push_back(row);
+            }
+        }
+    }
+    sort(retval.begin(), retval.end());
+    return retval;
+}
+
 BOOST_AUTO_TEST_SUITE(prelimsearch)
 
 BOOST_AUTO_TEST_CASE(ShortProteinSearch) {
@@ -166,6 +209,60 @@ BOOST_AUTO_TEST_CASE(SplitNucleotideQuery) {
     BOOST_REQUIRE(results->m_Diagnostics != 0);
 }
 
+// With more threads than a query chunk may use, the query chunks are
+// searched as tiles of work by a single pool of threads: the HSPs must be
+// those of the query chunks searched one after the other
+BOOST_AUTO_TEST_CASE(SplitQueryTilesMatchSingleThread) {
+    CSeq_id q_id(CSeq_id::e_Gi, 224384753);
+    const TSeqRange kRange(0, 60000);
+    const ENa_strand kStrand(eNa_strand_both);
+    unique_ptr<SSeqLoc> q_ssl(CTestObjMgr::Instance().CreateSSeqLoc(q_id, kRange, kStrand));
+    TSeqLocVector q_tsl;
+    q_tsl.push_back(*q_ssl);
+    CRef<IQueryFactory> query_factory(new CObjMgr_QueryFactory(q_tsl));
+
+    CSearchDatabase dbinfo("ecoli", CSearchDatabase::eBlastDbIsProtein);
+
+    CRef<CBlastOptionsHandle> options_handle
+        (CBlastOptionsFactory::Create(eBlastx));
+    CRef<CBlastOptions> options(&options_handle->SetOptions());
+
+    // Six query chunks, searched by up to 3 threads each against the 100
+    // chunks of the database
+    CAutoEnvironmentVariable tmp_env("CHUNK_SIZE", "10002");
+
+    TPrelimHsps expected =
+        s_RunPrelimSearch(query_factory, options, dbinfo, 1);
+    BOOST_REQUIRE( !expected.empty() );
+    TPrelimHsps tiled = s_RunPrelimSearch(query_factory, options, dbinfo, 4);
+    BOOST_REQUIRE(expected == tiled);
+}
+
+// The query chunks made of N's only are not searched (see SB-546), in the
+// tiles too
+BOOST_AUTO_TEST_CASE(SplitNucleotideQueryTilesMatchSingleThread) {
+    CSeq_id q_id(CSeq_id::e_Gi, 224384753);
+    const TSeqRange kRange(0, 5000000);
+    const ENa_strand kStrand(eNa_strand_plus);
+    unique_ptr<SSeqLoc> q_ssl(CTestObjMgr::Instance().CreateSSeqLoc(q_id, kRange, kStrand));
+    TSeqLocVector q_tsl;
+    q_tsl.push_back(*q_ssl);
+    CRef<IQueryFactory> query_factory(new CObjMgr_QueryFactory(q_tsl));
+
+    CSearchDatabase dbinfo("data/nt.41646578", CSearchDatabase::eBlastDbIsNucleotide);
+
+    CRef<CBlastOptionsHandle> options_handle
+        (CBlastOptionsFactory::Create(eMegablast));
+    CRef<CBlastOptions> options(&options_handle->SetOptions());
+
+    CAutoEnvironmentVariable tmp_env("CHUNK_SIZE", "40000");
+
+    TPrelimHsps expected =
+        s_RunPrelimSearch(query_factory, options, dbinfo, 1);
+    TPrelimHsps tiled = s_RunPrelimSearch(query_factory, options, dbinfo, 4);
+    BOOST_REQUIRE(expected == tiled);
+}
+
 BOOST_AUTO_TEST_CASE(BuildCStd_seg_blastn) {
     CSeq_id q_id(CSeq_id::e_Gi, 41646578);
     const TSeqRange kRange(54, 560);
@@ -1165,6 +1165,163 @@ BOOST_AUTO_TEST_CASE(TestMultipleIterationsAndConvergence_PssmAsQuery_CBS) {
     BOOST_REQUIRE_EQUAL(kNumExpectedIterations, iteration_counter);
 }
 
+// When the PSSM scores do not change, an incremental iteration returns the
+// results of the previous one
+BOOST_AUTO_TEST_CASE(TestIncrementalIteration_NoChangedColumns) {
+    m_OptHandle->SetCompositionBasedStats(eNoCompositionBasedStats);
+    CRef<CLocalDbAdapter> dbadapter(new CLocalDbAdapter(*m_SearchDb));
+    CPsiBlast psiblast(m_Pssm, dbadapter, m_OptHandle);
+    psiblast.SetIncrementalThreshold(0);
+
+    CSearchResultSet results = *psiblast.Run();
+    BOOST_REQUIRE(results[0].GetErrors().empty());
+    CConstRef<CSeq_align_set> alignment = results[0].GetSeqAlign();
+
+    CRef<CPssmWithParameters> pssm(new CPssmWithParameters);
+    pssm->Assign(*psiblast.GetPssm());
+    psiblast.SetPssm(pssm);
+
+    CSearchResultSet next_results = *psiblast.Run();
+    BOOST_REQUIRE(next_results[0].GetErrors().empty());
+    CConstRef<CSeq_align_set> next_alignment = next_results[0].GetSeqAlign();
+    BOOST_REQUIRE(alignment->Equals(*next_alignment));
+    BOOST_REQUIRE_EQUAL(m_Pssm->GetPssm().GetLambda(),
+                        pssm->GetPssm().GetLambda());
+}
+
+// When a few PSSM columns change, an incremental iteration only seeds from
+// these; the alignments it carries forward must be scored as a full search
+// with the new PSSM and its statistics scores them
+BOOST_AUTO_TEST_CASE(TestIncrementalIteration_PartialRescan) {
+    m_OptHandle->SetCompositionBasedStats(eNoCompositionBasedStats);
+    CRef<CLocalDbAdapter> dbadapter(new CLocalDbAdapter(*m_SearchDb));
+    CPsiBlast psiblast(m_Pssm, dbadapter, m_OptHandle);
+    psiblast.SetIncrementalThreshold(0);
+
+    CSearchResultSet results = *psiblast.Run();
+    BOOST_REQUIRE(results[0].GetErrors().empty());
+    BOOST_REQUIRE(results[0].HasAlignments());
+
+    // Raise the scores of a few columns in the middle of the query, and
+    // change Kappa so that every alignment carried forward must be rescored
+    CRef<CPssmWithParameters> pssm(new CPssmWithParameters);
+    pssm->Assign(*psiblast.GetPssm());
+    CPssm& pssm_data = pssm->SetPssm();
+    const int kNumRows = pssm_data.GetNumRows();
+    const int kNumCols = pssm_data.GetNumColumns();
+    const int kFirstChanged = kNumCols / 2 - 5;
+    const int kLastChanged = kNumCols / 2 + 4;
+    int index = 0;
+    NON_CONST_ITERATE(CPssmFinalData::TScores, score,
+                      pssm_data.SetFinalData().SetScores()) {
+        const int kCol = pssm_data.GetByRow()
+            ? index % kNumCols : index / kNumRows;
+        if (kCol >= kFirstChanged && kCol <= kLastChanged) {
+            *score += 2;
+        }
+        index++;
+    }
+    pssm_data.SetKappa(pssm_data.GetKappa() * 1.1);
+
+    CRef<CPssmWithParameters> pssm_copy(new CPssmWithParameters);
+    pssm_copy->Assign(*pssm);
+
+    psiblast.SetPssm(pssm);
+    CSearchResultSet next_results = *psiblast.Run();
+    BOOST_REQUIRE(next_results[0].GetErrors().empty());
+
+    CRef<CLocalDbAdapter> dbadapter2(new CLocalDbAdapter(*m_SearchDb));
+    CPsiBlast full_search(pssm_copy, dbadapter2, m_OptHandle);
+    CSearchResultSet full_results = *full_search.Run();
+    BOOST_REQUIRE(full_results[0].GetErrors().empty());
+
+    // Every alignment of the incremental iteration that a full search also
+    // finds must have the same scores, and most of them should be found
+    const CSeq_align_set::Tdata& aligns =
+        next_results[0].GetSeqAlign()->Get();
+    const CSeq_align_set::Tdata& full_aligns =
+        full_results[0].GetSeqAlign()->Get();
+    BOOST_REQUIRE(!aligns.empty());
+    size_t num_matched = 0;
+    ITERATE(CSeq_align_set::Tdata, align, aligns) {
+        ITERATE(CSeq_align_set::Tdata, full_align, full_aligns) {
+            if ( !(*align)->GetSeq_id(1).Match((*full_align)->GetSeq_id(1)) ||
+                 (*align)->GetSeqRange(0) != (*full_align)->GetSeqRange(0) ||
+                 (*align)->GetSeqRange(1) != (*full_align)->GetSeqRange(1)) {
+                continue;
+            }
+            int score = 0, full_score = 0;
+            double evalue = 0.0, full_evalue = 0.0;
+            double bit_score = 0.0, full_bit_score = 0.0;
+            (*align)->GetNamedScore(CSeq_align::eScore_Score, score);
+            (*full_align)->GetNamedScore(CSeq_align::eScore_Score, full_score);
+            (*align)->GetNamedScore(CSeq_align::eScore_EValue, evalue);
+            (*full_align)->GetNamedScore(CSeq_align::eScore_EValue,
+                                         full_evalue);
+            (*align)->GetNamedScore(CSeq_align::eScore_BitScore, bit_score);
+            (*full_align)->GetNamedScore(CSeq_align::eScore_BitScore,
+                                         full_bit_score);
+            BOOST_REQUIRE_EQUAL(score, full_score);
+            BOOST_REQUIRE_CLOSE(evalue, full_evalue, 1e-6);
+            BOOST_REQUIRE_CLOSE(bit_score, full_bit_score, 1e-6);
+            num_matched++;
+            break;
+        }
+    }
+    BOOST_REQUIRE(num_matched * 2 >= aligns.size());
+
+    // Subjects of the previous iteration with an alignment that avoids the
+    // changed columns are kept, if the full search reports them too
+    const CSeq_align_set::Tdata& prev_aligns =
+        results[0].GetSeqAlign()->Get();
+    ITERATE(CSeq_align_set::Tdata, prev_align, prev_aligns) {
+        const TSeqRange range = (*prev_align)->GetSeqRange(0);
+        if ((int)range.GetTo() >= kFirstChanged &&
+            (int)range.GetFrom() <= kLastChanged) {
+            continue;
+        }
+        const CSeq_id& subject = (*prev_align)->GetSeq_id(1);
+        bool in_full = false, in_next = false;
+        ITERATE(CSeq_align_set::Tdata, align, full_aligns) {
+            in_full = in_full || subject.Match((*align)->GetSeq_id(1));
+        }
+        ITERATE(CSeq_align_set::Tdata, align, aligns) {
+            in_next = in_next || subject.Match((*align)->GetSeq_id(1));
+        }
+        BOOST_REQUIRE(!in_full || in_next);
+    }
+}
+
+// Incremental iterations are disabled by default, so reusing a CPsiBlast
+// object gives the same results as a new search with the same PSSM
+BOOST_AUTO_TEST_CASE(TestIncrementalIteration_DisabledByDefault) {
+    m_OptHandle->SetCompositionBasedStats(eNoCompositionBasedStats);
+    CRef<CLocalDbAdapter> dbadapter(new CLocalDbAdapter(*m_SearchDb));
+    CPsiBlast psiblast(m_Pssm, dbadapter, m_OptHandle);
+
+    CSearchResultSet results = *psiblast.Run();
+    BOOST_REQUIRE(results[0].GetErrors().empty());
+
+    const CBioseq& query = m_Pssm->GetPssm().GetQuery().GetSeq();
+    CRef<CPssmWithParameters> pssm =
+        x_ComputePssmForNextIteration(query, results[0].GetSeqAlign(),
+                                      m_OptHandle,
+                                      results[0].GetAncillaryData());
+    psiblast.SetPssm(pssm);
+    CSearchResultSet next_results = *psiblast.Run();
+    BOOST_REQUIRE(next_results[0].GetErrors().empty());
+
+    CRef<CPssmWithParameters> pssm_copy(new CPssmWithParameters);
+    pssm_copy->Assign(*pssm);
+    CRef<CLocalDbAdapter> dbadapter2(new CLocalDbAdapter(*m_SearchDb));
+    CPsiBlast full_search(pssm_copy, dbadapter2, m_OptHandle);
+    CSearchResultSet full_results = *full_search.Run();
+    BOOST_REQUIRE(full_results[0].GetErrors().empty());
+
+    BOOST_REQUIRE(next_results[0].GetSeqAlign()->Equals
+                  (*full_results[0].GetSeqAlign()));
+}
+
 // Should throw exception as only one query sequence/pssm is allowed
 BOOST_AUTO_TEST_CASE(TestMultipleQueries) {
     CConstRef<CBioseq_set> bioseq_set(&m_SeqSet->GetSet());
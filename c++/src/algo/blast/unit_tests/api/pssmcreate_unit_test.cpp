@@ -755,7 +755,7 @@ BOOST_AUTO_TEST_CASE(testSeqAlignToPsiBlastMultipleSequenceAlignment) {
 /// layer):
 /// 1. purged biased sequences
 BOOST_AUTO_TEST_CASE(testPurgeSequencesWithNull) {
-        int rv = _PSIPurgeBiasedSegments(NULL);
+        int rv = _PSIPurgeBiasedSegments(NULL, 1);
         BOOST_REQUIRE_EQUAL(PSIERR_BADPARAM, rv);
 }
 
@@ -764,7 +764,7 @@ BOOST_AUTO_TEST_CASE(testPurgeSelfHit) {
             (new CPssmInputTestData(CPssmInputTestData::eSelfHit));
         pssm_input->Process();  // standard calling convention
         AutoPtr<_PSIPackedMsa> msa(_PSIPackedMsaNew(pssm_input->GetData()));
-        int rv = _PSIPurgeBiasedSegments(msa.get());
+        int rv = _PSIPurgeBiasedSegments(msa.get(), 1);
         BOOST_REQUIRE_EQUAL(PSI_SUCCESS, rv);    
         const Uint4 kSelfHitIndex = 1;
 		BOOST_REQUIRE_EQUAL(true, !!msa->use_sequence[kQueryIndex]);
@@ -776,7 +776,7 @@ BOOST_AUTO_TEST_CASE(testPurgeDuplicateHit) {
             (new CPssmInputTestData(CPssmInputTestData::eDuplicateHit));
         pssm_input->Process();  // standard calling convention
         AutoPtr<_PSIPackedMsa> msa(_PSIPackedMsaNew(pssm_input->GetData()));
-        int rv = _PSIPurgeBiasedSegments(msa.get());
+        int rv = _PSIPurgeBiasedSegments(msa.get(), 1);
         BOOST_REQUIRE_EQUAL(PSI_SUCCESS, rv);    
         const Uint4 kDuplicateHitIndex = 2;
         BOOST_REQUIRE_EQUAL(false, !!msa->use_sequence[kDuplicateHitIndex]);
@@ -789,7 +789,7 @@ BOOST_AUTO_TEST_CASE(testPurgeNearIdenticalHits) {
             (new CPssmInputTestData(CPssmInputTestData::eNearIdenticalHits));
         pssm_input->Process();  // standard calling convention
         AutoPtr<_PSIPackedMsa> msa(_PSIPackedMsaNew(pssm_input->GetData()));
-        int rv = _PSIPurgeBiasedSegments(msa.get());
+        int rv = _PSIPurgeBiasedSegments(msa.get(), 1);
         BOOST_REQUIRE_EQUAL(PSI_SUCCESS, rv);    
         const Uint4 kRemovedHitIndex = 2;
         BOOST_REQUIRE_EQUAL(false, 
@@ -798,6 +798,30 @@ BOOST_AUTO_TEST_CASE(testPurgeNearIdenticalHits) {
         BOOST_REQUIRE_EQUAL(true, !! msa->use_sequence[kQueryIndex + 1]);
 }
 
+BOOST_AUTO_TEST_CASE(testPurgeBiasedSegmentsMultiThreaded) {
+        unique_ptr<IPssmInputData> pssm_input
+            (new CPssmInputTestData(CPssmInputTestData::eNearIdenticalHits));
+        pssm_input->Process();  // standard calling convention
+        AutoPtr<_PSIPackedMsa> msa(_PSIPackedMsaNew(pssm_input->GetData()));
+        AutoPtr<_PSIPackedMsa> msa_mt(_PSIPackedMsaNew(pssm_input->GetData()));
+        BOOST_REQUIRE_EQUAL(PSI_SUCCESS, _PSIPurgeBiasedSegments(msa.get(), 1));
+        BOOST_REQUIRE_EQUAL(PSI_SUCCESS,
+                            _PSIPurgeBiasedSegments(msa_mt.get(), 4));
+
+        // The purged alignment must not depend on the number of threads
+        const Uint4 kNumSeqs = msa->dimensions->num_seqs + 1;
+        for (Uint4 s = 0; s < kNumSeqs; s++) {
+            BOOST_REQUIRE_EQUAL(!!msa->use_sequence[s],
+                                !!msa_mt->use_sequence[s]);
+            for (Uint4 p = 0; p < msa->dimensions->query_length; p++) {
+                BOOST_REQUIRE_EQUAL((int)msa->data[s][p].letter,
+                                    (int)msa_mt->data[s][p].letter);
+                BOOST_REQUIRE_EQUAL((int)msa->data[s][p].is_aligned,
+                                    (int)msa_mt->data[s][p].is_aligned);
+            }
+        }
+}
+
 BOOST_AUTO_TEST_CASE(testQueryAlignedWithInternalGaps) {
         unique_ptr<IPssmInputData> pssm_input
             (new CPssmInputTestData
@@ -876,7 +900,7 @@ BOOST_AUTO_TEST_CASE(testMultiSeqAlignmentHasRegionsUnalignedToQuery) {
         /*** Run the stage to purge biased alignment segments */
         AutoPtr<_PSIPackedMsa> packed_msa
             (_PSIPackedMsaNew(pssm_input->GetData()));
-        int rv = _PSIPurgeBiasedSegments(packed_msa.get());
+        int rv = _PSIPurgeBiasedSegments(packed_msa.get(), 1);
         BOOST_REQUIRE_EQUAL(PSI_SUCCESS, rv);    
         BOOST_REQUIRE_EQUAL(true, 
                              !!packed_msa->use_sequence[kQueryIndex]);
@@ -941,7 +965,7 @@ BOOST_AUTO_TEST_CASE(testMultiSeqAlignmentHasRegionsUnalignedToQuery) {
                                    sbp));
         rv = _PSIComputeSequenceWeights(msa.get(), aligned_blocks.get(),
                                         opts->nsg_compatibility_mode,
-                                        seq_weights.get());
+                                        seq_weights.get(), 1);
         ss.str("");
         ss << "_PSIComputeSequenceWeights failed: "
            << CPssmCreateTestFixture::x_ErrorCodeToString(rv);
@@ -984,7 +1008,7 @@ BOOST_AUTO_TEST_CASE(testMultiSeqAlignmentHasRegionsUnalignedToQuery) {
         rv = _PSIComputeFreqRatios(msa.get(), seq_weights.get(), sbp,
                                    aligned_blocks.get(), opts->pseudo_count,
                                    opts->nsg_compatibility_mode,
-                                   internal_pssm.get());
+                                   internal_pssm.get(), 1);
         ss.str("");
         ss << "_PSIComputeResidueFrequencies failed: "
            << CPssmCreateTestFixture::x_ErrorCodeToString(rv);
@@ -1074,7 +1098,7 @@ BOOST_AUTO_TEST_CASE(testQueryIsOnlyAlignedSequenceInMsa) {
         /*** Run the stage to purge biased alignment segments */
         AutoPtr<_PSIPackedMsa> packed_msa
             (_PSIPackedMsaNew(pssm_input->GetData()));
-        int rv = _PSIPurgeBiasedSegments(packed_msa.get());
+        int rv = _PSIPurgeBiasedSegments(packed_msa.get(), 1);
         BOOST_REQUIRE_EQUAL(PSI_SUCCESS, rv);    
         const Uint4 kSelfHitIndex = 1;
         BOOST_REQUIRE_EQUAL(true, 
@@ -1118,7 +1142,7 @@ BOOST_AUTO_TEST_CASE(testQueryIsOnlyAlignedSequenceInMsa) {
                                         // N.B.: we're deliberately ignoring
                                         // the sequence weights check!!!!
                                         TRUE,
-                                        seq_weights.get());
+                                        seq_weights.get(), 1);
         ss.str("");
         ss << "_PSIComputeSequenceWeights failed: "
            << CPssmCreateTestFixture::x_ErrorCodeToString(rv);
@@ -1131,7 +1155,7 @@ BOOST_AUTO_TEST_CASE(testQueryIsOnlyAlignedSequenceInMsa) {
         rv = _PSIComputeFreqRatios(msa.get(), seq_weights.get(), sbp,
                                    aligned_blocks.get(), opts->pseudo_count,
                                    opts->nsg_compatibility_mode,
-                                   internal_pssm.get());
+                                   internal_pssm.get(), 1);
         ss.str("");
         ss << "_PSIComputeResidueFrequencies failed: "
            << CPssmCreateTestFixture::x_ErrorCodeToString(rv);
@@ -42,10 +42,16 @@
 #include <algo/blast/api/objmgr_query_data.hpp>
 #include <algo/blast/api/blast_rps_options.hpp>
 #include <algo/blast/api/rpstblastn_options.hpp>
+#include <algo/blast/api/rpsblast_local.hpp>
+#include <algo/blast/api/prelim_stage.hpp>
+#include <algo/blast/api/setup_factory.hpp>
 #include <blast_seqalign.hpp>
+#include "blast_memento_priv.hpp"
+#include "prelim_search_runner.hpp"
 
 #include <algo/blast/core/lookup_wrap.h>
 #include <algo/blast/core/blast_lookup.h>
+#include <algo/blast/core/blast_aalookup.h>
 
 #include "test_objmgr.hpp"
 #include "blast_test_util.hpp"
@@ -300,6 +306,86 @@ BOOST_AUTO_TEST_CASE(testPreliminarySearch)
 }
 
 
+/// Lists the HSPs of the preliminary search, one line per HSP
+static vector<string> s_HspsToStrings(const BlastHSPResults* results)
+{
+    vector<string> retval;
+    for (int q = 0; q < results->num_queries; q++) {
+        const BlastHitList* hit_list = results->hitlist_array[q];
+        if ( !hit_list ) {
+            continue;
+        }
+        for (int i = 0; i < hit_list->hsplist_count; i++) {
+            const BlastHSPList* hsp_list = hit_list->hsplist_array[i];
+            for (int j = 0; j < hsp_list->hspcnt; j++) {
+                const BlastHSP* hsp = hsp_list->hsp_array[j];
+                CNcbiOstrstream os;
+                os << q << ' ' << hsp_list->oid << ' ' << hsp->context
+                   << ' ' << hsp->score
+                   << ' ' << hsp->query.offset << ' ' << hsp->query.end
+                   << ' ' << hsp->subject.offset << ' ' << hsp->subject.end;
+                retval.push_back(CNcbiOstrstreamToString(os));
+            }
+        }
+    }
+    return retval;
+}
+
+// the hits of each lookup table bucket are grouped by database block
+// before the ungapped extensions; the HSPs must be the same as with the
+// hits left in the scan order
+BOOST_AUTO_TEST_CASE(GroupedBucketsGiveSameHsps)
+{
+    static const char* kQueries[] = {
+        "gi|129295", "gi|38092615", "gi|7662354", "gi|1945390"
+    };
+    const size_t kNumQueries = sizeof(kQueries)/sizeof(kQueries[0]);
+
+    TSeqLocVector query_v;
+    for (size_t i = 0; i < kNumQueries; i++) {
+        CSeq_id id(kQueries[i]);
+        unique_ptr<SSeqLoc> query(CTestObjMgr::Instance().CreateSSeqLoc(id));
+        query_v.push_back(*query);
+    }
+    CBlastSeqSrc seq_src(SeqDbBlastSeqSrcInit(m_DbName, TRUE));
+    TestUtil::CheckForBlastSeqSrcErrors(seq_src);
+
+    CRef<CBlastOptionsHandle> opts(CBlastOptionsFactory::Create(eRPSBlast));
+    CRef<CBlastOptions> options(&opts->SetOptions());
+    CRef<IQueryFactory> query_factory(new CObjMgr_QueryFactory(query_v));
+    CBlastPrelimSearch prelim_search(query_factory, options, seq_src);
+    CRef<SInternalData> id(prelim_search.Run());
+
+    BlastRPSLookupTable* lookup =
+        (BlastRPSLookupTable*) id->m_LookupTable->GetPointer()->lut;
+    BOOST_REQUIRE(lookup->sort_by_block);
+
+    CBlastHSPResults grouped
+        (prelim_search.ComputeBlastHSPResults(id->m_HspStream->GetPointer()));
+    vector<string> expected = s_HspsToStrings(grouped.Get());
+    BOOST_REQUIRE( !expected.empty() );
+
+    // search again with the same lookup table, leaving the hits of each
+    // bucket in the scan order
+    unique_ptr<const CBlastOptionsMemento> memento(options->CreateSnapshot());
+    BlastHSPStream* hsp_stream =
+        CSetupFactory::CreateHspStream(memento.get(), kNumQueries,
+            CSetupFactory::CreateHspWriter(memento.get(), id->m_Queries,
+                                           id->m_QueryInfo));
+    id->m_HspStream.Reset(new TBlastHSPStream(hsp_stream, BlastHSPStreamFree));
+    lookup->sort_by_block = FALSE;
+    BOOST_REQUIRE_EQUAL(0, CPrelimSearchRunner(*id, memento.get())());
+
+    CBlastHSPResults ungrouped
+        (prelim_search.ComputeBlastHSPResults(id->m_HspStream->GetPointer()));
+    vector<string> actual = s_HspsToStrings(ungrouped.Get());
+
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        BOOST_CHECK_EQUAL(expected[i], actual[i]);
+    }
+}
+
 // test hanling of the case when CBS 1 is requested, but .freq file is missing
 BOOST_AUTO_TEST_CASE(TestCBSFreqsNotFound)
 {
@@ -326,5 +412,81 @@ BOOST_AUTO_TEST_CASE(TestCBSFreqsNotFound)
                         CBlastException);
 }
 
+/// Runs CLocalRPSBlast on a few queries and returns the text ASN.1 of the
+/// alignments of each query
+static vector<string> s_RunLocalRPSBlast(const string& dbname,
+                                         unsigned int num_threads)
+{
+    static const char* kQueries[] = {
+        "gi|129295", "gi|38092615", "gi|7662354", "gi|1945390"
+    };
+    const size_t kNumQueries = sizeof(kQueries)/sizeof(kQueries[0]);
+
+    CRef<CBlastQueryVector> query_vector(new CBlastQueryVector);
+    for (size_t i = 0; i < kNumQueries; i++) {
+        CSeq_id id(kQueries[i]);
+        query_vector->AddQuery(CTestObjMgr::Instance().CreateBlastSearchQuery(id));
+    }
+
+    CRef<CBlastOptionsHandle> opts(CBlastOptionsFactory::Create(eRPSBlast));
+    CLocalRPSBlast blaster(query_vector, dbname, opts, num_threads);
+    CRef<CSearchResultSet> results = blaster.Run();
+    BOOST_REQUIRE_EQUAL(kNumQueries, results->GetNumQueries());
+
+    vector<string> retval;
+    for (size_t i = 0; i < kNumQueries; i++) {
+        BOOST_REQUIRE(CSeq_id(kQueries[i]).Match(*(*results)[i].GetSeqId()));
+        CNcbiOstrstream os;
+        os << MSerial_AsnText << *(*results)[i].GetSeqAlign();
+        retval.push_back(CNcbiOstrstreamToString(os));
+    }
+    return retval;
+}
+
+// the queries of a single volume database are split across the threads;
+// the results must not depend on the number of threads
+BOOST_AUTO_TEST_CASE(LocalRPSBlastThreadsMatchSingleThread)
+{
+    vector<string> expected = s_RunLocalRPSBlast(m_DbName, 1);
+
+    bool has_hits = false;
+    ITERATE(vector<string>, it, expected) {
+        has_hits |= it->find("denseg") != NPOS;
+    }
+    BOOST_REQUIRE(has_hits);
+
+    for (unsigned int num_threads = 2; num_threads <= 8; num_threads *= 2) {
+        vector<string> actual = s_RunLocalRPSBlast(m_DbName, num_threads);
+        BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+        for (size_t i = 0; i < expected.size(); i++) {
+            BOOST_CHECK_EQUAL(expected[i], actual[i]);
+        }
+    }
+}
+
+// the database statistics set in an alias file on top of a single volume
+// must also be used when the queries are split across threads
+BOOST_AUTO_TEST_CASE(LocalRPSBlastThreadsKeepAliasSettings)
+{
+    const string kAlias = CDirEntry::GetTmpName();
+    {
+        CNcbiOfstream out((kAlias + ".pal").c_str());
+        out << "TITLE RPS test database with its own statistics" << endl
+            << "DBLIST " << CDirEntry::CreateAbsolutePath(m_DbName) << endl
+            << "STATS_NSEQ 100000" << endl
+            << "STATS_TOTLEN 50000000" << endl;
+    }
+
+    vector<string> volume_results = s_RunLocalRPSBlast(m_DbName, 1);
+    vector<string> expected = s_RunLocalRPSBlast(kAlias, 1);
+    vector<string> actual = s_RunLocalRPSBlast(kAlias, 4);
+    CFile(kAlias + ".pal").Remove();
+
+    BOOST_REQUIRE(volume_results != expected);
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        BOOST_CHECK_EQUAL(expected[i], actual[i]);
+    }
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -48,11 +48,22 @@
 #include <objects/seqset/Bioseq_set.hpp>
 
 #include <algo/blast/api/objmgrfree_query_data.hpp>
+#include <algo/blast/api/objmgr_query_data.hpp>
 #include <algo/blast/api/blast_nucl_options.hpp>
 #include <algo/blast/blastinput/blast_scope_src.hpp>
 #include <algo/blast/api/local_db_adapter.hpp>
 #include <algo/blast/format/blast_format.hpp>
 #include <algo/blast/format/blast_async_format.hpp>
+#include <algo/blast/format/blast_hit_table.hpp>
+#include <algo/blast/api/local_blast.hpp>
+#include <algo/blast/format/blastxml2_format.hpp>
+#include <algo/blast/format/data4xml2format.hpp>
+#include <objects/blastxml2/blastxml2__.hpp>
+#include <serial/objistr.hpp>
+#include <serial/objostr.hpp>
+#include <corelib/ncbifile.hpp>
+#include <util/compress/stream.hpp>
+#include <util/compress/zlib.hpp>
 
 
 #include <algo/blast/format/build_archive.hpp>
@@ -117,6 +128,372 @@ BOOST_AUTO_TEST_CASE(BlastFormatTest)
     BOOST_REQUIRE(myReport.find("Query=") != std::string::npos);
 }
 
+// Serialize a BLAST XML2 report object and read it back.
+static CRef<blastxml2::CBlastOutput2>
+s_XML2RoundTrip(const blastxml2::CBlastOutput2& report, ESerialDataFormat fmt)
+{
+    CNcbiStrstream buffer;
+    {{
+        unique_ptr<CObjectOStream> out(CObjectOStream::Open(fmt, buffer));
+        *out << report;
+    }}
+    CRef<blastxml2::CBlastOutput2> retval(new blastxml2::CBlastOutput2);
+    unique_ptr<CObjectIStream> in(CObjectIStream::Open(fmt, buffer));
+    *in >> *retval;
+    return retval;
+}
+
+// Read a BLAST XML2 report from a file.
+static CRef<blastxml2::CBlastOutput2>
+s_ReadXML2Report(const string& file_name, ESerialDataFormat fmt)
+{
+    CRef<blastxml2::CBlastOutput2> retval(new blastxml2::CBlastOutput2);
+    unique_ptr<CObjectIStream> in(CObjectIStream::Open(fmt, file_name));
+    *in >> *retval;
+    return retval;
+}
+
+// The XML2 and JSON reports, whose hits are streamed as they are created,
+// read back into the same object as the report built in memory.
+BOOST_AUTO_TEST_CASE(BlastXML2StreamedHitsRoundTrip)
+{
+    const char* fname = "data/archive.asn";
+    ifstream in(fname);
+    CRemoteBlast rb(in);
+
+    rb.LoadFromArchive();
+
+    CRef<objects::CBlast4_queries> queries = rb.GetQueries();
+ 
+    CConstRef<objects::CBioseq_set> bss_ref(&(queries->SetBioseq_set()));
+    const CBioseq& bs = bss_ref->GetSeq_set().front()->GetSeq();
+
+    CBlastNucleotideOptionsHandle nucl_opts(CBlastOptions::eBoth);
+
+    const bool kIsProtein = false;
+    SDataLoaderConfig dlconfig("refseq_rna", kIsProtein);
+    CRef<CScope> scope(CBlastScopeSource(dlconfig).NewScope());
+    scope->AddBioseq(bs);
+    CRef<CSeq_loc> loc(new CSeq_loc);
+    CRef<CSeq_id> id(new CSeq_id);
+    id->Assign(*(bs.GetFirstId()));
+    loc->SetWhole(*id);
+    CRef<CBlastSearchQuery> query(new CBlastSearchQuery(*loc, *scope));
+    CRef<CSearchResultSet> blast_results = rb.GetResultSet();
+
+    vector<align_format::CAlignFormatUtil::SDbInfo> dbs_info(1);
+    dbs_info.front().is_protein = kIsProtein;
+    dbs_info.front().name = "refseq_rna";
+    CCmdLineBlastXML2ReportData report_data(query, (*blast_results)[0],
+                                            CConstRef<CBlastOptions>(&nucl_opts.GetOptions()),
+                                            scope, dbs_info);
+
+    blastxml2::CBlastOutput2 report;
+    BlastXML2_FillReport(report, &report_data);
+    BOOST_REQUIRE(!report.GetReport().GetResults().GetSearch().GetHits().empty());
+
+    CTmpFile xml_file;
+    BlastXML2_FormatReport(&report_data, xml_file.GetFileName());
+    CRef<blastxml2::CBlastOutput2> xml_report =
+        s_ReadXML2Report(xml_file.GetFileName(), eSerial_Xml);
+    BOOST_REQUIRE(xml_report->Equals(*s_XML2RoundTrip(report, eSerial_Xml)));
+
+    CTmpFile json_file;
+    BlastJSON_FormatReport(&report_data, json_file.GetFileName());
+    CRef<blastxml2::CBlastOutput2> json_report =
+        s_ReadXML2Report(json_file.GetFileName(), eSerial_Json);
+    BOOST_REQUIRE(json_report->Equals(*s_XML2RoundTrip(report, eSerial_Json)));
+}
+
+// Search the query of data/archive.asn against refseq_rna and return the
+// tabular or SAM report, formatted from the HSPs by the writer of
+// CBlastFormat::GetHSPResultsWriter or from the Seq-aligns.
+static string
+s_RunFormattedSearch(const string& format_spec,
+                     CFormattingArgs::EOutputFormat format_type,
+                     bool from_hsps)
+{
+    const char* fname = "data/archive.asn";
+    ifstream in(fname);
+    CRemoteBlast rb(in);
+
+    rb.LoadFromArchive();
+
+    CRef<objects::CBlast4_queries> queries = rb.GetQueries();
+    CConstRef<objects::CBioseq_set> bss_ref(&(queries->SetBioseq_set()));
+    const CBioseq& bs = bss_ref->GetSeq_set().front()->GetSeq();
+
+    const bool kIsProtein = false;
+    SDataLoaderConfig dlconfig("refseq_rna", kIsProtein);
+    CRef<CScope> scope(CBlastScopeSource(dlconfig).NewScope());
+    scope->AddBioseq(bs);
+    CRef<CSeq_loc> loc(new CSeq_loc);
+    CRef<CSeq_id> id(new CSeq_id);
+    id->Assign(*(bs.GetFirstId()));
+    loc->SetWhole(*id);
+    CRef<CBlastQueryVector> q_vec(new CBlastQueryVector);
+    q_vec->push_back(CRef<CBlastSearchQuery>(new CBlastSearchQuery(*loc, *scope)));
+    CRef<IQueryFactory> query_factory(new CObjMgr_QueryFactory(*q_vec));
+
+    CRef<CBlastOptionsHandle> opts(new CBlastNucleotideOptionsHandle);
+    CRef<CSearchDatabase> target_db(new CSearchDatabase("refseq_rna", CSearchDatabase::eBlastDbIsNucleotide));
+    CRef<CLocalDbAdapter> db_adapter(new CLocalDbAdapter(*target_db));
+
+    CNcbiOstrstream report;
+    {{
+        CBlastFormat formatter(opts->GetOptions(), *db_adapter, format_type,
+                               false, report, 500, 250, *scope,
+                               BLAST_DEFAULT_MATRIX, false, false,
+                               BLAST_GENETIC_CODE, BLAST_GENETIC_CODE, false,
+                               false, -1, format_spec);
+        CLocalBlast lcl_blast(query_factory, opts, db_adapter);
+        CRef<IBlastHSPResultsWriter> writer;
+        if (from_hsps) {
+            writer = formatter.GetHSPResultsWriter(4);
+            BOOST_REQUIRE(writer.NotEmpty());
+            lcl_blast.SetHSPResultsWriter(writer);
+        }
+        CRef<CSearchResultSet> results = lcl_blast.Run();
+        formatter.PrintProlog();
+        ITERATE(CSearchResultSet, result, *results) {
+            formatter.PrintOneResultSet(**result, q_vec);
+        }
+        formatter.PrintEpilog(opts->GetOptions());
+    }}
+    return CNcbiOstrstreamToString(report);
+}
+
+// The tabular reports rendered from the HSPs match the ones formatted from
+// the Seq-aligns byte for byte.
+BOOST_AUTO_TEST_CASE(BlastHSPTabularMatchesSeqAlignTabular)
+{
+    const char* kFormatSpecs[] = {
+        "std",
+        "qaccver saccver pident length mismatch gapopen qstart qend sstart send evalue bitscore",
+        "qseqid qacc qlen sseqid sacc slen score nident gaps",
+        "sseqid evalue qstart qend sstart send length pident"
+    };
+    for (size_t i = 0; i < ArraySize(kFormatSpecs); i++) {
+        const string kSpec(kFormatSpecs[i]);
+        const string kExpected =
+            s_RunFormattedSearch(kSpec, CFormattingArgs::eTabular, false);
+        BOOST_REQUIRE_MESSAGE( !kExpected.empty(), kSpec);
+        BOOST_REQUIRE_MESSAGE(kExpected ==
+            s_RunFormattedSearch(kSpec, CFormattingArgs::eTabular, true), kSpec);
+    }
+
+    const string kSpec(kFormatSpecs[1]);
+    BOOST_REQUIRE(s_RunFormattedSearch(kSpec, CFormattingArgs::eCommaSeparatedValues, false) ==
+                  s_RunFormattedSearch(kSpec, CFormattingArgs::eCommaSeparatedValues, true));
+}
+
+// The SAM reports rendered from the HSPs match the ones formatted from the
+// Seq-aligns byte for byte.
+BOOST_AUTO_TEST_CASE(BlastHSPSAMMatchesSeqAlignSAM)
+{
+    const char* kFormatSpecs[] = { "", "SQ", "SR", "SQ SR" };
+    for (size_t i = 0; i < ArraySize(kFormatSpecs); i++) {
+        const string kSpec(kFormatSpecs[i]);
+        const string kExpected =
+            s_RunFormattedSearch(kSpec, CFormattingArgs::eSAM, false);
+        BOOST_REQUIRE_MESSAGE( !kExpected.empty(), kSpec);
+        BOOST_REQUIRE_MESSAGE(kExpected ==
+            s_RunFormattedSearch(kSpec, CFormattingArgs::eSAM, true), kSpec);
+    }
+}
+
+// Read a little-endian integer from BAM data.
+static Uint4
+s_GetBAMInt(const string& data, size_t& offset, size_t size)
+{
+    BOOST_REQUIRE(offset + size <= data.size());
+    Uint4 retval = 0;
+    for (size_t i = 0; i < size; i++) {
+        retval |= (Uint4)(unsigned char)data[offset + i] << (8 * i);
+    }
+    offset += size;
+    return retval;
+}
+
+// Decompress a BAM report and print its header and the mandatory fields of
+// its records as SAM text.
+static string
+s_BAMToSAM(const string& bam)
+{
+    CNcbiIstrstream in(bam);
+    CCompressionIStream zin(in,
+                            new CZipStreamDecompressor(CZipCompression::fGZip),
+                            CCompressionIStream::fOwnProcessor);
+    string data;
+    NcbiStreamToString(&data, zin);
+
+    BOOST_REQUIRE(data.compare(0, 4, string("BAM\1", 4)) == 0);
+    size_t offset = 4;
+    const size_t kTextLength = s_GetBAMInt(data, offset, 4);
+    string retval = data.substr(offset, kTextLength);
+    offset += kTextLength;
+    vector<string> refs(s_GetBAMInt(data, offset, 4));
+    NON_CONST_ITERATE(vector<string>, ref, refs) {
+        const size_t kNameLength = s_GetBAMInt(data, offset, 4);
+        *ref = data.substr(offset, kNameLength - 1);
+        offset += kNameLength + 4;
+    }
+
+    const char kCigarOps[] = "MIDNSHP=X";
+    const char kBases[] = "=ACMGRSVTWYHKDBN";
+    while (offset < data.size()) {
+        const size_t kEnd = offset + 4 + s_GetBAMInt(data, offset, 4);
+        const Uint4 kRefId = s_GetBAMInt(data, offset, 4);
+        const Uint4 kPos = s_GetBAMInt(data, offset, 4);
+        const size_t kNameLength = s_GetBAMInt(data, offset, 1);
+        const Uint4 kMapQ = s_GetBAMInt(data, offset, 1);
+        s_GetBAMInt(data, offset, 2);
+        const size_t kNumOps = s_GetBAMInt(data, offset, 2);
+        const Uint4 kFlag = s_GetBAMInt(data, offset, 2);
+        const size_t kSeqLength = s_GetBAMInt(data, offset, 4);
+        offset += 12;
+        BOOST_REQUIRE(kRefId < refs.size());
+
+        retval += data.substr(offset, kNameLength - 1);
+        offset += kNameLength;
+        retval += "\t" + NStr::UIntToString(kFlag) + "\t" + refs[kRefId] +
+            "\t" + NStr::UIntToString(kPos + 1) + "\t" +
+            NStr::UIntToString(kMapQ) + "\t";
+        for (size_t i = 0; i < kNumOps; i++) {
+            const Uint4 kOp = s_GetBAMInt(data, offset, 4);
+            retval += NStr::UIntToString(kOp >> 4) + kCigarOps[kOp & 0xf];
+        }
+        retval += "\t*\t0\t0\t";
+        for (size_t i = 0; i < kSeqLength; i++) {
+            const unsigned char kCodes = data[offset + i / 2];
+            retval += kBases[i % 2 ? kCodes & 0xf : kCodes >> 4];
+        }
+        retval += kSeqLength ? "\t*\n" : "*\t*\n";
+        offset = kEnd;
+    }
+    return retval;
+}
+
+// Keep the header and the mandatory fields of the records of a SAM report.
+static string
+s_SAMMandatoryFields(const string& sam)
+{
+    const size_t kNumMandatoryFields = 11;
+    vector<string> lines;
+    NStr::Split(sam, "\n", lines, NStr::fSplit_Tokenize);
+    string retval;
+    ITERATE(vector<string>, line, lines) {
+        if (NStr::StartsWith(*line, "@")) {
+            retval += *line + "\n";
+            continue;
+        }
+        vector<string> fields;
+        NStr::Split(*line, "\t", fields);
+        BOOST_REQUIRE(fields.size() >= kNumMandatoryFields);
+        fields.resize(kNumMandatoryFields);
+        retval += NStr::Join(fields, "\t") + "\n";
+    }
+    return retval;
+}
+
+// The BAM reports hold the header and the records of the SAM reports
+// formatted from the Seq-aligns; the optional fields are not compared, as
+// BAM keeps the floating point values in single precision.
+BOOST_AUTO_TEST_CASE(BlastHSPBAMMatchesSeqAlignSAM)
+{
+    const char* kFormatSpecs[] = { "", "SQ", "SR" };
+    for (size_t i = 0; i < ArraySize(kFormatSpecs); i++) {
+        const string kSpec(kFormatSpecs[i]);
+        const string kExpected = s_SAMMandatoryFields
+            (s_RunFormattedSearch(kSpec, CFormattingArgs::eSAM, false));
+        BOOST_REQUIRE_MESSAGE( !kExpected.empty(), kSpec);
+        const string kBAM = s_RunFormattedSearch
+            (NStr::TruncateSpaces(kSpec + " BAM"), CFormattingArgs::eSAM,
+             true);
+        BOOST_REQUIRE_MESSAGE(kExpected == s_BAMToSAM(kBAM), kSpec);
+    }
+
+    // BAM is only written from the HSPs
+    BOOST_REQUIRE_THROW(s_RunFormattedSearch("BAM", CFormattingArgs::eSAM,
+                                             false),
+                        CInputException);
+}
+
+// Write a string to a file.
+static void
+s_WriteFile(const string& file_name, const string& data)
+{
+    CNcbiOfstream out(file_name.c_str(), IOS_BASE::out | IOS_BASE::binary);
+    out.write(data.data(), data.size());
+}
+
+// The Seq-aligns rebuilt from a binary hit table are those of the search
+// which wrote it, and corrupt column offsets are rejected.
+BOOST_AUTO_TEST_CASE(BlastHitTableRoundTrip)
+{
+    const char* fname = "data/archive.asn";
+    ifstream in(fname);
+    CRemoteBlast rb(in);
+
+    rb.LoadFromArchive();
+
+    CRef<objects::CBlast4_queries> queries = rb.GetQueries();
+    CConstRef<objects::CBioseq_set> bss_ref(&(queries->SetBioseq_set()));
+    CRef<IQueryFactory> query_factory(new CObjMgrFree_QueryFactory(bss_ref));
+
+    CRef<CBlastOptionsHandle> opts(new CBlastNucleotideOptionsHandle);
+    CRef<CSearchDatabase> target_db(new CSearchDatabase("refseq_rna", CSearchDatabase::eBlastDbIsNucleotide));
+    CRef<CLocalDbAdapter> db_adapter(new CLocalDbAdapter(*target_db));
+
+    CLocalBlast expected_blast(query_factory, opts, db_adapter);
+    CRef<CSearchResultSet> expected = expected_blast.Run();
+    BOOST_REQUIRE(expected->size() == 1);
+    BOOST_REQUIRE((*expected)[0].HasAlignments());
+
+    CNcbiOstrstream table;
+    CRef<CBlastHitTableWriter> writer(new CBlastHitTableWriter(table));
+    CLocalBlast lcl_blast(query_factory, opts, db_adapter);
+    lcl_blast.SetHSPResultsWriter(CRef<IBlastHSPResultsWriter>(writer.GetPointer()));
+    CRef<CSearchResultSet> results = lcl_blast.Run();
+    BOOST_REQUIRE( !(*results)[0].HasAlignments() );
+    CRef<CBlast4_archive> archive =
+        BlastBuildArchive(*query_factory, *opts, *results, target_db);
+    writer->WriteChunk(*archive);
+    writer->Close();
+    const string kTable = CNcbiOstrstreamToString(table);
+
+    CTmpFile table_file;
+    s_WriteFile(table_file.GetFileName(), kTable);
+    BOOST_REQUIRE(CBlastHitTableReader::IsHitTable(table_file.GetFileName()));
+    CRef<CBlastHitTableReader> reader(new CBlastHitTableReader(table_file.GetFileName()));
+    BOOST_REQUIRE_EQUAL((size_t)1, reader->GetNumChunks());
+    BOOST_REQUIRE_EQUAL((Uint4)1, reader->GetChunk(0).header->num_queries);
+
+    CRef<ILocalQueryData> query_data =
+        query_factory->MakeLocalQueryData(&opts->GetOptions());
+    CRef<IBlastSeqInfoSrc> seqinfo_src(db_adapter->MakeSeqInfoSrc());
+    vector<TSeqLocInfoVector> subj_masks;
+    TSeqAlignVector aligns = reader->GetSeqAligns(0, *query_data, *seqinfo_src,
+                                                  opts->GetOptions(), subj_masks);
+    BOOST_REQUIRE_EQUAL((size_t)1, aligns.size());
+    BOOST_REQUIRE_EQUAL((size_t)1, subj_masks.size());
+    BOOST_REQUIRE(aligns[0]->Equals(*(*expected)[0].GetSeqAlign()));
+    reader.Reset();
+
+    // The first HSP of the first query must be HSP 0
+    const size_t kFirstHSPOffset =
+        sizeof(SHitTableFileHeader) + sizeof(SHitTableChunkHeader);
+    string corrupt(kTable);
+    const Uint4 kOne = 1;
+    corrupt.replace(kFirstHSPOffset, sizeof(kOne), (const char*)&kOne, sizeof(kOne));
+    s_WriteFile(table_file.GetFileName(), corrupt);
+    BOOST_REQUIRE_THROW(CBlastHitTableReader(table_file.GetFileName()), CException);
+
+    // A truncated table is rejected as well
+    s_WriteFile(table_file.GetFileName(), kTable.substr(0, kTable.size() / 2));
+    BOOST_REQUIRE_THROW(CBlastHitTableReader(table_file.GetFileName()), CException);
+}
+
 #ifdef NCBI_THREADS
 BOOST_AUTO_TEST_CASE(BlastAsyncFormatTest)
 {
@@ -194,5 +571,33 @@ BOOST_AUTO_TEST_CASE(BlastAsyncFormatDuplicateThrow)
     formatThr->Finalize();
     formatThr->Join();
 }
+
+// Buffered batches queued out of order are printed in batch order.
+BOOST_AUTO_TEST_CASE(BlastAsyncFormatBufferedOrder)
+{
+    const int kNumBatches = 16;
+    CNcbiOstrstream out;
+    CBlastAsyncFormatThread* formatThr =
+        new CBlastAsyncFormatThread(4, &out, kNumBatches);
+    formatThr->Run();
+
+    for (int i = kNumBatches - 1; i >= 0; i--) {
+        shared_ptr<CNcbiOstrstream> buffer(new CNcbiOstrstream);
+        *buffer << "batch " << i << "\n";
+        vector<SFormatResultValues> results_v;
+        results_v.push_back(SFormatResultValues(CRef<CBlastQueryVector>(),
+                                                CRef<CSearchResultSet>(new CSearchResultSet),
+                                                CRef<CBlastFormat>(), buffer));
+        formatThr->QueueResults(i, results_v);
+    }
+    formatThr->Join();
+
+    CNcbiOstrstream expected;
+    for (int i = 0; i < kNumBatches; i++) {
+        expected << "batch " << i << "\n";
+    }
+    BOOST_REQUIRE_EQUAL(string(CNcbiOstrstreamToString(expected)),
+                        string(CNcbiOstrstreamToString(out)));
+}
 #endif // NCBI_THREADS
 BOOST_AUTO_TEST_SUITE_END()
@@ -38,6 +38,7 @@
 #include <objmgr/bioseq_handle.hpp>
 #include <objmgr/util/sequence.hpp>
 #include <objtools/blast/seqdb_reader/seqdbcommon.hpp>   // for SeqDB_ReadGiList
+#include <objtools/blast/seqdb_reader/seqdb.hpp>
 #include <corelib/ncbithr.hpp>                      // for CThread
 #include <util/random_gen.hpp>
 #include <objmgr/seq_vector.hpp>        // for CSeqVector
@@ -452,5 +453,75 @@ BOOST_AUTO_TEST_CASE(TestDataNotFound_Remote)
 {
     TestDataNotFound(true);
 }
+
+/// The sequence headers and data decoded by a data loader are reused by the
+/// data loaders created later for the same BLAST database
+BOOST_AUTO_TEST_CASE(SharedCacheAcrossDataLoaders)
+{
+    const CSeq_id id(CSeq_id::e_Gi, 555);
+    const string db("nt");
+    const bool is_protein = false;
+    const bool use_fixed_slice_size = true;
+    const TSeqPos kLength(624);
+
+    CBlastDbDataLoader::SCacheStatistics before, after;
+    for (int i = 0; i < 2; i++) {
+        CAutoRegistrar reg(db, is_protein, use_fixed_slice_size);
+        CRef<CScope> scope(new CScope(*CObjectManager::GetInstance()));
+        scope->AddDefaults();
+        CBioseq_Handle bh = scope->GetBioseqHandle(id);
+        BOOST_REQUIRE(bh);
+        CSeqVector sv = bh.GetSeqVector(CBioseq_Handle::eCoding_Iupac);
+        string data;
+        sv.GetSeqData(0, sv.size(), data);
+        BOOST_REQUIRE_EQUAL(kLength, (TSeqPos)data.size());
+        if (i == 0) {
+            before = CBlastDbDataLoader::GetCacheStatistics();
+        }
+    }
+    after = CBlastDbDataLoader::GetCacheStatistics();
+
+    BOOST_REQUIRE(after.m_HeaderHits > before.m_HeaderHits);
+    BOOST_REQUIRE_EQUAL(before.m_HeaderMisses, after.m_HeaderMisses);
+    BOOST_REQUIRE_EQUAL(before.m_SeqDataMisses, after.m_SeqDataMisses);
+}
+
+/// The sequence headers of a BLAST database filtered by a GI list are not
+/// taken from the cache of the unfiltered database
+BOOST_AUTO_TEST_CASE(FilteredDatabaseDoesNotShareCache)
+{
+    const CSeq_id id(CSeq_id::e_Gi, 555);
+    const string db("nt");
+    const bool is_protein = false;
+    const bool use_fixed_slice_size = true;
+
+    {{
+        CAutoRegistrar reg(db, is_protein, use_fixed_slice_size);
+        CRef<CScope> scope(new CScope(*CObjectManager::GetInstance()));
+        scope->AddDefaults();
+        BOOST_REQUIRE(scope->GetBioseqHandle(id));
+    }}
+    const CBlastDbDataLoader::SCacheStatistics before =
+        CBlastDbDataLoader::GetCacheStatistics();
+
+    CRef<CSeqDBGiList> gis(new CSeqDBGiList);
+    gis->AddGi(GI_CONST(555));
+    CRef<CSeqDB> seqdb(new CSeqDB(db, CSeqDB::eNucleotide, gis));
+    CRef<CObjectManager> om = CObjectManager::GetInstance();
+    const string loader_name = CBlastDbDataLoader::RegisterInObjectManager
+        (*om, seqdb, use_fixed_slice_size, CObjectManager::eNonDefault)
+        .GetLoader()->GetName();
+    {{
+        CScope scope(*om);
+        scope.AddDataLoader(loader_name);
+        BOOST_REQUIRE(scope.GetBioseqHandle(id));
+    }}
+    om->RevokeDataLoader(loader_name);
+
+    const CBlastDbDataLoader::SCacheStatistics after =
+        CBlastDbDataLoader::GetCacheStatistics();
+    BOOST_REQUIRE_EQUAL(before.m_HeaderHits, after.m_HeaderHits);
+    BOOST_REQUIRE(after.m_HeaderMisses > before.m_HeaderMisses);
+}
 BOOST_AUTO_TEST_SUITE_END()
 #endif /* SKIP_DOXYGEN_PROCESSING */
@@ -4440,6 +4440,115 @@ BOOST_AUTO_TEST_CASE(CombinedFilters)
 
 }
 
+static void s_GetIncludedOids(CSeqDB & db, vector<int> & oids)
+{
+    oids.clear();
+    for(int oid = 0; db.CheckOrFindOID(oid); oid++) {
+        oids.push_back(oid);
+    }
+}
+
+// The first accession of an OID, as stored in the LMDB accession table
+static string s_GetAccession(CSeqDB & db, int oid)
+{
+    list< CRef<CSeq_id> > ids = db.GetSeqIDs(oid);
+    ITERATE(list< CRef<CSeq_id> >, id, ids) {
+        if ( !(*id)->IsGi() ) {
+            return (*id)->GetSeqIdString(true);
+        }
+    }
+    BOOST_FAIL("No accession for OID " + NStr::IntToString(oid));
+    return kEmptyStr;
+}
+
+BOOST_AUTO_TEST_CASE(CachedTaxIdOidMask)
+{
+    string db_name = "data/ipg_test";
+    set<TTaxId> t;
+    t.insert(TAX_ID_CONST(9606));
+    t.insert(TAX_ID_CONST(83333));
+
+    vector<int> expected;
+    {{
+        CRef<CSeqDBGiList> pos_list(new CSeqDBGiList());
+        pos_list->AddTaxIds(t);
+        CSeqDB db(db_name, CSeqDB::eProtein, &*pos_list);
+        s_GetIncludedOids(db, expected);
+    }}
+    BOOST_REQUIRE( ! expected.empty() );
+
+    CDir cache_dir(CDirEntry::GetTmpName());
+    BOOST_REQUIRE(cache_dir.CreatePath());
+    CNcbiEnvironment env;
+    env.Set("BLASTDB_OID_MASK_CACHE", cache_dir.GetPath());
+
+    // The first run compiles and saves the mask, the second loads it.
+    for (int pass = 0; pass < 2; pass++) {
+        CRef<CSeqDBGiList> pos_list(new CSeqDBGiList());
+        pos_list->AddTaxIds(t);
+        CSeqDB db(db_name, CSeqDB::eProtein, &*pos_list);
+        vector<int> oids;
+        s_GetIncludedOids(db, oids);
+        BOOST_REQUIRE(expected == oids);
+        BOOST_REQUIRE_EQUAL(1U, cache_dir.GetEntries("*.oidmask").size());
+    }
+
+    env.Unset("BLASTDB_OID_MASK_CACHE");
+    cache_dir.Remove();
+}
+
+BOOST_AUTO_TEST_CASE(CachedSeqIdListOidMask)
+{
+    string db_name = "data/seqp_v5";
+    vector<string> accs;
+    {{
+        CSeqDB db(db_name, CSeqDB::eProtein);
+        for (int oid = 1; oid < 10; oid += 3) {
+            accs.push_back(s_GetAccession(db, oid));
+        }
+    }}
+    SBlastSeqIdListInfo list_info;
+    list_info.is_v4 = false;
+
+    CDir cache_dir(CDirEntry::GetTmpName());
+    BOOST_REQUIRE(cache_dir.CreatePath());
+    CNcbiEnvironment env;
+    env.Set("BLASTDB_OID_MASK_CACHE", cache_dir.GetPath());
+
+    // The second run reads the mask from the cache, but must still
+    // report the OID found for each list entry.
+    vector<int> expected;
+    vector<blastdb::TOid> expected_translation;
+    for (int pass = 0; pass < 2; pass++) {
+        CRef<CSeqDBGiList> pos_list(new CSeqDBGiList());
+        pos_list->SetListInfo(list_info);
+        ITERATE(vector<string>, acc, accs) {
+            pos_list->AddSi(*acc);
+        }
+        CSeqDB db(db_name, CSeqDB::eProtein, &*pos_list);
+        BOOST_REQUIRE_EQUAL(1U, cache_dir.GetEntries("*.oidmask").size());
+
+        vector<int> oids;
+        s_GetIncludedOids(db, oids);
+        vector<blastdb::TOid> translation;
+        for (int i = 0; i < pos_list->GetNumSis(); i++) {
+            BOOST_REQUIRE(pos_list->GetSiOid(i).oid != -1);
+            translation.push_back(pos_list->GetSiOid(i).oid);
+        }
+        if (pass == 0) {
+            expected.swap(oids);
+            expected_translation.swap(translation);
+            BOOST_REQUIRE_EQUAL(accs.size(), expected.size());
+        } else {
+            BOOST_REQUIRE(expected == oids);
+            BOOST_REQUIRE(expected_translation == translation);
+        }
+    }
+
+    env.Unset("BLASTDB_OID_MASK_CACHE");
+    cache_dir.Remove();
+}
+
 BOOST_AUTO_TEST_CASE(TaxFilterWithGiListDB)
 {
     string db_name = "refseq_mrna";
@@ -4538,6 +4647,63 @@ BOOST_AUTO_TEST_CASE(TestTaxIdsLookup)
     }
 }
 
+BOOST_AUTO_TEST_CASE(TestAccessionsToOidMaskFile)
+{
+    CSeqDB db("data/seqp_v5", CSeqDB::eProtein);
+    const int kNumOids = 10;
+
+    // Build the list out of key order, with a duplicate and a miss.
+    vector<string> accs;
+    vector<blastdb::TOid> expected;
+    for (int oid = kNumOids - 1; oid >= 0; oid -= 2) {
+        accs.push_back(s_GetAccession(db, oid));
+        expected.push_back(oid);
+    }
+    accs.push_back(accs.front());
+    expected.push_back(expected.front());
+    accs.push_back("junk");
+    expected.push_back(kSeqDBEntryNotFound);
+
+    vector<blastdb::TOid> oids;
+    db.AccessionsToOids(accs, oids);
+    BOOST_REQUIRE_EQUAL(expected.size(), oids.size());
+    for (unsigned int i = 0; i < oids.size(); i++) {
+        BOOST_REQUIRE_EQUAL(expected[i], oids[i]);
+    }
+
+    // Split the same lookups across the threads set for this database.
+    CNcbiEnvironment env;
+    env.Set("LMDB_LOOKUP_CHUNK_SIZE", "2");
+    db.SetNumberOfThreads(3);
+    oids.clear();
+    db.AccessionsToOids(accs, oids);
+    db.SetNumberOfThreads(0);
+    env.Unset("LMDB_LOOKUP_CHUNK_SIZE");
+    BOOST_REQUIRE_EQUAL(expected.size(), oids.size());
+    for (unsigned int i = 0; i < oids.size(); i++) {
+        BOOST_REQUIRE_EQUAL(expected[i], oids[i]);
+    }
+
+    CTmpFile mask_tmpfile;
+    string mask_name = mask_tmpfile.GetFileName();
+    CFileDeleteAtExit::Add(mask_name);
+    BOOST_REQUIRE_EQUAL(kNumOids / 2, db.AccessionsToOidMaskFile(accs, mask_name));
+
+    vector<char> data;
+    {{
+        ifstream stream(mask_name.c_str(), ios::binary);
+        data.assign(istreambuf_iterator<char>(stream), istreambuf_iterator<char>());
+    }}
+    Uint4 last_oid = ((Uint1) data[0] << 24) | ((Uint1) data[1] << 16) |
+                     ((Uint1) data[2] << 8) | (Uint1) data[3];
+    BOOST_REQUIRE_EQUAL((Uint4) db.GetNumOIDs() - 1, last_oid);
+    BOOST_REQUIRE_EQUAL(4 + ((last_oid + 1 + 31) / 32) * 4, data.size());
+    for (int oid = 0; oid < db.GetNumOIDs(); oid++) {
+        bool is_set = (data[4 + oid / 8] & (0x80 >> (oid % 8))) != 0;
+        BOOST_REQUIRE_EQUAL((oid < kNumOids) && (oid % 2 == 1), is_set);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(TestTaxIdsLookup_v4)
 {
     string db_name = "data/test_v4";
@@ -53,6 +53,11 @@
 #include <objtools/data_loaders/blastdb/bdbloader_rmt.hpp>
 #include <algo/blast/format/blast_format.hpp>
 #include <objtools/align_format/format_flags.hpp>
+#include <algo/blast/format/blast_hsp_tabular.hpp>
+#include <algo/blast/api/objmgrfree_query_data.hpp> // for CObjMgrFree_QueryFactory
+#include <algo/blast/api/local_blast.hpp>
+#include <algo/blast/api/setup_factory.hpp>
+#include <algo/blast/blastinput/blast_fasta_input.hpp>
 
 #if defined(NCBI_OS_LINUX) && HAVE_MALLOC_H
 #include <malloc.h>
@@ -925,6 +930,60 @@ void QueryBatchCleanup()
 
 }
 
+int GetNumFormattingThreads(const CBlastAppArgs& cmd_line_args,
+                            const CArgs& args,
+                            const CLocalDbAdapter& db_adapter,
+                            bool hsp_writer_set)
+{
+    const int kNumThreads = (int) cmd_line_args.GetNumThreads();
+    if (kNumThreads < 2 || hsp_writer_set || cmd_line_args.ExecuteRemotely() ||
+        !db_adapter.IsBlastDb()) {
+        return 0;
+    }
+    CRef<CFormattingArgs> fmt_args = cmd_line_args.GetFormattingArgs();
+    if (fmt_args->ArchiveFormatRequested(args)) {
+        return 0;
+    }
+    // The pairwise reports only print the database and the parameters of
+    // the search in their prolog and epilog, and the tabular reports
+    // without comments print nothing there
+    switch (fmt_args->GetFormattedOutputChoice()) {
+    case CFormattingArgs::ePairwise:
+    case CFormattingArgs::eQueryAnchoredIdentities:
+    case CFormattingArgs::eQueryAnchoredNoIdentities:
+    case CFormattingArgs::eFlatQueryAnchoredIdentities:
+    case CFormattingArgs::eFlatQueryAnchoredNoIdentities:
+    case CFormattingArgs::eTabular:
+    case CFormattingArgs::eCommaSeparatedValues:
+        return kNumThreads;
+    default:
+        return 0;
+    }
+}
+
+/// Percentage of cache hits
+static double s_HitRate(Uint8 hits, Uint8 misses)
+{
+    return (hits + misses) == 0 ? 0.0 : (100.0 * hits) / (hits + misses);
+}
+
+void PrintBlastDbCacheStatistics(CNcbiOstream& out)
+{
+    const CBlastDbDataLoader::SCacheStatistics kStats =
+        CBlastDbDataLoader::GetCacheStatistics();
+    out << "BLAST database cache statistics:\n"
+        << "  Headers: " << kStats.m_HeaderHits << " hits, "
+        << kStats.m_HeaderMisses << " misses ("
+        << NStr::DoubleToString(s_HitRate(kStats.m_HeaderHits,
+                                          kStats.m_HeaderMisses), 1)
+        << "% hit rate)\n"
+        << "  Sequence data: " << kStats.m_SeqDataHits << " hits, "
+        << kStats.m_SeqDataMisses << " misses ("
+        << NStr::DoubleToString(s_HitRate(kStats.m_SeqDataHits,
+                                          kStats.m_SeqDataMisses), 1)
+        << "% hit rate)\n";
+}
+
 void LogQueryInfo(CBlastUsageReport & report, const CBlastInput & q_info)
 {
 	report.AddParam(CBlastUsageReport::eTotalQueryLength, q_info.GetTotalLengthProcessed());
@@ -984,6 +1043,32 @@ int GetMTByQueriesBatchSize(EProgram p, int num_threads)
 		return batch_size;
 }
 
+CRef<CSeqDB> GetMTByQueriesSeqDb(CBlastAppArgs & args)
+{
+	CRef<CSeqDB> retval;
+	if (args.ExecuteRemotely()) {
+		return retval;
+	}
+	CRef<CSearchDatabase> search_db = args.GetBlastDatabaseArgs()->GetSearchDatabase();
+	if (search_db.NotEmpty()) {
+		retval = search_db->GetSeqDb();
+	}
+	return retval;
+}
+
+void LogMTByQueriesThreadTimes(CBlastUsageReport & report, CBlastMasterNode & master_node)
+{
+	const vector<double> & times = master_node.GetThreadBusyTimes();
+	string retval;
+	ITERATE(vector<double>, t, times) {
+		if (!retval.empty()) {
+			retval += ",";
+		}
+		retval += NStr::DoubleToString(*t, 2);
+	}
+	report.AddParam(CBlastUsageReport::eMTThreadTimes, retval);
+}
+
 void CheckMTByQueries_DBSize(CRef<CLocalDbAdapter> & db_adapter, const CBlastOptions & opt)
 {
 	CRef<CSearchDatabase> sdb = db_adapter->GetSearchDatabase();
@@ -1038,4 +1123,171 @@ void CheckMTByQueries_QuerySize(EProgram prog, int batch_size)
     ERR_POST(Warning << warning);
 }
 
+/// Throw if the search cannot be run without the object manager
+/// @param cmd_line_args command line arguments [in]
+/// @param opt BLAST options [in]
+/// @param search_db BLAST database to search, NULL for subject sequences [in]
+static void
+s_CheckLeanSearch(CBlastAppArgs& cmd_line_args, const CArgs& args,
+                  CBlastOptions& opt, CRef<CSearchDatabase> search_db)
+{
+    // The queries are searched in batches by all threads, -mt_mode would
+    // silently be ignored
+    if (args.Exist(kArgMTMode)) {
+        CArgValue::TArgValueFlags flags = 0;
+        args[kArgMTMode].GetDefault(&flags);
+        if ( !(flags & CArgValue::fArgValue_FromDefault) ) {
+            NCBI_THROW(CInputException, eInvalidInput,
+                       "-" + kArgLean + " cannot be used with -" +
+                       kArgMTMode);
+        }
+    }
+
+    // DUST is on by default in blastn, but needs the object manager: it is
+    // only an error if requested on the command line
+    if (opt.GetDustFiltering() && !(args.Exist(kArgDustFiltering) &&
+                                    args[kArgDustFiltering].HasValue())) {
+        opt.SetDustFiltering(false);
+        ERR_POST(Warning << "DUST filtering of the queries is turned off "
+                 "by -" << kArgLean << ", use -" << kArgDustFiltering <<
+                 " no to silence this warning");
+    }
+
+    CRef<CFormattingArgs> fmt_args(cmd_line_args.GetFormattingArgs());
+    const CFormattingArgs::EOutputFormat kFormat =
+        fmt_args->GetFormattedOutputChoice();
+    const ENa_strand kStrand =
+        cmd_line_args.GetQueryOptionsArgs()->GetStrand();
+    const char* wmdb = opt.GetWindowMaskerDatabase();
+
+    string requirement;
+    if (search_db.Empty()) {
+        requirement = "a BLAST database";
+    } else if (kFormat != CFormattingArgs::eTabular &&
+               kFormat != CFormattingArgs::eCommaSeparatedValues) {
+        requirement = "tabular or comma-separated values output";
+    } else if ( !CBlastHSPTabularWriter::CanFormat
+                    (fmt_args->GetCustomOutputFormatSpec()) ) {
+        requirement = "output fields computed from the alignments and the "
+            "BLAST database only";
+    } else if ( !opt.GetGappedMode() ) {
+        requirement = "a gapped search";
+    } else if (opt.GetDustFiltering() || opt.GetRepeatFiltering() ||
+               (wmdb && *wmdb) || opt.GetWindowMaskerTaxId() != 0) {
+        // These masks are computed on CSeqVectors, SEG is applied by the
+        // engine itself
+        requirement = "no query masking other than SEG (e.g.: -dust no)";
+    } else if (kStrand != eNa_strand_both && kStrand != eNa_strand_unknown) {
+        requirement = "both query strands to be searched";
+    }
+    if ( !requirement.empty() ) {
+        NCBI_THROW(CInputException, eInvalidInput,
+                   "-" + kArgLean + " requires " + requirement);
+    }
+}
+
+void RunLeanSearch(CBlastAppArgs& cmd_line_args,
+                   const CArgs& args,
+                   CRef<CBlastOptionsHandle> opts_hndl,
+                   CBlastUsageReport& report)
+{
+    CRef<CSearchDatabase> search_db =
+        cmd_line_args.GetBlastDatabaseArgs()->GetSearchDatabase();
+    s_CheckLeanSearch(cmd_line_args, args, opts_hndl->SetOptions(),
+                      search_db);
+    const CBlastOptions& opt = opts_hndl->GetOptions();
+
+    CNcbiIstream& in = cmd_line_args.GetInputStream();
+    if (IsIStreamEmpty(in)) {
+        ERR_POST(Warning << "Query is Empty!");
+        return;
+    }
+
+    // The subjects are read from CSeqDB only, so no data loader is needed
+    CRef<CLocalDbAdapter> db_adapter(new CLocalDbAdapter(*search_db));
+    if (opt.GetUseIndex()) {
+        CRef<CBlastOptions> my_options(&(opts_hndl->SetOptions()));
+        CSetupFactory::InitializeMegablastDbIndex(my_options);
+    }
+
+    // The queries are read into Bioseqs holding the encoded sequences, one
+    // batch ahead of the search
+    CRef<CQueryOptionsArgs> query_opts(cmd_line_args.GetQueryOptionsArgs());
+    CShortReadFastaInputSource fasta(in);
+    fasta.SetProtein(query_opts->QueryIsProtein());
+    fasta.SetParseSeqIds(query_opts->GetParseDeflines());
+    fasta.SetLocalIdsFromDeflines(true);
+    fasta.SetEncodeSequences(true);
+
+    CBatchSizeMixer mixer(SplitQuery_GetChunkSize(opt.GetProgram())-1000);
+    const int kBatchSize = cmd_line_args.GetQueryBatchSize();
+    if ( !kBatchSize ) {
+        Int8 total_len = search_db->GetSeqDb()->GetTotalLength();
+        if (total_len > 0) {
+            /* the optimal hits per batch scales with total db size */
+            mixer.SetTargetHits(total_len / 3000);
+        }
+    }
+    CBlastInputOMF input(&fasta,
+                         kBatchSize ? kBatchSize : mixer.GetBatchSize());
+    input.SetPrefetch(true);
+
+    // The report is written straight from the HSPs, with the subject
+    // labels taken from the BLAST database headers
+    CRef<CFormattingArgs> fmt_args(cmd_line_args.GetFormattingArgs());
+    string delim = (fmt_args->GetFormattedOutputChoice() ==
+                    CFormattingArgs::eCommaSeparatedValues) ? "," : "\t";
+    if ( !fmt_args->GetCustomDelimiter().empty() ) {
+        delim = fmt_args->GetCustomDelimiter();
+    }
+    const int kNumThreads = static_cast<int>(cmd_line_args.GetNumThreads());
+    CRef<IBlastHSPResultsWriter> hsp_writer
+        (new CBlastHSPTabularWriter(cmd_line_args.GetOutputStream(),
+                                    fmt_args->GetCustomOutputFormatSpec(),
+                                    delim, NULL,
+                                    query_opts->GetParseDeflines(),
+                                    opt.GetHitlistSize(), kNumThreads));
+
+    while ( !input.End() ) {
+        CRef<CBioseq_set> query_batch = input.GetNextSeqBatch();
+        if ( !query_batch->IsSetSeq_set() ||
+             query_batch->GetSeq_set().empty() ) {
+            continue;
+        }
+        CRef<IQueryFactory> queries
+            (new CObjMgrFree_QueryFactory(CConstRef<CBioseq_set>(query_batch)));
+
+        CLocalBlast lcl_blast(queries, opts_hndl, db_adapter);
+        lcl_blast.SetNumberOfThreads(kNumThreads);
+        lcl_blast.SetHSPResultsWriter(hsp_writer);
+        CRef<CSearchResultSet> results = lcl_blast.Run();
+        if ( !kBatchSize ) {
+            input.SetBatchSize
+                (mixer.GetBatchSize(lcl_blast.GetNumExtensions()));
+        }
+
+        ITERATE(CSearchResultSet, result, *results) {
+            if ((*result)->HasErrors()) {
+                ERR_POST(Error << (*result)->GetErrorStrings());
+            }
+            if ((*result)->HasWarnings()) {
+                ERR_POST(Warning << (*result)->GetWarningStrings());
+            }
+        }
+        QueryBatchCleanup();
+    }
+
+    if (cmd_line_args.ProduceDebugOutput()) {
+        opt.DebugDumpText(NcbiCerr, "BLAST options", 1);
+    }
+
+    report.AddParam(CBlastUsageReport::eTotalQueryLength,
+                    input.GetTotalLengthProcessed());
+    report.AddParam(CBlastUsageReport::eNumQueries, input.GetNumSeqsProcessed());
+    report.AddParam(CBlastUsageReport::eProgram,
+                    Blast_ProgramNameFromType(opt.GetProgramType()));
+    report.AddParam(CBlastUsageReport::eOutputFmt,
+                    fmt_args->GetFormattedOutputChoice());
+}
+
 END_NCBI_SCOPE
@@ -50,6 +50,7 @@
 #include <algo/blast/format/blastfmtutil.hpp>   // for CBlastFormatUtil
 #include <algo/blast/blastinput/blast_scope_src.hpp>    // for SDataLoaderConfig
 #include <algo/blast/api/blast_usage_report.hpp>
+#include <algo/blast/api/blast_node.hpp>
 
 BEGIN_NCBI_SCOPE
 
@@ -313,6 +314,25 @@ void PrintErrorArchive(const CArgs & a, const list<CRef<CBlast4_error> > & msg);
 /// Clean up formatter scope and release
 void QueryBatchCleanup();
 
+/// Get the number of threads to format the reports of the query batches of
+/// a database search with, while the search moves on to the next batch.
+/// Only the reports printed query by query, without anything accumulated
+/// for the end of the output, can be formatted this way.
+/// @param cmd_line_args Command line arguments of the application [in]
+/// @param args Parsed command line arguments [in]
+/// @param db_adapter Subject of the search [in]
+/// @param hsp_writer_set True if the report is written from the HSPs [in]
+/// @return 0 if the reports must be formatted by the searching thread
+int GetNumFormattingThreads(const blast::CBlastAppArgs& cmd_line_args,
+                            const CArgs& args,
+                            const blast::CLocalDbAdapter& db_adapter,
+                            bool hsp_writer_set);
+
+/// Print the hit rates of the BLAST database caches of subject headers and
+/// sequence data used while formatting
+/// @param out Stream to print to [in]
+void PrintBlastDbCacheStatistics(CNcbiOstream& out);
+
 void LogQueryInfo(blast::CBlastUsageReport & report, const blast::CBlastInput & q_info);
 
 /// Log blast usage opts for rpsblast apps
@@ -321,6 +341,35 @@ void LogCmdOptions(blast::CBlastUsageReport & report, const blast::CBlastAppArgs
 
 int GetMTByQueriesBatchSize(blast::EProgram p, int num_threads);
 
+/// Open the BLAST database searched in -mt_mode 1 for the duration of the
+/// run.  The memory maps of all CSeqDB objects live in one atlas, which is
+/// released with the last of them; holding this one keeps the database
+/// mapped across the nodes, while each node still opens its own CSeqDB to
+/// iterate over the database independently.
+/// @param args command line arguments [in]
+/// @return NULL for remote searches and searches of subject sequences
+CRef<CSeqDB> GetMTByQueriesSeqDb(blast::CBlastAppArgs & args);
+
+/// Log the time each thread spent running nodes in -mt_mode 1
+void LogMTByQueriesThreadTimes(blast::CBlastUsageReport & report, blast::CBlastMasterNode & master_node);
+
+/// Search the FASTA queries against a local BLAST database without the
+/// object manager (-lean): the queries are read into Bioseqs in a background
+/// thread, and the tabular report is written straight from the HSPs and the
+/// BLAST database headers, without a CScope or CBlastFormat.
+/// The default DUST filtering of blastn is turned off, with a warning.
+/// @param cmd_line_args command line arguments, with the options set [in]
+/// @param args parsed command line arguments [in]
+/// @param opts_hndl BLAST options [in|out]
+/// @param report usage report [in|out]
+/// @throw CInputException if the search cannot be run this way (e.g.: DUST
+/// filtering or -mt_mode was requested, or an output format needing the
+/// Seq-aligns)
+void RunLeanSearch(blast::CBlastAppArgs& cmd_line_args,
+                   const CArgs& args,
+                   CRef<blast::CBlastOptionsHandle> opts_hndl,
+                   blast::CBlastUsageReport& report);
+
 void CheckMTByQueries_DBSize(CRef<blast::CLocalDbAdapter> & db_adapter, const blast::CBlastOptions & opt);
 void CheckMTByQueries_QuerySize(blast::EProgram prog, int batch_size);
 
@@ -39,6 +39,7 @@
 #include <algo/blast/api/remote_blast.hpp>
 #include <algo/blast/blastinput/blast_input_aux.hpp>
 #include <algo/blast/format/blast_format.hpp>
+#include <algo/blast/format/blast_hit_table.hpp>
 #include <algo/blast/api/objmgr_query_data.hpp>
 #include <objtools/data_loaders/blastdb/bdbloader_rmt.hpp>
 #include <objtools/data_loaders/genbank/gbloader.hpp>
@@ -61,6 +62,7 @@ public:
         version->SetVersionInfo(new CBlastVersion());
         SetFullVersion(version);
         m_LoadFromArchive = false;
+        m_HitTableChunk = 0;
         m_StopWatch.Start();
         if (m_UsageReport.IsEnabled()) {
         	m_UsageReport.AddParam(CBlastUsageReport::eVersion, GetVersion().Print());
@@ -97,6 +99,20 @@ private:
 
     void x_AddCmdOptions();
 
+    /// Load the next BLAST archive of the input, i.e.: the archive of the
+    /// next chunk of a hit table
+    /// @return false if there are no more archives
+    bool x_LoadFromArchive();
+
+    /// Retrieve the results of the current BLAST archive, with the
+    /// alignments of the current hit table chunk if the input is a hit table
+    /// @param queries Queries of the archive [in]
+    /// @param opts Search options of the archive [in]
+    /// @param db_adapter Database the search was run against [in]
+    CRef<CSearchResultSet> x_GetResultSet(CRef<CBlastQueryVector> queries,
+                                          const CBlastOptions& opts,
+                                          CLocalDbAdapter& db_adapter);
+
     /// Our link to the NCBI BLAST service
     CRef<CRemoteBlast> m_RmtBlast;
 
@@ -105,6 +121,13 @@ private:
 
     /// Tracks whether results come from an archive file.
     bool m_LoadFromArchive;
+
+    /// Binary hit table (output format 21) being formatted, if any
+    CRef<CBlastHitTableReader> m_HitTable;
+    /// Index of the next hit table chunk
+    size_t m_HitTableChunk;
+    /// Stream over the BLAST archive of the current hit table chunk
+    unique_ptr<CNcbiIstrstream> m_HitTableArchive;
     CBlastUsageReport m_UsageReport;
     CStopWatch m_StopWatch;
 };
@@ -124,7 +147,8 @@ void CBlastFormatterApp::Init()
                      CArgDescriptions::eString);
 
     // add input file for seq-align here?
-    arg_desc->AddOptionalKey(kArgArchive, "ArchiveFile", "File containing BLAST Archive format in ASN.1 (i.e.: output format 11)", 
+    arg_desc->AddOptionalKey(kArgArchive, "ArchiveFile", "File containing BLAST Archive format in ASN.1 (i.e.: output format 11) "
+                     "or a binary hit table (i.e.: output format 21)", 
                      CArgDescriptions::eInputFile);
     arg_desc->SetDependency(kArgRid, CArgDescriptions::eExcludes, kArgArchive);
 
@@ -338,13 +362,11 @@ int CBlastFormatterApp::PrintFormattedOutput(void)
     CRef<CBlastOptionsHandle> opts_handle = m_RmtBlast->GetSearchOptions();
     CBlastOptions& opts = opts_handle->SetOptions();
     fmt_args.ExtractAlgorithmOptions(args, opts);
-    {{
-        CDebugArgs debug_args;
-        debug_args.ExtractAlgorithmOptions(args, opts);
-        if (debug_args.ProduceDebugOutput()) {
-            opts.DebugDumpText(NcbiCerr, "BLAST options", 1);
-        }
-    }}
+    CDebugArgs debug_args;
+    debug_args.ExtractAlgorithmOptions(args, opts);
+    if (debug_args.ProduceDebugOutput()) {
+        opts.DebugDumpText(NcbiCerr, "BLAST options", 1);
+    }
 
 
     const EBlastProgramType p = opts.GetProgramType();
@@ -426,7 +448,7 @@ int CBlastFormatterApp::PrintFormattedOutput(void)
     if(UseXInclude(fmt_args, args[kArgOutput].AsString())) {
        	formatter.SetBaseFile(args[kArgOutput].AsString());
     }
-    CRef<CSearchResultSet> results = m_RmtBlast->GetResultSet();
+    CRef<CSearchResultSet> results = x_GetResultSet(queries, opts, *db_adapter);
     formatter.PrintProlog();
     bool isPsiBlast = ("psiblast" == kTask);
     if (fmt_args.ArchiveFormatRequested(args))
@@ -472,13 +494,13 @@ int CBlastFormatterApp::PrintFormattedOutput(void)
                         && fmt_args.GetFormattedOutputChoice() != CFormattingArgs::eJson
                         && fmt_args.GetFormattedOutputChoice() != CFormattingArgs::eXml2_S
                         && fmt_args.GetFormattedOutputChoice() != CFormattingArgs::eJson_S )
-			|| !m_RmtBlast->LoadFromArchive()) {
+			|| !x_LoadFromArchive()) {
 			break;
                 }
 		// Reset these for next set from archive
-    		results.Reset(m_RmtBlast->GetResultSet());
     		queries.Reset(x_ExtractQueries(Blast_QueryIsProtein(p)?true:false));
     		_ASSERT(queries);
+    		results.Reset(x_GetResultSet(queries, opts, *db_adapter));
                 if (fmt_args.GetFormattedOutputChoice() == CFormattingArgs::eXml) {
     		    scope.Reset(queries->GetScope(0));
                 }
@@ -489,6 +511,9 @@ int CBlastFormatterApp::PrintFormattedOutput(void)
 	}
     }
     formatter.PrintEpilog(opts);
+    if (debug_args.ProduceDebugOutput()) {
+        PrintBlastDbCacheStatistics(NcbiCerr);
+    }
     return retval;
 }
 
@@ -504,18 +529,24 @@ int CBlastFormatterApp::Run(void)
     try {
         SetDiagPostLevel(eDiag_Warning);
         if (args[kArgArchive].HasValue()) {
-            CNcbiIstream& istr = args[kArgArchive].AsInputFile();
-            try { m_RmtBlast.Reset(new CRemoteBlast(istr)); }
-            catch (const CBlastException& e) {
-                if (e.GetErrCode() == CBlastException::eInvalidArgument) {
-                    NCBI_RETHROW(e, CInputException, eInvalidInput,
-                                 "Invalid input format for BLAST Archive.");
+            const string& kArchive = args[kArgArchive].AsString();
+            if (kArchive != "-" && CBlastHitTableReader::IsHitTable(kArchive)) {
+                // The hit table is memory mapped rather than read as a stream
+                m_HitTable.Reset(new CBlastHitTableReader(kArchive));
+            } else {
+                CNcbiIstream& istr = args[kArgArchive].AsInputFile();
+                try { m_RmtBlast.Reset(new CRemoteBlast(istr)); }
+                catch (const CBlastException& e) {
+                    if (e.GetErrCode() == CBlastException::eInvalidArgument) {
+                        NCBI_RETHROW(e, CInputException, eInvalidInput,
+                                     "Invalid input format for BLAST Archive.");
+                    }
                 }
             }
 
 	    m_LoadFromArchive = true;
             try {
-                while (m_RmtBlast->LoadFromArchive()) {
+                while (x_LoadFromArchive()) {
                 	if(!m_RmtBlast->IsErrMsgArchive()) {
                 		status = PrintFormattedOutput();
                 	}
@@ -571,6 +602,51 @@ int CBlastFormatterApp::Run(void)
     return status;
 }
 
+bool CBlastFormatterApp::x_LoadFromArchive()
+{
+    if (m_HitTable.Empty()) {
+        return m_RmtBlast->LoadFromArchive();
+    }
+    if (m_HitTableChunk >= m_HitTable->GetNumChunks()) {
+        return false;
+    }
+    const SHitTableChunk& chunk = m_HitTable->GetChunk(m_HitTableChunk++);
+    m_HitTableArchive.reset(new CNcbiIstrstream(
+        string(chunk.archive, (size_t)chunk.header->archive_size)));
+    m_RmtBlast.Reset(new CRemoteBlast(*m_HitTableArchive));
+    return m_RmtBlast->LoadFromArchive();
+}
+
+CRef<CSearchResultSet>
+CBlastFormatterApp::x_GetResultSet(CRef<CBlastQueryVector> queries,
+                                   const CBlastOptions& opts,
+                                   CLocalDbAdapter& db_adapter)
+{
+    CRef<CSearchResultSet> retval = m_RmtBlast->GetResultSet();
+    if (m_HitTable.Empty()) {
+        return retval;
+    }
+
+    // The archive of a hit table chunk has no alignments; they are rebuilt
+    // from the HSP columns
+    CRef<IQueryFactory> query_factory(new CObjMgr_QueryFactory(*queries));
+    CRef<ILocalQueryData> query_data =
+        query_factory->MakeLocalQueryData(&opts);
+    CRef<IBlastSeqInfoSrc> seqinfo_src(db_adapter.MakeSeqInfoSrc());
+    vector<TSeqLocInfoVector> subj_masks;
+    TSeqAlignVector aligns = m_HitTable->GetSeqAligns(m_HitTableChunk - 1,
+                                                      *query_data,
+                                                      *seqinfo_src, opts,
+                                                      subj_masks);
+    for (size_t i = 0; i < aligns.size() && i < retval->size(); i++) {
+        (*retval)[i].SetSeqAlign()->Set() = aligns[i]->Get();
+        if (i < subj_masks.size()) {
+            (*retval)[i].SetSubjectMasks(subj_masks[i]);
+        }
+    }
+    return retval;
+}
+
 void CBlastFormatterApp::x_AddCmdOptions()
 {
 	const CArgs & args = GetArgs();
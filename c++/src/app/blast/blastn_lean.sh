@@ -0,0 +1,92 @@
+#! /bin/sh
+# $Id$
+#
+# Checks that blastn -lean writes the same tabular report as the search
+# through the object manager
+
+if test -z "$CHECK_EXEC"; then
+  bin="./"
+else
+  bin=""
+fi
+
+tmp=blastn_lean.$$
+mkdir $tmp || exit 1
+trap 'rm -rf $tmp' 0 1 2 15
+
+# Random subjects, and queries made of mutated pieces of them on either
+# strand, so that each query has hits of various lengths and scores
+awk 'BEGIN {
+    srand(1);
+    nt = "ACGT"; comp["A"] = "T"; comp["C"] = "G"; comp["G"] = "C"; comp["T"] = "A";
+    for (i = 1; i <= 200; i++) {
+        seq[i] = "";
+        len = 500 + int(rand() * 1500);
+        for (j = 0; j < len; j++) {
+            seq[i] = seq[i] substr(nt, int(rand() * 4) + 1, 1);
+        }
+        printf(">subject_%d test subject %d\n%s\n", i, i, seq[i]) > "'$tmp'/db.fsa";
+    }
+    for (q = 1; q <= 300; q++) {
+        s = int(rand() * 200) + 1;
+        from = int(rand() * 400);
+        len = 50 + int(rand() * 400);
+        query = "";
+        for (j = from; j < from + len && j < length(seq[s]); j++) {
+            c = substr(seq[s], j + 1, 1);
+            if (rand() < 0.05) {
+                c = substr(nt, int(rand() * 4) + 1, 1);
+            }
+            query = query c;
+        }
+        if (q % 2 == 0) {
+            rc = "";
+            for (j = length(query); j > 0; j--) {
+                rc = rc comp[substr(query, j, 1)];
+            }
+            query = rc;
+        }
+        printf(">query_%d from subject %d\n%s\n", q, s, query) > "'$tmp'/query.fsa";
+    }
+}' /dev/null
+
+$CHECK_EXEC ${bin}makeblastdb -in $tmp/db.fsa -dbtype nucl -parse_seqids \
+    -out $tmp/db > /dev/null || exit 1
+
+status=0
+check() {
+    $CHECK_EXEC ${bin}blastn -db $tmp/db -query $tmp/query.fsa -dust no \
+        "$@" -out $tmp/regular.out || exit 1
+    $CHECK_EXEC ${bin}blastn -db $tmp/db -query $tmp/query.fsa -dust no \
+        "$@" -lean -out $tmp/lean.out || exit 1
+    if test ! -s $tmp/regular.out; then
+        echo "No hits with $*"
+        status=1
+    elif ! cmp -s $tmp/regular.out $tmp/lean.out; then
+        echo "Reports differ with $*:"
+        diff $tmp/regular.out $tmp/lean.out | head -20
+        status=1
+    fi
+}
+
+check -outfmt 6
+check -outfmt 6 -task blastn
+check -outfmt "6 qseqid sseqid pident length mismatch gapopen qstart qend sstart send evalue bitscore qlen slen score gaps nident"
+check -outfmt 10 -num_threads 4
+check -outfmt 6 -max_target_seqs 3 -evalue 1e-10
+
+# The default DUST filtering is turned off with a warning, -mt_mode is an
+# error
+$CHECK_EXEC ${bin}blastn -db $tmp/db -query $tmp/query.fsa -outfmt 6 -lean \
+    -out $tmp/lean.out 2> $tmp/lean.err
+if test $? != 0 || ! grep -q "DUST" $tmp/lean.err; then
+    echo "-lean failed under the default DUST filtering"
+    status=1
+fi
+if $CHECK_EXEC ${bin}blastn -db $tmp/db -query $tmp/query.fsa -outfmt 6 \
+        -lean -num_threads 2 -mt_mode 1 -out $tmp/lean.out 2> /dev/null; then
+    echo "-lean was accepted with -mt_mode"
+    status=1
+fi
+
+exit $status
@@ -0,0 +1,74 @@
+#! /bin/sh
+# $Id$
+#
+# Times blastn with and without -lean on many short queries against a
+# generated BLAST database, the workload -lean is meant for.
+#
+# Usage: blastn_lean_perf.sh [num_queries [num_threads [database]]]
+# Without a database, one of 2000 random subjects of 5000 bases is built.
+
+num_queries=${1:-20000}
+num_threads=${2:-1}
+db=$3
+
+if test -z "$CHECK_EXEC"; then
+  bin="./"
+else
+  bin=""
+fi
+
+tmp=blastn_lean_perf.$$
+mkdir $tmp || exit 1
+trap 'rm -rf $tmp' 0 1 2 15
+
+if test -z "$db"; then
+    awk 'BEGIN {
+        srand(1);
+        nt = "ACGT";
+        for (i = 1; i <= 2000; i++) {
+            seq = "";
+            for (j = 0; j < 5000; j++) {
+                seq = seq substr(nt, int(rand() * 4) + 1, 1);
+            }
+            printf(">subject_%d\n%s\n", i, seq);
+        }
+    }' /dev/null > $tmp/db.fsa
+    $CHECK_EXEC ${bin}makeblastdb -in $tmp/db.fsa -dbtype nucl \
+        -parse_seqids -out $tmp/db > /dev/null || exit 1
+    db=$tmp/db
+fi
+
+# Reads of 150 bases with 2% errors, taken from the database
+$CHECK_EXEC ${bin}blastdbcmd -db $db -entry all -outfmt "%s" > $tmp/subjects.txt \
+    || exit 1
+awk -v n=$num_queries 'BEGIN { srand(2); nt = "ACGT" }
+{ seq[NR] = $0 }
+END {
+    for (q = 1; q <= n; q++) {
+        s = seq[int(rand() * NR) + 1];
+        from = int(rand() * (length(s) - 150));
+        read = "";
+        for (j = 1; j <= 150; j++) {
+            c = substr(s, from + j, 1);
+            if (rand() < 0.02) {
+                c = substr(nt, int(rand() * 4) + 1, 1);
+            }
+            read = read c;
+        }
+        printf(">read_%d\n%s\n", q, read);
+    }
+}' $tmp/subjects.txt > $tmp/query.fsa
+
+run() {
+    start=`date +%s.%N`
+    $CHECK_EXEC ${bin}blastn -db $db -query $tmp/query.fsa -outfmt 6 \
+        -dust no -num_threads $num_threads "$@" -out $tmp/out.tab || exit 1
+    end=`date +%s.%N`
+    awk -v s=$start -v e=$end -v n=$num_queries -v l="$*" -v h=`wc -l < $tmp/out.tab` \
+        'BEGIN { printf("%-8s %8.2f s %10.0f queries/s %10d hits\n",
+                        (l == "" ? "regular" : l), e - s, n / (e - s), h) }'
+}
+
+echo "$num_queries queries, $num_threads threads"
+run
+run -lean
@@ -201,6 +201,7 @@ CBlastnNode::Main()
                 CLocalBlast lcl_blast(queries, opts_hndl, db_adapter);
                 lcl_blast.SetNumberOfThreads(1);
                 results = lcl_blast.Run();
+                AddNumHits(lcl_blast.GetNumExtensions());
                 if (!batch_size)
                     input.SetBatchSize(mixer.GetBatchSize(lcl_blast.GetNumExtensions()));
             }
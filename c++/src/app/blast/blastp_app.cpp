@@ -39,6 +39,7 @@
 #include <algo/blast/blastinput/blastp_args.hpp>
 #include <algo/blast/api/objmgr_query_data.hpp>
 #include <algo/blast/format/blast_format.hpp>
+#include <algo/blast/format/blast_async_format.hpp>
 #include "blast_app_util.hpp"
 #include "blastp_node.hpp"
 
@@ -73,6 +74,12 @@ private:
 
     int x_RunMTBySplitDB();
     int x_RunMTBySplitQuery();
+    int x_RunLean();
+
+    /// Create the formatter of the reports written to out
+    CRef<CBlastFormat> x_CreateFormatter(const CBlastOptions& opt,
+                                         CLocalDbAdapter& db_adapter,
+                                         CScope& scope, CNcbiOstream& out);
 
     /// This application's command line args
     CRef<CBlastpAppArgs> m_CmdLineArgs;
@@ -93,6 +100,9 @@ void CBlastpApp::Init()
 int CBlastpApp::Run(void)
 {
 	const CArgs& args = GetArgs();
+	if (args.Exist(kArgLean) && args[kArgLean]) {
+		return x_RunLean();
+	}
 	CMTArgs mt_args(args);
 	if ((mt_args.GetMTMode() == CMTArgs::eSplitByQueries) &&
 		(mt_args.GetNumThreads() > 1)){
@@ -109,6 +119,8 @@ int CBlastpApp::x_RunMTBySplitDB()
 
     int status = BLAST_EXIT_SUCCESS;
     CBlastAppDiagHandler bah;
+    int batch_num = 0;
+    CRef<CBlastAsyncFormatThread> fmt_thread;
 
     try {
 
@@ -161,40 +173,38 @@ int CBlastpApp::x_RunMTBySplitDB()
         if(!isArchiveFormat) {
            	bah.DoNotSaveMessages();
         }
-        CBlastFormat formatter(opt, *db_adapter,
-                               fmt_args->GetFormattedOutputChoice(),
-                               query_opts->GetParseDeflines(),
-                               m_CmdLineArgs->GetOutputStream(),
-                               fmt_args->GetNumDescriptions(),
-                               fmt_args->GetNumAlignments(),
-                               *scope,
-                               opt.GetMatrixName(),
-                               fmt_args->ShowGis(),
-                               fmt_args->DisplayHtmlOutput(),
-                               opt.GetQueryGeneticCode(),
-                               opt.GetDbGeneticCode(),
-                               opt.GetSumStatisticsMode(),
-                               m_CmdLineArgs->ExecuteRemotely(),
-                               db_adapter->GetFilteringAlgorithm(),
-                               fmt_args->GetCustomOutputFormatSpec(),
-                               false, false, NULL, NULL,
-                               GetCmdlineArgs(GetArguments()),
-			       GetSubjectFile(args));
-        
-        formatter.SetQueryRange(query_opts->GetRange());
-        formatter.SetLineLength(fmt_args->GetLineLength());
-        formatter.SetHitsSortOption(fmt_args->GetHitsSortOption());
-        formatter.SetHspsSortOption(fmt_args->GetHspsSortOption());
-        formatter.SetCustomDelimiter(fmt_args->GetCustomDelimiter());
-	if(UseXInclude(*fmt_args, args[kArgOutput].AsString())) {
-        	formatter.SetBaseFile(args[kArgOutput].AsString());
-        }
+        CRef<CBlastFormat> formatter_ref =
+            x_CreateFormatter(opt, *db_adapter, *scope,
+                              m_CmdLineArgs->GetOutputStream());
+        CBlastFormat& formatter = *formatter_ref;
+        // Plain tabular reports are rendered directly from the HSPs
+        CRef<IBlastHSPResultsWriter> hsp_writer =
+            formatter.GetHSPResultsWriter(m_CmdLineArgs->GetNumThreads());
         formatter.PrintProlog();
 
+        // Reports printed query by query are formatted by a pool of threads
+        // while the next batches are searched
+        const int kNumFmtThreads =
+            GetNumFormattingThreads(*m_CmdLineArgs, args, *db_adapter,
+                                    hsp_writer.NotEmpty());
+        if (kNumFmtThreads > 0) {
+            fmt_thread.Reset(new CBlastAsyncFormatThread
+                             (kNumFmtThreads, &m_CmdLineArgs->GetOutputStream(),
+                              kNumFmtThreads));
+            fmt_thread->Run();
+        }
+
         /*** Process the input ***/
         for (; !input.End(); formatter.ResetScopeHistory(), QueryBatchCleanup()) {
 
-            CRef<CBlastQueryVector> query_batch(input.GetNextSeqBatch(*scope));
+            CRef<CScope> batch_scope(scope);
+            if (fmt_thread.NotEmpty()) {
+                // The queries of each batch go to a scope of its own, which
+                // is released once the batch is formatted
+                batch_scope.Reset(new CScope(*CObjectManager::GetInstance()));
+                batch_scope->AddScope(*scope);
+            }
+            CRef<CBlastQueryVector> query_batch(input.GetNextSeqBatch(*batch_scope));
             CRef<IQueryFactory> queries(new CObjMgr_QueryFactory(*query_batch));
 
             SaveSearchStrategy(args, m_CmdLineArgs, queries, opts_hndl);
@@ -210,12 +220,22 @@ int CBlastpApp::x_RunMTBySplitDB()
             } else {
                 CLocalBlast lcl_blast(queries, opts_hndl, db_adapter);
                 lcl_blast.SetNumberOfThreads(m_CmdLineArgs->GetNumThreads());
+                lcl_blast.SetHSPResultsWriter(hsp_writer);
                 results = lcl_blast.Run();
             }
 
             if (fmt_args->ArchiveFormatRequested(args)) {
                 formatter.WriteArchive(*queries, *opts_hndl, *results,  0, bah.GetMessages());
                 bah.ResetMessages();
+            } else if (fmt_thread.NotEmpty()) {
+                BlastFormatter_PreFetchSequenceData(*results, batch_scope,
+                		                            fmt_args->GetFormattedOutputChoice());
+                shared_ptr<CNcbiOstrstream> buffer(new CNcbiOstrstream);
+                vector<SFormatResultValues> values;
+                values.push_back(SFormatResultValues(query_batch, results,
+                    x_CreateFormatter(opt, *db_adapter, *batch_scope, *buffer),
+                    buffer));
+                fmt_thread->QueueResults(batch_num, values);
             } else {
                 BlastFormatter_PreFetchSequenceData(*results, scope,
                 		                            fmt_args->GetFormattedOutputChoice());
@@ -223,17 +243,32 @@ int CBlastpApp::x_RunMTBySplitDB()
                     formatter.PrintOneResultSet(**result, query_batch);
                 }
             }
+            batch_num++;
+        }
+        if (fmt_thread.NotEmpty()) {
+            CRef<CBlastAsyncFormatThread> t(fmt_thread);
+            fmt_thread.Reset();
+            t->Join();
         }
 
         formatter.PrintEpilog(opt);
 
         if (m_CmdLineArgs->ProduceDebugOutput()) {
             opts_hndl->GetOptions().DebugDumpText(NcbiCerr, "BLAST options", 1);
+            PrintBlastDbCacheStatistics(NcbiCerr);
         }
 
         LogQueryInfo(m_UsageReport, input);
         formatter.LogBlastSearchInfo(m_UsageReport);
     } CATCH_ALL(status)
+    if (fmt_thread.NotEmpty()) {
+        // The search failed; let the formatting threads exit
+        try {
+            fmt_thread->Join();
+        } catch (const CException&) {
+            // Already reported by the formatting threads
+        }
+    }
     if(!bah.GetMessages().empty()) {
        	const CArgs & a = GetArgs();
        	PrintErrorArchive(a, bah.GetMessages());
@@ -245,6 +280,70 @@ int CBlastpApp::x_RunMTBySplitDB()
     return status;
 }
 
+CRef<CBlastFormat>
+CBlastpApp::x_CreateFormatter(const CBlastOptions& opt,
+                              CLocalDbAdapter& db_adapter,
+                              CScope& scope, CNcbiOstream& out)
+{
+    const CArgs& args = GetArgs();
+    CRef<CFormattingArgs> fmt_args(m_CmdLineArgs->GetFormattingArgs());
+    CRef<CQueryOptionsArgs> query_opts =
+        m_CmdLineArgs->GetQueryOptionsArgs();
+    CRef<CBlastFormat> formatter(new CBlastFormat(opt, db_adapter,
+                               fmt_args->GetFormattedOutputChoice(),
+                               query_opts->GetParseDeflines(),
+                               out,
+                               fmt_args->GetNumDescriptions(),
+                               fmt_args->GetNumAlignments(),
+                               scope,
+                               opt.GetMatrixName(),
+                               fmt_args->ShowGis(),
+                               fmt_args->DisplayHtmlOutput(),
+                               opt.GetQueryGeneticCode(),
+                               opt.GetDbGeneticCode(),
+                               opt.GetSumStatisticsMode(),
+                               m_CmdLineArgs->ExecuteRemotely(),
+                               db_adapter.GetFilteringAlgorithm(),
+                               fmt_args->GetCustomOutputFormatSpec(),
+                               false, false, NULL, NULL,
+                               GetCmdlineArgs(GetArguments()),
+                               GetSubjectFile(args)));
+
+    formatter->SetQueryRange(query_opts->GetRange());
+    formatter->SetLineLength(fmt_args->GetLineLength());
+    formatter->SetHitsSortOption(fmt_args->GetHitsSortOption());
+    formatter->SetHspsSortOption(fmt_args->GetHspsSortOption());
+    formatter->SetCustomDelimiter(fmt_args->GetCustomDelimiter());
+    if(UseXInclude(*fmt_args, args[kArgOutput].AsString())) {
+        formatter->SetBaseFile(args[kArgOutput].AsString());
+    }
+    return formatter;
+}
+
+int CBlastpApp::x_RunLean()
+{
+    int status = BLAST_EXIT_SUCCESS;
+
+    try {
+
+        // Allow the fasta reader to complain on invalid sequence input
+        SetDiagPostLevel(eDiag_Warning);
+        SetDiagPostPrefix("blastp");
+
+        /*** Get the BLAST options ***/
+        const CArgs& args = GetArgs();
+        CRef<CBlastOptionsHandle> opts_hndl(&*m_CmdLineArgs->SetOptions(args));
+
+        /*** Search and format without the object manager ***/
+        RunLeanSearch(*m_CmdLineArgs, args, opts_hndl, m_UsageReport);
+    } CATCH_ALL(status)
+
+    m_UsageReport.AddParam(CBlastUsageReport::eTask, m_CmdLineArgs->GetTask());
+    m_UsageReport.AddParam(CBlastUsageReport::eNumThreads, (int) m_CmdLineArgs->GetNumThreads());
+    m_UsageReport.AddParam(CBlastUsageReport::eExitStatus, status);
+    return status;
+}
+
 int CBlastpApp::x_RunMTBySplitQuery()
 {
     int status = BLAST_EXIT_SUCCESS;
@@ -279,11 +378,15 @@ int CBlastpApp::x_RunMTBySplitQuery()
    	    int batch_size = GetMTByQueriesBatchSize(opts_hndl->GetOptions().GetProgram(), kMaxNumOfThreads);
    		INFO_POST("Batch Size: " << batch_size);
    		CBlastNodeInputReader input(m_CmdLineArgs->GetInputStream(), batch_size, 2000);
+   		CBlastNodeBatchScheduler scheduler(batch_size, kMaxNumOfThreads);
+   		CRef<CSeqDB> seqdb = GetMTByQueriesSeqDb(*m_CmdLineArgs);
 		while (master_node.Processing()) {
 			if (!input.AtEOF()) {
 			 	if (!master_node.IsFull()) {
 					string qb;
 					int q_index = 0;
+					scheduler.Update(master_node.GetQueriesLength(), master_node.GetNumHits());
+					input.SetQueryBatchSize(scheduler.GetBatchSize(input.GetRemainingInputSize()));
 					int num_q = input.GetQueryBatch(qb, q_index);
 					if (num_q > 0) {
 						CBlastNodeMailbox * mb(new CBlastNodeMailbox(chunk_num, master_node.GetBuzzer()));
@@ -306,6 +409,7 @@ int CBlastpApp::x_RunMTBySplitQuery()
 		m_UsageReport.AddParam(CBlastUsageReport::eNumQueries, master_node.GetNumOfQueries());
 		m_UsageReport.AddParam(CBlastUsageReport::eTotalQueryLength, master_node.GetQueriesLength());
 		m_UsageReport.AddParam(CBlastUsageReport::eNumErrStatus, master_node.GetNumErrStatus());
+		LogMTByQueriesThreadTimes(m_UsageReport, master_node);
 
 	} CATCH_ALL (status)
 
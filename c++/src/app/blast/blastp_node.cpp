@@ -177,6 +177,7 @@ CBlastpNode::Main()
                 CLocalBlast lcl_blast(queries, opts_hndl, db_adapter);
                 lcl_blast.SetNumberOfThreads(1);
                 results = lcl_blast.Run();
+                AddNumHits(lcl_blast.GetNumExtensions());
             }
 
             if (fmt_args->ArchiveFormatRequested(args)) {
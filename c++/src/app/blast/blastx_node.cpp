@@ -181,6 +181,7 @@ CBlastxNode::Main()
                 CLocalBlast lcl_blast(queries, opts_hndl, db_adapter);
                 lcl_blast.SetNumberOfThreads(1);
                 results = lcl_blast.Run();
+                AddNumHits(lcl_blast.GetNumExtensions());
             }
 
             if (isArchiveFormat) {
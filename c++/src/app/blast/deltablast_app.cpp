@@ -447,6 +447,7 @@ int CDeltaBlastApp::Run(void)
 
         if (m_CmdLineArgs->ProduceDebugOutput()) {
             opts_hndl->GetOptions().DebugDumpText(NcbiCerr, "BLAST options", 1);
+            PrintBlastDbCacheStatistics(NcbiCerr);
         }
 
         LogQueryInfo(m_UsageReport, input);
@@ -591,7 +592,8 @@ CDeltaBlastApp::ComputePssmForNextPsiBlastIteration(const CBioseq& bioseq,
     
     m_AncillaryData = ancillary_data;
     return PsiBlastComputePssmFromAlignment(bioseq, sset, scope, *opts_handle,
-                                            m_AncillaryData, diags);
+                                            m_AncillaryData, diags,
+                                            m_CmdLineArgs->GetNumThreads());
 }
 
 
@@ -176,7 +176,8 @@ CPsiBlastApp::ComputePssmForNextIteration(const CBioseq& bioseq,
         diags(PSIDiagnosticsRequestNewEx(m_CmdLineArgs->SaveAsciiPssm()));
     m_AncillaryData = ancillary_data;
     return PsiBlastComputePssmFromAlignment(bioseq, sset, scope, *opts_handle,
-                                            m_AncillaryData, diags);
+                                            m_AncillaryData, diags,
+                                            m_CmdLineArgs->GetNumThreads());
 }
 
 /*** Convenience function to make a query factory object */
@@ -561,8 +562,10 @@ int CPsiBlastApp::Run(void)
         // finish up
         formatter.PrintEpilog(opt);
 
-        if (m_CmdLineArgs->ProduceDebugOutput())
+        if (m_CmdLineArgs->ProduceDebugOutput()) {
             opts_hndl->GetOptions().DebugDumpText(NcbiCerr, "BLAST options", 1);
+            PrintBlastDbCacheStatistics(NcbiCerr);
+        }
         if(input) {
             LogQueryInfo(m_UsageReport, *input);
         }
@@ -230,6 +230,7 @@ int CRPSBlastApp::x_RunMTBySplitDB(void)
 
         if (m_CmdLineArgs->ProduceDebugOutput()) {
             opts_hndl->GetOptions().DebugDumpText(NcbiCerr, "BLAST options", 1);
+            PrintBlastDbCacheStatistics(NcbiCerr);
         }
 
         LogQueryInfo(m_UsageReport, input);
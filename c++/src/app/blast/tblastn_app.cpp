@@ -286,6 +286,7 @@ int CTblastnApp::x_RunMTBySplitDB()
 
         if (m_CmdLineArgs->ProduceDebugOutput()) {
             opts_hndl->GetOptions().DebugDumpText(NcbiCerr, "BLAST options", 1);
+            PrintBlastDbCacheStatistics(NcbiCerr);
         }
         if (input) {
         	LogQueryInfo(m_UsageReport, *input);
@@ -336,11 +337,15 @@ int CTblastnApp::x_RunMTBySplitQuery()
    	    int batch_size = GetMTByQueriesBatchSize(opts_hndl->GetOptions().GetProgram(), kMaxNumOfThreads);
    		INFO_POST("Batch Size: " << batch_size);
    		CBlastNodeInputReader input(m_CmdLineArgs->GetInputStream(), batch_size, 2000);
+   		CBlastNodeBatchScheduler scheduler(batch_size, kMaxNumOfThreads);
+   		CRef<CSeqDB> seqdb = GetMTByQueriesSeqDb(*m_CmdLineArgs);
 		while (master_node.Processing()) {
 			if (!input.AtEOF()) {
 			 	if (!master_node.IsFull()) {
 					string qb;
 					int q_index = 0;
+					scheduler.Update(master_node.GetQueriesLength(), master_node.GetNumHits());
+					input.SetQueryBatchSize(scheduler.GetBatchSize(input.GetRemainingInputSize()));
 					int num_q = input.GetQueryBatch(qb, q_index);
 					if (num_q > 0) {
 						CBlastNodeMailbox * mb(new CBlastNodeMailbox(chunk_num, master_node.GetBuzzer()));
@@ -363,6 +368,7 @@ int CTblastnApp::x_RunMTBySplitQuery()
 		m_UsageReport.AddParam(CBlastUsageReport::eNumQueries, master_node.GetNumOfQueries());
 		m_UsageReport.AddParam(CBlastUsageReport::eTotalQueryLength, master_node.GetQueriesLength());
 		m_UsageReport.AddParam(CBlastUsageReport::eNumErrStatus, master_node.GetNumErrStatus());
+		LogMTByQueriesThreadTimes(m_UsageReport, master_node);
 
 	} CATCH_ALL (status)
 
@@ -205,6 +205,7 @@ CTblastnNode::Main()
                     CLocalBlast lcl_blast(query_factory, opts_hndl, db_adapter);
                     lcl_blast.SetNumberOfThreads(1);
                     results = lcl_blast.Run();
+                    AddNumHits(lcl_blast.GetNumExtensions());
                 }
 
                 if (fmt_args->ArchiveFormatRequested(args)) {
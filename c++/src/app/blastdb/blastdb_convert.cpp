@@ -41,6 +41,7 @@
 #include <objtools/blast/seqdb_reader/seqdb.hpp>
 #include <objtools/blast/seqdb_reader/impl/seqdbgeneral.hpp>
 #include <objtools/blast/seqdb_reader/impl/seqdb_lmdb.hpp>
+#include <objtools/blast/seqdb_writer/writedb.hpp>
 #include <objtools/blast/seqdb_writer/writedb_error.hpp>
 #include <objtools/blast/seqdb_writer/writedb_files.hpp>
 #include <objtools/blast/seqdb_writer/writedb_lmdb.hpp>
@@ -142,6 +143,12 @@ void CBlastdbConvertApp::Init()
     arg_desc->AddDefaultKey(kMapSize, "memory_map_size_limit",
                                 "Max mempry map size of output file",
                                 CArgDescriptions::eInt8, "1000000000000");
+    arg_desc->AddDefaultKey("seq_compression", "method",
+                            "Store the sequence data in compressed blocks, "
+                            "which are decompressed on demand when read",
+                            CArgDescriptions::eString, "none");
+    arg_desc->SetConstraint("seq_compression", &(*new CArgAllow_Strings,
+                                                 "none", "zlib", "zstd"));
 
     arg_desc->SetCurrentGroup("Output options");
     arg_desc->AddKey(kArgOutput, "database_name",
@@ -313,6 +320,8 @@ int CBlastdbConvertApp::Run(void)
     const bool kIsProt = (seqtype == CSeqDB::eProtein);
     string kOutputAbsPath = CDirEntry::CreateAbsolutePath(kOutput);
     const bool kNewIndex = args["new_index"].HasValue() ? true: false;
+    const ESeqDBSeqCompression kCompression =
+        SeqDB_ParseSeqCompression(args["seq_compression"].AsString());
 
     m_LogFile = & (args["logfile"].HasValue()? args["logfile"].AsOutputFile() : cout);
     SetDiagPostLevel(eDiag_Warning);
@@ -473,6 +482,13 @@ int CBlastdbConvertApp::Run(void)
         	s_UpdateVolumesInAliasFile(alias_files[0],kOutputFile, vol_names);
         }
 
+        if (kCompression != eSeqDBSeqCompress_None) {
+            CWriteDB_CompressSequenceFiles(kOutput,
+                                           kIsProt ? CWriteDB::eProtein
+                                                   : CWriteDB::eNucleotide,
+                                           kCompression);
+        }
+
     } CATCH_ALL(status)
 
     if((status != 0) && cleanup) {
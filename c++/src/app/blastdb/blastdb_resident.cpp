@@ -0,0 +1,298 @@
+/*  $Id$
+ * ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+/** @file blastdb_resident.cpp
+ * Command line tool to keep BLAST database files resident in memory.
+ *
+ * The tool maps every file of the requested BLAST databases read-only and
+ * shared, reads them into the page cache and (optionally) locks the pages
+ * with mlock.  Because CSeqDB memory maps the same files, all BLAST
+ * processes on the node then open and scan the databases from memory
+ * shared with this process, instead of each faulting the pages in from
+ * (possibly network) storage.  The tool keeps the files resident until it
+ * receives SIGINT or SIGTERM, or until the -duration has elapsed.
+ */
+
+#include <ncbi_pch.hpp>
+#include <corelib/ncbiapp.hpp>
+#include <corelib/ncbifile.hpp>
+#include <corelib/ncbi_signal.hpp>
+#include <corelib/ncbi_process.hpp>
+#include <corelib/ncbi_system.hpp>
+#include <algo/blast/api/version.hpp>
+#include <objtools/blast/seqdb_reader/seqdbexpert.hpp>
+#include <algo/blast/blastinput/blast_input.hpp>
+#include "../blast/blast_app_util.hpp"
+
+#if defined(NCBI_OS_UNIX)
+#  include <sys/mman.h>
+#endif
+
+
+#ifndef SKIP_DOXYGEN_PROCESSING
+USING_NCBI_SCOPE;
+USING_SCOPE(blast);
+#endif
+
+/// The application class
+class CBlastDBResidentApp : public CNcbiApplication
+{
+public:
+    /** @inheritDoc */
+    CBlastDBResidentApp() {
+        CRef<CVersion> version(new CVersion());
+        version->SetVersionInfo(new CBlastVersion());
+        SetFullVersion(version);
+    }
+private:
+    /** @inheritDoc */
+    virtual void Init();
+    /** @inheritDoc */
+    virtual int Run();
+
+    /// Collect the names of all files belonging to a BLAST database
+    /// @param dbname Name of the BLAST database [in]
+    /// @param seqdb The opened BLAST database [in]
+    /// @param files Database file names are appended here [in|out]
+    void x_GetDbFiles(const string & dbname, const CSeqDB & seqdb,
+                      vector<string> & files);
+
+    /// Map a file and bring its pages into memory
+    /// @param fname Name of the file to map [in]
+    /// @param lock Lock the mapped pages in memory [in]
+    /// @return Number of bytes made resident
+    Uint8 x_MakeResident(const string & fname, bool lock);
+
+    /// Mappings kept alive for the lifetime of the process
+    vector< shared_ptr<CMemoryFile> > m_Files;
+};
+
+void CBlastDBResidentApp::Init()
+{
+    HideStdArgs(fHideConffile | fHideFullVersion | fHideXmlHelp | fHideDryRun);
+
+    unique_ptr<CArgDescriptions> arg_desc(new CArgDescriptions);
+
+    // Specify USAGE context
+    arg_desc->SetUsageContext(GetArguments().GetProgramBasename(),
+                  "Keep BLAST databases resident in memory, version " +
+                  CBlastVersion().Print());
+
+    arg_desc->SetCurrentGroup("BLAST database options");
+    arg_desc->AddKey(kArgDb, "dbname",
+                     "BLAST database name(s), separated by spaces",
+                     CArgDescriptions::eString);
+
+    arg_desc->AddDefaultKey(kArgDbType, "molecule_type",
+                            "Molecule type stored in BLAST database",
+                            CArgDescriptions::eString, "guess");
+    arg_desc->SetConstraint(kArgDbType, &(*new CArgAllow_Strings,
+                                        "nucl", "prot", "guess"));
+    arg_desc->AddFlag("no_taxdb", "Do not keep the taxonomy database resident",
+                      true);
+
+    arg_desc->SetCurrentGroup("Residency options");
+    arg_desc->AddFlag("lock",
+                      "Lock the database pages in memory (mlock); requires a "
+                      "sufficient RLIMIT_MEMLOCK", true);
+    arg_desc->AddDefaultKey("duration", "seconds",
+                            "Number of seconds to keep the databases resident, "
+                            "0 waits for SIGINT or SIGTERM",
+                            CArgDescriptions::eInteger, "0");
+    arg_desc->SetConstraint("duration", new CArgAllowValuesGreaterThanOrEqual(0));
+    arg_desc->AddOptionalKey("ready_file", "file_name",
+                             "File to create (holding the process id) once the "
+                             "databases are resident; it is removed on exit",
+                             CArgDescriptions::eString);
+
+    arg_desc->SetCurrentGroup("Output configuration options");
+    arg_desc->AddDefaultKey(kArgOutput, "output_file", "Output file name",
+                            CArgDescriptions::eOutputFile, "-");
+
+    SetupArgDescriptions(arg_desc.release());
+}
+
+void CBlastDBResidentApp::x_GetDbFiles(const string & dbname,
+                                       const CSeqDB & seqdb,
+                                       vector<string> & files)
+{
+    const bool is_protein = (seqdb.GetSequenceType() == CSeqDB::eProtein);
+    vector<string> vol_paths;
+    vector<string> alias_paths;
+    CSeqDB::FindVolumePaths(dbname, seqdb.GetSequenceType(), vol_paths,
+                            &alias_paths);
+
+    files.insert(files.end(), alias_paths.begin(), alias_paths.end());
+
+    // The volume files depend on the database version (e.g. the string
+    // ISAM files of version 4)
+    vector<string> vol_extn;
+    SeqDB_GetFileExtensions(is_protein, vol_extn, seqdb.GetBlastDbVersion());
+    ITERATE(vector<string>, vol, vol_paths) {
+        ITERATE(vector<string>, ext, vol_extn) {
+            files.push_back(*vol + "." + *ext);
+        }
+    }
+
+    // The LMDB files are shared by all volumes of a database; SeqDB
+    // reports the ones it uses, and the others have the same base name.
+    vector<string> lmdb_files;
+    seqdb.GetLMDBFileNames(lmdb_files);
+    vector<string> lmdb_extn;
+    SeqDB_GetLMDBFileExtensions(is_protein, lmdb_extn);
+    ITERATE(vector<string>, lmdb, lmdb_files) {
+        CFile lmdb_file(*lmdb);
+        string base = CDirEntry::MakePath(lmdb_file.GetDir(),
+                                          lmdb_file.GetBase());
+        ITERATE(vector<string>, ext, lmdb_extn) {
+            if ( !NStr::EndsWith(*ext, "-lock") ) {
+                files.push_back(base + "." + *ext);
+            }
+        }
+    }
+}
+
+Uint8 CBlastDBResidentApp::x_MakeResident(const string & fname, bool lock)
+{
+    CFile f(fname);
+    if ( !f.Exists() || f.GetLength() <= 0) {
+        return 0;
+    }
+
+    shared_ptr<CMemoryFile> mf(new CMemoryFile(fname));
+    const char * ptr = (const char *) mf->GetPtr();
+    size_t size = mf->GetSize();
+    if (ptr == NULL || size == 0) {
+        return 0;
+    }
+
+    mf->MemMapAdvise(CMemoryFile::eMMA_WillNeed);
+
+#if defined(NCBI_OS_UNIX)
+    if (lock) {
+        if (mlock(ptr, size) != 0) {
+            ERR_POST(Warning << "Cannot lock " << fname << " in memory: "
+                     << strerror(errno));
+        }
+    }
+#endif
+
+    // Touch one byte per page so that the file is resident on return,
+    // also where advice is ignored.
+    const size_t kPageSize = CSystemInfo::GetVirtualMemoryPageSize();
+    volatile char sum = 0;
+    for (size_t i = 0; i < size; i += kPageSize) {
+        sum ^= ptr[i];
+    }
+
+    m_Files.push_back(mf);
+    return size;
+}
+
+int CBlastDBResidentApp::Run(void)
+{
+    int status = 0;
+    const CArgs& args = GetArgs();
+    string ready_file;
+
+    try {
+        CNcbiOstream& out = args[kArgOutput].AsOutputFile();
+        string dbtype = args[kArgDbType].AsString();
+        bool lock = args["lock"];
+
+        vector<string> dbs;
+        NStr::Split(args[kArgDb].AsString(), " ", dbs, NStr::fSplit_Tokenize);
+
+        vector<string> files;
+        ITERATE(vector<string>, db, dbs) {
+            CSeqDB seqdb(*db, ParseMoleculeTypeString(dbtype));
+            x_GetDbFiles(*db, seqdb, files);
+        }
+
+        if ( !args["no_taxdb"] ) {
+            string taxdb = SeqDB_ResolveDbPath("taxdb.bti");
+            if ( !taxdb.empty() ) {
+                taxdb.resize(taxdb.size() - 4);
+                files.push_back(taxdb + ".bti");
+                files.push_back(taxdb + ".btd");
+            }
+        }
+
+        sort(files.begin(), files.end());
+        files.erase(unique(files.begin(), files.end()), files.end());
+
+        CStopWatch sw(CStopWatch::eStart);
+        Uint8 total = 0;
+        ITERATE(vector<string>, f, files) {
+            Uint8 bytes = x_MakeResident(*f, lock);
+            if (bytes) {
+                out << *f << "\t" << bytes << NcbiEndl;
+                total += bytes;
+            }
+        }
+        out << "Resident: " << m_Files.size() << " files, " << total
+            << " bytes" << (lock ? " (locked)" : "") << " in "
+            << sw.AsSmartString() << NcbiEndl;
+
+        CSignal::TrapSignals(CSignal::eSignal_INT | CSignal::eSignal_TERM |
+                             CSignal::eSignal_HUP);
+
+        if (args["ready_file"]) {
+            ready_file = args["ready_file"].AsString();
+            CNcbiOfstream ready(ready_file.c_str());
+            ready << CCurrentProcess::GetPid() << endl;
+        }
+
+        int duration = args["duration"].AsInteger();
+        CStopWatch wait(CStopWatch::eStart);
+        while ( !CSignal::IsSignaled() &&
+                (duration == 0 || wait.Elapsed() < duration)) {
+            SleepMilliSec(200);
+        }
+    }
+    catch (const CException& e) {
+        ERR_POST(Error << e.GetMsg());
+        status = 1;
+    } catch (...) {
+        ERR_POST(Error << "Failed to make databases resident");
+        status = 1;
+    }
+
+    if ( !ready_file.empty() ) {
+        CFile(ready_file).Remove();
+    }
+    m_Files.clear();
+    return status;
+}
+
+
+#ifndef SKIP_DOXYGEN_PROCESSING
+int main(int argc, const char* argv[] /*, const char* envp[]*/)
+{
+    return CBlastDBResidentApp().AppMain(argc, argv);
+}
+#endif /* SKIP_DOXYGEN_PROCESSING */
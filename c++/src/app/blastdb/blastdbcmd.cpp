@@ -49,6 +49,10 @@
 #include "../blast/blast_app_util.hpp"
 #include <iomanip>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 
 #ifndef SKIP_DOXYGEN_PROCESSING
 USING_NCBI_SCOPE;
@@ -93,6 +97,10 @@ private:
     bool m_GetDuplicates;
     /// should we output target sequence only?
     bool m_TargetOnly;
+    /// Output format specification
+    string m_OutFmt;
+    /// Number of threads to use for batch retrieval
+    int m_NumThreads;
 
     CBlastDB_FormatterConfig m_Config;
 
@@ -123,6 +131,19 @@ private:
 
     int x_ProcessBatchEntry_NoDup(CBlastDB_Formatter & fmt);
 
+    /// Process batch entry using multiple threads.  Entries are read in
+    /// windows of bounded size; within a window the ids are resolved and
+    /// the entries formatted in parallel, each thread using its own
+    /// CSeqDB handle and formatter, and the formatted entries are written
+    /// out in input order.
+    /// @return 0 on sucess; 1 if some queries were not processed
+    int x_ProcessBatchEntry_MT();
+
+    /// Create the formatter selected by the output format options
+    /// @param blastdb BLAST database to read from
+    /// @param out stream to write the formatted entries to
+    CBlastDB_Formatter * x_CreateFormatter(CSeqDB & blastdb, CNcbiOstream & out);
+
     /// Process entry with range, strand and filter id
     /// @param args program input args
     /// @param seq_fmt sequence formatter object
@@ -137,6 +158,9 @@ private:
 
     int x_ModifyConfigForBatchEntry(const string & config);
 
+    int x_ModifyConfigForBatchEntry(const string & format, CSeqDB & blastdb,
+                                    CBlastDB_FormatterConfig & config);
+
     bool x_UseLongSeqIds();
 
     void x_PrintBlastDatabaseTaxInformation();
@@ -178,19 +202,23 @@ string s_PreProcessAccessionsForDBv5(const string & id)
 }
 
 
-bool
-CBlastDBCmdApp::x_GetOids(const string & id, vector<int> & oids)
+/// Resolve a sequence identifier to the oids it maps to
+/// @param blastdb BLAST database to search
+/// @param id sequence identifier
+/// @param oids oids found for id
+/// @return the accession that was looked up
+static string s_GetOids(CSeqDB & blastdb, const string & id, vector<int> & oids)
 {
 	string acc = id;
-	if(m_BlastDb->GetBlastDbVersion() == EBlastDbVersion::eBDB_Version5) {
+	if(blastdb.GetBlastDbVersion() == EBlastDbVersion::eBDB_Version5) {
 		acc = s_PreProcessAccessionsForDBv5(id);
 	}
 	TGi num_id = NStr::StringToNumeric<TGi>(acc, NStr::fConvErr_NoThrow);
 	if(!errno) {
 		int gi_oid = -1;
-		m_BlastDb->GiToOidwFilterCheck(num_id, gi_oid);
+		blastdb.GiToOidwFilterCheck(num_id, gi_oid);
 		if(gi_oid < 0) {
-			m_BlastDb->AccessionToOids(acc, oids);
+			blastdb.AccessionToOids(acc, oids);
 		}
 		else {
 			oids.push_back(gi_oid);
@@ -198,8 +226,15 @@ CBlastDBCmdApp::x_GetOids(const string & id, vector<int> & oids)
 
 	}
 	else {
-		m_BlastDb->AccessionToOids(acc, oids);
+		blastdb.AccessionToOids(acc, oids);
 	}
+	return acc;
+}
+
+bool
+CBlastDBCmdApp::x_GetOids(const string & id, vector<int> & oids)
+{
+	string acc = s_GetOids(*m_BlastDb, id, oids);
 	if(oids.empty()) {
 		ERR_POST(Error <<  "Entry not found: " << acc);
 		return false;
@@ -267,29 +302,35 @@ bool s_IsMaskAlgoIdValid(CSeqDB & blastdb, int id)
 }
 
 int CBlastDBCmdApp::x_ModifyConfigForBatchEntry(const string & format)
+{
+	return x_ModifyConfigForBatchEntry(format, *m_BlastDb, m_Config);
+}
+
+int CBlastDBCmdApp::x_ModifyConfigForBatchEntry(const string & format, CSeqDB & blastdb,
+                                                CBlastDB_FormatterConfig & config)
 {
 	int status = 0;
 	if (!m_DbIsProtein) {
-		m_Config.m_Strand = eNa_strand_plus;
+		config.m_Strand = eNa_strand_plus;
 	}
-   	m_Config.m_SeqRange = TSeqRange::GetEmpty();
-   	m_Config.m_FiltAlgoId = -1;
+   	config.m_SeqRange = TSeqRange::GetEmpty();
+   	config.m_FiltAlgoId = -1;
    	if(!format.empty()) {
    		vector<string> tmp;
    		NStr::Split(format, " \t", tmp, NStr::fSplit_MergeDelimiters | NStr::fSplit_Truncate);
    		for(unsigned int i=0; i < tmp.size(); i++) {
    			if(tmp[i].find('-')!= string::npos) {
    				try {
-   					m_Config.m_SeqRange = ParseSequenceRangeOpenEnd(tmp[i]);
+   					config.m_SeqRange = ParseSequenceRangeOpenEnd(tmp[i]);
    				} catch (...) {
    				}
    			}
    			else if (!m_DbIsProtein && NStr::EqualNocase(tmp[i].c_str(), "minus")) {
-   				m_Config.m_Strand = eNa_strand_minus;
+   				config.m_Strand = eNa_strand_minus;
    			}
    			else {
-   				m_Config.m_FiltAlgoId = NStr::StringToNonNegativeInt(tmp[i]);
-   				if(!s_IsMaskAlgoIdValid(*m_BlastDb, m_Config.m_FiltAlgoId)){
+   				config.m_FiltAlgoId = NStr::StringToNonNegativeInt(tmp[i]);
+   				if(!s_IsMaskAlgoIdValid(blastdb, config.m_FiltAlgoId)){
    					status = 1;
    				}
    			}
@@ -463,6 +504,190 @@ CBlastDBCmdApp::x_ProcessBatchEntry(CBlastDB_Formatter & fmt)
     return (err_found) ? 1 : 0;
 }
 
+/// Result of retrieving one -entry_batch entry
+struct SBatchEntry {
+	/// Sequence identifier
+	string id;
+	/// Range, strand and filter specifiers
+	string format;
+	/// Oid the identifier resolves to, if resolved in a batch
+	CSeqDB::TOID oid;
+	/// Formatted entry
+	string output;
+	/// Messages to report for this entry
+	vector<string> errors;
+	/// Error which stops the retrieval
+	string fatal;
+	/// Was the entry skipped?
+	bool skipped;
+};
+
+/// Number of entries buffered per thread.  This bounds the memory used to
+/// keep the output in input order.
+static const size_t kBatchEntriesPerThread = 256;
+
+int
+CBlastDBCmdApp::x_ProcessBatchEntry_MT()
+{
+	int err_found = 0;
+   	const CArgs& args = GetArgs();
+    CNcbiIstream& input = args["entry_batch"].AsInputFile();
+    CNcbiOstream& out = args[kArgOutput].AsOutputFile();
+    const bool kIsV5 = (m_BlastDb->GetBlastDbVersion() == EBlastDbVersion::eBDB_Version5);
+
+    // Each thread reads the database and formats the entries through its
+    // own handle, so that they do not contend for a single CSeqDB.
+    vector< CRef<CSeqDBExpert> > dbs(m_NumThreads);
+    vector< unique_ptr<CNcbiOstrstream> > streams(m_NumThreads);
+    vector< unique_ptr<CBlastDB_Formatter> > fmts(m_NumThreads);
+    dbs[0] = m_BlastDb;
+    for (int t = 0; t < m_NumThreads; t++) {
+    	if (t > 0) {
+    		dbs[t].Reset(new CSeqDBExpert(args[kArgDb].AsString(), m_BlastDb->GetSequenceType()));
+    	}
+    	streams[t].reset(new CNcbiOstrstream);
+    	fmts[t].reset(x_CreateFormatter(*dbs[t], *streams[t]));
+    }
+
+    const size_t kWindowSize = kBatchEntriesPerThread * m_NumThreads;
+    vector<SBatchEntry> entries;
+    entries.reserve(kWindowSize);
+    while (input) {
+    	entries.clear();
+        while (input && entries.size() < kWindowSize) {
+        	string line;
+        	NcbiGetlineEOL(input, line);
+        	if ( !line.empty() ) {
+        		SBatchEntry e;
+        		NStr::SplitInTwo(line, " \t", e.id, e.format, NStr::fSplit_MergeDelimiters | NStr::fSplit_Truncate);
+        		if(e.id.empty()) {
+        			continue;
+        		}
+        		e.oid = kSeqDBEntryNotFound;
+        		e.skipped = false;
+        		entries.push_back(e);
+        	}
+        }
+        if (entries.empty()) {
+        	break;
+        }
+
+        // Without duplicates, the accessions of the window are resolved in
+        // one (internally parallel) lookup, as in x_ProcessBatchEntry_NoDup
+        if ( !m_GetDuplicates) {
+        	vector<string> ids;
+        	vector<CSeqDB::TOID> oids;
+        	ids.reserve(entries.size());
+        	for (unsigned int i = 0; i < entries.size(); i++) {
+        		if (kIsV5) {
+        			entries[i].id = s_PreProcessAccessionsForDBv5(entries[i].id);
+        		}
+        		ids.push_back(entries[i].id);
+        	}
+        	try {
+        		m_BlastDb->AccessionsToOids(ids, oids);
+        	}
+        	catch (CSeqDBException & e) {
+        		if (e.GetMsg().find("DB contains no accession info") == NPOS){
+        			NCBI_RETHROW_SAME(e, e.GetMsg());
+        		}
+        	}
+        	if (oids.size() == entries.size()) {
+        		for (unsigned int i = 0; i < entries.size(); i++) {
+        			entries[i].oid = oids[i];
+        		}
+        	}
+        }
+
+        const int kNumEntries = static_cast<int>(entries.size());
+#pragma omp parallel for num_threads(m_NumThreads) schedule(dynamic, 1)
+        for (int i = 0; i < kNumEntries; i++) {
+        	int t = 0;
+#ifdef _OPENMP
+        	t = omp_get_thread_num();
+#endif
+        	SBatchEntry & e = entries[i];
+        	CSeqDB & blastdb = *dbs[t];
+        	CBlastDB_Formatter & fmt = *fmts[t];
+        	CNcbiOstrstream & os = *streams[t];
+        	try {
+        		CBlastDB_FormatterConfig config(m_Config);
+        		vector<int> oids;
+        		if (m_GetDuplicates) {
+        			if(x_ModifyConfigForBatchEntry(e.format, blastdb, config))  {
+        				e.skipped = true;
+        				continue;
+        			}
+        			string acc = s_GetOids(blastdb, e.id, oids);
+        			if (oids.empty()) {
+        				e.errors.push_back("Entry not found: " + acc);
+        				e.skipped = true;
+        				continue;
+        			}
+        		}
+        		else {
+        			if (e.oid == kSeqDBEntryNotFound) {
+        				TGi num_id = NStr::StringToNumeric<TGi>(e.id, NStr::fConvErr_NoThrow);
+        				if(!errno) {
+        					int gi_oid = -1;
+        					blastdb.GiToOidwFilterCheck(num_id, gi_oid);
+        					if(gi_oid >= 0) {
+        						e.oid = gi_oid;
+        					}
+        				}
+        				if (e.oid == kSeqDBEntryNotFound) {
+        					e.skipped = true;
+        					continue;
+        				}
+        			}
+        			if(x_ModifyConfigForBatchEntry(e.format, blastdb, config))  {
+        				e.skipped = true;
+        				continue;
+        			}
+        			oids.push_back(e.oid);
+        		}
+
+        		os.str(kEmptyStr);
+        		for (unsigned int j = 0; j < oids.size(); j++) {
+        			// Duplicates are printed as whole entries, as in
+        			// x_ProcessBatchEntry
+        			if(m_TargetOnly && !m_GetDuplicates) {
+        				fmt.Write(oids[j], config, e.id);
+        			}
+        			else {
+        				fmt.Write(oids[j], config);
+        			}
+        		}
+        		e.output = CNcbiOstrstreamToString(os);
+        	}
+        	catch (const CException & ex) {
+        		e.fatal = ex.GetMsg();
+        	}
+        	catch (const exception & ex) {
+        		e.fatal = ex.what();
+        	}
+        }
+
+        // Write the window out in input order
+        ITERATE(vector<SBatchEntry>, e, entries) {
+        	ITERATE(vector<string>, msg, e->errors) {
+        		ERR_POST(Error << *msg);
+        	}
+        	if ( !e->fatal.empty()) {
+        		out.flush();
+        		NCBI_THROW(CInputException, eInvalidInput, e->fatal);
+        	}
+        	if (e->skipped) {
+        		err_found ++;
+        		ERR_POST (Error << "Skipped " << e->id);
+        		continue;
+        	}
+        	out << e->output;
+        }
+    }
+    return (err_found) ? 1 : 0;
+}
+
 
 int
 CBlastDBCmdApp::x_ProcessBatchPig(CBlastDB_Formatter & fmt)
@@ -720,6 +945,14 @@ CBlastDBCmdApp::x_InitSearchRequest()
     m_GetDuplicates = args["get_dups"];
     m_TargetOnly = args["target_only"];
 
+    m_NumThreads = args[kArgNumThreads].AsInteger();
+    const int kMaxThreads = static_cast<int>(CSystemInfo::GetCpuCount());
+    if (m_NumThreads > kMaxThreads) {
+    	m_NumThreads = kMaxThreads;
+    	ERR_POST(Warning << "Number of threads was reduced to "
+    	         << m_NumThreads << " to match the number of available CPUs");
+    }
+
     string outfmt = kEmptyStr;
     if (args["outfmt"].HasValue()) {
     	outfmt = args["outfmt"].AsString();
@@ -805,7 +1038,10 @@ CBlastDBCmdApp::x_ProcessSearchType(CBlastDB_Formatter & fmt)
 		fmt.DumpAll(m_Config);
 	}
 	else if (args["entry_batch"].HasValue()) {
-		if(m_GetDuplicates) {
+		if(m_NumThreads > 1) {
+			return x_ProcessBatchEntry_MT();
+		}
+		else if(m_GetDuplicates) {
 			return x_ProcessBatchEntry(fmt);
 		}
 		else {
@@ -845,6 +1081,19 @@ bool CBlastDBCmdApp::x_UseLongSeqIds()
 	return false;
 }
 
+CBlastDB_Formatter *
+CBlastDBCmdApp::x_CreateFormatter(CSeqDB & blastdb, CNcbiOstream & out)
+{
+	const CArgs& args = GetArgs();
+	if (m_FASTA) {
+		return new CBlastDB_FastaFormatter(blastdb, out, args["line_length"].AsInteger(), x_UseLongSeqIds());
+	}
+	else if (m_Asn1Bioseq) {
+		return new CBlastDB_BioseqFormatter(blastdb, out);
+	}
+	return new CBlastDB_SeqFormatter(m_OutFmt, blastdb, out);
+}
+
 int
 CBlastDBCmdApp::x_ProcessSearchRequest()
 {
@@ -852,20 +1101,10 @@ CBlastDBCmdApp::x_ProcessSearchRequest()
     try {
     	const CArgs& args = GetArgs();
     	CNcbiOstream& out = args[kArgOutput].AsOutputFile();
-    	string outfmt = x_InitSearchRequest();
+    	m_OutFmt = x_InitSearchRequest();
     	/* Special case: full db dump when no range and mask data is specified */
-    	if (m_FASTA) {
-    		CBlastDB_FastaFormatter fasta_fmt(*m_BlastDb, out, args["line_length"].AsInteger(), x_UseLongSeqIds());
-    		err_found = x_ProcessSearchType(fasta_fmt);
-    	}
-    	else if (m_Asn1Bioseq) {
-    		CBlastDB_BioseqFormatter bioseq_fmt(*m_BlastDb, out);
-    		err_found = x_ProcessSearchType(bioseq_fmt);
-    	}
-    	else {
-    		CBlastDB_SeqFormatter seq_fmt(outfmt, *m_BlastDb, out);
-    		err_found = x_ProcessSearchType(seq_fmt);
-    	}
+    	unique_ptr<CBlastDB_Formatter> fmt(x_CreateFormatter(*m_BlastDb, out));
+    	err_found = x_ProcessSearchType(*fmt);
     }
     catch (const CException& e) {
     	ERR_POST(Error << e.GetMsg());
@@ -914,6 +1153,12 @@ void CBlastDBCmdApp::Init()
     arg_desc->SetDependency("entry_batch", CArgDescriptions::eExcludes, "strand");
     arg_desc->SetDependency("entry_batch", CArgDescriptions::eExcludes, "mask_sequence_with");
 
+    arg_desc->AddDefaultKey(kArgNumThreads, "int_value",
+                 "Number of threads to use for -entry_batch retrieval; "
+                 "the output\n\tremains in input order",
+                 CArgDescriptions::eInteger, "1");
+    arg_desc->SetConstraint(kArgNumThreads, new CArgAllowValuesGreaterThanOrEqual(1));
+
     arg_desc->AddOptionalKey("ipg", "IPG", "IPG to retrieve",
                              CArgDescriptions::eInteger);
     arg_desc->SetConstraint("ipg", new CArgAllowValuesGreaterThanOrEqual(0));
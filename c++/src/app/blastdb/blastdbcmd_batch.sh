@@ -0,0 +1,77 @@
+#! /bin/sh
+# $Id$
+#
+# Checks that blastdbcmd -entry_batch prints the same entries, in the same
+# order, with one thread and with several
+
+if test -z "$CHECK_EXEC"; then
+  bin="./"
+else
+  bin=""
+fi
+
+tmp=blastdbcmd_batch.$$
+mkdir $tmp || exit 1
+trap 'rm -rf $tmp' 0 1 2 15
+
+# Two volumes sharing their first 100 accessions, so that -get_dups finds
+# more than one entry for them.  The batch covers several windows of
+# entries per thread, with ranges and unknown accessions.
+awk 'BEGIN {
+    aa = "ACDEFGHIKLMNPQRSTVWY";
+    for (i = 1; i <= 1300; i++) {
+        vol = (i <= 1200) ? "a" : "b";
+        seq = "";
+        for (j = 0; j < 60 + i % 40; j++) {
+            seq = seq substr(aa, (i * 7 + j * 13) % 20 + 1, 1);
+        }
+        printf(">ref|NP_%06d.1| protein %d\n%s\n", i, i, seq) > "'$tmp'/" vol ".fsa";
+        if (i <= 100) {
+            printf(">ref|NP_%06d.1| protein %d copy\n%s%s\n", i, i, seq, seq) > "'$tmp'/b.fsa";
+        }
+        if (i % 50 == 0) {
+            printf("NP_%06d.1 5-30\n", i) > "'$tmp'/batch.txt";
+        } else {
+            printf("NP_%06d.1\n", i) > "'$tmp'/batch.txt";
+        }
+        if (i % 300 == 0) {
+            printf("XP_%06d.1\n", i) > "'$tmp'/batch.txt";
+        }
+    }
+}' /dev/null
+
+for vol in a b; do
+    $CHECK_EXEC ${bin}makeblastdb -in $tmp/$vol.fsa -dbtype prot \
+        -parse_seqids -out $tmp/$vol > /dev/null || exit 1
+done
+$CHECK_EXEC ${bin}blastdb_aliastool -dblist "$tmp/a $tmp/b" -dbtype prot \
+    -out $tmp/ab -title ab > /dev/null || exit 1
+
+status=0
+check() {
+    $CHECK_EXEC ${bin}blastdbcmd -db $tmp/ab -entry_batch $tmp/batch.txt \
+        "$@" -out $tmp/serial.out 2> /dev/null
+    serial_exit=$?
+    $CHECK_EXEC ${bin}blastdbcmd -db $tmp/ab -entry_batch $tmp/batch.txt \
+        "$@" -num_threads 4 -out $tmp/mt.out 2> /dev/null
+    mt_exit=$?
+    if test $serial_exit != $mt_exit; then
+        echo "Exit codes differ with $*: $serial_exit and $mt_exit"
+        status=1
+    elif test ! -s $tmp/serial.out; then
+        echo "No output with $*"
+        status=1
+    elif ! cmp -s $tmp/serial.out $tmp/mt.out; then
+        echo "Outputs differ with $*:"
+        diff $tmp/serial.out $tmp/mt.out | head -20
+        status=1
+    fi
+}
+
+check
+check -get_dups
+check -target_only
+check -outfmt "%a %o %l %s"
+check -get_dups -outfmt "%a %o %l %s"
+
+exit $status
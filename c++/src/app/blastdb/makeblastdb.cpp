@@ -299,6 +299,12 @@ void CMakeBlastDBApp::Init()
     arg_desc->AddDefaultKey("max_file_sz", "number_of_bytes",
                             "Maximum file size for BLAST database files",
                             CArgDescriptions::eString, "3GB");
+    arg_desc->AddDefaultKey("seq_compression", "method",
+                            "Store the sequence data in compressed blocks, "
+                            "which are decompressed on demand when read",
+                            CArgDescriptions::eString, "none");
+    arg_desc->SetConstraint("seq_compression", &(*new CArgAllow_Strings,
+                                                 "none", "zlib", "zstd"));
     arg_desc->AddOptionalKey("metadata_output_prefix", "",
     						"Path prefix for location of database files in metadata", CArgDescriptions::eString);
     arg_desc->AddOptionalKey("logfile", "File_Name",
@@ -1146,6 +1152,8 @@ void CMakeBlastDBApp::x_BuildDatabase()
 
     const EBlastDbVersion dbver =
         static_cast<EBlastDbVersion>(args["blastdb_version"].AsInteger());
+    const ESeqDBSeqCompression compression =
+        SeqDB_ParseSeqCompression(args["seq_compression"].AsString());
 
     bool limit_defline = false;
 #if _BLAST_DEBUG
@@ -1225,6 +1233,12 @@ void CMakeBlastDBApp::x_BuildDatabase()
     if(success) {
     	string new_db = m_DB->GetOutputDbName();
     	CSeqDB::ESeqType t = is_protein? CSeqDB::eProtein: CSeqDB::eNucleotide;
+        if (compression != eSeqDBSeqCompress_None) {
+            CWriteDB_CompressSequenceFiles(new_db,
+                                           is_protein ? CWriteDB::eProtein
+                                                      : CWriteDB::eNucleotide,
+                                           compression);
+        }
     	CSeqDB sdb(new_db, t);
         string output_prefix = args["metadata_output_prefix"]
                 ? args["metadata_output_prefix"].AsString()
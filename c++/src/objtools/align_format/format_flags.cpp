@@ -228,14 +228,17 @@ const string kArgQueryIndex("queryindex");
 const string kArgSortHits("sorthits");
 const string kArgSortHSPs("sorthsps");
 
-const size_t kNumSAMOutputFormatSpecifiers = 2;
+const size_t kNumSAMOutputFormatSpecifiers = 3;
 const SSAMFormatSpec sc_SAMFormatSpecifiers[kNumSAMOutputFormatSpecifiers] = {
     SSAMFormatSpec("SQ",
                    "Include Sequence Data",
                    eSAM_SeqData),
     SSAMFormatSpec("SR",
                    "Subject as Reference Seq",
-                   eSAM_SubjAsRefSeq)
+                   eSAM_SubjAsRefSeq),
+    SSAMFormatSpec("BAM",
+                   "Write BAM (blastn database searches only)",
+                   eSAM_BAM)
 };
 
 string DescribeSAMOutputFormatSpecifiers()
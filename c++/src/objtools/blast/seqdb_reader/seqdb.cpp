@@ -254,6 +254,11 @@ void CSeqDB::AccessionsToOids(const vector<string>& accs, vector<blastdb::TOid>&
      m_Impl->AccessionsToOids(accs, oids);
 }
 
+int CSeqDB::AccessionsToOidMaskFile(const vector<string>& accs, const string & mask_file) const
+{
+     return m_Impl->AccessionsToOidMaskFile(accs, mask_file);
+}
+
 void CSeqDB::TaxIdsToOids(set<TTaxId>& tax_ids, vector<blastdb::TOid>& rv) const
 {
      m_Impl->TaxIdsToOids(tax_ids, rv);
@@ -1122,6 +1127,11 @@ const CSeqDBGiList * CSeqDB::GetGiList() const
     return m_Impl->GetGiList();
 }
 
+const CSeqDBNegativeList * CSeqDB::GetNegativeList() const
+{
+    return m_Impl->GetNegativeList();
+}
+
 CSeqDBIdSet CSeqDB::GetIdSet() const
 {
     return m_Impl->GetIdSet();
@@ -1574,6 +1584,11 @@ EBlastDbVersion CSeqDB::GetBlastDbVersion() const
 	 return m_Impl->GetBlastDbVersion();
 }
 
+void CSeqDB::GetLMDBFileNames(vector<string> & lmdb_list) const
+{
+	m_Impl->GetLMDBFileNames(lmdb_list);
+}
+
 
 void CSeqDB::x_GetDBFilesMetaData(Int8 & disk_bytes, Int8 & cached_bytes, vector<string> & db_files, const string & user_path) const
 {
@@ -1607,6 +1622,7 @@ void CSeqDB::x_GetDBFilesMetaData(Int8 & disk_bytes, Int8 & cached_bytes, vector
     const string kExtnMol(1, is_protein ? 'p' : 'n');
     const string index_ext = kExtnMol + "in";
     const string seq_ext = kExtnMol + "sq";
+    const string seq_z_ext = kExtnMol + "sz";
 
     ITERATE(vector<string>, path, paths) {
         ITERATE(vector<string>, ext, extn) {
@@ -1617,7 +1633,8 @@ void CSeqDB::x_GetDBFilesMetaData(Int8 & disk_bytes, Int8 & cached_bytes, vector
                 Int8 length = file.GetLength();
                 if (length != -1) {
                     disk_bytes += length;
-                    if((*ext == index_ext) || (*ext == seq_ext)) {
+                    if((*ext == index_ext) || (*ext == seq_ext) ||
+                       (*ext == seq_z_ext)) {
                     	cached_bytes += length;
                     }
                 } else {
@@ -36,9 +36,15 @@
 #include <corelib/ncbifile.hpp>
 #include <objects/seqloc/PDB_seq_id.hpp>
 #include <cmath>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 BEGIN_NCBI_SCOPE
 
+/// Minimum number of accessions per thread for batched lookups
+#define DEFAULT_MIN_LOOKUP_CHUNK_SIZE 1000000
+
 #define SEQDB_LMDB_TIMING
 #ifdef SEQDB_LMDB_TIMING
 template<class T>
@@ -233,7 +239,8 @@ CSeqDBLMDB::CSeqDBLMDB(const string & fname)
       m_TaxId2OidsFile(GetFileNameFromExistingLMDBFile(fname, ELMDBFileType::eTaxId2Oids)),
       m_TaxId2OffsetsFile(GetFileNameFromExistingLMDBFile(fname, ELMDBFileType::eTaxId2Offsets)),
       m_LMDBFileOpened(false),
-      m_NumOids(0)
+      m_NumOids(0),
+      m_NumThreads(1)
 {
 }
 
@@ -343,37 +350,127 @@ void CSeqDBLMDB::GetVolumesInfo(vector<string> & vol_names, vector<blastdb::TOid
     }
 }
 
+/// Order accession indices by the accession strings in LMDB key order
+/// (byte-wise comparison, shorter key first on a common prefix), so that
+/// a cursor visits the acc2oid B-tree pages in a single forward sweep.
+struct SAccessionKeyOrder
+{
+	SAccessionKeyOrder(const vector<string> & accs) : m_Accs(accs) {}
+	bool operator()(Uint4 a, Uint4 b) const {
+		return (m_Accs[a] < m_Accs[b]);
+	}
+	const vector<string> & m_Accs;
+};
+
+/// Look up the accessions accessions[order[begin]] .. accessions[order[end-1]]
+/// with one read transaction and one cursor.  The keys are visited in sorted
+/// order and repeated keys are resolved only once.
+static void s_GetOidsForSortedKeys(lmdb::env                   & env,
+                                   MDB_dbi                       dbi_handle,
+                                   const vector<string>        & accessions,
+                                   const vector<Uint4>         & order,
+                                   size_t                        begin,
+                                   size_t                        end,
+                                   vector<blastdb::TOid>       & oids)
+{
+	lmdb::dbi dbi(dbi_handle);
+	auto txn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+	auto cursor = lmdb::cursor::open(txn, dbi);
+
+	const string * prev_acc = NULL;
+	blastdb::TOid prev_oid = kSeqDBEntryNotFound;
+	for (size_t i = begin; i < end; i++) {
+		const string & acc = accessions[order[i]];
+		if ((prev_acc != NULL) && (*prev_acc == acc)) {
+			oids[order[i]] = prev_oid;
+			continue;
+		}
+		prev_acc = &acc;
+		prev_oid = kSeqDBEntryNotFound;
+		lmdb::val data2find(acc);
+		if (cursor.get(data2find, MDB_SET)) {
+			lmdb::val k, val;
+			cursor.get(k, val, MDB_GET_CURRENT);
+			const char* d = val.data();
+			prev_oid = (((d[3] << 24)&0xFF000000) | ((d[2] << 16) & 0xFF0000) | ((d[1] << 8) & 0xFF00) | (d[0]&0xFF));
+		}
+		oids[order[i]] = prev_oid;
+	}
+	cursor.close();
+	txn.reset();
+}
+
 void
 CSeqDBLMDB::GetOids(const vector<string>& accessions, vector<blastdb::TOid>& oids) const
 {
     try {
     oids.clear();
     oids.resize(accessions.size(), kSeqDBEntryNotFound);
+    if (accessions.empty()) {
+    	return;
+    }
 
-    MDB_dbi dbi_handle;
-	lmdb::env & env = CBlastLMDBManager::GetInstance().GetReadEnvAcc(m_LMDBFile, dbi_handle, &m_LMDBFileOpened);
-	{
-    lmdb::dbi dbi(dbi_handle);
-    auto txn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
-
-    auto cursor = lmdb::cursor::open(txn, dbi);
+#ifdef SEQDB_LMDB_TIMING
+    CStopWatch sw;
+    sw.Start();
+#endif /* SEQDB_LMDB_TIMING */
 
-    unsigned int i=0;
-    for (i=0; i < accessions.size(); i++) {
-    	string acc = accessions[i];
-        lmdb::val data2find(acc);
-        if (cursor.get(data2find, MDB_SET)) {
-            lmdb::val k, val;
-            cursor.get(k, val, MDB_GET_CURRENT);
-            const char* d = val.data();
-            oids[i] = (((d[3] << 24)&0xFF000000) | ((d[2] << 16) & 0xFF0000) | ((d[1] << 8) & 0xFF00) | (d[0]&0xFF));
-        }
+    // Sort the lookups into key order, so that neighbouring lookups land
+    // on the same or adjacent LMDB pages instead of descending the tree
+    // at random for every accession.
+    vector<Uint4> order(accessions.size());
+    for (Uint4 i=0; i < order.size(); i++) {
+    	order[i] = i;
     }
+    std::sort(order.begin(), order.end(), SAccessionKeyOrder(accessions));
 
-    cursor.close();
-    txn.reset();
+    MDB_dbi dbi_handle;
+	lmdb::env & env = CBlastLMDBManager::GetInstance().GetReadEnvAcc(m_LMDBFile, dbi_handle, &m_LMDBFileOpened);
+
+#ifdef _OPENMP
+	// Large batches are split into contiguous key ranges, each walked by
+	// its own read transaction and cursor.
+	size_t chunk_size = DEFAULT_MIN_LOOKUP_CHUNK_SIZE;
+	char* chunk_str = getenv("LMDB_LOOKUP_CHUNK_SIZE");
+	if (chunk_str) {
+		chunk_size = NStr::StringToUInt(chunk_str);
+		_TRACE("DEBUG: LMDB_LOOKUP_CHUNK_SIZE " << chunk_str);
+	}
+	int num_chunks = (chunk_size > 0) ? (int) ((order.size() + chunk_size - 1) / chunk_size) : 1;
+	int num_threads = min(m_NumThreads, num_chunks);
+	if (num_threads > 1) {
+		size_t range = (order.size() + num_threads - 1) / num_threads;
+		int lmdb_err = MDB_SUCCESS;
+		#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+		for (int t = 0; t < num_threads; t++) {
+			size_t begin = t * range;
+			size_t end = min(begin + range, order.size());
+			try {
+				if (begin < end) {
+					s_GetOidsForSortedKeys(env, dbi_handle, accessions, order, begin, end, oids);
+				}
+			} catch (lmdb::error & e) {
+				#pragma omp critical
+				lmdb_err = e.code();
+			}
+		}
+		if (lmdb_err != MDB_SUCCESS) {
+			lmdb::error::raise("mdb_cursor_get", lmdb_err);
+		}
+	}
+	else
+#endif
+	{
+		s_GetOidsForSortedKeys(env, dbi_handle, accessions, order, 0, order.size(), oids);
 	}
     CBlastLMDBManager::GetInstance().CloseEnv(m_LMDBFile);
+
+#ifdef SEQDB_LMDB_TIMING
+    sw.Stop();
+    _TRACE("Resolved " << s_FormatNum(accessions.size()) << " accessions in "
+           << sw.AsSmartString() << " (" << SPEED(sw.Elapsed(), accessions.size())
+           << " lookups/sec)");
+#endif /* SEQDB_LMDB_TIMING */
     } catch (lmdb::error & e) {
    		string dbname;
        	CSeqDB_Path(m_LMDBFile).FindBaseName().GetString(dbname);
@@ -423,6 +423,49 @@ void CSeqDB_BitSet::Normalize()
     }
 }
 
+void CSeqDB_BitSet::WriteOidMask(CNcbiOstream & os) const
+{
+    _ASSERT(m_Start == 0);
+    
+    // The header holds the index of the last OID, not the count of OIDs.
+    Uint4 last_oid = (m_End > 0) ? (Uint4) (m_End - 1) : 0;
+    
+    unsigned char header[4];
+    header[0] = (unsigned char) (last_oid >> 24);
+    header[1] = (unsigned char) (last_oid >> 16);
+    header[2] = (unsigned char) (last_oid >> 8);
+    header[3] = (unsigned char) (last_oid);
+    os.write((const char *) header, sizeof(header));
+    
+    // Bit data is padded to a whole number of 32 bit words.
+    size_t num_bytes = (((size_t) last_oid + 1 + 31) / 32) * 4;
+    
+    if (m_Special == eNone) {
+        size_t nbytes = min(num_bytes, m_Bits.size());
+        if (nbytes) {
+            os.write((const char *) & m_Bits[0], nbytes);
+        }
+        for(size_t i = nbytes; i < num_bytes; i++) {
+            os.put((char) 0);
+        }
+    } else {
+        // Special cases are written out as whole bytes, with the
+        // padding bits past the end point left clear.
+        size_t full_bytes = (m_Special == eAllSet) ? (m_End >> eWordShift) : 0;
+        for(size_t i = 0; i < full_bytes; i++) {
+            os.put((char) 0xFF);
+        }
+        size_t i = full_bytes;
+        if (m_Special == eAllSet && (m_End & eWordMask)) {
+            os.put((char) (TByte(0xFF) << (eWordBits - (m_End & eWordMask))));
+            i++;
+        }
+        for(; i < num_bytes; i++) {
+            os.put((char) 0);
+        }
+    }
+}
+
 void CSeqDB_BitSet::DebugDump(CDebugDumpContext ddc, unsigned int depth) const
 {
     ddc.SetFrame("CSeqDB_BitSet");
@@ -210,6 +210,16 @@ public:
     /// converts it to a normal (`eNone') bitset if so.
     void Normalize();
     
+    /// Write this bitset in the OID mask file format.
+    ///
+    /// The output uses the same layout as the OID mask files named by
+    /// OIDLIST alias file entries: a big-endian Uint4 holding the
+    /// index of the last OID, followed by the bit data padded to a
+    /// multiple of four bytes.  The bitset must start at OID zero.
+    ///
+    /// @param os The stream to write the mask to.
+    void WriteOidMask(CNcbiOstream & os) const;
+    
 private:
     /// Set all bits that are true in `src'.
     /// @param src The bitset to read from.
@@ -2630,6 +2630,7 @@ void SeqDB_GetFileExtensions(bool db_is_protein, vector<string>& extn, EBlastDbV
     extn.push_back(kExtnMol + "in");   // index file
     extn.push_back(kExtnMol + "hr");   // header file
     extn.push_back(kExtnMol + "sq");   // sequence file
+    extn.push_back(kExtnMol + "sz");   // block compressed sequence file
     extn.push_back(kExtnMol + "ni");   // ISAM numeric index file
     extn.push_back(kExtnMol + "nd");   // ISAM numeric data file
     if (dbver == eBDB_Version4) {
@@ -2655,6 +2656,20 @@ void SeqDB_GetFileExtensions(bool db_is_protein, vector<string>& extn, EBlastDbV
 }
 
 
+ESeqDBSeqCompression SeqDB_ParseSeqCompression(const string & name)
+{
+    if (NStr::EqualNocase(name, "none")) {
+        return eSeqDBSeqCompress_None;
+    } else if (NStr::EqualNocase(name, "zlib")) {
+        return eSeqDBSeqCompress_Zlib;
+    } else if (NStr::EqualNocase(name, "zstd")) {
+        return eSeqDBSeqCompress_Zstd;
+    }
+    NCBI_THROW(CSeqDBException, eArgErr,
+               "Invalid sequence compression method: " + name);
+}
+
+
 void SeqDB_GetLMDBFileExtensions(bool db_is_protein, vector<string>& extn)
 {
 
@@ -32,6 +32,9 @@
 /// database volume.
 #include <ncbi_pch.hpp>
 #include <objtools/blast/seqdb_reader/impl/seqdbfile.hpp>
+#include <util/compress/zlib.hpp>
+#include <util/compress/zstd.hpp>
+#include <atomic>
 
 BEGIN_NCBI_SCOPE
 
@@ -238,5 +241,462 @@ CSeqDBIdxFile::CSeqDBIdxFile(CSeqDBAtlas    & atlas,
     }
 }
 
+/// Per-thread cache of uncompressed sequence data.
+///
+/// Block compressed sequence files are decompressed into this cache,
+/// which is owned by the calling thread so that no locking is needed.
+/// Entries are single blocks, or the assembled data of a range that
+/// spans several blocks; they are evicted in LRU order once the cache
+/// holds more than CSeqDBSeqFile::GetCacheSize() bytes.  Entries are
+/// reference counted, so an evicted entry lives on while it is pinned
+/// (see CSeqDBSeqBlockPins) or used by the code that looked it up.
+
+class CSeqDBSeqBlockCache {
+public:
+    /// Cache key: file id and block index (or flagged start offset).
+    typedef pair<Uint8, Uint8> TKey;
+
+    /// Cached data.
+    typedef CSeqDBSeqFile::TBlock TBlock;
+
+    /// Key bit marking a multi-block range rather than a block.
+    static const Uint8 kRangeFlag = (Uint8) 1 << 63;
+
+    /// Constructor
+    CSeqDBSeqBlockCache()
+        : m_Size(0),
+          m_MaxSize(CSeqDBSeqFile::GetCacheSize())
+    {
+    }
+
+    /// Look up an entry, marking it as most recently used.
+    CRef<TBlock> Find(const TKey & key)
+    {
+        if (m_Lru.empty()) {
+            return CRef<TBlock>();
+        }
+        if (m_Lru.front().first == key) {
+            return m_Lru.front().second;
+        }
+        TIndex::iterator it = m_Index.find(key);
+        if (it == m_Index.end()) {
+            return CRef<TBlock>();
+        }
+        m_Lru.splice(m_Lru.begin(), m_Lru, it->second);
+        return m_Lru.front().second;
+    }
+
+    /// Add an entry.
+    void Insert(const TKey & key, CRef<TBlock> data)
+    {
+        TIndex::iterator it = m_Index.find(key);
+        if (it != m_Index.end()) {
+            m_Size -= it->second->second->GetData().size();
+            m_Lru.erase(it->second);
+            m_Index.erase(it);
+        }
+
+        m_Lru.push_front(make_pair(key, data));
+        m_Index[key] = m_Lru.begin();
+        m_Size += data->GetData().size();
+
+        while (m_Size > m_MaxSize && m_Lru.size() > 1) {
+            m_Size -= m_Lru.back().second->GetData().size();
+            m_Index.erase(m_Lru.back().first);
+            m_Lru.pop_back();
+        }
+    }
+
+    /// Get this thread's zlib decompressor.
+    CZipCompression & GetZip()
+    {
+        if ( !m_Zip ) {
+            m_Zip.reset(new CZipCompression());
+        }
+        return *m_Zip;
+    }
+
+#if defined(HAVE_LIBZSTD)
+    /// Get this thread's zstd decompressor.
+    CZstdCompression & GetZstd()
+    {
+        if ( !m_Zstd ) {
+            m_Zstd.reset(new CZstdCompression());
+        }
+        return *m_Zstd;
+    }
+#endif
+
+    /// Get the cache of the calling thread.
+    static CSeqDBSeqBlockCache & Get()
+    {
+        static thread_local CSeqDBSeqBlockCache cache;
+        return cache;
+    }
+
+private:
+    /// Entries, most recently used first.
+    typedef list< pair< TKey, CRef<TBlock> > > TLru;
+
+    /// Index of the entries.
+    typedef map<TKey, TLru::iterator> TIndex;
+
+    TLru   m_Lru;
+    TIndex m_Index;
+
+    /// Bytes held by the entries.
+    size_t m_Size;
+
+    /// Bytes held before entries are evicted.
+    size_t m_MaxSize;
+
+    unique_ptr<CZipCompression> m_Zip;
+#if defined(HAVE_LIBZSTD)
+    unique_ptr<CZstdCompression> m_Zstd;
+#endif
+};
+
+/// Blocks of uncompressed data handed out by GetFileDataPtr().
+///
+/// Each pointer given to a caller pins the block it points into,
+/// keeping the block alive after its eviction from the cache until the
+/// pointer is returned with CSeqDBSeqFile::RetData().  Pointers are
+/// often returned by a different thread than the one that fetched
+/// them (for instance by CSeqDBImpl's prefetch buffers), so unlike the
+/// caches this is shared and locked.
+
+class CSeqDBSeqBlockPins {
+public:
+    /// Pinned data.
+    typedef CSeqDBSeqFile::TBlock TBlock;
+
+    /// Constructor
+    CSeqDBSeqBlockPins()
+        : m_NumPinned(0)
+    {
+    }
+
+    /// Pin a block.
+    void Pin(TBlock & block)
+    {
+        CFastMutexGuard guard(m_Mutex);
+
+        SPin & pin = m_Pins[& block.GetData()[0]];
+        if (pin.block.Empty()) {
+            pin.block.Reset(& block);
+            m_NumPinned++;
+        }
+        pin.count++;
+    }
+
+    /// Add a pin to the block holding datap, if any.
+    void Retain(const char * datap)
+    {
+        if (m_NumPinned.load(memory_order_relaxed) == 0) {
+            return;
+        }
+
+        CFastMutexGuard guard(m_Mutex);
+
+        TPins::iterator it = x_Find(datap);
+        if (it != m_Pins.end()) {
+            it->second.count++;
+        }
+    }
+
+    /// Release a pin on the block holding datap, if any.
+    void Release(const char * datap)
+    {
+        if (m_NumPinned.load(memory_order_relaxed) == 0) {
+            return;
+        }
+
+        // Declared before the guard, so the data is freed after the
+        // lock is released.
+        CRef<TBlock> last;
+        CFastMutexGuard guard(m_Mutex);
+
+        TPins::iterator it = x_Find(datap);
+        if (it != m_Pins.end() && --it->second.count == 0) {
+            last.Swap(it->second.block);
+            m_Pins.erase(it);
+            m_NumPinned--;
+        }
+    }
+
+    /// Get the registry.
+    static CSeqDBSeqBlockPins & Get()
+    {
+        static CSeqDBSeqBlockPins pins;
+        return pins;
+    }
+
+private:
+    /// A pinned block and its number of pins.
+    struct SPin {
+        SPin() : count(0) {}
+
+        CRef<TBlock> block;
+        int count;
+    };
+
+    /// Pinned blocks, by data address.
+    typedef map<const char *, SPin> TPins;
+
+    /// Find the block holding datap.
+    TPins::iterator x_Find(const char * datap)
+    {
+        TPins::iterator it = m_Pins.upper_bound(datap);
+        if (it == m_Pins.begin()) {
+            return m_Pins.end();
+        }
+        --it;
+
+        // The end is included; a zero length sequence at the end of a
+        // range points there.
+        if (datap > it->first + it->second.block->GetData().size()) {
+            return m_Pins.end();
+        }
+        return it;
+    }
+
+    CFastMutex m_Mutex;
+    TPins      m_Pins;
+
+    /// Number of pinned blocks, checked without the lock so that
+    /// returning data from uncompressed files costs no locking.
+    std::atomic<size_t> m_NumPinned;
+};
+
+/// Source of the ids distinguishing sequence files in the caches.
+static std::atomic<Uint8> s_SeqFileCacheId(0);
+
+CSeqDBSeqFile::CSeqDBSeqFile(CSeqDBAtlas    & atlas,
+                             const string   & dbname,
+                             char             prot_nucl)
+    : CSeqDBExtFile(atlas, x_GetFileName(atlas, dbname, prot_nucl), prot_nucl),
+      m_Compressed (false),
+      m_Method     (eSeqDBSeqCompress_None),
+      m_BlockSize  (0),
+      m_NumBlocks  (0),
+      m_RawLength  (0),
+      m_BlockTable (0),
+      m_CacheId    (++s_SeqFileCacheId)
+{
+    if (NStr::EndsWith(m_FileName, "sz")) {
+        x_ReadCompressedHeader();
+    }
+}
+
+string CSeqDBSeqFile::x_GetFileName(CSeqDBAtlas  & atlas,
+                                    const string & dbname,
+                                    char           prot_nucl)
+{
+    string raw_name = dbname + "." + prot_nucl + "sq";
+    string zip_name = dbname + "." + prot_nucl + "sz";
+
+    if ( !atlas.DoesFileExist(raw_name) && atlas.DoesFileExist(zip_name) ) {
+        return dbname + ".-sz";
+    }
+    return dbname + ".-sq";
+}
+
+size_t CSeqDBSeqFile::GetCacheSize()
+{
+    size_t cache_size = kSeqDBSeqCacheSize;
+    const char * env = getenv("BLASTDB_SEQ_CACHE_SIZE");
+    if (env) {
+        try {
+            cache_size = (size_t) NStr::StringToUInt8_DataSize(env);
+        }
+        catch (const CStringException &) {
+            ERR_POST(Warning << "Invalid BLASTDB_SEQ_CACHE_SIZE value: "
+                     << env);
+        }
+    }
+    return cache_size;
+}
+
+void CSeqDBSeqFile::RetainData(const char * datap)
+{
+    CSeqDBSeqBlockPins::Get().Retain(datap);
+}
+
+void CSeqDBSeqFile::RetData(const char * datap)
+{
+    CSeqDBSeqBlockPins::Get().Release(datap);
+}
+
+void CSeqDBSeqFile::x_ReadCompressedHeader()
+{
+    // Header: format version, method, block size and block count
+    // (Int4), uncompressed length (Int8), then the file offsets of
+    // the num_blocks + 1 block boundaries (Int8[]).
+
+    TIndx offset = 0;
+    Uint4 format_version = 0;
+
+    offset = x_ReadSwapped(m_Lease, offset, & format_version);
+
+    if (format_version != kSeqDBSeqCompressFormat) {
+        NCBI_THROW(CSeqDBException, eFileErr,
+                   "Error: Unsupported compressed sequence file format in "
+                   + m_FileName + ".");
+    }
+
+    offset = x_ReadSwapped(m_Lease, offset, & m_Method);
+    offset = x_ReadSwapped(m_Lease, offset, & m_BlockSize);
+    offset = x_ReadSwapped(m_Lease, offset, & m_NumBlocks);
+
+    // Unlike the volume length in the index file, the Int8 values
+    // here are stored in big-endian order.
+    m_RawLength = (TIndx) SeqDB_GetStdOrd(
+        (const Uint8 *) m_Lease.GetFileDataPtr(m_FileName, offset));
+    m_BlockTable = offset + sizeof(Uint8);
+
+    bool method_ok = (m_Method == eSeqDBSeqCompress_None ||
+                      m_Method == eSeqDBSeqCompress_Zlib);
+#if defined(HAVE_LIBZSTD)
+    method_ok = method_ok || (m_Method == eSeqDBSeqCompress_Zstd);
+#endif
+    if ( !method_ok ) {
+        NCBI_THROW(CSeqDBException, eFileErr,
+                   "Error: Unsupported compression method in " + m_FileName +
+                   ".");
+    }
+
+    if (m_BlockSize == 0 ||
+        (TIndx) m_NumBlocks * m_BlockSize < m_RawLength ||
+        m_File.GetFileLength() < m_BlockTable + 8 * ((TIndx) m_NumBlocks + 1)) {
+        NCBI_THROW(CSeqDBException, eFileErr,
+                   "Error: Corrupt compressed sequence file " + m_FileName +
+                   ".");
+    }
+
+    m_Compressed = true;
+}
+
+void CSeqDBSeqFile::x_DecompressBlock(Uint4 block, char * dst) const
+{
+    const Uint8 * table =
+        (const Uint8 *) m_Lease.GetFileDataPtr(m_FileName, m_BlockTable);
+    TIndx begin = (TIndx) SeqDB_GetStdOrd(table + block);
+    TIndx end   = (TIndx) SeqDB_GetStdOrd(table + block + 1);
+
+    if (begin > end || end > m_File.GetFileLength()) {
+        NCBI_THROW(CSeqDBException, eFileErr,
+                   "Error: Corrupt compressed sequence file " + m_FileName +
+                   ".");
+    }
+
+    const char * src = m_Lease.GetFileDataPtr(m_FileName, begin);
+    size_t src_len = (size_t)(end - begin);
+    size_t dst_len = x_GetBlockLength(block);
+    size_t out_len = 0;
+    bool ok = false;
+
+    switch (m_Method) {
+    case eSeqDBSeqCompress_None:
+        if (src_len == dst_len) {
+            memcpy(dst, src, dst_len);
+            out_len = dst_len;
+            ok = true;
+        }
+        break;
+
+    case eSeqDBSeqCompress_Zlib:
+        ok = CSeqDBSeqBlockCache::Get().GetZip().
+            DecompressBuffer(src, src_len, dst, dst_len, & out_len);
+        break;
+
+#if defined(HAVE_LIBZSTD)
+    case eSeqDBSeqCompress_Zstd:
+        ok = CSeqDBSeqBlockCache::Get().GetZstd().
+            DecompressBuffer(src, src_len, dst, dst_len, & out_len);
+        break;
+#endif
+    }
+
+    if ( !ok || out_len != dst_len ) {
+        NCBI_THROW(CSeqDBException, eFileErr,
+                   "Error: Cannot decompress block " +
+                   NStr::UIntToString(block) + " of " + m_FileName + ".");
+    }
+}
+
+const char * CSeqDBSeqFile::x_GetUncompressed(TIndx          start,
+                                              TIndx          end,
+                                              CRef<TBlock> & block) const
+{
+    if (start < 0 || start >= end || end > m_RawLength) {
+        NCBI_THROW(CSeqDBException, eFileErr,
+                   "Error: Sequence data offset out of range in " +
+                   m_FileName + ".");
+    }
+
+    CSeqDBSeqBlockCache & cache = CSeqDBSeqBlockCache::Get();
+
+    Uint4 first = (Uint4) (start / m_BlockSize);
+    Uint4 last  = (Uint4) ((end - 1) / m_BlockSize);
+
+    if (first == last) {
+        CSeqDBSeqBlockCache::TKey key(m_CacheId, first);
+        block = cache.Find(key);
+
+        if (block.Empty()) {
+            block.Reset(new TBlock);
+            block->GetData().resize(x_GetBlockLength(first));
+            x_DecompressBlock(first, & block->GetData()[0]);
+            cache.Insert(key, block);
+        }
+        return & block->GetData()[0] + (start - (TIndx) first * m_BlockSize);
+    }
+
+    // The range spans blocks, so it is assembled in an entry of its
+    // own.  Fully covered blocks are decompressed in place; the partly
+    // covered first and last blocks go through the cache, as they are
+    // likely to be shared with the neighbouring sequences.
+
+    CSeqDBSeqBlockCache::TKey key(m_CacheId,
+                                  CSeqDBSeqBlockCache::kRangeFlag | start);
+    block = cache.Find(key);
+
+    if (block.NotEmpty() && (TIndx) block->GetData().size() >= end - start) {
+        return & block->GetData()[0];
+    }
+
+    block.Reset(new TBlock);
+    block->GetData().resize((size_t)(end - start));
+    char * dst = & block->GetData()[0];
+
+    for(Uint4 b = first; b <= last; b++) {
+        TIndx b_start = (TIndx) b * m_BlockSize;
+        TIndx b_end   = b_start + x_GetBlockLength(b);
+        TIndx from    = max(start, b_start);
+        TIndx to      = min(end, b_end);
+
+        if (from == b_start && to == b_end) {
+            x_DecompressBlock(b, dst);
+        } else {
+            CRef<TBlock> part;
+            memcpy(dst, x_GetUncompressed(from, to, part),
+                   (size_t)(to - from));
+        }
+        dst += to - from;
+    }
+
+    cache.Insert(key, block);
+    return & block->GetData()[0];
+}
+
+const char * CSeqDBSeqFile::x_GetPinned(TIndx start, TIndx end) const
+{
+    CRef<TBlock> block;
+    const char * datap = x_GetUncompressed(start, end, block);
+
+    CSeqDBSeqBlockPins::Get().Pin(*block);
+    return datap;
+}
+
 END_NCBI_SCOPE
 
@@ -638,15 +638,15 @@ void CSeqDBImpl::RetSequence(const char ** buffer) const
     if (m_NumThreads) {
         int cacheID = x_GetCacheID(locked);
         (m_CachedSeqs[cacheID]->checked_out)--;
-        *buffer = 0;
-        return;
     }
 
-    // This returns a reference to part of a memory mapped region.
+    // This returns a reference to part of a memory mapped region, or
+    // releases a pinned block of a compressed volume.
 
     //m_Atlas.Lock(locked);
 
     //m_Atlas.RetRegion(*buffer);
+    CSeqDBSeqFile::RetData(*buffer);
     *buffer = 0;
 }
 
@@ -664,6 +664,9 @@ void CSeqDBImpl::x_RetSeqBuffer(SSeqResBuffer * buffer) const
     }
 
     buffer->checked_out = 0;
+    ITERATE(vector<SSeqRes>, res, buffer->results) {
+        CSeqDBSeqFile::RetData(res->address);
+    }
     buffer->results.clear();
 }
 
@@ -675,12 +678,14 @@ int CSeqDBImpl::x_GetSeqBuffer(SSeqResBuffer * buffer, int oid,
     if (index < buffer->results.size()) {
         (buffer->checked_out)++;
         *seq = buffer->results[index].address;
+        CSeqDBSeqFile::RetainData(*seq);
         return buffer->results[index].length;
     }
 
     x_FillSeqBuffer(buffer, oid);
     (buffer->checked_out)++;
     *seq = buffer->results[0].address;
+    CSeqDBSeqFile::RetainData(*seq);
     return buffer->results[0].length;
 }
 
@@ -709,6 +714,10 @@ void CSeqDBImpl::x_FillSeqBuffer(SSeqResBuffer  *buffer,
             res.length = vol->GetSequence(vol_oid++, &seq);
         } while (res.length >= 0 && tot_length >= res.length && vol_oid < m_RestrictEnd);
 
+        // The sequence that did not fit is not buffered.
+        if (res.length >= 0) {
+            CSeqDBSeqFile::RetData(seq);
+        }
         return;
     }
 
@@ -1385,6 +1394,55 @@ void CSeqDBImpl::AccessionsToOids(const vector<string>& accs, vector<blastdb::TO
     return;
 }
 
+int CSeqDBImpl::AccessionsToOids(const vector<string>& accs, CSeqDB_BitSet & oid_bits)
+{
+    CHECK_MARKER();
+    if (m_LMDBSet.IsBlastDBVersion5()) {
+    	m_LMDBSet.AccessionsToOids(accs, oid_bits);
+    }
+    else {
+    	for(unsigned int i=0; i < accs.size(); i++) {
+    		vector<blastdb::TOid> tmp;
+    		AccessionToOids(accs[i], tmp);
+    		ITERATE(vector<blastdb::TOid>, itr, tmp) {
+    			oid_bits.SetBit(*itr);
+    		}
+    	}
+    }
+
+    // Drop OIDs excluded by the filtering applied to this db.
+    CSeqDBLockHold locked(m_Atlas);
+    int num_oids = 0;
+    for(size_t oid = 0; oid_bits.CheckOrFindBit(oid); oid++) {
+    	int oid2 = (int) oid;
+    	if (x_CheckOrFindOID(oid2, locked) && (oid2 == (int) oid)) {
+    		num_oids++;
+    	}
+    	else {
+    		oid_bits.ClearBit(oid);
+    	}
+    }
+    return num_oids;
+}
+
+int CSeqDBImpl::AccessionsToOidMaskFile(const vector<string>& accs, const string & mask_file)
+{
+    CHECK_MARKER();
+    CSeqDB_BitSet oid_bits(0, m_NumOIDs);
+    int num_oids = AccessionsToOids(accs, oid_bits);
+
+    CNcbiOfstream out(mask_file.c_str(), IOS_BASE::out | IOS_BASE::binary);
+    if (! out) {
+    	NCBI_THROW(CSeqDBException, eFileErr, "Cannot open OID mask file " + mask_file);
+    }
+    oid_bits.WriteOidMask(out);
+    out.flush();
+    if (! out) {
+    	NCBI_THROW(CSeqDBException, eFileErr, "Failed to write OID mask file " + mask_file);
+    }
+    return num_oids;
+}
+
 
 void CSeqDBImpl::SeqidToOids(const CSeq_id & seqid_in,
                              vector<int>   & oids,
@@ -2572,6 +2630,8 @@ void CSeqDBImpl::SetNumberOfThreads(int num_threads, bool force_mt)
     CSeqDBLockHold locked(m_Atlas);
     m_Atlas.Lock(locked);
 
+    m_LMDBSet.SetNumberOfThreads(num_threads);
+
     if (num_threads < 1) {
         num_threads = 0;
     } else if (num_threads == 1) {
@@ -582,6 +582,14 @@ public:
         return m_UserGiList.GetPointerOrNull();
     }
 
+    /// Get negative list attached to this database.
+    ///
+    /// @return A pointer to the attached negative list, or NULL.
+    const CSeqDBNegativeList * GetNegativeList() const
+    {
+        return m_NegativeList.GetPointerOrNull();
+    }
+
     /// Get IdSet list attached to this database.
     ///
     /// This returns the ID set used to filter this database. If a
@@ -630,6 +638,12 @@ public:
 
     void AccessionsToOids(const vector<string>& accs, vector<blastdb::TOid>& oids);
 
+    /// Resolve accessions into a bitset of included OIDs.
+    int AccessionsToOids(const vector<string>& accs, CSeqDB_BitSet & oid_bits);
+
+    /// Resolve accessions and write the OIDs found as an OID mask file.
+    int AccessionsToOidMaskFile(const vector<string>& accs, const string & mask_file);
+
     /// Translate a CSeq-id to a list of OIDs.
     void SeqidToOids(const CSeq_id & seqid, vector<int> & oids, bool multi);
 
@@ -300,6 +300,19 @@ void CSeqDBLMDBSet::AccessionsToOids(const vector<string>& accs, vector<TOid>& o
 	}
 }
 
+void CSeqDBLMDBSet::AccessionsToOids(const vector<string>& accs, CSeqDB_BitSet & oid_bits) const
+{
+	vector<TOid> oids;
+	for(unsigned int i=0; i < m_LMDBEntrySet.size(); i++) {
+		m_LMDBEntrySet[i]->AccessionsToOids(accs, oids);
+		for(unsigned int j=0; j < oids.size(); j++) {
+			if(oids[j] != kSeqDBEntryNotFound) {
+				oid_bits.SetBit(oids[j]);
+			}
+		}
+	}
+}
+
 void CSeqDBLMDBSet::NegativeSeqIdsToOids(const vector<string>& ids, vector<blastdb::TOid>& rv) const
 {
 	m_LMDBEntrySet[0]->NegativeSeqIdsToOids(ids, rv);
@@ -402,4 +415,11 @@ void CSeqDBLMDBSet::GetLMDBFileNames(vector<string> & lmdb_list) const
 		lmdb_list.push_back(m_LMDBEntrySet[i]->GetLMDBFileName());
 	}
 }
+
+void CSeqDBLMDBSet::SetNumberOfThreads(int num_threads)
+{
+	for(unsigned int i=0; i < m_LMDBEntrySet.size(); i++) {
+		m_LMDBEntrySet[i]->SetNumberOfThreads(num_threads);
+	}
+}
 END_NCBI_SCOPE
@@ -42,6 +42,7 @@
 #include <objtools/blast/seqdb_reader/impl/seqdb_lmdb.hpp>
 #include <algo/blast/core/ncbi_std.h>
 #include "seqdbvolset.hpp"
+#include "seqdbbitset.hpp"
 
 BEGIN_NCBI_SCOPE
 
@@ -108,6 +109,8 @@ public:
 
     void GetTaxIdsForOids(const vector<blastdb::TOid> & oids, set<TTaxId> & tax_ids) const;
 
+    void SetNumberOfThreads(int num_threads) { m_LMDB->SetNumberOfThreads(num_threads); }
+
 private:
     void x_AdjustOidsOffset(vector<TOid> & oids) const;
     void x_AdjustOidsOffset_TaxList(vector<TOid> & oids) const;
@@ -167,6 +170,15 @@ public:
 
     void AccessionsToOids(const vector<string>& accs, vector<TOid>& oids) const;
 
+    /// Resolve accessions and set the bit of every OID found.
+    ///
+    /// Unlike the vector form, no per accession result is merged across
+    /// LMDB files; each file's lookups go directly into the bitset, so
+    /// an accession present in several files sets all of its OIDs.
+    /// @param accs Accessions to resolve [in]
+    /// @param oid_bits Bitset spanning the OID range of the db [in|out]
+    void AccessionsToOids(const vector<string>& accs, CSeqDB_BitSet & oid_bits) const;
+
     bool IsBlastDBVersion5() const { return (m_LMDBEntrySet.empty()? false:true); }
 
     void NegativeSeqIdsToOids(const vector<string>& ids, vector<blastdb::TOid>& rv) const;
@@ -181,6 +193,10 @@ public:
 
     void GetLMDBFileNames(vector<string> & lmdb_list) const;
 
+    /// Set the number of threads used to resolve batches of accessions
+    /// @param num_threads Number of threads [in]
+    void SetNumberOfThreads(int num_threads);
+
 private:
     vector<CRef<CSeqDBLMDBEntry> >  m_LMDBEntrySet;
 
@@ -36,6 +36,9 @@
 #include "seqdbfilter.hpp"
 #include <objtools/blast/seqdb_reader/impl/seqdbfile.hpp>
 #include "seqdbgilistset.hpp"
+#include <corelib/ncbifile.hpp>
+#include <corelib/ncbi_process.hpp>
+#include <util/checksum.hpp>
 #include <algorithm>
 
 BEGIN_NCBI_SCOPE
@@ -79,14 +82,28 @@ void CSeqDBOIDList::x_Setup(const CSeqDBVolSet       & volset,
     
     m_NumOIDs = volset.GetNumOIDs();
     
-    m_AllBits.Reset(new CSeqDB_BitSet(0, m_NumOIDs));
+    string cache_file = x_GetOidMaskCacheFile(volset, filters, gi_list, neg_list, lmdb_set);
     
+    // The user lists are translated even when the mask is cached, since
+    // callers read the OIDs found for each list entry (and the excluded
+    // OIDs of a negative list) back from the lists themselves.
     CSeqDBGiListSet gi_list_set(m_Atlas,
                                 volset,
                                 gi_list,
                                 neg_list,
                                 locked,
                                 lmdb_set);
+    
+    if ((! cache_file.empty()) && x_LoadOidMaskCache(cache_file)) {
+        while(m_NumOIDs && (! x_IsSet(m_NumOIDs - 1))) {
+            -- m_NumOIDs;
+        }
+        LOG_POST(Info << "Num Of Oids: " << m_NumOIDs << " (cached in " << cache_file << ")");
+        return;
+    }
+    
+    m_AllBits.Reset(new CSeqDB_BitSet(0, m_NumOIDs));
+    
     // Then get the list of filenames and offsets to overlay onto it.
 
     for(int i = 0; i < volset.GetNumVols(); i++) {
@@ -113,6 +130,10 @@ void CSeqDBOIDList::x_Setup(const CSeqDBVolSet       & volset,
         x_ApplyNegativeList(*neg_list, lmdb_set.IsBlastDBVersion5());
     }
     
+    if (! cache_file.empty()) {
+        x_SaveOidMaskCache(cache_file);
+    }
+    
     while(m_NumOIDs && (! x_IsSet(m_NumOIDs - 1))) {
         -- m_NumOIDs;
     }
@@ -507,6 +528,164 @@ CSeqDBOIDList::x_GetOidMask(const CSeqDB_Path & fn,
     return bitset;
 }
 
+/// Check that an ID list only holds Seq-ids (in v5 seqidlist format)
+/// and tax ids, the kinds of lists resolved through LMDB files.
+template<class TList>
+static bool s_IsCacheableIdList(TList & list)
+{
+    if (list.GetNumGis() || list.GetNumTis() || list.GetNumPigs()) {
+        return false;
+    }
+    if (list.GetNumSis() && list.GetListInfo().is_v4) {
+        return false;
+    }
+    return true;
+}
+
+static void s_AddToOidMaskKey(CChecksum & key, const string & tag, const vector<string> & ids)
+{
+    vector<string> sorted_ids(ids);
+    sort(sorted_ids.begin(), sorted_ids.end());
+    key.AddLine(tag + NStr::NumericToString(sorted_ids.size()));
+    ITERATE(vector<string>, itr, sorted_ids) {
+        key.AddLine(*itr);
+    }
+}
+
+static void s_AddToOidMaskKey(CChecksum & key, const string & tag, const set<TTaxId> & tax_ids)
+{
+    key.AddLine(tag + NStr::NumericToString(tax_ids.size()));
+    ITERATE(set<TTaxId>, itr, tax_ids) {
+        key.AddLine(NStr::NumericToString(TAX_ID_TO(Int8, *itr)));
+    }
+}
+
+string
+CSeqDBOIDList::x_GetOidMaskCacheFile(const CSeqDBVolSet       & volset,
+                                     const CSeqDB_FilterTree  & filters,
+                                     CRef<CSeqDBGiList>       & gi_list,
+                                     CRef<CSeqDBNegativeList> & neg_list,
+                                     const CSeqDBLMDBSet      & lmdb_set)
+{
+    const char * cache_dir = getenv("BLASTDB_OID_MASK_CACHE");
+    if ((cache_dir == NULL) || (*cache_dir == 0)) {
+        return kEmptyStr;
+    }
+    
+    // Only user seqid and taxid lists are cached; alias file filtering
+    // may refer to other files, which would also have to be tracked.
+    if ((! lmdb_set.IsBlastDBVersion5()) || filters.HasFilter()) {
+        return kEmptyStr;
+    }
+    bool have_pos = gi_list.NotEmpty() && gi_list->NotEmpty();
+    bool have_neg = neg_list.NotEmpty() && neg_list->NotEmpty();
+    if ((! have_pos) && (! have_neg)) {
+        return kEmptyStr;
+    }
+    if (have_pos && ((gi_list->GetMaskOpts() != 0) || ! s_IsCacheableIdList(*gi_list))) {
+        return kEmptyStr;
+    }
+    if (have_neg && ! s_IsCacheableIdList(*neg_list)) {
+        return kEmptyStr;
+    }
+    
+    CChecksum key(CChecksum::eMD5);
+    key.AddLine("OIDMASK-1");
+    for(int i = 0; i < volset.GetNumVols(); i++) {
+        const CSeqDBVolEntry * entry = volset.GetVolEntry(i);
+        const CSeqDBVol * vol = entry->Vol();
+        key.AddLine(vol->GetVolName());
+        key.AddLine(NStr::NumericToString(entry->OIDStart()) + "-" +
+                    NStr::NumericToString(entry->OIDEnd()));
+        key.AddLine(vol->GetDate());
+        key.AddLine(NStr::NumericToString(vol->GetVolumeLength()));
+    }
+    vector<string> lmdb_files;
+    lmdb_set.GetLMDBFileNames(lmdb_files);
+    ITERATE(vector<string>, itr, lmdb_files) {
+        CFile f(*itr);
+        CTime mtime;
+        f.GetTime(&mtime);
+        key.AddLine(*itr);
+        key.AddLine(NStr::NumericToString(f.GetLength()) + " " + mtime.AsString());
+    }
+    if (have_pos) {
+        vector<string> sis;
+        gi_list->GetSiList(sis);
+        s_AddToOidMaskKey(key, "SI+", sis);
+        s_AddToOidMaskKey(key, "TAXID+", gi_list->GetTaxIdsList());
+    }
+    if (have_neg) {
+        s_AddToOidMaskKey(key, "SI-", neg_list->GetSiList());
+        s_AddToOidMaskKey(key, "TAXID-", neg_list->GetTaxIdsList());
+    }
+    
+    return CDirEntry::MakePath(cache_dir, key.GetHexSum(), "oidmask");
+}
+
+bool CSeqDBOIDList::x_LoadOidMaskCache(const string & fname)
+{
+    if (! CFile(fname).Exists()) {
+        return false;
+    }
+    
+    try {
+        CMemoryFile mask_file(fname);
+        const TCUC * data = (const TCUC *) mask_file.GetPtr();
+        size_t file_length = mask_file.GetSize();
+        if ((data == NULL) || (file_length < sizeof(Uint4))) {
+            return false;
+        }
+        
+        // This is the index of the last oid, not the count of oids...
+        Uint4 num_oids = SeqDB_GetStdOrd((const Uint4 *) data) + 1;
+        size_t num_bytes = ((num_oids + 31) / 32) * 4;
+        if ((num_oids != (Uint4) m_NumOIDs) ||
+            (file_length != sizeof(Uint4) + num_bytes)) {
+            ERR_POST(Warning << "Ignoring stale OID mask cache file " << fname);
+            return false;
+        }
+        
+        const TCUC * bitmap = data + sizeof(Uint4);
+        m_AllBits.Reset(new CSeqDB_BitSet(0, m_NumOIDs, bitmap, bitmap + num_bytes));
+    }
+    catch (CException & e) {
+        ERR_POST(Warning << "Cannot read OID mask cache file " << fname << ": " << e.GetMsg());
+        return false;
+    }
+    return true;
+}
+
+void CSeqDBOIDList::x_SaveOidMaskCache(const string & fname)
+{
+    string tmp_name = fname + "." + NStr::NumericToString(CCurrentProcess::GetPid()) + ".tmp";
+    try {
+        {
+            CNcbiOfstream out(tmp_name.c_str(), IOS_BASE::out | IOS_BASE::binary);
+            if (! out) {
+                ERR_POST(Warning << "Cannot create OID mask cache file " << tmp_name);
+                return;
+            }
+            m_AllBits->WriteOidMask(out);
+            out.flush();
+            if (! out) {
+                out.close();
+                CFile(tmp_name).Remove();
+                ERR_POST(Warning << "Failed to write OID mask cache file " << tmp_name);
+                return;
+            }
+        }
+        if (! CFile(tmp_name).Rename(fname, CDirEntry::fRF_Overwrite)) {
+            CFile(tmp_name).Remove();
+            ERR_POST(Warning << "Failed to install OID mask cache file " << fname);
+        }
+    }
+    catch (CException & e) {
+        CFile(tmp_name).Remove();
+        ERR_POST(Warning << "Cannot save OID mask cache file " << fname << ": " << e.GetMsg());
+    }
+}
+
 void 
 CSeqDBOIDList::DebugDump(CDebugDumpContext ddc, unsigned int depth) const
 {
@@ -280,6 +280,47 @@ private:
                		      CSeqDB_BitSet 		   & filter_bit,
                		      CRef<CSeqDBGiList>	     user_list,
                           CRef<CSeqDBNegativeList>   neg_user_list);
+
+    /// Get the name of the cached OID mask for this filtering.
+    ///
+    /// Compiled OID masks for user seqid and taxid lists are kept in
+    /// the directory named by the BLASTDB_OID_MASK_CACHE environment
+    /// variable.  The file name is derived from the volume names, OID
+    /// ranges, creation dates and lengths of the database volumes, the
+    /// LMDB files backing them, and the contents of the user lists.
+    /// An empty string is returned if caching is disabled or does not
+    /// apply to this combination of filters.
+    ///
+    /// @param volset The set of database volumes.
+    /// @param filters The alias file filtering for the volumes.
+    /// @param gi_list The user (positive) ID list.
+    /// @param neg_list The negative user ID list.
+    /// @param lmdb_set The LMDB files for the volumes.
+    /// @return Path of the cached OID mask file, or an empty string.
+    string x_GetOidMaskCacheFile(const CSeqDBVolSet       & volset,
+                                 const CSeqDB_FilterTree  & filters,
+                                 CRef<CSeqDBGiList>       & gi_list,
+                                 CRef<CSeqDBNegativeList> & neg_list,
+                                 const CSeqDBLMDBSet      & lmdb_set);
+
+    /// Load the OID bit set from a cached OID mask file.
+    ///
+    /// The file is memory mapped; if it does not exist or does not
+    /// match the OID range of this database, false is returned and
+    /// the bit set is left unchanged.
+    ///
+    /// @param fname The cached OID mask file.
+    /// @return true if the bit set was loaded.
+    bool x_LoadOidMaskCache(const string & fname);
+
+    /// Save the OID bit set to a cached OID mask file.
+    ///
+    /// The mask is written to a temporary file which is then renamed,
+    /// so concurrent searches never see a partial file.  Failures are
+    /// reported as warnings only.
+    ///
+    /// @param fname The cached OID mask file.
+    void x_SaveOidMaskCache(const string & fname);
     
     /// The memory management layer object.
     CSeqDBAtlas & m_Atlas;
@@ -1361,6 +1361,7 @@ CSeqDBVol::GetBioseq(int                    oid,
     if (seqdata) {
         const char * seq_buffer = 0;
         int length = x_GetSequence(oid, & seq_buffer);
+        CSeqDBSeqDataHold seq_hold(seq_buffer);
 
         if (length < 1) {
             return null_result;
@@ -1533,6 +1534,7 @@ int CSeqDBVol::GetAmbigPartialSeq(int                oid,
 
     const char * tmp(0);
     int base_length = x_GetSequence(oid, &tmp);
+    CSeqDBSeqDataHold seq_hold(tmp);
 	if (base_length < 1) {
 	    NCBI_THROW(CSeqDBException, eFileErr, "Error: could not get sequence or range.");
 	}
@@ -1599,6 +1601,7 @@ int CSeqDBVol::x_GetAmbigSeq(int                oid,
 
     const char * tmp(0);
     int base_length = x_GetSequence(oid, &tmp);
+    CSeqDBSeqDataHold seq_hold(tmp);
 
     if (region && region->end > base_length )
         NCBI_THROW(CSeqDBException, eFileErr, "Error: region beyond sequence range.");
@@ -1781,7 +1784,7 @@ int CSeqDBVol::x_GetSequence(int              oid,
         // we expand the range here by one byte in both directions.
         // The normal consumer of this data relies on them, and can
         // walk off memory if a sequence ends on a slice boundary.        
-        *buffer = m_Seq->GetFileDataPtr(start_offset-1) + 1;
+        *buffer = m_Seq->GetFileDataPtr(start_offset-1, end_offset+1) + 1;
         if (! (*buffer - 1)) return -1;
 
     } else if ('n' == seqtype) {
@@ -1796,7 +1799,7 @@ int CSeqDBVol::x_GetSequence(int              oid,
         // will already have preserved the region.
 
         
-        *buffer = m_Seq->GetFileDataPtr(start_offset);
+        *buffer = m_Seq->GetFileDataPtr(start_offset, end_offset);
 
         if (! (*buffer))  return -1;
 
@@ -2349,10 +2352,10 @@ void CSeqDBVol::x_GetAmbChar(int              oid,
     if (length) {
         int total = length / 4;
 
-        // 'hold' should be false here because we only need the data
-        // for the duration of this function.        
-        Int4 * buffer =
-            (Int4*) m_Seq->GetFileDataPtr(start_offset);                                     
+        // The data is only needed for the duration of this function.
+        const char * data = m_Seq->GetFileDataPtr(start_offset, end_offset);
+        CSeqDBSeqDataHold data_hold(data);
+        const Int4 * buffer = (const Int4 *) data;
 
         // This is probably unnecessary
         total &= 0x7FFFFFFF;
@@ -2922,6 +2925,7 @@ CSeqDBVol::GetSeqData(int              oid,
         TSeqPos      length(0);
 
         length = x_GetSequence(oid, & buffer);
+        CSeqDBSeqDataHold seq_hold(buffer);
 
         if ((begin >= end) || (end > length)) {
             NCBI_THROW(CSeqDBException,
@@ -3037,7 +3041,7 @@ CSeqDBVol::GetRawSeqAndAmbig(int              oid,
     }
 
     if (buffer) {        
-        *buffer = m_Seq->GetFileDataPtr(map_begin);
+        *buffer = m_Seq->GetFileDataPtr(map_begin, map_end);
         *buffer += (start_S - map_begin);
     }
 
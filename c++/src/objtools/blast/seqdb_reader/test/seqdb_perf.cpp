@@ -35,6 +35,7 @@
 #include <corelib/ncbiapp.hpp>
 #include <corelib/ncbi_system.hpp>
 #include <corelib/ncbistr.hpp>
+#include <corelib/ncbifile.hpp>
 #include <objtools/blast/seqdb_reader/seqdbexpert.hpp>
 #ifdef _OPENMP
 #include <omp.h>
@@ -105,6 +106,11 @@ private:
     /// Processes all requests except printing the BLAST database information
     /// @return 0 on success; 1 if some sequences were not retrieved
     int x_ScanDatabase();
+
+    /// Get the size of the sequence files of the BLAST database
+    /// @param compressed set to true if any volume is block compressed [out]
+    /// @return number of bytes of sequence data on disk
+    Uint8 x_GetSequenceFileSize(bool& compressed) const;
 };
 
 void
@@ -124,6 +130,28 @@ CSeqDBPerfApp::x_ReportMemUsage() const
     cout << total << endl;
 }
 
+Uint8
+CSeqDBPerfApp::x_GetSequenceFileSize(bool& compressed) const
+{
+    const string kExtnMol(1, m_DbIsProtein ? 'p' : 'n');
+    vector<string> volumes;
+    m_BlastDb->FindVolumePaths(volumes);
+
+    Uint8 retval = 0;
+    compressed = false;
+    ITERATE(vector<string>, vol, volumes) {
+        CFile raw(*vol + "." + kExtnMol + "sq");
+        CFile zip(*vol + "." + kExtnMol + "sz");
+        if (raw.Exists()) {
+            retval += raw.GetLength();
+        } else if (zip.Exists()) {
+            retval += zip.GetLength();
+            compressed = true;
+        }
+    }
+    return retval;
+}
+
 int
 CSeqDBPerfApp::x_ScanDatabase()
 {
@@ -181,6 +209,18 @@ CSeqDBPerfApp::x_ScanDatabase()
     cout << "Scanning rate: "
          << NStr::NumericToString(bases, NStr::fWithCommas)
          << " bases/second" << endl;
+
+    // Compare runs on the raw and block compressed (makeblastdb
+    // -seq_compression) copies of a database to weigh the I/O saved
+    // against the decompression cost.
+    bool compressed = false;
+    Uint8 file_bytes = x_GetSequenceFileSize(compressed);
+    cout << "Sequence data: "
+         << NStr::UInt8ToString_DataSize(file_bytes) << " on disk ("
+         << (compressed ? "block compressed" : "raw") << "), read at "
+         << NStr::UInt8ToString_DataSize(
+                static_cast<Uint8>(file_bytes / sw.Elapsed()))
+         << "/second" << endl;
     return 0;
 }
 
@@ -43,6 +43,7 @@
 #include "../mask_info_registry.hpp"
 #include <sstream>
 
+#include <corelib/ncbithr.hpp>
 #include <corelib/test_boost.hpp>
 #include <boost/current_function.hpp>
 #include <objtools/blast/seqdb_writer/build_db.hpp>
@@ -77,6 +78,8 @@ s_FetchRawData(CSeqDBExpert & seqdb,
 
     sequence.assign(buffer, slength);
     ambig.assign(buffer + slength, alength);
+
+    seqdb.RetSequence(& buffer);
 }
 
 // Return a Seq-id built from the given int (gi).
@@ -1096,6 +1099,176 @@ BOOST_AUTO_TEST_CASE(ProtBioseqDup)
                        "raw protein dup");
 }
 
+BOOST_AUTO_TEST_CASE(CompressedSequenceFiles)
+{
+    const string srcname("data/writedb_nucl");
+    const string dstname("w-nucl-compressed");
+    const string title("compressed nucleotide dup");
+
+    CSeqDBExpert src(srcname, CSeqDB::eNucleotide);
+    vector<string> files;
+
+    {{
+        CRef<CWriteDB> db(new CWriteDB(dstname,
+                                       CWriteDB::eNucleotide,
+                                       title,
+                                       CWriteDB::eFullIndex));
+
+        for(int oid = 0; src.CheckOrFindOID(oid); oid++) {
+            string seq, ambig;
+            s_FetchRawData(src, oid, seq, ambig);
+            db->AddSequence(seq, ambig);
+            db->SetDeflines(*src.GetHdr(oid));
+        }
+
+        db->Close();
+        db->ListFiles(files);
+    }}
+
+    // Use small blocks, so that most sequences span several of them.
+    CWriteDB_CompressSequenceFiles(dstname, CWriteDB::eNucleotide,
+                                   eSeqDBSeqCompress_Zlib, 1000);
+    files.push_back(dstname + ".nsz");
+
+    BOOST_REQUIRE(! CFile(dstname + ".nsq").Exists());
+    BOOST_REQUIRE(CFile(dstname + ".nsz").Exists());
+    BOOST_REQUIRE(CFile(dstname + ".nsz").GetLength() <
+                  CFile(srcname + ".nsq").GetLength());
+
+    s_TestDatabase(src, dstname, title);
+
+    CSeqDBExpert dst(dstname, CSeqDB::eNucleotide);
+    BOOST_REQUIRE_EQUAL(src.GetNumOIDs(), dst.GetNumOIDs());
+
+    for(int oid = 0; src.CheckOrFindOID(oid); oid++) {
+        const char * src_seq = 0;
+        const char * dst_seq = 0;
+
+        int src_len = src.GetSequence(oid, & src_seq);
+        int dst_len = dst.GetSequence(oid, & dst_seq);
+
+        BOOST_REQUIRE_EQUAL(src_len, dst_len);
+        BOOST_REQUIRE(memcmp(src_seq, dst_seq, (src_len + 3) / 4) == 0);
+
+        src.RetSequence(& src_seq);
+        dst.RetSequence(& dst_seq);
+    }
+
+    s_RemoveFiles(files);
+}
+
+// Reads a compressed protein database in a thread of its own, so that
+// the thread's cache of uncompressed data is created with the current
+// BLASTDB_SEQ_CACHE_SIZE.  The first two sequences are held while all
+// of the others are read.
+
+class CHeldSequenceReader : public CThread {
+public:
+    CHeldSequenceReader(const string & dbname)
+        : m_DbName(dbname)
+    {
+    }
+
+    vector<string> m_Held;
+    string m_Error;
+
+protected:
+    virtual void * Main()
+    {
+        try {
+            CSeqDB db(m_DbName, CSeqDB::eProtein);
+
+            const char * first = 0;
+            const char * second = 0;
+            int first_len = db.GetSequence(0, & first);
+            int second_len = db.GetSequence(1, & second);
+
+            for(int oid = 2; db.CheckOrFindOID(oid); oid++) {
+                const char * seq = 0;
+                db.GetSequence(oid, & seq);
+                db.RetSequence(& seq);
+                db.GetBioseq(oid);
+            }
+
+            m_Held.push_back(string(first, first_len));
+            m_Held.push_back(string(second, second_len));
+
+            db.RetSequence(& first);
+            db.RetSequence(& second);
+        }
+        catch (const exception & e) {
+            m_Error = e.what();
+        }
+        return NULL;
+    }
+
+private:
+    string m_DbName;
+};
+
+BOOST_AUTO_TEST_CASE(CompressedSequencesHeldUnderSmallCache)
+{
+    const string dbname("w-prot-compressed-held");
+    const int kNumSeqs = 6;
+    const int kLength = 20000;
+
+    vector<string> seqs;
+    vector<string> files;
+
+    {{
+        CWriteDB db(dbname,
+                    CWriteDB::eProtein,
+                    "compressed long proteins",
+                    CWriteDB::eFullIndex);
+
+        for(int i = 0; i < kNumSeqs; i++) {
+            string seq(kLength, 0);
+            for(int j = 0; j < kLength; j++) {
+                seq[j] = (char) (1 + (j * 7 + j / 11 + i * 13) % 24);
+            }
+            seqs.push_back(seq);
+
+            CRef<CBlast_def_line_set> bdls(new CBlast_def_line_set);
+            CRef<CBlast_def_line> dl(new CBlast_def_line);
+            bdls->Set().push_back(dl);
+            dl->SetTitle("Long protein " + NStr::IntToString(i));
+            dl->SetSeqid().push_back
+                (CRef<CSeq_id>(new CSeq_id("lcl|long" +
+                                           NStr::IntToString(i))));
+
+            db.AddSequence(seq);
+            db.SetDeflines(*bdls);
+        }
+
+        db.Close();
+        db.ListFiles(files);
+    }}
+
+    // Each sequence spans many blocks, and the cache only keeps the
+    // most recently used entry, so the held sequences are evicted from
+    // it long before they are returned.
+    CWriteDB_CompressSequenceFiles(dbname,
+                                   CWriteDB::eProtein,
+                                   eSeqDBSeqCompress_Zlib, 1024);
+    files.push_back(dbname + ".psz");
+    BOOST_REQUIRE(! CFile(dbname + ".psq").Exists());
+
+    CNcbiApplication::Instance()->SetEnvironment("BLASTDB_SEQ_CACHE_SIZE",
+                                                 "1");
+    CRef<CHeldSequenceReader> reader(new CHeldSequenceReader(dbname));
+    reader->Run();
+    reader->Join();
+    CNcbiApplication::Instance()->SetEnvironment().
+        Unset("BLASTDB_SEQ_CACHE_SIZE");
+
+    BOOST_REQUIRE_EQUAL(reader->m_Error, string());
+    BOOST_REQUIRE_EQUAL(reader->m_Held.size(), 2u);
+    BOOST_REQUIRE(reader->m_Held[0] == seqs[0]);
+    BOOST_REQUIRE(reader->m_Held[1] == seqs[1]);
+
+    s_RemoveFiles(files);
+}
+
 BOOST_AUTO_TEST_CASE(EmptyBioseq)
 {
 
@@ -35,6 +35,9 @@
 #include <objtools/blast/seqdb_reader/impl/seqdbgeneral.hpp>
 #include "writedb_impl.hpp"
 #include <objtools/blast/seqdb_writer/writedb_convert.hpp>
+#include <corelib/ncbifile.hpp>
+#include <util/compress/zlib.hpp>
+#include <util/compress/zstd.hpp>
 #include <iostream>
 
 BEGIN_NCBI_SCOPE
@@ -620,5 +623,176 @@ void CWriteDB_CreateOidMaskDB(const string& input_db,
 	ofs << "LENGTH " << total_length << endl;
 }
 
+/// Compress one block of sequence data.
+/// @param method Compression method [in]
+/// @param src Uncompressed data [in]
+/// @param src_len Length of the uncompressed data [in]
+/// @param dst Compressed data [out]
+static void s_CompressSeqBlock(ESeqDBSeqCompression method,
+                               const char         * src,
+                               size_t               src_len,
+                               vector<char>       & dst)
+{
+    unique_ptr<CCompression> codec;
+
+    switch (method) {
+    case eSeqDBSeqCompress_None:
+        dst.assign(src, src + src_len);
+        return;
+
+    case eSeqDBSeqCompress_Zlib:
+        codec.reset(new CZipCompression(CCompression::eLevel_Default));
+        break;
+
+#if defined(HAVE_LIBZSTD)
+    case eSeqDBSeqCompress_Zstd:
+        codec.reset(new CZstdCompression(CCompression::eLevel_Default));
+        break;
+#endif
+
+    default:
+        NCBI_THROW(CWriteDBException, eArgErr,
+                   "Unsupported sequence compression method.");
+    }
+
+    size_t dst_len = 0;
+    dst.resize(codec->EstimateCompressionBufferSize(src_len) + src_len + 64);
+    if ( !codec->CompressBuffer(src, src_len, & dst[0], dst.size(), & dst_len) ) {
+        NCBI_THROW(CWriteDBException, eFileErr,
+                   "Failed to compress sequence data: " +
+                   codec->GetErrorDescription());
+    }
+    dst.resize(dst_len);
+}
+
+/// Write the block compressed form of a sequence file.
+///
+/// The layout is described in seqdb_reader/sequence_files.txt.
+/// Blocks are compressed in batches, in parallel if OpenMP is enabled.
+///
+/// @param input Name of the .psq or .nsq file [in]
+/// @param output Name of the .psz or .nsz file [in]
+/// @param method Compression method [in]
+/// @param block_size Uncompressed size of the blocks [in]
+static void s_CompressSequenceFile(const string       & input,
+                                   const string       & output,
+                                   ESeqDBSeqCompression method,
+                                   Uint4                block_size)
+{
+    CMemoryFile in(input);
+    const char * data = (const char *) in.GetPtr();
+    Uint8 length = in.GetSize();
+
+    Uint4 num_blocks = (Uint4) ((length + block_size - 1) / block_size);
+
+    CNcbiOfstream out(output.c_str(), IOS_BASE::out | IOS_BASE::binary);
+    if ( !out ) {
+        NCBI_THROW(CWriteDBException, eFileErr, "Cannot create " + output);
+    }
+
+    s_WriteInt4(out, kSeqDBSeqCompressFormat);
+    s_WriteInt4(out, method);
+    s_WriteInt4(out, block_size);
+    s_WriteInt4(out, num_blocks);
+    s_WriteInt8BE(out, length);
+
+    // Reserve the block table; it is filled in once the blocks are
+    // written and their sizes are known.
+    const Uint8 table_start = 4 * sizeof(Uint4) + sizeof(Uint8);
+    vector<Uint8> offsets;
+    offsets.reserve(num_blocks + 1);
+    for (Uint4 i = 0; i <= num_blocks; i++) {
+        s_WriteInt8BE(out, 0);
+    }
+    Uint8 offset = table_start + sizeof(Uint8) * ((Uint8) num_blocks + 1);
+
+    const int kBatchSize = 256;
+    vector< vector<char> > batch(kBatchSize);
+
+    for (Uint4 first = 0; first < num_blocks; first += kBatchSize) {
+        int n = (int) min((Uint4) kBatchSize, num_blocks - first);
+
+        // Exceptions must not leave the parallel region; the first
+        // error is rethrown after it.
+        string error;
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < n; i++) {
+            Uint8 begin = (Uint8) (first + i) * block_size;
+            size_t len = (size_t) min((Uint8) block_size, length - begin);
+            try {
+                s_CompressSeqBlock(method, data + begin, len, batch[i]);
+            }
+            catch (const CException & e) {
+#pragma omp critical
+                if (error.empty()) {
+                    error = e.GetMsg();
+                }
+            }
+        }
+        if ( !error.empty() ) {
+            NCBI_THROW(CWriteDBException, eFileErr, error);
+        }
+
+        for (int i = 0; i < n; i++) {
+            offsets.push_back(offset);
+            out.write(& batch[i][0], batch[i].size());
+            offset += batch[i].size();
+        }
+    }
+    offsets.push_back(offset);
+
+    out.seekp(table_start);
+    ITERATE(vector<Uint8>, off, offsets) {
+        s_WriteInt8BE(out, *off);
+    }
+    out.flush();
+
+    if ( !out ) {
+        NCBI_THROW(CWriteDBException, eFileErr, "Cannot write " + output);
+    }
+}
+
+void CWriteDB_CompressSequenceFiles(const string& db_name,
+                                    CWriteDB::ESeqType seq_type,
+                                    ESeqDBSeqCompression method,
+                                    Uint4 block_size)
+{
+#if !defined(HAVE_LIBZSTD)
+    if (method == eSeqDBSeqCompress_Zstd) {
+        NCBI_THROW(CWriteDBException, eArgErr,
+                   "zstd compression is not available in this build.");
+    }
+#endif
+    if (block_size == 0) {
+        NCBI_THROW(CWriteDBException, eArgErr, "Invalid block size.");
+    }
+
+    bool is_protein = (seq_type == CWriteDB::eProtein);
+    vector<string> vols;
+    CSeqDB::FindVolumePaths(db_name,
+                            is_protein ? CSeqDB::eProtein : CSeqDB::eNucleotide,
+                            vols);
+
+    const string kRawExt = is_protein ? ".psq" : ".nsq";
+    const string kZipExt = is_protein ? ".psz" : ".nsz";
+
+    ITERATE(vector<string>, vol, vols) {
+        CFile raw(*vol + kRawExt);
+        if ( !raw.Exists() ) {
+            continue;
+        }
+        string zip_name = *vol + kZipExt;
+        try {
+            s_CompressSequenceFile(raw.GetPath(), zip_name, method,
+                                   block_size);
+        }
+        catch (...) {
+            CFile(zip_name).Remove();
+            throw;
+        }
+        raw.Remove();
+    }
+}
+
 END_NCBI_SCOPE
 
@@ -204,6 +204,17 @@ CBlastDbDataLoader::~CBlastDbDataLoader(void)
 {
 }
 
+CBlastDbDataLoader::SCacheStatistics::SCacheStatistics()
+    : m_HeaderHits(0), m_HeaderMisses(0),
+      m_SeqDataHits(0), m_SeqDataMisses(0)
+{}
+
+CBlastDbDataLoader::SCacheStatistics
+CBlastDbDataLoader::GetCacheStatistics(void)
+{
+    return CBlastDbDataCache::GetStatistics();
+}
+
 /// A BLAST DB (blob) ID
 /// The first field represents an OID in the BLAST database
 typedef pair<int, CSeq_id_Handle> TBlastDbId;
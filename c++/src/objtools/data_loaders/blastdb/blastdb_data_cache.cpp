@@ -0,0 +1,143 @@
+/*  $Id$
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*/
+
+/** @file blastdb_data_cache.cpp
+ * Defines the CBlastDbDataCache class
+ */
+#include <ncbi_pch.hpp>
+#include "blastdb_data_cache.hpp"
+#include <atomic>
+
+BEGIN_NCBI_SCOPE
+BEGIN_SCOPE(objects)
+
+/// Caches of the process, by database
+typedef map<string, CRef<CBlastDbDataCache> > TBlastDbDataCaches;
+
+DEFINE_STATIC_FAST_MUTEX(s_Caches_Mutex);
+
+/// Statistics of all caches of the process; kept outside of the caches so
+/// that private caches, which are not registered, are counted as well
+static atomic<Uint8> s_HeaderHits(0);
+static atomic<Uint8> s_HeaderMisses(0);
+static atomic<Uint8> s_SeqDataHits(0);
+static atomic<Uint8> s_SeqDataMisses(0);
+
+/// Returns the caches of the process; the map is never destroyed, so the
+/// caches can be used by data loaders released at exit
+static TBlastDbDataCaches& s_GetCaches(void)
+{
+    static TBlastDbDataCaches* caches = new TBlastDbDataCaches;
+    return *caches;
+}
+
+CBlastDbDataCache::CBlastDbDataCache()
+    : m_Headers(kHeaderCacheSize),
+      m_SeqData(kSeqDataCacheSize)
+{
+}
+
+CRef<CBlastDbDataCache>
+CBlastDbDataCache::GetInstance(const string& db_key)
+{
+    CFastMutexGuard guard(s_Caches_Mutex);
+    CRef<CBlastDbDataCache>& retval = s_GetCaches()[db_key];
+    if (retval.Empty()) {
+        retval.Reset(new CBlastDbDataCache);
+    }
+    return retval;
+}
+
+CRef<CBlastDbDataCache>
+CBlastDbDataCache::CreatePrivate(void)
+{
+    return CRef<CBlastDbDataCache>(new CBlastDbDataCache);
+}
+
+CBlastDbDataLoader::SCacheStatistics
+CBlastDbDataCache::GetStatistics(void)
+{
+    CBlastDbDataLoader::SCacheStatistics retval;
+    retval.m_HeaderHits = s_HeaderHits;
+    retval.m_HeaderMisses = s_HeaderMisses;
+    retval.m_SeqDataHits = s_SeqDataHits;
+    retval.m_SeqDataMisses = s_SeqDataMisses;
+    return retval;
+}
+
+CRef<CBioseq>
+CBlastDbDataCache::GetHeader(const THeaderKey& key)
+{
+    CRef<CBioseq> retval;
+    THeaderCache::EGetResult result;
+    CConstRef<CBioseq> cached =
+        m_Headers.Get(key, THeaderCache::fGet_NoInsert, &result);
+    if (result == THeaderCache::eGet_Found) {
+        s_HeaderHits++;
+        retval.Reset(new CBioseq);
+        retval->Assign(*cached);
+    } else {
+        s_HeaderMisses++;
+    }
+    return retval;
+}
+
+void
+CBlastDbDataCache::AddHeader(const THeaderKey& key, const CBioseq& bioseq)
+{
+    CRef<CBioseq> copy(new CBioseq);
+    copy->Assign(bioseq);
+    m_Headers.Add(key, CConstRef<CBioseq>(copy));
+}
+
+CRef<CSeq_data>
+CBlastDbDataCache::GetSeqData(const TSeqDataKey& key)
+{
+    CRef<CSeq_data> retval;
+    TSeqDataCache::EGetResult result;
+    CConstRef<CSeq_data> cached =
+        m_SeqData.Get(key, TSeqDataCache::fGet_NoInsert, &result);
+    if (result == TSeqDataCache::eGet_Found) {
+        s_SeqDataHits++;
+        retval.Reset(new CSeq_data);
+        retval->Assign(*cached);
+    } else {
+        s_SeqDataMisses++;
+    }
+    return retval;
+}
+
+void
+CBlastDbDataCache::AddSeqData(const TSeqDataKey& key,
+                              const CSeq_data& seq_data)
+{
+    CRef<CSeq_data> copy(new CSeq_data);
+    copy->Assign(seq_data);
+    m_SeqData.Add(key, CConstRef<CSeq_data>(copy));
+}
+
+END_SCOPE(objects)
+END_NCBI_SCOPE
@@ -0,0 +1,104 @@
+#ifndef OBJTOOLS_DATA_LOADERS_BLASTDB___BLASTDB_DATA_CACHE__HPP
+#define OBJTOOLS_DATA_LOADERS_BLASTDB___BLASTDB_DATA_CACHE__HPP
+
+/*  $Id$
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*/
+/** @file blastdb_data_cache.hpp
+ * Defines the CBlastDbDataCache class
+ */
+
+#include <objtools/data_loaders/blastdb/bdbloader.hpp>
+#include <objects/seq/Bioseq.hpp>
+#include <objects/seq/Seq_data.hpp>
+#include <util/ncbi_cache.hpp>
+
+BEGIN_NCBI_SCOPE
+BEGIN_SCOPE(objects)
+
+/// Bounded least recently used cache of the sequence headers (Bioseqs
+/// without sequence data) and sequence data slices decoded from one BLAST
+/// database.  The caches are shared by all data loaders of the process that
+/// use the same unfiltered database, and are safe to use from multiple
+/// threads.  Databases opened with a user GI/TI/Seq-id or negative list get
+/// a private cache, as their headers only contain the listed IDs.  The
+/// cached objects are never handed out: callers get copies, as the object
+/// manager takes ownership of (and modifies) the objects it loads.
+class CBlastDbDataCache : public CObject {
+public:
+    enum {
+        /// Maximum number of sequence headers cached per database
+        kHeaderCacheSize = 4096,
+        /// Maximum number of sequence data slices cached per database
+        kSeqDataCacheSize = 512,
+        /// Slices longer than this are not cached
+        kMaxCachedSliceLength = kSequenceSliceSize
+    };
+
+    /// Key of a sequence header: the OID and the Seq-id to promote
+    typedef pair<int, CSeq_id_Handle> THeaderKey;
+
+    /// Key of a sequence data slice: the OID, start and end offsets
+    typedef pair<int, pair<int, int> > TSeqDataKey;
+
+    /// Get the cache of a BLAST database, creating it if needed
+    /// @param db_key Names and molecule type of the database [in]
+    static CRef<CBlastDbDataCache> GetInstance(const string& db_key);
+
+    /// Create a cache which is not shared with other data loaders
+    static CRef<CBlastDbDataCache> CreatePrivate(void);
+
+    /// Get the statistics of all caches of the process, shared or private
+    static CBlastDbDataLoader::SCacheStatistics GetStatistics(void);
+
+    /// Get a copy of a cached sequence header
+    /// @return NULL if the header is not cached
+    CRef<CBioseq> GetHeader(const THeaderKey& key);
+
+    /// Cache a copy of a sequence header
+    void AddHeader(const THeaderKey& key, const CBioseq& bioseq);
+
+    /// Get a copy of a cached sequence data slice
+    /// @return NULL if the slice is not cached
+    CRef<CSeq_data> GetSeqData(const TSeqDataKey& key);
+
+    /// Cache a copy of a sequence data slice
+    void AddSeqData(const TSeqDataKey& key, const CSeq_data& seq_data);
+
+private:
+    typedef CCache<THeaderKey, CConstRef<CBioseq> > THeaderCache;
+    typedef CCache<TSeqDataKey, CConstRef<CSeq_data> > TSeqDataCache;
+
+    /// Use GetInstance() or CreatePrivate()
+    CBlastDbDataCache();
+
+    THeaderCache        m_Headers;          ///< Cached sequence headers
+    TSeqDataCache       m_SeqData;          ///< Cached sequence data slices
+};
+
+END_SCOPE(objects)
+END_NCBI_SCOPE
+
+#endif /* OBJTOOLS_DATA_LOADERS_BLASTDB___BLASTDB_DATA_CACHE__HPP */
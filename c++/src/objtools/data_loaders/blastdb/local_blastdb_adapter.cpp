@@ -80,10 +80,36 @@ CLocalBlastDbAdapter::GetSeqIDs(int oid)
     return m_SeqDB->GetSeqIDs(oid);
 }
 
+void
+CLocalBlastDbAdapter::x_InitCache()
+{
+    // The headers of a database filtered by a user list only contain the
+    // listed IDs, so they must not be served to (or from) other handles
+    if (m_SeqDB->GetGiList() != NULL || m_SeqDB->GetNegativeList() != NULL) {
+        m_Cache = CBlastDbDataCache::CreatePrivate();
+        return;
+    }
+    const string kDbKey = m_SeqDB->GetDBNameList() +
+        (m_SeqDB->GetSequenceType() == CSeqDB::eProtein ? "(p)" : "(n)");
+    m_Cache = CBlastDbDataCache::GetInstance(kDbKey);
+}
+
 CRef<CBioseq> 
 CLocalBlastDbAdapter::GetBioseqNoData(int oid, TGi target_gi /* = 0 */, const CSeq_id * target_id /* = NULL */)
 {
-    return m_SeqDB->GetBioseqNoData(oid, target_gi, target_id);
+    if (target_gi != ZERO_GI) {
+        return m_SeqDB->GetBioseqNoData(oid, target_gi, target_id);
+    }
+
+    const CBlastDbDataCache::THeaderKey kKey(oid, target_id
+                                   ? CSeq_id_Handle::GetHandle(*target_id)
+                                   : CSeq_id_Handle());
+    CRef<CBioseq> retval = m_Cache->GetHeader(kKey);
+    if (retval.Empty()) {
+        retval = m_SeqDB->GetBioseqNoData(oid, target_gi, target_id);
+        m_Cache->AddHeader(kKey, *retval);
+    }
+    return retval;
 }
 
 /// Assigns a buffer of nucleotide sequence data as retrieved from CSeqDB into
@@ -121,6 +147,18 @@ CLocalBlastDbAdapter::GetSequence(int oid,
                                   int begin /* = 0 */, 
                                   int end /* = 0*/)
 {
+    // Slices are cached only when they are short enough, whole sequences
+    // of unknown length are never cached
+    const bool kCache = (begin != end &&
+        (end - begin) <= CBlastDbDataCache::kMaxCachedSliceLength);
+    const CBlastDbDataCache::TSeqDataKey kKey(oid, make_pair(begin, end));
+    if (kCache) {
+        CRef<CSeq_data> cached = m_Cache->GetSeqData(kKey);
+        if (cached.NotEmpty()) {
+            return cached;
+        }
+    }
+
     const bool kIsProtein = (GetSequenceType() == CSeqDB::eProtein)
         ? true : false;
     const int kNuclCode(kSeqDBNuclNcbiNA8);
@@ -154,6 +192,9 @@ CLocalBlastDbAdapter::GetSequence(int oid,
             m_SeqDB->RetAmbigSeq(&buffer);
         }
     }
+    if (kCache) {
+        m_Cache->AddSeqData(kKey, *retval);
+    }
     return retval;
 }
 
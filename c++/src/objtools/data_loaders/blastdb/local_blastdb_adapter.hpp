@@ -36,6 +36,7 @@
   */
 
 #include <objtools/data_loaders/blastdb/blastdb_adapter.hpp>
+#include "blastdb_data_cache.hpp"
 
 BEGIN_NCBI_SCOPE
 BEGIN_SCOPE(objects)
@@ -48,13 +49,17 @@ class NCBI_XLOADER_BLASTDB_EXPORT CLocalBlastDbAdapter : public IBlastDbAdapter
 public:
     /// Constructor with a CSeqDB instance
     /// @param seqdb CSeqDB object to initialize this object with [in]
-    CLocalBlastDbAdapter(CRef<CSeqDB> seqdb) : m_SeqDB(seqdb) {}
+    CLocalBlastDbAdapter(CRef<CSeqDB> seqdb) : m_SeqDB(seqdb) {
+        x_InitCache();
+    }
 
     /// Constructor with a CSeqDB instance
     /// @param db_name database name [in]
     /// @param db_type database molecule type [in]
     CLocalBlastDbAdapter(const string& db_name, CSeqDB::ESeqType db_type)
-        : m_SeqDB(new CSeqDB(db_name, db_type)) {}
+        : m_SeqDB(new CSeqDB(db_name, db_type)) {
+        x_InitCache();
+    }
 
 	/** @inheritDoc */
     virtual CSeqDB::ESeqType GetSequenceType();
@@ -72,8 +77,14 @@ public:
     virtual TTaxId GetTaxId(const CSeq_id_Handle& id);
     
 private:
+    /// Attach the cache shared by the adapters of this BLAST database, or a
+    /// private one if the database is filtered by a user list
+    void x_InitCache();
+
     /// The BLAST database handle
     CRef<CSeqDB> m_SeqDB;
+    /// Decoded sequence headers and sequence data
+    CRef<CBlastDbDataCache> m_Cache;
 };
 
 END_SCOPE(objects)